@@ -1,10 +1,16 @@
 #include "LCD1602A.h"
 #include <string.h>
-#include <stdio.h>
-#include <stdarg.h>
 #include "sys/time.h"
 #include "sam.h"
 #include "Plants_definitions.h"
+#include "warm_state.h"
+#include "boot_monitor.h"
+#include "fmt.h"
+#include "runtime_config.h"
+#include "ramfunc.h"
+#include "app_msg.h"
+#include "app_state.h"
+#include "energy_monitor.h"
 //#include "de"
 
 // LCD display control states
@@ -18,18 +24,54 @@ int current_plant_index = 0;
 
 // Number of plants in the lookup table
 #define NUM_PLANTS (sizeof(PLANT_THRESHOLDS) / sizeof(PLANT_THRESHOLDS[0]))
+const int PLANT_THRESHOLDS_COUNT = NUM_PLANTS;
+
+// HD44780 power-up sequence: each step writes one nibble or a full command,
+// then waits at least wait_us before the next step
+#define LCD_POWER_UP_DELAY_US 50000U  // Wait for LCD to initialize
+typedef struct {
+    uint8_t value;
+    bool nibble_only;
+    uint16_t wait_us;
+} LcdInitStep;
+
+static const LcdInitStep lcd_init_sequence[] = {
+    { 0x03, true, 4100 },   // Function set: 8-bit interface, wait min 4.1ms
+    { 0x03, true, 150 },    // Function set: 8-bit interface, wait min 100us
+    { 0x03, true, 150 },    // Function set: 8-bit interface, wait min 100us
+    { 0x02, true, 150 },    // Function set: set to 4-bit interface, wait min 100us
+    // Now in 4-bit mode, set up the display
+    { LCD_FUNCTIONSET | LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS, false, 100 },
+    // Turn on the display with no cursor or blinking
+    { LCD_DISPLAYCONTROL | LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF, false, 100 },
+    // Initialize display mode
+    { LCD_ENTRYMODESET | LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT, false, 100 },
+    // Clear the display; this command takes a long time
+    { LCD_CLEARDISPLAY, false, 2000 }
+};
+#define LCD_INIT_STEPS (sizeof(lcd_init_sequence) / sizeof(lcd_init_sequence[0]))
+
+// Non-blocking initialization progress
+static uint8_t lcd_init_step;
+static uint32_t lcd_init_deadline_us;
+static bool lcd_ready = false;
 
 // Helper functions for LCD
-static void lcd_pulse_enable(void) {
+static void lcd_strobe_enable(void) {
     LCD_EN_Set();
 //    PORT->Group[0].OUTSET.reg = (1ul << LCD_EN_PIN);
     delay_us(1);    // Enable pulse must be > 450ns
     LCD_EN_Clear();
 //    PORT->Group[0].OUTCLR.reg = (1ul << LCD_EN_PIN);
+}
+
+static void lcd_pulse_enable(void) {
+    lcd_strobe_enable();
     delay_us(100);  // Commands need > 37us to settle
 }
 
-static void lcd_write4bits(uint8_t value) {
+// Put a nibble on D4-D7 without strobing
+RAMFUNC static void lcd_set_data_pins(uint8_t value) {
      // Set individual data pins
     if (value & 0x01)
         LCD_D4_Set();
@@ -50,11 +92,27 @@ static void lcd_write4bits(uint8_t value) {
         LCD_D7_Set();
     else
         LCD_D7_Clear();
-    
+}
+
+static void lcd_write4bits(uint8_t value) {
+    lcd_set_data_pins(value);
     lcd_pulse_enable();
 }
 
+// Write one init step without the settle delay; the caller schedules the wait
+static void lcd_write_init_step(const LcdInitStep *step) {
+    energy_monitor_count(ENERGY_LCD, step->wait_us);
+    LCD_RS_Clear();
+    if (!step->nibble_only) {
+        lcd_set_data_pins(step->value >> 4);
+        lcd_strobe_enable();
+    }
+    lcd_set_data_pins(step->value);
+    lcd_strobe_enable();
+}
+
 static void lcd_send(uint8_t value, uint8_t mode) {
+    energy_monitor_count(ENERGY_LCD, ENERGY_LCD_SEND_US);
     if (mode)
         LCD_RS_Set();
     else
@@ -75,11 +133,13 @@ void lcd_write(uint8_t value) {
 
 void lcd_clear(void) {
     lcd_command(LCD_CLEARDISPLAY);
+    energy_monitor_count(ENERGY_LCD, 2000U);
     delay_ms(2); // This command takes a long time
 }
 
 void lcd_home(void) {
     lcd_command(LCD_RETURNHOME);
+    energy_monitor_count(ENERGY_LCD, 2000U);
     delay_ms(2); // This command takes a long time
 }
 
@@ -103,38 +163,48 @@ void lcd_init(void) {
     // Configure pins as outputs
 
     // Wait for LCD to initialize
-    delay_ms(50);
-    
-    // Start in 8-bit mode, try to set to 4-bit mode
-//    PORT->Group[0].OUTCLR.reg = (1ul << LCD_RS_PIN);
-//    PORT->Group[0].OUTCLR.reg = (1ul << LCD_EN_PIN);
-//    
-    // Initialization sequence
-    lcd_write4bits(0x03);  // Function set: 8-bit interface
-    delay_ms(5);           // Wait min 4.1ms
-    
-    lcd_write4bits(0x03);  // Function set: 8-bit interface
-    delay_us(150);         // Wait min 100us
-    
-    lcd_write4bits(0x03);  // Function set: 8-bit interface
-    delay_us(150);         // Wait min 100us
-    
-    lcd_write4bits(0x02);  // Function set: set to 4-bit interface
-    delay_us(150);         // Wait min 100us
-    
-    // Now in 4-bit mode, set up the display
-    lcd_command(LCD_FUNCTIONSET | LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS);
-    
-    // Turn on the display with no cursor or blinking
+    delay_us(LCD_POWER_UP_DELAY_US);
+
+    // Start in 8-bit mode, switch to 4-bit mode and set up the display
+    for (uint8_t i = 0; i < LCD_INIT_STEPS; i++) {
+        lcd_write_init_step(&lcd_init_sequence[i]);
+        delay_us(lcd_init_sequence[i].wait_us);
+    }
+
     _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
-    lcd_display();
-    
-    // Initialize display mode
     _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-    lcd_command(LCD_ENTRYMODESET | _displaymode);
-    
-    // Clear the display
-    lcd_clear();
+    lcd_ready = true;
+}
+
+void lcd_init_start(void) {
+    lcd_ready = false;
+    lcd_init_step = 0;
+    lcd_init_deadline_us = boot_monitor_now_us() + LCD_POWER_UP_DELAY_US;
+}
+
+bool lcd_init_poll(void) {
+    if (lcd_ready) {
+        return true;
+    }
+    // Signed difference keeps the comparison correct across counter wrap
+    if ((int32_t)(boot_monitor_now_us() - lcd_init_deadline_us) < 0) {
+        return false;
+    }
+    if (lcd_init_step < LCD_INIT_STEPS) {
+        const LcdInitStep *step = &lcd_init_sequence[lcd_init_step++];
+        lcd_write_init_step(step);
+        lcd_init_deadline_us = boot_monitor_now_us() + step->wait_us;
+        return false;
+    }
+
+    _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
+    _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+    lcd_ready = true;
+    return true;
+}
+
+bool lcd_is_ready(void) {
+    return lcd_ready;
 }
 
 void lcd_print(const char* str) {
@@ -151,15 +221,17 @@ int map(int x, int in_min, int in_max, int out_min, int out_max) {
 
 // Function to get moisture status for a given plant and moisture reading
 MoistureStatus getMoistureStatus(const char* plant_name, int moisture_percent) {
-    // Search for the plant in our lookup table
-    for (int i = 0; i < NUM_PLANTS; i++) {
-        if (strcmp(PLANT_THRESHOLDS[i].name, plant_name) == 0) {
-            if (moisture_percent < PLANT_THRESHOLDS[i].moisture_low) {
+    // Search for the plant in the active configuration
+    const ConfigBlock *config = runtime_config_get();
+    for (int i = 0; i < config->plant_count; i++) {
+        const ConfigPlant *plant = &config->plants[i];
+        if (strcmp(plant->name, plant_name) == 0) {
+            if (moisture_percent < plant->moisture_low) {
                 return MOISTURE_TOO_LOW;
-            } else if (moisture_percent > PLANT_THRESHOLDS[i].moisture_high) {
+            } else if (moisture_percent > plant->moisture_high) {
                 return MOISTURE_TOO_HIGH;
-            } else if (moisture_percent >= PLANT_THRESHOLDS[i].moisture_ideal_low && 
-                      moisture_percent <= PLANT_THRESHOLDS[i].moisture_ideal_high) {
+            } else if (moisture_percent >= plant->moisture_ideal_low && 
+                      moisture_percent <= plant->moisture_ideal_high) {
                 return MOISTURE_IDEAL;
             } else {
                 // In the transition zones (approaching ideal but not quite there)
@@ -172,56 +244,93 @@ MoistureStatus getMoistureStatus(const char* plant_name, int moisture_percent) {
     return PLANT_NOT_FOUND;
 }
 
-// Function to display status message on LCD
-void displayMessage(const char* format, ...) {
-    char buffer[33]; // 16x2 LCD can display 32 characters plus null terminator
-    va_list args;
-    
-    va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
-    
-    lcd_clear();
-    
-    // Handle multi-line display
-    char* line2 = NULL;
-    for (int i = 0; buffer[i] != '\0'; i++) {
-        if (buffer[i] == '\n') {
-            buffer[i] = '\0';
-            line2 = &buffer[i + 1];
-            break;
-        }
+// Write one LCD row, padding with spaces so stale characters are
+// overwritten without a slow clear command. Stops at '\n' or NUL and
+// returns a pointer to the terminating character.
+static const char *lcd_print_row(uint8_t row, const char *text) {
+    uint8_t column = 0;
+    lcd_set_cursor(0, row);
+    while (*text && *text != '\n' && column < FMT_LCD_COLUMNS) {
+        lcd_write(*text++);
+        column++;
     }
-    
-    lcd_set_cursor(0, 0);
-    lcd_print(buffer);
-    
-    if (line2) {
-        lcd_set_cursor(0, 1);
-        lcd_print(line2);
+    while (column++ < FMT_LCD_COLUMNS) {
+        lcd_write(' ');
+    }
+    // Skip anything that did not fit on the row
+    while (*text && *text != '\n') {
+        text++;
     }
+    return text;
+}
+
+// Function to display status message on LCD
+void displayText(const char* text) {
+    // Handle multi-line display
+    const char *end = lcd_print_row(0, text);
+    lcd_print_row(1, (*end == '\n') ? end + 1 : end);
 }
 
 void updateMoistureStatusDisplay(const char* plant_name, int moisture_percent) {
     MoistureStatus status = getMoistureStatus(plant_name, moisture_percent);
-    
+    char storage[2 * FMT_LCD_COLUMNS + 2]; // Two lines, separator and terminator
+    FmtBuffer message;
+
+    fmt_init(&message, storage, sizeof(storage));
+    if (status == PLANT_NOT_FOUND) {
+        fmt_str(&message, "Unknown plant:\n");
+        fmt_str(&message, plant_name);
+    } else {
+        fmt_str(&message, plant_name);
+        fmt_str(&message, ": ");
+        fmt_i32(&message, moisture_percent, 0);
+        fmt_str(&message, "%\n");
+    }
+
     switch (status) {
         case MOISTURE_TOO_LOW:
-            displayMessage("%s: %d%%\nTOO DRY! WATER", plant_name, moisture_percent);
+            fmt_str(&message, "TOO DRY! WATER");
             break;
         case MOISTURE_IDEAL:
-            displayMessage("%s: %d%%\nMOISTURE IDEAL", plant_name, moisture_percent);
+            fmt_str(&message, "MOISTURE IDEAL");
             break;
         case MOISTURE_TOO_HIGH:
-            displayMessage("%s: %d%%\nTOO WET!", plant_name, moisture_percent);
+            fmt_str(&message, "TOO WET!");
             break;
         case PLANT_NOT_FOUND:
-            displayMessage("Unknown plant:\n%s", plant_name);
             break;
     }
+    displayText(message.data);
+}
+
+void lcd_on_message(const MsgbusMessage *message, const void *payload) {
+    static const char *const state_names[] = { "IDLE", "INIT", "RUNNING", "ERROR", "STANDBY" };
+
+    if (!lcd_is_ready()) {
+        return;
+    }
+    if (message->topic == MSG_MOISTURE) {
+        const MoistureMessage *reading = payload;
+        if (reading->zone == 0) {
+            updateMoistureStatusDisplay(runtime_config_plant(reading->plant_index)->name,
+                                        reading->percent);
+        }
+    } else if (message->topic == MSG_STATE) {
+        const StateMessage *change = payload;
+        if (change->to <= STATE_STANDBY) {
+            char storage[2 * FMT_LCD_COLUMNS + 2];
+            FmtBuffer text;
+            fmt_init(&text, storage, sizeof(storage));
+            fmt_str(&text, "System state:\n");
+            fmt_str(&text, state_names[change->to]);
+            displayText(text.data);
+        }
+    }
 }
 
 void cyclePlantSelection() {
     // Move to next plant
-    current_plant_index = (current_plant_index + 1) % NUM_PLANTS;
+    current_plant_index = (current_plant_index + 1) % runtime_config_get()->plant_count;
+    warm_state_get()->current_plant_index = current_plant_index;
+    warm_state_commit();
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define IRRIGATION_SYSTEM_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "msgbus.h"
 #include "../src/config/default/peripheral/port/plib_port.h"
 // LCD pin definitions - adjust according to your specific connections
 //#define LCD_RS_PIN      PIN_PA08  // Register Select pin
@@ -71,6 +73,9 @@ typedef enum {
 
 // LCD functions
 void lcd_init(void);
+void lcd_init_start(void);  // Non-blocking init: start the power-up sequence
+bool lcd_init_poll(void);   // Advance the sequence; true once the LCD is ready
+bool lcd_is_ready(void);
 void lcd_command(uint8_t command);
 void lcd_write(uint8_t value);
 void lcd_set_cursor(uint8_t col, uint8_t row);
@@ -89,10 +94,19 @@ int map(int x, int in_min, int in_max, int out_min, int out_max);
 MoistureStatus getMoistureStatus(const char* plant_name, int moisture_percent);
 void updateMoistureStatusDisplay(const char* plant_name, int moisture_percent);
 void cyclePlantSelection(void);
-void displayMessage(const char* format, ...);
+// Shows preformatted text (build it with fmt.h): up to two 16-char lines
+// split by '\n'; '%' is printed as is and longer lines are cut. Replaces
+// the printf-style displayMessage(format, ...), renamed so that old
+// callers fail to build rather than print their format strings.
+void displayText(const char* text);
+// MSG_MOISTURE and MSG_STATE subscriber (app_msg.h): shows zone 0 readings
+// and the new State_t
+void lcd_on_message(const MsgbusMessage *message, const void *payload);
 
 // External variables
+// Compiled-in plant table; the thresholds in use come from runtime_config_plant()
 extern const PlantMoistureThresholds PLANT_THRESHOLDS[];
+extern const int PLANT_THRESHOLDS_COUNT;
 extern int current_plant_index;
 
 #endif // IRRIGATION_SYSTEM_H
\ No newline at end of file
@@ -4,62 +4,80 @@
  */
 
 #include "pump_control.h" // Include the public API header
-
-#include <stdio.h> // For printf debugging (optional, ensure UART is set up)
+#include "trace.h"
+#include "warm_state.h"
+#include "systime.h"
+#include "pump_interlock.h"
+#include "runtime_config.h"
+#include "dose_plan.h"
+#include "ramfunc.h"
+
+#include "app_msg.h"
+#include "energy_monitor.h"
+#include "fmt.h"   // For debug output (optional, ensure UART is set up)
 #include <math.h>  // For fabs in interpolation
 
-// --- Atmel Start / Harmony Includes (Adapt as necessary) ---
-// Ensure these match your project's framework includes.
-#include <atmel_start.h> // Or your specific Harmony/ASF top-level include
-#include <hal_tcc.h>    // Header for TCC functions
-
-// --- Configuration (MUST BE ADJUSTED based on MHC/START setup) ---
-// These MUST match the TCC peripheral settings configured in Harmony/MCC
-
-// Define which TCC instance is used for the pump PWM
-#define PUMP_TCC_INSTANCE    TCC0 // Example: Using TCC0 instance
+#include "definitions.h"   // TCC0 plib
+#include "sam.h"           // TC5, EVSYS and TCC0 registers for the dose timer
 
-// Define the TCC channel (Waveform Output - WO[x]) connected to the pump driver pin.
-// This corresponds to the Compare Channel (CC[x]) register used.
-#define PUMP_TCC_CHANNEL     0    // Example: Using CC[0] and WO[0]
+// --- Configuration (must match the TCC0 setup in MCC) ---
+// Compare channel CC[0] drives WO[0], the pump driver pin
+#define PUMP_TCC_CHANNEL     TCC0_CHANNEL0
 
-// Define the PWM Period value set in the TCC configuration (PER register).
-// This determines the PWM frequency and resolution.
-// Calculation: PER = (TCC_Clock_Hz / Target_PWM_Frequency_Hz) - 1
-// Example: TCC Clock = 6MHz (48MHz/8). Target PWM Freq = 5kHz.
-// PER = (6,000,000 / 5000) - 1 = 1199
-#define PUMP_PWM_PERIOD      1199
-
-// --- Calibration Data ---
-// Structure to hold a calibration point (Duty Cycle vs. Flow Rate)
-typedef struct {
-    float duty_cycle_percent;   // PWM Duty Cycle (%)
-    float flow_rate_ml_per_sec; // Measured Flow Rate (mL/second) at this duty cycle
-} PumpCalibrationPoint;
-
-// !! IMPORTANT !!
-// Replace these example values with your actual measured calibration data!
-#define NUM_CALIBRATION_POINTS 5
-static const PumpCalibrationPoint calibration_table[NUM_CALIBRATION_POINTS] = {
-    // { Duty Cycle %, Flow Rate mL/s }
-    { 20.0f, 0.8f },   // Example: At 20% duty, measured 0.8 mL/sec
-    { 40.0f, 1.9f },   // Example: At 40% duty, measured 1.9 mL/sec
-    { 60.0f, 3.1f },   // Example: At 60% duty, measured 3.1 mL/sec
-    { 80.0f, 4.5f },   // Example: At 80% duty, measured 4.5 mL/sec
-    { 100.0f, 5.8f }   // Example: At 100% duty, measured 5.8 mL/sec
-};
+// The PWM period (PER register) and the calibration table (duty cycle vs.
+// flow rate) come from the runtime configuration; PUMP_PWM_PERIOD in
+// pump_control.h is the default
 
 // --- Module State Variables (Private) ---
 static bool pump_is_active = false;                 // Is the pump currently supposed to be running?
-static uint32_t current_pump_cc_value = 0;          // Current TCC Compare Channel value (0 to PUMP_PWM_PERIOD)
+static uint32_t current_pump_cc_value = 0;          // Current TCC Compare Channel value (0 to pump_pwm_period)
+static uint32_t pump_pwm_period = PUMP_PWM_PERIOD;  // PER value programmed into the TCC
+static uint32_t pump_config_version = 0;            // Runtime configuration the period and flow came from
 static float total_volume_dispensed_ml = 0.0f;      // Accumulated volume since last reset
-static uint32_t pump_run_start_ms = 0;              // Timestamp (in ms) when the current run interval started
+static uint64_t pump_run_start_ms = 0;              // systime_now_ms() when the current run interval started
 static bool is_tracking_pump_run = false;           // Flag indicating if we are currently timing a run interval
+static float tracked_flow_ml_per_sec = 0.0f;        // Flow rate of the interval being timed
+static uint8_t pump_zone = 0;                       // Zone the next run waters, for the interlock limits
+static uint32_t resume_run_ms = 0;                  // Interlock usage carried over by a warm resume
+static uint32_t resume_run_ml = 0;
+static bool trip_reported = false;
+
+// --- Timed dose (pump_dispense_ml()) ---
+typedef enum {
+    DOSE_IDLE,
+    DOSE_STARTING,               // pump_dispense_ml() is starting the run
+    DOSE_RUNNING                 // TC5 is timing the run
+} DoseState;
 
-// --- External Dependencies (Assumed to exist) ---
-// Requires a function returning monotonically increasing milliseconds.
-// Ensure SysTick or another timer is configured to provide this.
-extern uint32_t GetTickMs(void); // Provided by your system (e.g., SysTick handler)
+typedef struct {
+    DoseState state;
+    DosePlan plan;
+    float flow_ml_per_sec;       // Flow the plan was made for
+    uint64_t start_ms;           // Run start on systime_now_ms()
+    uint64_t stop_ms;            // Where TC5 ends it
+    PumpDispenseCallback done;
+    void *context;
+} PumpDose;
+
+// An ended dose waiting for pump_checkpoint() to call its callback
+typedef struct {
+    bool pending;
+    PumpDispenseResult result;
+    float dispensed_ml;
+    PumpDispenseCallback done;
+    void *context;
+} PumpDoseResult;
+
+static PumpDose dose;
+static PumpDoseResult dose_result;
+static PumpDispenseStats dispense_stats;
+static uint32_t dose_rest_cc;                       // CC0 for every segment after the first
+static volatile uint16_t dose_segments_left;        // Shared with TC5_Handler()
+#if PUMP_DISPENSE_EVSYS
+static bool dose_fault_ready = false;               // TCC0 configured to take the TC5 event
+#else
+static volatile bool dose_expired;                  // Set by TC5_Handler() at the end
+#endif
 
 // --- Private Helper Functions ---
 
@@ -69,6 +87,10 @@ extern uint32_t GetTickMs(void); // Provided by your system (e.g., SysTick handl
  * @return Estimated flow rate in mL/second. Performs linear interpolation/extrapolation.
  */
 static float get_flow_rate_ml_per_sec(float duty_cycle_percent) {
+    const ConfigBlock *config = runtime_config_get();
+    const ConfigPumpPoint *calibration_table = config->pump_points;
+    int point_count = config->pump_point_count;
+
     // Handle edge cases: below min or above max calibration point
     if (duty_cycle_percent <= calibration_table[0].duty_cycle_percent) {
         // Linearly extrapolate from the lowest point down to 0%
@@ -78,13 +100,13 @@ static float get_flow_rate_ml_per_sec(float duty_cycle_percent) {
              return 0.0f; // If lowest point is 0% or less, flow is 0
          }
     }
-    if (duty_cycle_percent >= calibration_table[NUM_CALIBRATION_POINTS - 1].duty_cycle_percent) {
+    if (duty_cycle_percent >= calibration_table[point_count - 1].duty_cycle_percent) {
         // Above highest point, return the max calibrated flow rate
-        return calibration_table[NUM_CALIBRATION_POINTS - 1].flow_rate_ml_per_sec;
+        return calibration_table[point_count - 1].flow_rate_ml_per_sec;
     }
 
     // Find the two calibration points surrounding the target duty cycle for interpolation
-    for (int i = 0; i < NUM_CALIBRATION_POINTS - 1; i++) {
+    for (int i = 0; i < point_count - 1; i++) {
         if (duty_cycle_percent >= calibration_table[i].duty_cycle_percent && duty_cycle_percent <= calibration_table[i+1].duty_cycle_percent) {
             // Interpolate between point i and i+1
             float d1 = calibration_table[i].duty_cycle_percent;
@@ -101,7 +123,7 @@ static float get_flow_rate_ml_per_sec(float duty_cycle_percent) {
         }
     }
     // Fallback (should not be reached if logic is correct)
-    return calibration_table[NUM_CALIBRATION_POINTS - 1].flow_rate_ml_per_sec;
+    return calibration_table[point_count - 1].flow_rate_ml_per_sec;
 }
 
 /**
@@ -110,19 +132,72 @@ static float get_flow_rate_ml_per_sec(float duty_cycle_percent) {
  */
 static float get_current_duty_percentage(void) {
     // PWM Duty Cycle = CCx / (PER + 1)
-    if ((PUMP_PWM_PERIOD + 1) == 0) return 0.0f; // Avoid division by zero
+    if ((pump_pwm_period + 1) == 0) return 0.0f; // Avoid division by zero
     // Ensure calculation uses float for precision
-    return ((float)current_pump_cc_value * 100.0f) / (float)(PUMP_PWM_PERIOD + 1);
+    return ((float)current_pump_cc_value * 100.0f) / (float)(pump_pwm_period + 1);
+}
+
+/**
+ * @brief Converts a duty cycle percentage to a TCC compare value.
+ * @param percentage Clamped to 0.0 to 100.0.
+ * @return CC value from 0 to pump_pwm_period.
+ */
+static uint32_t percentage_to_cc(float percentage) {
+    uint32_t cc_value;
+
+    // Sanitize input percentage (clamp between 0.0 and 100.0)
+    if (percentage < 0.0f) percentage = 0.0f;
+    if (percentage > 100.0f) percentage = 100.0f;
+
+    // Calculate the required TCC Compare Channel (CCx) value based on percentage.
+    // Duty Cycle = CCx / (PER + 1) => CCx = Duty Cycle * (PER + 1)
+    // Add 0.5f for proper rounding before casting to integer.
+    cc_value = (uint32_t)(((percentage / 100.0f) * (float)(pump_pwm_period + 1)) + 0.5f);
+
+    // Clamp CC value to the maximum possible (which is PER, as counter goes 0..PER)
+    if (cc_value > pump_pwm_period) {
+         cc_value = pump_pwm_period;
+    }
+    // Ensure 100% really results in PER value, handling potential float rounding issues.
+    if (percentage >= 99.99f && cc_value < pump_pwm_period) {
+         cc_value = pump_pwm_period;
+    }
+    return cc_value;
+}
+
+/**
+ * @brief systime_now_ms() for the volume accounting: a dose's run ends at
+ * its planned stop even when the main loop notices later.
+ */
+static uint64_t tracking_now_ms(void) {
+    uint64_t now_ms = systime_now_ms();
+    return (dose.state == DOSE_RUNNING && now_ms > dose.stop_ms) ? dose.stop_ms : now_ms;
+}
+
+/**
+ * @brief Copies the accounting state into the warm-reset retention block.
+ * A dose is not resumed: nothing would stop it.
+ */
+static void pump_retain_state(void) {
+    WarmState *retained = warm_state_get();
+    retained->total_volume_ml = total_volume_dispensed_ml;
+    retained->pump_percentage = (pump_is_active && dose.state == DOSE_IDLE) ? get_current_duty_percentage() : 0.0f;
+    retained->interlock_trip = (uint8_t)pump_interlock_trip();
+    retained->pump_zone = pump_zone;
+    pump_interlock_usage(&retained->pump_run_ms, &retained->pump_run_ml);
+    warm_state_commit();
 }
 
 /**
  * @brief Starts tracking the volume for the current pump run interval.
- * Records the start time using GetTickMs().
+ * Records the start time using systime_now_ms() and the flow rate, so a new
+ * calibration table only applies from the next interval.
  */
 static void pump_start_tracking(void) {
     // Only start tracking if the pump is supposed to be active and we aren't already tracking
     if (pump_is_active && !is_tracking_pump_run) {
-        pump_run_start_ms = GetTickMs(); // Record start time
+        pump_run_start_ms = systime_now_ms(); // Record start time
+        tracked_flow_ml_per_sec = get_flow_rate_ml_per_sec(get_current_duty_percentage());
         is_tracking_pump_run = true;
         // printf("DEBUG: Started volume tracking at %lu ms\n", (long unsigned int)pump_run_start_ms);
     }
@@ -134,24 +209,16 @@ static void pump_start_tracking(void) {
  */
 static void pump_stop_tracking(void) {
     if (is_tracking_pump_run) {
-        uint32_t end_ms = GetTickMs();
-        uint32_t elapsed_ms;
-
-        // Calculate elapsed time, handling timer wrap-around (assuming 32-bit ms timer)
-        if (end_ms >= pump_run_start_ms) {
-            elapsed_ms = end_ms - pump_run_start_ms;
-        } else {
-            // Timer wrapped around (e.g., overflowed from 0xFFFFFFFF to 0)
-            elapsed_ms = (0xFFFFFFFF - pump_run_start_ms) + end_ms + 1;
-        }
+        // The 64-bit clock does not wrap
+        uint32_t elapsed_ms = (uint32_t)(tracking_now_ms() - pump_run_start_ms);
 
         float elapsed_seconds = (float)elapsed_ms / 1000.0f;
 
         // Get the duty cycle % that was active during this run interval
         float active_duty_percent = get_current_duty_percentage();
 
-        // Get the corresponding flow rate from calibration data
-        float flow_rate = get_flow_rate_ml_per_sec(active_duty_percent);
+        // Flow rate from the calibration data when the interval started
+        float flow_rate = tracked_flow_ml_per_sec;
 
         // Calculate volume dispensed during this interval
         float volume_interval_ml = flow_rate * elapsed_seconds;
@@ -162,11 +229,194 @@ static void pump_stop_tracking(void) {
         is_tracking_pump_run = false; // Mark tracking as stopped for this interval
 
         // Optional Debug Print
-        printf("DEBUG: Tracked interval: %.3f s @ %.1f%% (%.3f mL/s). Added: %.3f mL. New Total: %.3f mL\n",
-               elapsed_seconds, active_duty_percent, flow_rate, volume_interval_ml, total_volume_dispensed_ml);
+        char storage[96];
+        FmtBuffer message;
+        fmt_init(&message, storage, sizeof(storage));
+        fmt_str(&message, "DEBUG: Tracked interval: ");
+        fmt_fixed(&message, (int32_t)elapsed_ms, 3, 0);
+        fmt_str(&message, " s @ ");
+        fmt_fixed(&message, fmt_scale(active_duty_percent, 1), 1, 0);
+        fmt_str(&message, "% (");
+        fmt_fixed(&message, fmt_scale(flow_rate, 3), 3, 0);
+        fmt_str(&message, " mL/s). Added: ");
+        fmt_fixed(&message, fmt_scale(volume_interval_ml, 3), 3, 0);
+        fmt_str(&message, " mL. New Total: ");
+        fmt_fixed(&message, fmt_scale(total_volume_dispensed_ml, 3), 3, 0);
+        fmt_str(&message, " mL\n");
+        fmt_uart_write(&message);
+    }
+}
+
+/**
+ * @brief Takes a new PWM period and calibration table from the runtime
+ * configuration. A running pump keeps its duty cycle: the open interval is
+ * closed at the old flow rate and timing continues at the new one.
+ */
+static void pump_apply_config(void) {
+    const ConfigBlock *config = runtime_config_get();
+    // A dose keeps the period and flow its run time was planned for
+    if (dose.state != DOSE_IDLE) {
+        return;
+    }
+    if (config->version == pump_config_version && config->pump_pwm_period == pump_pwm_period) {
+        return;
+    }
+    float percentage = get_current_duty_percentage();
+    pump_config_version = config->version;
+    if (is_tracking_pump_run) {
+        pump_stop_tracking();
+    }
+    if (config->pump_pwm_period != pump_pwm_period) {
+        pump_pwm_period = config->pump_pwm_period;
+        // Harmony TCC0 plib: PER is buffered, so the period changes at the
+        // next update without stopping the output
+        TCC0_PWM24bitPeriodSet(pump_pwm_period);
+    }
+    if (pump_is_active) {
+        pump_activate(percentage);  // Compare value for the new period
+        pump_start_tracking();      // Unless pump_activate() already restarted it
+        pump_interlock_set_flow(tracked_flow_ml_per_sec);
+    }
+}
+
+static void tc5_sync(void) {
+    while (TC5->COUNT16.STATUS.reg & TC_STATUS_SYNCBUSY) {
+    }
+}
+
+#if PUMP_DISPENSE_EVSYS
+// Connects or disconnects the TC5 overflow to TCC0's fault input
+static RAMFUNC void dose_event_attach(bool attach) {
+    EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(PUMP_DISPENSE_EVSYS_CHANNEL) |
+                         EVSYS_CHANNEL_PATH_ASYNCHRONOUS |
+                         (attach ? EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_TC5_OVF) : 0U);
+}
+#endif
+
+/**
+ * @brief Sets up TC5 as the dose timer. TC3 and TC4 belong to the MCC
+ * configuration; TC5 is not configured there and shares TC4's generic
+ * clock channel, which SYS_Initialize() has already connected to GCLK0.
+ * With PUMP_DISPENSE_EVSYS the TC5 overflow event becomes TCC0 event 1.
+ * The MCC TCC0 configuration turns that into a non-recoverable fault that
+ * holds WO[0] low (EVACT1 = FAULT, NRE0 with NRV0 low); those registers
+ * are enable-protected, so they are only checked here.
+ */
+static void dose_timer_init(void) {
+    PM->APBCMASK.reg |= PM_APBCMASK_TC5 | PM_APBCMASK_EVSYS;
+
+    TC5->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC5->COUNT16.CTRLA.reg & TC_CTRLA_SWRST) {
     }
+    // Match frequency: CC0 is the top, so n counts is CC0 = n - 1
+    TC5->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ |
+                             TC_CTRLA_PRESCALER_DIV1024 | TC_CTRLA_PRESCSYNC_PRESC;
+    TC5->COUNT16.EVCTRL.reg = TC_EVCTRL_OVFEO;
+    tc5_sync();
+    NVIC_ClearPendingIRQ(TC5_IRQn);
+    NVIC_EnableIRQ(TC5_IRQn);
+
+#if PUMP_DISPENSE_EVSYS
+    EVSYS->USER.reg = EVSYS_USER_USER(EVSYS_ID_USER_TCC0_EV_1) |
+                      EVSYS_USER_CHANNEL(PUMP_DISPENSE_EVSYS_CHANNEL + 1U);
+    dose_event_attach(false);
+    // A TCC0 plib generated without the fault would leave the end of
+    // every dose to the main loop, so doses are refused instead
+    dose_fault_ready =
+        (TCC0->EVCTRL.reg & (TCC_EVCTRL_TCEI1 | TCC_EVCTRL_EVACT1_Msk)) ==
+            (TCC_EVCTRL_TCEI1 | TCC_EVCTRL_EVACT1_FAULT) &&
+        (TCC0->DRVCTRL.reg & (TCC_DRVCTRL_NRE0 | TCC_DRVCTRL_NRV0)) == TCC_DRVCTRL_NRE0;
+#endif
 }
 
+// Arms the last segment: one-shot, so TC5 stops at its overflow, which
+// ends the run through EVSYS or through the interrupt
+static RAMFUNC void dose_timer_last_segment(void) {
+    TC5->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+#if PUMP_DISPENSE_EVSYS
+    dose_event_attach(true);
+    TC5->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+#else
+    TC5->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+#endif
+}
+
+static void dose_timer_start(const DosePlan *plan) {
+    TC5->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    tc5_sync();
+    TC5->COUNT16.COUNT.reg = 0;
+    tc5_sync();
+    TC5->COUNT16.CC[0].reg = (uint16_t)(plan->first - 1U);
+    tc5_sync();
+    TC5->COUNT16.CTRLBCLR.reg = TC_CTRLBCLR_ONESHOT;
+    tc5_sync();
+    TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+
+    dose_rest_cc = plan->rest - 1U;
+    dose_segments_left = plan->segments;
+#if !PUMP_DISPENSE_EVSYS
+    dose_expired = false;
+#endif
+    if (plan->segments == 1U) {
+        dose_timer_last_segment();
+    } else {
+        TC5->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+    }
+    tc5_sync();
+    TC5->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+}
+
+static void dose_timer_stop(void) {
+    TC5->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+    TC5->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    tc5_sync();
+#if PUMP_DISPENSE_EVSYS
+    dose_event_attach(false);
+#endif
+    TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+    NVIC_ClearPendingIRQ(TC5_IRQn);
+    dose_segments_left = 0;
+}
+
+// true once TC5 has ended the run
+static bool dose_timer_expired(void) {
+#if PUMP_DISPENSE_EVSYS
+    // The last overflow has no interrupt; its flag shows the fault fired
+    return dose_segments_left == 1U && (TC5->COUNT16.INTFLAG.reg & TC_INTFLAG_OVF) != 0;
+#else
+    return dose_expired;
+#endif
+}
+
+/**
+ * @brief Ends the running dose: stops TC5, closes its interval at the
+ * planned stop at the latest and queues the callback. The caller switches
+ * the pump off.
+ */
+static void dose_end(PumpDispenseResult result) {
+    uint64_t end_ms = tracking_now_ms();
+    dose_timer_stop();
+    if (is_tracking_pump_run) {
+        pump_stop_tracking();
+    }
+    dose_result.pending = true;
+    dose_result.result = result;
+    // The full dose to the timer count; an early end to the millisecond
+    dose_result.dispensed_ml = (result == PUMP_DISPENSE_DONE)
+        ? dose_plan_volume_ml(&dose.plan, dose.flow_ml_per_sec, PUMP_DISPENSE_TIMER_HZ)
+        : dose.flow_ml_per_sec * ((float)(uint32_t)(end_ms - dose.start_ms) / 1000.0f);
+    dose_result.done = dose.done;
+    dose_result.context = dose.context;
+    dose.state = DOSE_IDLE;
+    dispense_stats.results[result]++;
+}
+
+// Releases TCC0 from the fault that ended the previous dose
+static void dose_release_output(void) {
+#if PUMP_DISPENSE_EVSYS
+    TCC0->STATUS.reg = TCC_STATUS_FAULT1;
+#endif
+}
 
 // --- Public API Function Implementations ---
 
@@ -175,42 +425,91 @@ void pump_init(void) {
     // are already configured and enabled by the framework (MCC/Harmony).
 
     // Ensure pump starts OFF by setting duty cycle (CC value) to 0.
-    // The specific HAL function might vary slightly (e.g., tcc_set_pwm_compare).
-    // Cast PUMP_TCC_INSTANCE to the required struct type if necessary.
-    tcc_set_compare_value((struct tcc_module *)&PUMP_TCC_INSTANCE, PUMP_TCC_CHANNEL, 0);
-
-    // Optional: Verify TCC counter is running (usually enabled by framework init)
-    // if (!tcc_is_enabled(&PUMP_TCC_INSTANCE)) { /* Log error or handle */ }
+    TCC0_PWM24bitDutySet(PUMP_TCC_CHANNEL, 0);
 
     // Initialize state variables
     pump_is_active = false;
     current_pump_cc_value = 0;
     total_volume_dispensed_ml = 0.0f;
     is_tracking_pump_run = false;
+    pump_zone = 0;
+    trip_reported = false;
+    dose.state = DOSE_IDLE;
+    dose_result.pending = false;
+    dose_timer_init();
+    pump_apply_config();
+
+    // After a warm reset, keep the accounting and resume or abort the
+    // interrupted run without printing anything. A latched interlock trip
+    // survives, and a resumed run keeps the time and volume it had used.
+    if (warm_state_is_warm()) {
+        WarmState *retained = warm_state_get();
+        total_volume_dispensed_ml = retained->total_volume_ml;
+        pump_interlock_init((InterlockTrip)retained->interlock_trip);
+        trip_reported = retained->interlock_trip != INTERLOCK_OK;
+        pump_zone = retained->pump_zone;
+        resume_run_ms = retained->pump_run_ms;
+        resume_run_ml = retained->pump_run_ml;
+        if (retained->pump_percentage > 0.0f) {
+            pump_activate(retained->pump_percentage);
+        } else {
+            pump_retain_state();
+        }
+        boot_monitor_mark(BOOT_MILESTONE_FIRST_CONTROL_ACTION);
+        return;
+    }
+    pump_interlock_init(INTERLOCK_OK);
+    pump_retain_state();
+
+    char storage[80];
+    FmtBuffer message;
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, "Pump control initialized. TCC0 channel: ");
+    fmt_u32(&message, PUMP_TCC_CHANNEL, 0);
+    fmt_str(&message, ", Period: ");
+    fmt_u32(&message, pump_pwm_period, 0);
+    fmt_str(&message, "\n");
+    fmt_uart_write(&message);
+}
 
-    printf("Pump control initialized. TCC Instance: %p, Channel: %d, Period: %lu\n",
-           (void *)&PUMP_TCC_INSTANCE, PUMP_TCC_CHANNEL, (long unsigned int)PUMP_PWM_PERIOD);
+// Tells the bus node and any other subscriber what the pump did
+static void pump_publish(PumpMessageKind kind, InterlockTrip trip) {
+    PumpMessage event;
+    event.kind = (uint8_t)kind;
+    event.zone = pump_zone;
+    event.trip = (uint8_t)trip;
+    event.duty_percent = (uint8_t)(get_current_duty_percentage() + 0.5f);
+    event.total_ml = (uint32_t)total_volume_dispensed_ml;
+    APP_MSG_PUBLISH(MSG_PUMP, &event);
 }
 
 void pump_activate(float percentage) {
     uint32_t new_cc_value;
 
-    // Sanitize input percentage (clamp between 0.0 and 100.0)
-    if (percentage < 0.0f) percentage = 0.0f;
-    if (percentage > 100.0f) percentage = 100.0f;
+    // Any other command ends a running dose. Its run ends here too, so a
+    // new duty starts a fresh run below with the interlock's consent.
+    if (dose.state == DOSE_RUNNING) {
+        dose_end(dose_timer_expired() ? PUMP_DISPENSE_DONE : PUMP_DISPENSE_CANCELLED);
+        if (percentage > 0.0f) {
+            pump_activate(0.0f);
+        }
+    }
 
-    // Calculate the required TCC Compare Channel (CCx) value based on percentage.
-    // Duty Cycle = CCx / (PER + 1) => CCx = Duty Cycle * (PER + 1)
-    // Add 0.5f for proper rounding before casting to integer.
-    new_cc_value = (uint32_t)(((percentage / 100.0f) * (float)(PUMP_PWM_PERIOD + 1)) + 0.5f);
+    new_cc_value = percentage_to_cc(percentage);
 
-    // Clamp CC value to the maximum possible (which is PER, as counter goes 0..PER)
-    if (new_cc_value > PUMP_PWM_PERIOD) {
-         new_cc_value = PUMP_PWM_PERIOD;
-    }
-    // Ensure 100% really results in PER value, handling potential float rounding issues.
-    if (percentage >= 99.99f && new_cc_value < PUMP_PWM_PERIOD) {
-         new_cc_value = PUMP_PWM_PERIOD;
+    // A new run needs the interlock's consent; a tripped pump stays off
+    if (new_cc_value > 0 && !pump_is_active) {
+        float flow = get_flow_rate_ml_per_sec(((float)new_cc_value * 100.0f) / (float)(pump_pwm_period + 1));
+        bool allowed = pump_interlock_start(pump_zone, flow, resume_run_ms, resume_run_ml);
+        resume_run_ms = 0;
+        resume_run_ml = 0;
+        if (!allowed) {
+            new_cc_value = 0;
+        } else {
+            dose_release_output();
+        }
+    } else if (new_cc_value == 0) {
+        pump_interlock_stop();
     }
 
     // --- Volume Tracking Logic ---
@@ -220,10 +519,14 @@ void pump_activate(float percentage) {
     }
 
     // --- Set PWM Duty Cycle ---
-    // Update the TCC compare register using the HAL function.
-    tcc_set_compare_value((struct tcc_module *)&PUMP_TCC_INSTANCE, PUMP_TCC_CHANNEL, new_cc_value);
+    // The plib writes CCBUF, so the new duty starts with the next period
+    TCC0_PWM24bitDutySet(PUMP_TCC_CHANNEL, new_cc_value);
     uint32_t old_cc_value = current_pump_cc_value; // Store old value for state change check
     current_pump_cc_value = new_cc_value;          // Update current CC value state
+    // The output is on for CC / (PER + 1) of the time; an interlock trip is
+    // counted from the pump_checkpoint() that switches the pump off
+    energy_monitor_level(ENERGY_PUMP,
+                         (uint16_t)((new_cc_value << ENERGY_LEVEL_SHIFT) / (pump_pwm_period + 1U)));
 
     // --- Update State & Start/Stop Tracking ---
     if (new_cc_value > 0) {
@@ -235,6 +538,13 @@ void pump_activate(float percentage) {
         if (needs_tracking_start || (old_cc_value != new_cc_value && !is_tracking_pump_run)) {
              pump_start_tracking();
         }
+        if (old_cc_value != new_cc_value) {
+            pump_interlock_set_flow(get_flow_rate_ml_per_sec(get_current_duty_percentage()));
+            TRACE(TRACE_EVT_PUMP_ON, 0, new_cc_value);
+        }
+        if (needs_tracking_start) {
+            pump_publish(PUMP_MSG_STARTED, INTERLOCK_OK);
+        }
         // printf("Pump activated/adjusted to %.1f%% duty (CC=%lu)\n", get_current_duty_percentage(), (long unsigned int)current_pump_cc_value);
 
     } else {
@@ -245,11 +555,16 @@ void pump_activate(float percentage) {
                  pump_stop_tracking();
              }
             pump_is_active = false; // Mark as inactive
+            TRACE(TRACE_EVT_PUMP_OFF, 0, trace_arg16_f(total_volume_dispensed_ml));
+            pump_publish(PUMP_MSG_STOPPED, INTERLOCK_OK);
             // printf("Pump deactivated (0%% duty cycle).\n");
         }
         // Ensure tracking is stopped if percentage is 0
         is_tracking_pump_run = false;
     }
+
+    pump_retain_state();
+    boot_monitor_mark(BOOT_MILESTONE_FIRST_CONTROL_ACTION);
 }
 
 void pump_deactivate(void) {
@@ -263,6 +578,53 @@ void pump_adjust_flow(float percentage) {
     pump_activate(percentage);
 }
 
+bool pump_dispense_ml(float volume_ml, float duty_percent, PumpDispenseCallback done, void *context) {
+    DosePlan plan;
+    uint32_t cc_value = percentage_to_cc(duty_percent);
+    float flow = get_flow_rate_ml_per_sec(((float)cc_value * 100.0f) / (float)(pump_pwm_period + 1));
+
+#if PUMP_DISPENSE_EVSYS
+    if (!dose_fault_ready) {
+        dispense_stats.rejected++;
+        return false;
+    }
+#endif
+    if (pump_is_active || dose.state != DOSE_IDLE || cc_value == 0 ||
+        !dose_plan_make(&plan, volume_ml, flow, PUMP_DISPENSE_TIMER_HZ, PUMP_DISPENSE_MAX_MS)) {
+        dispense_stats.rejected++;
+        return false;
+    }
+
+    dose.state = DOSE_STARTING;
+    pump_activate(duty_percent);
+    if (!pump_is_active) {
+        // The interlock refused the run
+        dose.state = DOSE_IDLE;
+        dispense_stats.rejected++;
+        return false;
+    }
+
+    dose.plan = plan;
+    dose.flow_ml_per_sec = tracked_flow_ml_per_sec;
+    dose.start_ms = pump_run_start_ms;
+    dose.stop_ms = pump_run_start_ms + dose_plan_ms(&plan, PUMP_DISPENSE_TIMER_HZ);
+    dose.done = done;
+    dose.context = context;
+    dose_timer_start(&plan);
+    dose.state = DOSE_RUNNING;
+    dispense_stats.doses++;
+    dispense_stats.last_counts = plan.counts;
+    return true;
+}
+
+bool pump_dispense_active(void) {
+    return dose.state != DOSE_IDLE || dose_result.pending;
+}
+
+void pump_dispense_get_stats(PumpDispenseStats *stats) {
+    *stats = dispense_stats;
+}
+
 bool pump_get_status(void) {
     // Returns the intended state based on the last command.
     return pump_is_active;
@@ -274,18 +636,9 @@ float pump_get_total_volume_ml(void) {
     // If the pump is currently running, calculate the estimated volume dispensed
     // in the *current, ongoing* interval up to this exact moment.
     if (is_tracking_pump_run) {
-        uint32_t current_ms = GetTickMs();
-        uint32_t elapsed_ms;
-        // Calculate elapsed time for the current interval, handling wrap-around
-         if (current_ms >= pump_run_start_ms) {
-            elapsed_ms = current_ms - pump_run_start_ms;
-         } else {
-            elapsed_ms = (0xFFFFFFFF - pump_run_start_ms) + current_ms + 1;
-         }
+        uint32_t elapsed_ms = (uint32_t)(tracking_now_ms() - pump_run_start_ms);
          float elapsed_seconds = (float)elapsed_ms / 1000.0f;
-         float active_duty_percent = get_current_duty_percentage();
-         float flow_rate = get_flow_rate_ml_per_sec(active_duty_percent);
-         current_interval_volume = flow_rate * elapsed_seconds;
+         current_interval_volume = tracked_flow_ml_per_sec * elapsed_seconds;
     }
 
     // Return the total accumulated from completed intervals PLUS the calculated volume from the current running interval.
@@ -304,5 +657,102 @@ void pump_reset_total_volume(void) {
      }
     // Reset the accumulator for completed intervals.
     total_volume_dispensed_ml = 0.0f;
+    pump_retain_state();
     // printf("Total volume reset to 0.0 mL.\n");
 }
+
+void pump_set_zone(uint8_t zone) {
+    pump_zone = zone;
+}
+
+uint8_t pump_get_zone(void) {
+    return pump_zone;
+}
+
+void pump_interlock_clear_trip(void) {
+    pump_interlock_clear();
+    trip_reported = false;
+    pump_retain_state();
+}
+
+void pump_checkpoint(void) {
+    // The interlock has already cut the output from its interrupt; bring
+    // the compare value and the accounting in line and say why, once
+    InterlockTrip trip = pump_interlock_trip();
+    if (trip != INTERLOCK_OK && !trip_reported) {
+        trip_reported = true;
+        if (dose.state == DOSE_RUNNING) {
+            dose_end(PUMP_DISPENSE_TRIPPED);
+        }
+        if (pump_is_active) {
+            pump_deactivate();
+        }
+        PumpInterlockStats stats;
+        pump_interlock_get_stats(&stats);
+        TRACE(TRACE_EVT_INTERLOCK_TRIP, trip, trace_arg16(stats.volume_ml));
+        pump_publish(PUMP_MSG_TRIPPED, trip);
+
+        char storage[96];
+        FmtBuffer message;
+        fmt_init(&message, storage, sizeof(storage));
+        fmt_str(&message, "PUMP INTERLOCK: ");
+        fmt_str(&message, pump_interlock_trip_name(trip));
+        fmt_str(&message, ", zone ");
+        fmt_u32(&message, stats.zone, 0);
+        fmt_str(&message, " after ");
+        fmt_u32(&message, stats.on_ms / 1000U, 0);
+        fmt_str(&message, " s, ");
+        fmt_u32(&message, stats.volume_ml, 0);
+        fmt_str(&message, " mL. Pump locked out.\r\n");
+        fmt_uart_write(&message);
+    }
+
+    // The timer has already switched the output off; account for the
+    // planned run time and stop the pump on the books
+    if (dose.state == DOSE_RUNNING && dose_timer_expired()) {
+        dose_end(PUMP_DISPENSE_DONE);
+        pump_deactivate();
+    }
+
+    pump_apply_config();
+
+    // Fold the running interval into the total so a reset loses at most
+    // the time since the last checkpoint
+    if (is_tracking_pump_run) {
+        uint64_t now_ms = tracking_now_ms();
+        uint32_t elapsed_ms = (uint32_t)(now_ms - pump_run_start_ms);
+        total_volume_dispensed_ml += tracked_flow_ml_per_sec * ((float)elapsed_ms / 1000.0f);
+        pump_run_start_ms = now_ms;
+    }
+    pump_retain_state();
+
+    // Last, so the callback sees the pump stopped and may start another dose
+    if (dose_result.pending) {
+        PumpDoseResult ended = dose_result;
+        dose_result.pending = false;
+        if (ended.done != NULL) {
+            ended.done(ended.result, ended.dispensed_ml, ended.context);
+        }
+    }
+}
+
+RAMFUNC void TC5_Handler(void) {
+    TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+    dispense_stats.segment_irqs++;
+    uint16_t left = (uint16_t)(dose_segments_left - 1U);
+    dose_segments_left = left;
+#if !PUMP_DISPENSE_EVSYS
+    if (left == 0) {
+        pump_interlock_output_off();
+        TC5->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+        dose_expired = true;
+        return;
+    }
+#endif
+    // The counter restarted from zero a few microseconds ago, and every
+    // later segment is over half a period, so the new top is not missed
+    TC5->COUNT16.CC[0].reg = (uint16_t)dose_rest_cc;
+    if (left == 1U) {
+        dose_timer_last_segment();
+    }
+}
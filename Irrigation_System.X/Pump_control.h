@@ -2,12 +2,14 @@
  * @file pump_control.h
  * @brief Public API for controlling a DC pump via PWM and tracking volume dispensed.
  *
- * Assumes a TCC module is configured for PWM generation and a millisecond
- * timer (like SysTick) is available and provides GetTickMs().
+ * Assumes a TCC module is configured for PWM generation. Run times are
+ * taken from the 64-bit systime_now_ms() clock.
  * Requires a suitable driver circuit (e.g., MOSFET) between MCU and pump.
  *
- * @note Requires calibration data specific to the pump and setup, defined
- * in pump_control.c.
+ * @note Requires calibration data specific to the pump and setup. It comes
+ * from the runtime configuration (runtime_config.h) and can be uploaded
+ * without a reflash; a new PWM period or table takes effect at the next
+ * pump_checkpoint().
  */
 
 #ifndef PUMP_CONTROL_H
@@ -16,12 +18,51 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-// --- Configuration (Adjust in pump_control.c if needed) ---
-// These determine which TCC peripheral and channel are used, and the PWM resolution.
-// They are defined in pump_control.c but mentioned here for awareness.
-// #define PUMP_TCC_INSTANCE    TCC0 // Example TCC instance (defined in .c)
-// #define PUMP_TCC_CHANNEL     0    // Example TCC channel (defined in .c)
-// #define PUMP_PWM_PERIOD      1199 // Example PWM Period (defined in .c)
+// --- Configuration ---
+// The pump PWM is TCC0, compare channel PUMP_TCC_CHANNEL (pump_control.c).
+
+// Default PWM period for the runtime configuration. Must match the PER value
+// the framework programs into the TCC at start-up.
+// Calculation: PER = (TCC_Clock_Hz / Target_PWM_Frequency_Hz) - 1
+// Example: TCC Clock = 6MHz (48MHz/8). Target PWM Freq = 5kHz.
+// PER = (6,000,000 / 5000) - 1 = 1199
+#define PUMP_PWM_PERIOD      1199
+
+// Volume doses (pump_dispense_ml()) are timed by TC5 from GCLK0, through
+// the clock channel it shares with TC4, at 48 MHz / 1024: 21.3 us per
+// count, 1.4 s per 16-bit period
+#define PUMP_DISPENSE_TIMER_HZ  (48000000UL / 1024UL)
+#define PUMP_DISPENSE_MAX_MS    900000UL  // Longest dose, the interlock's on-time limit
+// 1: the TC5 overflow ends the dose through EVSYS channel
+// PUMP_DISPENSE_EVSYS_CHANNEL as a non-recoverable fault on TCC0, which
+// holds WO[0] low with no CPU involved. The fault (EVACT1 and NRE0/NRV0)
+// is part of the MCC TCC0 configuration. 0: the TC5 interrupt takes the pin
+// away from TCC0, as an interlock trip does
+#ifndef PUMP_DISPENSE_EVSYS
+#define PUMP_DISPENSE_EVSYS     1
+#endif
+#define PUMP_DISPENSE_EVSYS_CHANNEL  0
+
+typedef enum {
+    PUMP_DISPENSE_DONE,          // The full volume ran
+    PUMP_DISPENSE_CANCELLED,     // pump_activate()/pump_deactivate() took over
+    PUMP_DISPENSE_TRIPPED,       // The interlock stopped the pump
+    PUMP_DISPENSE_RESULT_COUNT
+} PumpDispenseResult;
+
+/**
+ * @brief Called from pump_checkpoint() once a dose has ended.
+ * @param dispensed_ml Volume counted for the dose at the calibrated flow.
+ */
+typedef void (*PumpDispenseCallback)(PumpDispenseResult result, float dispensed_ml, void *context);
+
+typedef struct {
+    uint32_t doses;              // Started
+    uint32_t results[PUMP_DISPENSE_RESULT_COUNT];
+    uint32_t rejected;           // pump_dispense_ml() returned false
+    uint32_t segment_irqs;       // TC5 interrupts, over all doses
+    uint32_t last_counts;        // TC5 counts of the last dose
+} PumpDispenseStats;
 
 
 // --- Public API Functions ---
@@ -41,6 +82,30 @@ void pump_init(void);
  */
 void pump_activate(float percentage);
 
+/**
+ * @brief Starts a dose of @p volume_ml at @p duty_percent and returns.
+ * The run time comes from the calibration table's flow at the duty;
+ * TC5 measures it and switches the output off in hardware, so the dose
+ * does not depend on how often the main loop runs. The pump then counts
+ * as running until the next pump_checkpoint(), which does the accounting
+ * for the exact run time and calls @p done.
+ * Any other pump_activate()/pump_deactivate() ends the dose early, as
+ * does an interlock trip. A warm reset ends it too, with the pump off.
+ * @param done May be NULL.
+ * @return false, with the pump untouched, if the pump is already running,
+ * the dose rounds to nothing or exceeds PUMP_DISPENSE_MAX_MS, the
+ * interlock refuses the run, or TCC0 was generated without the fault
+ * input that ends a dose.
+ */
+bool pump_dispense_ml(float volume_ml, float duty_percent, PumpDispenseCallback done, void *context);
+
+/**
+ * @brief true from pump_dispense_ml() until the dose's callback.
+ */
+bool pump_dispense_active(void);
+
+void pump_dispense_get_stats(PumpDispenseStats *stats);
+
 /**
  * @brief Deactivates the pump (sets PWM duty cycle to 0%).
  * Equivalent to calling pump_activate(0.0f).
@@ -74,5 +139,27 @@ float pump_get_total_volume_ml(void);
  */
 void pump_reset_total_volume(void);
 
+/**
+ * @brief Folds the running interval into the total and saves the accounting
+ * state for warm-reset retention. Also switches the pump off and reports
+ * it after an interlock trip.
+ * Call periodically (e.g., once per main loop pass) while the pump may run;
+ * a reset loses at most the volume dispensed since the last checkpoint.
+ * Finishes a dose the timer has ended and calls its callback.
+ */
+void pump_checkpoint(void);
+
+/**
+ * @brief Selects the zone whose interlock limits apply to the next run.
+ */
+void pump_set_zone(uint8_t zone);
+uint8_t pump_get_zone(void);
+
+/**
+ * @brief Releases the pump after an interlock trip (see pump_interlock.h).
+ * Until then pump_activate() leaves the pump off.
+ */
+void pump_interlock_clear_trip(void);
+
 
 #endif // PUMP_CONTROL_H
@@ -0,0 +1,122 @@
+/**
+ * @file adaptive_sampling.c
+ * @brief Drying-slope fit and time-to-threshold sampling interval.
+ */
+
+#include "adaptive_sampling.h"
+#include <stddef.h>
+
+// Fastest drying assumed when no slope is visible yet (percent per hour).
+// Bounds the interval by the distance to the nearest threshold, so integer
+// readings that have not changed for a while cannot hide a slow drift.
+#define ADAPTIVE_SAMPLING_ASSUMED_RATE_PER_HOUR 10U
+#define ADAPTIVE_SAMPLING_MIN_FIT_POINTS        3
+#define ADAPTIVE_SAMPLING_FLAT_SLOPE            1.0e-6f  // percent/s treated as stable
+
+static uint32_t clamp_interval(const AdaptiveSampler *sampler, uint32_t interval_ms) {
+    if (interval_ms < sampler->config.min_interval_ms) {
+        return sampler->config.min_interval_ms;
+    }
+    if (interval_ms > sampler->config.max_interval_ms) {
+        return sampler->config.max_interval_ms;
+    }
+    return interval_ms;
+}
+
+// Least-squares slope in percent per second over the window
+static bool fit_slope(const AdaptiveSampler *sampler, float *slope_per_s) {
+    uint8_t newest = (uint8_t)((sampler->head + ADAPTIVE_SAMPLING_WINDOW - 1) % ADAPTIVE_SAMPLING_WINDOW);
+    uint32_t newest_ms = sampler->times_ms[newest];
+    float sum_t = 0.0f, sum_v = 0.0f;
+
+    // Times relative to the newest reading keep the floats small and
+    // survive systemTicks wrap-around
+    for (uint8_t i = 0; i < sampler->count; i++) {
+        sum_t -= (float)(newest_ms - sampler->times_ms[i]) / 1000.0f;
+        sum_v += (float)sampler->percents[i];
+    }
+    float mean_t = sum_t / (float)sampler->count;
+    float mean_v = sum_v / (float)sampler->count;
+
+    float covariance = 0.0f, variance = 0.0f;
+    for (uint8_t i = 0; i < sampler->count; i++) {
+        float dt = -(float)(newest_ms - sampler->times_ms[i]) / 1000.0f - mean_t;
+        float dv = (float)sampler->percents[i] - mean_v;
+        covariance += dt * dv;
+        variance += dt * dt;
+    }
+    if (variance <= 0.0f) {
+        return false;
+    }
+    *slope_per_s = covariance / variance;
+    return true;
+}
+
+void adaptive_sampling_init(AdaptiveSampler *sampler, const AdaptiveSamplingConfig *config) {
+    if (config != NULL) {
+        sampler->config = *config;
+    } else {
+        sampler->config.min_interval_ms = ADAPTIVE_SAMPLING_MIN_MS;
+        sampler->config.max_interval_ms = ADAPTIVE_SAMPLING_MAX_MS;
+    }
+    sampler->wakeups = 0;
+    adaptive_sampling_reset(sampler);
+    sampler->interval_ms = clamp_interval(sampler, ADAPTIVE_SAMPLING_DEFAULT_MS);
+}
+
+void adaptive_sampling_reset(AdaptiveSampler *sampler) {
+    sampler->head = 0;
+    sampler->count = 0;
+    sampler->slope_per_s = 0.0f;
+    sampler->interval_ms = sampler->config.min_interval_ms;
+}
+
+uint32_t adaptive_sampling_update(AdaptiveSampler *sampler, uint32_t now_ms,
+                                  uint8_t percent, int low, int high) {
+    sampler->times_ms[sampler->head] = now_ms;
+    sampler->percents[sampler->head] = percent;
+    sampler->head = (uint8_t)((sampler->head + 1) % ADAPTIVE_SAMPLING_WINDOW);
+    if (sampler->count < ADAPTIVE_SAMPLING_WINDOW) {
+        sampler->count++;
+    }
+    sampler->wakeups++;
+
+    // At or past a threshold: the control loop needs every reading
+    if ((int)percent <= low || (int)percent >= high) {
+        sampler->interval_ms = sampler->config.min_interval_ms;
+        return sampler->interval_ms;
+    }
+
+    // Bound by the fastest plausible drift across the remaining margin
+    uint32_t margin = (uint32_t)(((int)percent - low < high - (int)percent)
+                                 ? (int)percent - low : high - (int)percent);
+    uint32_t candidate = margin * (3600000U / ADAPTIVE_SAMPLING_ASSUMED_RATE_PER_HOUR)
+                         / ADAPTIVE_SAMPLING_LEAD;
+
+    float slope;
+    if (sampler->count >= ADAPTIVE_SAMPLING_MIN_FIT_POINTS && fit_slope(sampler, &slope)) {
+        sampler->slope_per_s = slope;
+        float distance = 0.0f;
+        if (slope < -ADAPTIVE_SAMPLING_FLAT_SLOPE) {
+            distance = (float)((int)percent - low) / -slope;   // Seconds until dry threshold
+        } else if (slope > ADAPTIVE_SAMPLING_FLAT_SLOPE) {
+            distance = (float)(high - (int)percent) / slope;   // Seconds until wet threshold
+        }
+        if (distance > 0.0f) {
+            float predicted_ms = distance * 1000.0f / (float)ADAPTIVE_SAMPLING_LEAD;
+            if (predicted_ms < (float)candidate) {
+                candidate = (uint32_t)predicted_ms;
+            }
+        }
+    } else if (candidate > ADAPTIVE_SAMPLING_DEFAULT_MS) {
+        candidate = ADAPTIVE_SAMPLING_DEFAULT_MS;  // Not enough history for a trend
+    }
+
+    // Shrink immediately, grow gradually
+    uint32_t growth_limit = sampler->interval_ms * ADAPTIVE_SAMPLING_MAX_GROWTH;
+    if (candidate > growth_limit) {
+        candidate = growth_limit;
+    }
+    sampler->interval_ms = clamp_interval(sampler, candidate);
+    return sampler->interval_ms;
+}
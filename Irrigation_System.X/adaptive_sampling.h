@@ -0,0 +1,73 @@
+/**
+ * @file adaptive_sampling.h
+ * @brief Per-zone moisture sampling interval predicted from the drying slope.
+ *
+ * Each zone keeps its last few readings and fits a least-squares slope
+ * (percent per second) through them. From the slope and the plant's
+ * thresholds (runtime_config_plant()) it predicts how long until the reading
+ * crosses the threshold it is heading for, and schedules the next sample
+ * at a fraction of that time. Stable soil is therefore sampled rarely,
+ * while a bed that is close to its dry threshold is sampled often enough
+ * to catch the crossing within roughly one minimum interval.
+ *
+ * The interval only grows by a bounded factor per sample, so a single
+ * noisy reading cannot push the next sample far into the future, and it
+ * falls back to the minimum as soon as a reading is outside the thresholds.
+ *
+ * The module has no hardware dependencies; tools/sampling_sim.c runs it
+ * against simulated or recorded traces on the host.
+ */
+
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ADAPTIVE_SAMPLING_WINDOW       8        // Readings used for the slope fit
+#define ADAPTIVE_SAMPLING_MIN_MS       10000U   // 10 s: close to a threshold
+#define ADAPTIVE_SAMPLING_DEFAULT_MS   30000U   // 30 s: until a slope is known
+#define ADAPTIVE_SAMPLING_MAX_MS       1800000U // 30 min: stable soil
+#define ADAPTIVE_SAMPLING_LEAD         4        // Samples planned before a predicted crossing
+#define ADAPTIVE_SAMPLING_MAX_GROWTH   2        // Interval may at most double per sample
+
+typedef struct {
+    uint32_t min_interval_ms;
+    uint32_t max_interval_ms;
+} AdaptiveSamplingConfig;
+
+typedef struct {
+    AdaptiveSamplingConfig config;
+    uint32_t times_ms[ADAPTIVE_SAMPLING_WINDOW];
+    uint8_t percents[ADAPTIVE_SAMPLING_WINDOW];
+    uint8_t head;                  // Next slot to write
+    uint8_t count;                 // Valid readings in the window
+    uint32_t interval_ms;          // Current sampling interval
+    float slope_per_s;             // Last fitted slope, percent per second
+    uint32_t wakeups;              // Samples taken since init
+} AdaptiveSampler;
+
+/**
+ * @brief Resets a zone's history.
+ * @param config Interval bounds, or NULL for the ADAPTIVE_SAMPLING_* defaults.
+ */
+void adaptive_sampling_init(AdaptiveSampler *sampler, const AdaptiveSamplingConfig *config);
+
+/**
+ * @brief Adds a reading and computes the interval until the next one.
+ * @param now_ms Time of the reading (systemTicks).
+ * @param percent Moisture reading.
+ * @param low Plant threshold the soil dries towards (moisture_low).
+ * @param high Plant threshold the soil wets towards (moisture_high).
+ * @return Milliseconds to wait before the next sample.
+ */
+uint32_t adaptive_sampling_update(AdaptiveSampler *sampler, uint32_t now_ms,
+                                  uint8_t percent, int low, int high);
+
+/**
+ * @brief Forgets the history, e.g. after watering changes the trend.
+ * The next sample is taken after the minimum interval.
+ */
+void adaptive_sampling_reset(AdaptiveSampler *sampler);
+
+#endif // ADAPTIVE_SAMPLING_H
@@ -0,0 +1,39 @@
+/**
+ * @file adc_window.c
+ * @brief Inverse of the calibration table around the present reading.
+ */
+
+#include "adc_window.h"
+
+static bool in_band(const MoistureLut *lut, int32_t raw, int16_t raw_offset,
+                    uint8_t low_percent, uint8_t high_percent) {
+    int32_t compensated = raw + raw_offset;
+    if (compensated < 0) compensated = 0;
+    if (compensated > (int32_t)MOISTURE_LUT_RAW_MAX) compensated = MOISTURE_LUT_RAW_MAX;
+
+    uint8_t percent = moisture_lut_convert(lut, (uint16_t)compensated);
+    return percent > low_percent && percent < high_percent;
+}
+
+bool adc_window_around(const MoistureLut *lut, uint16_t raw, int16_t raw_offset,
+                       uint8_t low_percent, uint8_t high_percent, AdcWindow *window) {
+    if (raw > MOISTURE_LUT_RAW_MAX ||
+        !in_band(lut, raw, raw_offset, low_percent, high_percent)) {
+        return false;
+    }
+
+    // Walk outwards; works for either sensor polarity and for tables that
+    // are not monotonic over the whole range
+    int32_t lower = raw;
+    while (lower > 0 && in_band(lut, lower - 1, raw_offset, low_percent, high_percent)) {
+        lower--;
+    }
+    int32_t upper = raw;
+    while (upper < (int32_t)MOISTURE_LUT_RAW_MAX &&
+           in_band(lut, upper + 1, raw_offset, low_percent, high_percent)) {
+        upper++;
+    }
+    window->lower = (uint16_t)lower;
+    window->upper = (uint16_t)upper;
+    return true;
+}
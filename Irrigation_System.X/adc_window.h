@@ -0,0 +1,51 @@
+/**
+ * @file adc_window.h
+ * @brief Raw ADC band that keeps a moisture reading between two thresholds.
+ *
+ * The SAMD21 ADC can compare every result with a window (WINLT, WINUT) and
+ * raise an interrupt only when a result falls outside it. To use that for
+ * moisture monitoring, the plant's percent thresholds have to be turned
+ * back into raw counts: the inverse of the calibration table, shifted by
+ * the current temperature compensation. adc_window_around() walks the
+ * table outwards from the present reading to the first raw value on each
+ * side that reads at or beyond a threshold. The band is the run of raw
+ * values around the reading that a full measurement would also call
+ * "between the thresholds", so a window wake means a real threshold
+ * crossing, subject only to ADC noise.
+ *
+ * The module has no hardware dependencies; moisture_sensor.c programs the
+ * ADC from the result and tools/sampling_sim.c simulates the wake pattern.
+ */
+
+#ifndef ADC_WINDOW_H
+#define ADC_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "moisture_curve.h"
+
+// Raw values a reading may take without crossing a threshold, inclusive
+typedef struct {
+    uint16_t lower;
+    uint16_t upper;
+} AdcWindow;
+
+/**
+ * @brief Band of raw readings around @p raw that convert to a percentage
+ * strictly between @p low_percent and @p high_percent.
+ * @param lut Calibration table used for readings.
+ * @param raw Present uncompensated reading.
+ * @param raw_offset Temperature compensation added to raw before lookup.
+ * @return false if @p raw itself is not between the thresholds.
+ */
+bool adc_window_around(const MoistureLut *lut, uint16_t raw, int16_t raw_offset,
+                       uint8_t low_percent, uint8_t high_percent, AdcWindow *window);
+
+/**
+ * @brief Whether @p raw lies outside @p window (would wake the CPU).
+ */
+static inline bool adc_window_outside(const AdcWindow *window, uint16_t raw) {
+    return raw < window->lower || raw > window->upper;
+}
+
+#endif // ADC_WINDOW_H
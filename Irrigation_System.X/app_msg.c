@@ -0,0 +1,104 @@
+/**
+ * @file app_msg.c
+ * @brief Topic storage, subscriber table and report of the firmware bus.
+ */
+
+#include "app_msg.h"
+#include "pump_interlock.h"
+#include "bus_node.h"
+#include "LCD1602A.h"
+#include "fmt.h"
+
+extern volatile uint32_t systemTicks;
+
+// Payload slots; each covers that many publishes between two dispatches
+static MoistureMessage moisture_slots[4];
+static PumpMessage pump_slots[4];
+static StateMessage state_slots[4];
+
+static MsgbusTopic topics[MSG_TOPIC_COUNT] = {
+    [MSG_MOISTURE] = MSGBUS_TOPIC_INIT(moisture_slots),
+    [MSG_PUMP]     = MSGBUS_TOPIC_INIT(pump_slots),
+    [MSG_STATE]    = MSGBUS_TOPIC_INIT(state_slots),
+};
+
+static const char *const topic_names[MSG_TOPIC_COUNT] = { "moisture", "pump", "state" };
+
+static MsgbusMessage interlock_queue[4];
+static MsgbusMessage telemetry_queue[8];
+static MsgbusMessage display_queue[8];
+
+static MsgbusSubscriber subscribers[] = {
+    MSGBUS_SUBSCRIBER_INIT(pump_interlock_on_message,
+                           MSGBUS_TOPIC_BIT(MSG_MOISTURE), interlock_queue),
+    MSGBUS_SUBSCRIBER_INIT(bus_node_on_message,
+                           MSGBUS_TOPIC_BIT(MSG_MOISTURE) | MSGBUS_TOPIC_BIT(MSG_PUMP), telemetry_queue),
+    MSGBUS_SUBSCRIBER_INIT(lcd_on_message,
+                           MSGBUS_TOPIC_BIT(MSG_MOISTURE) | MSGBUS_TOPIC_BIT(MSG_STATE), display_queue),
+};
+
+static const char *const subscriber_names[] = { "interlock", "bus node", "display" };
+
+#define SUBSCRIBER_COUNT (sizeof(subscribers) / sizeof(subscribers[0]))
+
+// Latency is counted in 1 ms ticks
+static uint32_t bus_clock(void) {
+    return systemTicks;
+}
+
+// Static storage: usable from reset, before any boot step has run
+Msgbus app_msgbus = {
+    topics,
+    subscribers,
+    MSG_TOPIC_COUNT,
+    SUBSCRIBER_COUNT,
+    bus_clock,
+};
+
+void app_msg_dispatch(void) {
+    msgbus_dispatch(&app_msgbus);
+}
+
+void app_msg_report(void) {
+    char storage[96];
+    FmtBuffer line;
+
+    fmt_uart_str("MSG BEGIN\r\n");
+    for (uint8_t topic = 0; topic < MSG_TOPIC_COUNT; topic++) {
+        fmt_init(&line, storage, sizeof(storage));
+        fmt_str(&line, "topic ");
+        fmt_str(&line, topic_names[topic]);
+        fmt_str(&line, ": ");
+        fmt_u32(&line, topics[topic].slot_count, 0);
+        fmt_str(&line, " x ");
+        fmt_u32(&line, topics[topic].payload_size, 0);
+        fmt_str(&line, " B, ");
+        fmt_u32(&line, msgbus_topic_bytes(&app_msgbus, topic), 0);
+        fmt_str(&line, " B RAM, published ");
+        fmt_u32(&line, topics[topic].sequence, 0);
+        fmt_str(&line, "\r\n");
+        fmt_uart_write(&line);
+    }
+    for (uint8_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        const MsgbusSubscriber *subscriber = &subscribers[i];
+        const MsgbusSubscriberStats *stats = &subscriber->stats;
+        fmt_init(&line, storage, sizeof(storage));
+        fmt_str(&line, "sub ");
+        fmt_str(&line, subscriber_names[i]);
+        fmt_str(&line, ": queue ");
+        fmt_u32(&line, (uint32_t)subscriber->queue_size * sizeof(MsgbusMessage), 0);
+        fmt_str(&line, " B, handled ");
+        fmt_u32(&line, stats->handled, 0);
+        fmt_str(&line, ", dropped ");
+        fmt_u32(&line, stats->dropped, 0);
+        fmt_str(&line, ", overrun ");
+        fmt_u32(&line, stats->overrun, 0);
+        fmt_str(&line, ", latency max ");
+        fmt_u32(&line, stats->latency_max, 0);
+        fmt_str(&line, " ms, avg ");
+        fmt_u32(&line, stats->handled ? stats->latency_total / stats->handled : 0U, 0);
+        fmt_str(&line, " ms\r\n");
+        fmt_uart_write(&line);
+    }
+    fmt_uart_str("MSG END\r\n");
+}
@@ -0,0 +1,86 @@
+/**
+ * @file app_msg.h
+ * @brief The firmware's message bus topics, payloads and subscribers.
+ *
+ * Readings, pump events and state changes are published here instead of
+ * being left in globals for other modules to poll (see msgbus.h):
+ *
+ *   MSG_MOISTURE  each reported reading           moisture_sensor.c
+ *   MSG_PUMP      pump started, stopped, tripped   Pump_control.c
+ *   MSG_STATE     State_t changes                  app_state.c
+ *
+ * Subscribers, in dispatch order (app_msg.c):
+ *   pump interlock  MSG_MOISTURE                 leak check of the pump zone
+ *   bus node        MSG_MOISTURE, MSG_PUMP       STATUS report for the master
+ *   display         MSG_MOISTURE, MSG_STATE      LCD
+ *
+ * The main loop calls app_msg_dispatch() once per pass. app_msg_report()
+ * (bound to APP_MSG_REPORT_COMMAND in Check_Commands) prints the memory
+ * per topic and each subscriber's counts and latency.
+ */
+
+#ifndef APP_MSG_H
+#define APP_MSG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "msgbus.h"
+
+#define APP_MSG_REPORT_COMMAND  'M'   // UART command character for app_msg_report()
+
+typedef enum {
+    MSG_MOISTURE,
+    MSG_PUMP,
+    MSG_STATE,
+    MSG_TOPIC_COUNT
+} AppMsgTopic;
+
+typedef struct {
+    uint8_t zone;
+    uint8_t percent;
+    uint8_t plant_index;              // Plant the thresholds came from
+    bool temperature_valid;
+    uint16_t raw;                     // 12-bit ADC value
+    int16_t temperature_x16;          // 1/16 degC
+    uint32_t input_voltage_mv;
+} MoistureMessage;
+
+typedef enum {
+    PUMP_MSG_STARTED,
+    PUMP_MSG_STOPPED,
+    PUMP_MSG_TRIPPED                  // The interlock cut the pump
+} PumpMessageKind;
+
+typedef struct {
+    uint8_t kind;                     // PumpMessageKind
+    uint8_t zone;
+    uint8_t trip;                     // InterlockTrip, for PUMP_MSG_TRIPPED
+    uint8_t duty_percent;
+    uint32_t total_ml;                // Dispensed since the last reset
+} PumpMessage;
+
+typedef struct {
+    uint8_t machine;                  // TRACE_FSM_*
+    uint8_t from;                     // HSM_NONE when the machine starts
+    uint8_t to;
+} StateMessage;
+
+extern Msgbus app_msgbus;
+
+// Copies *payload into the topic's next slot; the size must match the topic
+#define APP_MSG_PUBLISH(topic, payload) \
+    msgbus_publish(&app_msgbus, (topic), (payload), (uint16_t)sizeof(*(payload)))
+
+/**
+ * @brief Runs the subscribers' handlers for everything published since
+ * the last call. Main loop only.
+ */
+void app_msg_dispatch(void);
+
+/**
+ * @brief Writes "MSG BEGIN", one line per topic and per subscriber, then
+ * "MSG END" to the UART.
+ */
+void app_msg_report(void);
+
+#endif // APP_MSG_H
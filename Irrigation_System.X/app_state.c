@@ -0,0 +1,98 @@
+/**
+ * @file app_state.c
+ * @brief State_t transition table and state entry messages.
+ */
+
+#include "app_state.h"
+#include "hsm.h"
+#include "trace.h"
+#include "fmt.h"
+#include "app_msg.h"
+#include <stddef.h>
+
+// Contains every State_t; handles the fault for all of them
+#define STATE_APP        (STATE_STANDBY + 1)
+#define APP_STATE_COUNT  (STATE_APP + 1)
+
+static Hsm app_fsm;
+
+static void idle_entry(Hsm *fsm) {
+    (void)fsm;
+    fmt_uart_str("System in IDLE State\r\n");
+}
+
+static void init_entry(Hsm *fsm) {
+    (void)fsm;
+    fmt_uart_str("System in INIT State\r\n");
+}
+
+static void running_entry(Hsm *fsm) {
+    (void)fsm;
+    fmt_uart_str("System in RUNNING State\r\n");
+}
+
+static void error_entry(Hsm *fsm) {
+    (void)fsm;
+    fmt_uart_str("System in ERROR State\r\n");
+}
+
+static void standby_entry(Hsm *fsm) {
+    (void)fsm;
+    fmt_uart_str("System in STANDBY State\r\n");
+}
+
+// Transition hook: traced and published on MSG_STATE
+static void state_changed(uint8_t machine, HsmStateId from, HsmStateId to, HsmEventId event) {
+    StateMessage change = { machine, from, to };
+#if TRACE_ENABLED
+    trace_fsm_transition(machine, from, to, event);
+#else
+    (void)event;
+#endif
+    APP_MSG_PUBLISH(MSG_STATE, &change);
+}
+
+static const HsmState app_states[APP_STATE_COUNT] = {
+    //                  parent     initial     entry          exit  poll
+    [STATE_IDLE]    = { STATE_APP, HSM_NONE,   idle_entry,    NULL, NULL },
+    [STATE_INIT]    = { STATE_APP, HSM_NONE,   init_entry,    NULL, NULL },
+    [STATE_RUNNING] = { STATE_APP, HSM_NONE,   running_entry, NULL, NULL },
+    [STATE_ERROR]   = { STATE_APP, HSM_NONE,   error_entry,   NULL, NULL },
+    [STATE_STANDBY] = { STATE_APP, HSM_NONE,   standby_entry, NULL, NULL },
+    [STATE_APP]     = { HSM_NONE,  STATE_IDLE, NULL,          NULL, NULL },
+};
+
+static const HsmStateId app_transitions[APP_STATE_COUNT][APP_EVT_COUNT] = {
+    [STATE_IDLE]    = { [APP_EVT_BUTTON] = HSM_TO(STATE_INIT) },
+    [STATE_INIT]    = { [APP_EVT_BUTTON] = HSM_TO(STATE_RUNNING) },
+    [STATE_RUNNING] = { [APP_EVT_BUTTON] = HSM_TO(STATE_ERROR) },
+    [STATE_ERROR]   = { [APP_EVT_BUTTON] = HSM_TO(STATE_STANDBY) },
+    [STATE_STANDBY] = { [APP_EVT_BUTTON] = HSM_TO(STATE_IDLE) },
+    [STATE_APP]     = { [APP_EVT_FAULT]  = HSM_TO(STATE_ERROR) },
+};
+
+static const HsmDefinition app_machine = {
+    app_states,
+    &app_transitions[0][0],
+    APP_STATE_COUNT,
+    APP_EVT_COUNT,
+    TRACE_FSM_APP,
+    state_changed,
+};
+
+void app_state_init(void) {
+    hsm_init(&app_fsm, &app_machine, NULL);
+    hsm_transition(&app_fsm, STATE_IDLE);
+}
+
+bool app_state_post(AppEvent event) {
+    return hsm_post(&app_fsm, (HsmEventId)event);
+}
+
+void app_state_run(void) {
+    hsm_run(&app_fsm);
+}
+
+State_t app_state_get(void) {
+    return (State_t)hsm_state(&app_fsm);
+}
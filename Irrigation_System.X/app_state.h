@@ -0,0 +1,54 @@
+/**
+ * @file app_state.h
+ * @brief Top-level system state (State_t), cycled by the button.
+ *
+ * Each button press moves IDLE -> INIT -> RUNNING -> ERROR -> STANDBY and
+ * back to IDLE, printing the new state. A fault moves any state to ERROR;
+ * it is handled once, by the APP state that contains the other five.
+ * Every change is published on MSG_STATE (app_msg.h).
+ *
+ * The machine runs on hsm.h. main.c posts the button with app_state_post()
+ * from its debounced press handler and calls app_state_run() from the
+ * main loop.
+ */
+
+#ifndef APP_STATE_H
+#define APP_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// hsm.h state ids
+typedef enum {
+    STATE_IDLE,
+    STATE_INIT,
+    STATE_RUNNING,
+    STATE_ERROR,
+    STATE_STANDBY
+} State_t;
+
+typedef enum {
+    APP_EVT_BUTTON,                   // Debounced press: next state
+    APP_EVT_FAULT,                    // Any state to ERROR
+    APP_EVT_COUNT
+} AppEvent;
+
+/**
+ * @brief Enters STATE_IDLE.
+ */
+void app_state_init(void);
+
+/**
+ * @brief Queues @p event; safe from one interrupt handler.
+ * @return false if the queue is full.
+ */
+bool app_state_post(AppEvent event);
+
+/**
+ * @brief Handles the queued events. Call from the main loop.
+ */
+void app_state_run(void);
+
+State_t app_state_get(void);
+
+#endif // APP_STATE_H
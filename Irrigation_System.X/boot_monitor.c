@@ -0,0 +1,90 @@
+/**
+ * @file boot_monitor.c
+ * @brief Boot milestone timestamps and report.
+ */
+
+#include "boot_monitor.h"
+#include "definitions.h"
+#include "trace.h"
+#include "fmt.h"
+
+extern volatile uint32_t systemTicks;
+
+static BootKind boot_kind = BOOT_COLD;
+static uint8_t boot_reset_cause = 0;
+static uint32_t milestone_us[BOOT_MILESTONE_COUNT];
+static bool milestone_reached[BOOT_MILESTONE_COUNT];
+
+static const char *const milestone_names[BOOT_MILESTONE_COUNT] = {
+    "state restored",
+    "first control action",
+    "calibration loaded",
+    "LCD ready",
+    "first valid reading",
+    "boot complete"
+};
+
+void boot_monitor_set_kind(BootKind kind, uint8_t reset_cause) {
+    boot_kind = kind;
+    boot_reset_cause = reset_cause;
+}
+
+BootKind boot_monitor_get_kind(void) {
+    return boot_kind;
+}
+
+uint32_t boot_monitor_now_us(void) {
+    uint32_t ticks;
+    uint32_t counter;
+
+    // Re-read if the 1 ms interrupt landed between the two samples
+    do {
+        ticks = systemTicks;
+        counter = TC4_Timer16bitCounterGet();
+    } while (ticks != systemTicks);
+
+    return ticks * 1000U + (counter * 1000U) / ((uint32_t)TC4_Timer16bitPeriodGet() + 1U);
+}
+
+void boot_monitor_mark(BootMilestone milestone) {
+    if (milestone >= BOOT_MILESTONE_COUNT || milestone_reached[milestone]) {
+        return;
+    }
+    milestone_us[milestone] = boot_monitor_now_us();
+    milestone_reached[milestone] = true;
+    TRACE(TRACE_EVT_BOOT_MILESTONE, milestone,
+          milestone_us[milestone] > 0xFFFFU ? 0xFFFFU : milestone_us[milestone]);
+}
+
+uint32_t boot_monitor_get_us(BootMilestone milestone) {
+    if (milestone >= BOOT_MILESTONE_COUNT || !milestone_reached[milestone]) {
+        return 0;
+    }
+    return milestone_us[milestone];
+}
+
+void boot_monitor_report(void) {
+    char storage[48];
+    FmtBuffer line;
+
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "Boot: ");
+    fmt_str(&line, boot_kind == BOOT_WARM ? "warm" : "cold");
+    fmt_str(&line, " (reset cause 0x");
+    fmt_hex(&line, boot_reset_cause, 2);
+    fmt_str(&line, ")\r\n");
+    fmt_uart_write(&line);
+    for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+        fmt_init(&line, storage, sizeof(storage));
+        fmt_str(&line, "  ");
+        fmt_str(&line, milestone_names[i]);
+        fmt_str(&line, ": ");
+        if (milestone_reached[i]) {
+            fmt_u32(&line, milestone_us[i], 0);
+            fmt_str(&line, " us\r\n");
+        } else {
+            fmt_str(&line, "pending\r\n");
+        }
+        fmt_uart_write(&line);
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * @file boot_monitor.h
+ * @brief Boot classification and time-to-milestone instrumentation.
+ *
+ * Times are in microseconds since the 1 ms TC4 tick started counting in
+ * SYS_Initialize(), derived from systemTicks plus the TC4 counter position.
+ * Each milestone keeps only its first timestamp after reset and is also
+ * written to the event trace (TRACE_EVT_BOOT_MILESTONE).
+ */
+
+#ifndef BOOT_MONITOR_H
+#define BOOT_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    BOOT_COLD,   // Power-on, brownout without valid retained state, or first boot
+    BOOT_WARM    // Watchdog, system or external reset with valid retained state
+} BootKind;
+
+typedef enum {
+    BOOT_MILESTONE_STATE_RESTORED,        // Retained state validated (or discarded)
+    BOOT_MILESTONE_FIRST_CONTROL_ACTION,  // First pump command or processed reading
+    BOOT_MILESTONE_CALIBRATION_LOADED,    // Calibration values read from RAM or flash
+    BOOT_MILESTONE_LCD_READY,             // HD44780 power-up sequence finished
+    BOOT_MILESTONE_FIRST_VALID_READING,   // First calibrated moisture percentage
+    BOOT_MILESTONE_BOOT_COMPLETE,         // All boot sequencer steps finished
+    BOOT_MILESTONE_COUNT
+} BootMilestone;
+
+/**
+ * @brief Records the boot kind and reset cause for the report.
+ * Called by warm_state_init().
+ */
+void boot_monitor_set_kind(BootKind kind, uint8_t reset_cause);
+
+/**
+ * @brief Returns the boot kind recorded for this reset.
+ */
+BootKind boot_monitor_get_kind(void);
+
+/**
+ * @brief Current time since the tick timer started, in microseconds.
+ */
+uint32_t boot_monitor_now_us(void);
+
+/**
+ * @brief Timestamps a milestone. Only the first call per milestone counts.
+ */
+void boot_monitor_mark(BootMilestone milestone);
+
+/**
+ * @brief Gets the timestamp of a milestone.
+ * @return Microseconds since timer start, or 0 if not reached yet.
+ */
+uint32_t boot_monitor_get_us(BootMilestone milestone);
+
+/**
+ * @brief Prints the boot kind, reset cause and milestone times to the UART.
+ */
+void boot_monitor_report(void);
+
+#endif // BOOT_MONITOR_H
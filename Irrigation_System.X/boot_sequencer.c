@@ -0,0 +1,152 @@
+/**
+ * @file boot_sequencer.c
+ * @brief Boot step table and cooperative scheduler.
+ */
+
+#include "boot_sequencer.h"
+#include <stddef.h>
+#include <stdint.h>
+#include "definitions.h"
+#include "boot_monitor.h"
+#include "warm_state.h"
+#include "trace.h"
+#include "moisture_calibration.h"
+#include "Pump_control.h"
+#include "LCD1602A.h"
+#include "temperature_sensor.h"
+#include "bus_node.h"
+#include "console_rx.h"
+#include "schedule_runner.h"
+#include "runtime_config.h"
+
+#define BOOT_DEP(step)       (1U << (step))
+#define BOOT_STEPS_ALL       ((1U << BOOT_STEP_COUNT) - 1U)
+#define BOOT_MILESTONE_NONE  BOOT_MILESTONE_COUNT
+
+typedef struct {
+    uint16_t depends_on;           // BOOT_DEP() mask of prerequisite steps
+    void (*start)(void);
+    bool (*poll)(void);            // NULL: finished when start returns
+    BootMilestone milestone;       // Stamped on completion, or BOOT_MILESTONE_NONE
+} BootStep;
+
+static MoistureSensorContext *boot_sensor_context;
+static uint16_t steps_started;
+static uint16_t steps_done;
+
+// --- Step implementations ---
+
+static void retained_state_start(void) {
+    trace_init();
+    warm_state_init();
+}
+
+
+static void calibration_start(void) {
+    calibration_load();
+}
+
+static void temperature_start(void) {
+    temperature_sensor_init();
+    temperature_sensor_start_cycle(systemTicks);
+}
+
+static void bus_start(void) {
+    bus_node_init(BUS_NODE_ADDRESS);
+}
+
+static void first_reading_start(void) {
+    MoistureSensorContext *context = boot_sensor_context;
+
+    uint16_t dry_value, wet_value;
+
+    context->moisture_raw_value = moisture_sensor_scan_result(context->zone);
+    context->input_voltage_mv = context->moisture_raw_value * ADC_VREF / 4095U;
+    get_calibration_values(&dry_value, &wet_value);
+    moisture_sensor_calibrate(context, dry_value, wet_value);
+
+    // Let the regular state machine report it and schedule the next sample
+    hsm_transition(&context->fsm, MOISTURE_STATE_SEND_UART);
+    if (get_calibration_status()) {
+        boot_monitor_mark(BOOT_MILESTONE_FIRST_VALID_READING);
+    }
+}
+
+static void display_start(void) {
+    updateMoistureStatusDisplay(runtime_config_plant(current_plant_index)->name,
+                                boot_sensor_context->moisture_percentage);
+}
+
+static void report_start(void) {
+    if (!warm_state_is_warm()) {
+        calibration_report();
+    }
+    boot_monitor_report();
+}
+
+// Steps are polled in table order, so a step whose dependencies finish
+// earlier in the same pass starts immediately
+static const BootStep boot_steps[BOOT_STEP_COUNT] = {
+    [BOOT_STEP_RETAINED_STATE] = {
+        0, retained_state_start, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_CONFIG] = {
+        0, runtime_config_init, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_ADC_SAMPLE] = {
+        0, moisture_sensor_scan_start, moisture_sensor_scan_poll, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_CALIBRATION] = {
+        BOOT_DEP(BOOT_STEP_RETAINED_STATE),
+        calibration_start, NULL, BOOT_MILESTONE_CALIBRATION_LOADED },
+    [BOOT_STEP_LCD] = {
+        0, lcd_init_start, lcd_init_poll, BOOT_MILESTONE_LCD_READY },
+    [BOOT_STEP_PUMP] = {
+        BOOT_DEP(BOOT_STEP_RETAINED_STATE) | BOOT_DEP(BOOT_STEP_CONFIG),
+        pump_init, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_TEMPERATURE] = {
+        0, temperature_start, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_BUS] = {
+        0, bus_start, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_CONSOLE_RX] = {
+        0, console_rx_init, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_SCHEDULE] = {
+        0, schedule_runner_init, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_FIRST_READING] = {
+        BOOT_DEP(BOOT_STEP_ADC_SAMPLE) | BOOT_DEP(BOOT_STEP_CALIBRATION) | BOOT_DEP(BOOT_STEP_CONFIG),
+        first_reading_start, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_DISPLAY] = {
+        BOOT_DEP(BOOT_STEP_LCD) | BOOT_DEP(BOOT_STEP_FIRST_READING),
+        display_start, NULL, BOOT_MILESTONE_NONE },
+    [BOOT_STEP_REPORT] = {
+        BOOT_STEPS_ALL & ~BOOT_DEP(BOOT_STEP_REPORT),
+        report_start, NULL, BOOT_MILESTONE_BOOT_COMPLETE },
+};
+
+// --- Public API ---
+
+void boot_sequencer_start(MoistureSensorContext *sensor_context) {
+    boot_sensor_context = sensor_context;
+    steps_started = 0;
+    steps_done = 0;
+}
+
+bool boot_sequencer_run(void) {
+    for (uint8_t i = 0; i < BOOT_STEP_COUNT; i++) {
+        const BootStep *step = &boot_steps[i];
+        uint16_t mask = BOOT_DEP(i);
+
+        if (steps_done & mask) {
+            continue;
+        }
+        if (!(steps_started & mask)) {
+            if ((steps_done & step->depends_on) != step->depends_on) {
+                continue;
+            }
+            steps_started |= mask;
+            step->start();
+        }
+        if (step->poll == NULL || step->poll()) {
+            steps_done |= mask;
+            boot_monitor_mark(step->milestone);
+        }
+    }
+    return steps_done == BOOT_STEPS_ALL;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file boot_sequencer.h
+ * @brief Cooperative, dependency-ordered startup after SYS_Initialize().
+ *
+ * Each subsystem's init is a boot step with a start function, an optional
+ * non-blocking poll function and a mask of steps it depends on. A step
+ * starts as soon as its dependencies are finished, so the ADC samples and
+ * the calibration values are loaded while the LCD is still inside its
+ * power-up window. Step completions are timestamped by boot_monitor.
+ *
+ * Usage from main():
+ * @code
+ *     SYS_Initialize(NULL);
+ *     boot_sequencer_start(&moisture_sensor_ctx);
+ *     while (!boot_sequencer_run()) {
+ *         // Other non-blocking work may run here
+ *     }
+ *     // Normal loop: moisture_sensor_state_machine_run() etc.
+ * @endcode
+ * The moisture context must have its message buffers assigned before the
+ * sequencer hands it the first reading.
+ */
+
+#ifndef BOOT_SEQUENCER_H
+#define BOOT_SEQUENCER_H
+
+#include <stdbool.h>
+#include "moisture_sensor.h"
+
+typedef enum {
+    BOOT_STEP_RETAINED_STATE,   // trace_init(), warm_state_init()
+    BOOT_STEP_CONFIG,           // Runtime configuration from flash, or the defaults
+    BOOT_STEP_ADC_SAMPLE,       // First power-gated sensor scan
+    BOOT_STEP_CALIBRATION,      // Load calibration values (RAM or flash)
+    BOOT_STEP_LCD,              // HD44780 power-up sequence
+    BOOT_STEP_PUMP,             // pump_init(), warm resume or abort
+    BOOT_STEP_TEMPERATURE,      // 1-Wire SERCOM setup, first DS18B20 conversion
+    BOOT_STEP_BUS,              // RS-485 bus node, answers polls from here on
+    BOOT_STEP_CONSOLE_RX,       // DMA receive on the console UART
+    BOOT_STEP_SCHEDULE,         // Load the watering schedule from flash
+    BOOT_STEP_FIRST_READING,    // Convert the first sample to a percentage
+    BOOT_STEP_DISPLAY,          // Show the first reading on the LCD
+    BOOT_STEP_REPORT,           // Deferred UART messages and boot report
+    BOOT_STEP_COUNT
+} BootStepId;
+
+/**
+ * @brief Resets the sequencer. Call once after SYS_Initialize().
+ * @param sensor_context Moisture context that receives the first reading.
+ */
+void boot_sequencer_start(MoistureSensorContext *sensor_context);
+
+/**
+ * @brief Starts and polls every ready boot step once. Never blocks on a delay.
+ * @return true once all steps have finished.
+ */
+bool boot_sequencer_run(void);
+
+#endif // BOOT_SEQUENCER_H
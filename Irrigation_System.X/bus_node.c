@@ -0,0 +1,185 @@
+/**
+ * @file bus_node.c
+ * @brief RS-485 bus node on a SERCOM USART, answered from its interrupt.
+ */
+
+#include "bus_node.h"
+#include "definitions.h"
+#include "sam.h"
+#include "cycle_counter.h"
+#include "app_msg.h"
+#include "Pump_control.h"
+#include "moisture_calibration.h"
+
+// --- Configuration (must match the board wiring) ---
+#define BUS_SERCOM              SERCOM0
+#define BUS_SERCOM_IRQn         SERCOM0_IRQn
+#define BUS_SERCOM_APB          PM_APBCMASK_SERCOM0
+#define BUS_SERCOM_GCLK_ID      SERCOM0_GCLK_ID_CORE
+#define BUS_TX_PIN              10      // PA10, SERCOM0 PAD2 (peripheral function C) -> DI
+#define BUS_RX_PIN              11      // PA11, SERCOM0 PAD3 (peripheral function C) <- RO
+#define BUS_PIN_FUNCTION        2       // PMUX value for function C
+#define BUS_DE_PIN              7       // PA07 -> DE and /RE of the transceiver
+#define BUS_CLOCK_HZ            48000000UL  // GCLK0 feeding the SERCOM core clock
+
+// Arithmetic baud generator: BAUD = 65536 * (1 - 16 * f_baud / f_ref)
+#define BUS_BAUD_REG(baud)      ((uint16_t)(65536ULL - (65536ULL * 16U * (baud)) / BUS_CLOCK_HZ))
+
+#define BUS_RX_ERRORS   (SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_BUFOVF | \
+                         SERCOM_USART_STATUS_PERR)
+
+extern volatile uint32_t systemTicks;
+
+// --- Driver state (shared with the SERCOM interrupt) ---
+static BusResponder responder;
+static uint8_t tx_frame[BUS_FRAME_MAX];
+static uint8_t tx_length;
+static uint8_t tx_index;
+static volatile bool transmitting = false;
+static BusNodeStats stats;
+
+static void bus_driver_enable(bool on) {
+    if (on) {
+        PORT->Group[0].OUTSET.reg = 1UL << BUS_DE_PIN;
+    } else {
+        PORT->Group[0].OUTCLR.reg = 1UL << BUS_DE_PIN;
+    }
+}
+
+// Answer a poll straight away; the DRE interrupt feeds the rest
+static void bus_node_receive(uint8_t byte) {
+    size_t length = bus_responder_receive(&responder, byte, systemTicks, tx_frame);
+    if (length == 0) {
+        return;
+    }
+    tx_length = (uint8_t)length;
+    tx_index = 0;
+    transmitting = true;
+    bus_driver_enable(true);
+    BUS_SERCOM->USART.INTENSET.reg = SERCOM_USART_INTENSET_DRE;
+}
+
+void SERCOM0_Handler(void) {
+    uint32_t start = cycle_counter_now();
+    SercomUsart *usart = &BUS_SERCOM->USART;
+    uint8_t flags = usart->INTFLAG.reg & usart->INTENSET.reg;
+
+    if (flags & SERCOM_USART_INTFLAG_RXC) {
+        uint16_t status = usart->STATUS.reg;
+        uint8_t byte = (uint8_t)usart->DATA.reg;  // Clears RXC
+        if (status & BUS_RX_ERRORS) {
+            usart->STATUS.reg = BUS_RX_ERRORS;
+            stats.errors++;
+            bus_decoder_reset(&responder.decoder);
+        } else if (!transmitting) {
+            bus_node_receive(byte);
+        }
+    }
+    if (flags & SERCOM_USART_INTFLAG_DRE) {
+        usart->DATA.reg = tx_frame[tx_index++];
+        if (tx_index == tx_length) {
+            usart->INTENCLR.reg = SERCOM_USART_INTENCLR_DRE;
+            usart->INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+            usart->INTENSET.reg = SERCOM_USART_INTENSET_TXC;
+        }
+    }
+    if (flags & SERCOM_USART_INTFLAG_TXC) {
+        usart->INTENCLR.reg = SERCOM_USART_INTENCLR_TXC;
+        usart->INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+        bus_driver_enable(false);
+        transmitting = false;
+    }
+    stats.isr_cycles += cycle_counter_elapsed(start);
+}
+
+// --- Public API ---
+
+void bus_node_init(uint8_t address) {
+    SercomUsart *usart = &BUS_SERCOM->USART;
+
+    bus_responder_init(&responder, address);
+
+    // Receive unless transmitting
+    PORT->Group[0].DIRSET.reg = 1UL << BUS_DE_PIN;
+    bus_driver_enable(false);
+
+    PM->APBCMASK.reg |= BUS_SERCOM_APB;
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(BUS_SERCOM_GCLK_ID) | GCLK_CLKCTRL_GEN_GCLK0 |
+                        GCLK_CLKCTRL_CLKEN;
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY);
+
+    PORT->Group[0].PINCFG[BUS_TX_PIN].reg = PORT_PINCFG_PMUXEN;
+    PORT->Group[0].PINCFG[BUS_RX_PIN].reg = PORT_PINCFG_PMUXEN | PORT_PINCFG_INEN;
+    PORT->Group[0].PMUX[BUS_TX_PIN >> 1].reg = PORT_PMUX_PMUXE(BUS_PIN_FUNCTION) |
+                                               PORT_PMUX_PMUXO(BUS_PIN_FUNCTION);
+
+    usart->CTRLA.reg = SERCOM_USART_CTRLA_SWRST;
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_SWRST);
+
+    // 8N1, LSB first, internal clock, TX on PAD2, RX on PAD3
+    usart->CTRLA.reg = SERCOM_USART_CTRLA_MODE_USART_INT_CLK | SERCOM_USART_CTRLA_DORD |
+                       SERCOM_USART_CTRLA_TXPO(1) | SERCOM_USART_CTRLA_RXPO(3);
+    usart->BAUD.reg = BUS_BAUD_REG(BUS_BAUD);
+    usart->CTRLB.reg = SERCOM_USART_CTRLB_TXEN | SERCOM_USART_CTRLB_RXEN |
+                       SERCOM_USART_CTRLB_CHSIZE(0);
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_CTRLB);
+    usart->INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+    NVIC_EnableIRQ(BUS_SERCOM_IRQn);
+
+    usart->CTRLA.reg |= SERCOM_USART_CTRLA_ENABLE;
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_ENABLE);
+}
+
+void bus_node_publish(const BusStatus *status) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bus_responder_publish(&responder, status, systemTicks);
+    __set_PRIMASK(primask);
+}
+
+void bus_node_on_message(const MsgbusMessage *message, const void *payload) {
+    (void)message;
+    (void)payload;
+    // A pump message also refreshes the report, from the latest reading
+    const MoistureMessage *reading = msgbus_latest(&app_msgbus, MSG_MOISTURE);
+    BusStatus status;
+
+    if (reading == NULL) {
+        return;
+    }
+    status.flags = 0;
+    if (reading->temperature_valid) {
+        status.flags |= BUS_STATUS_TEMPERATURE_VALID;
+    }
+    if (pump_get_status()) {
+        status.flags |= BUS_STATUS_PUMP_RUNNING;
+    }
+    if (get_calibration_status()) {
+        status.flags |= BUS_STATUS_CALIBRATED;
+    }
+    status.moisture_percent = reading->percent;
+    status.plant_index = reading->plant_index;
+    status.moisture_raw = reading->raw;
+    status.temperature_x16 = reading->temperature_x16;
+    status.pump_total_ml = (uint32_t)pump_get_total_volume_ml();
+    bus_node_publish(&status);
+}
+
+bool bus_node_take_command(uint8_t *command) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool ready = bus_responder_take_command(&responder, command);
+    __set_PRIMASK(primask);
+    return ready;
+}
+
+void bus_node_get_stats(BusNodeStats *result) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *result = stats;
+    result->polls = responder.polls;
+    result->status_replies = responder.status_replies;
+    result->foreign_frames = responder.decoder.skipped;
+    result->errors += responder.decoder.errors;
+    __set_PRIMASK(primask);
+}
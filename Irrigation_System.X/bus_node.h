@@ -0,0 +1,74 @@
+/**
+ * @file bus_node.h
+ * @brief Node side of the shared RS-485 bus (see bus_protocol.h).
+ *
+ * The bus runs on its own SERCOM through an RS-485 transceiver whose
+ * driver enable (DE, tied to /RE) is a GPIO. Everything happens in the
+ * SERCOM interrupt: received bytes go through the address-filtering
+ * decoder, and a POLL or COMMAND for this node is answered from the
+ * interrupt as soon as its last byte arrives, so the master sees a short,
+ * constant turnaround regardless of what the main loop is doing. The
+ * driver is released from the transmit-complete interrupt, after the last
+ * stop bit has left the shift register.
+ *
+ * The main loop only publishes a new status after every measurement or
+ * pump change (from its message bus subscription) and picks up commands
+ * received from the master. The console UART (SERCOM5)
+ * is unaffected and stays available for local debugging.
+ */
+
+#ifndef BUS_NODE_H
+#define BUS_NODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bus_protocol.h"
+#include "msgbus.h"
+
+// Node address on the bus, set per board (e.g. -DBUS_NODE_ADDRESS=12)
+#ifndef BUS_NODE_ADDRESS
+#define BUS_NODE_ADDRESS 1
+#endif
+
+#define BUS_BAUD 115200U
+
+typedef struct {
+    uint32_t polls;              // POLL and COMMAND frames addressed to this node
+    uint32_t status_replies;     // Replies carrying a STATUS
+    uint32_t foreign_frames;     // Frames skipped by the address filter
+    uint32_t errors;             // CRC, length and UART framing errors
+    uint32_t isr_cycles;         // CPU cycles spent in the bus interrupt
+} BusNodeStats;
+
+/**
+ * @brief Configures the SERCOM, its pins and the DE output; the node
+ * starts listening immediately.
+ */
+void bus_node_init(uint8_t address);
+
+/**
+ * @brief Makes @p status the report for the next poll.
+ *
+ * sequence and age_ms are filled in by the driver. The report is repeated
+ * on every poll until the master acknowledges it.
+ */
+void bus_node_publish(const BusStatus *status);
+
+/**
+ * @brief MSG_MOISTURE and MSG_PUMP subscriber (app_msg.h): publishes a new
+ * status from the latest reading and the pump state.
+ */
+void bus_node_on_message(const MsgbusMessage *message, const void *payload);
+
+/**
+ * @brief Takes the command byte last sent by the master, if any.
+ * @return true if @p command was written.
+ */
+bool bus_node_take_command(uint8_t *command);
+
+/**
+ * @brief Bus and CPU cost counters since startup.
+ */
+void bus_node_get_stats(BusNodeStats *stats);
+
+#endif // BUS_NODE_H
@@ -0,0 +1,199 @@
+/**
+ * @file bus_protocol.c
+ * @brief Frame codec, address-filtering decoder and node replies for the
+ * shared bus.
+ */
+
+#include "bus_protocol.h"
+#include <string.h>
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, MSB first), one nibble per lookup
+static const uint16_t crc16_nibble_table[16] = {
+    0x0000U, 0x1021U, 0x2042U, 0x3063U, 0x4084U, 0x50A5U, 0x60C6U, 0x70E7U,
+    0x8108U, 0x9129U, 0xA14AU, 0xB16BU, 0xC18CU, 0xD1ADU, 0xE1CEU, 0xF1EFU
+};
+
+static uint16_t crc16_byte(uint16_t crc, uint8_t byte) {
+    crc = (uint16_t)((crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (byte >> 4)]);
+    crc = (uint16_t)((crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (byte & 0x0F)]);
+    return crc;
+}
+
+uint16_t bus_crc16(uint16_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    while (length--) {
+        crc = crc16_byte(crc, *bytes++);
+    }
+    return crc;
+}
+
+size_t bus_frame_encode(uint8_t *out, uint8_t dst, uint8_t src, uint8_t type,
+                        const void *payload, uint8_t length) {
+    if (length > BUS_MAX_PAYLOAD) {
+        return 0;
+    }
+    out[0] = BUS_SOF;
+    out[1] = dst;
+    out[2] = src;
+    out[3] = type;
+    out[4] = length;
+    if (length > 0) {
+        memcpy(&out[5], payload, length);
+    }
+    uint16_t crc = bus_crc16(0xFFFF, &out[1], 4U + length);
+    out[5 + length] = (uint8_t)(crc >> 8);
+    out[6 + length] = (uint8_t)crc;
+    return BUS_FRAME_SIZE(length);
+}
+
+void bus_decoder_init(BusDecoder *decoder, uint8_t address) {
+    decoder->address = address;
+    decoder->frames = 0;
+    decoder->skipped = 0;
+    decoder->errors = 0;
+    bus_decoder_reset(decoder);
+}
+
+void bus_decoder_reset(BusDecoder *decoder) {
+    decoder->state = BUS_DECODER_SOF;
+    decoder->index = 0;
+}
+
+BusDecodeResult bus_decoder_push(BusDecoder *decoder, uint8_t byte) {
+    BusFrame *frame = &decoder->frame;
+
+    switch (decoder->state) {
+        case BUS_DECODER_SOF:
+            if (byte == BUS_SOF) {
+                decoder->crc = 0xFFFF;
+                decoder->state = BUS_DECODER_DST;
+            }
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_DST:
+            frame->dst = byte;
+            decoder->crc = crc16_byte(decoder->crc, byte);
+            decoder->state = BUS_DECODER_SRC;
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_SRC:
+            frame->src = byte;
+            decoder->crc = crc16_byte(decoder->crc, byte);
+            decoder->state = BUS_DECODER_TYPE;
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_TYPE:
+            frame->type = byte;
+            decoder->crc = crc16_byte(decoder->crc, byte);
+            decoder->state = BUS_DECODER_LENGTH;
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_LENGTH:
+            if (byte > BUS_MAX_PAYLOAD) {
+                decoder->errors++;
+                decoder->state = BUS_DECODER_SOF;
+                return BUS_DECODE_ERROR;
+            }
+            frame->length = byte;
+            if (frame->dst != decoder->address && frame->dst != BUS_ADDRESS_BROADCAST) {
+                // Not ours: count off payload and CRC without looking at them
+                decoder->skipped++;
+                decoder->index = (uint8_t)(byte + 2U);
+                decoder->state = BUS_DECODER_SKIP;
+                return BUS_DECODE_BUSY;
+            }
+            decoder->crc = crc16_byte(decoder->crc, byte);
+            decoder->index = 0;
+            decoder->state = (byte > 0) ? BUS_DECODER_PAYLOAD : BUS_DECODER_CRC_HIGH;
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_PAYLOAD:
+            frame->payload[decoder->index++] = byte;
+            decoder->crc = crc16_byte(decoder->crc, byte);
+            if (decoder->index == frame->length) {
+                decoder->state = BUS_DECODER_CRC_HIGH;
+            }
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_CRC_HIGH:
+            decoder->received_crc = (uint16_t)(byte << 8);
+            decoder->state = BUS_DECODER_CRC_LOW;
+            return BUS_DECODE_BUSY;
+
+        case BUS_DECODER_CRC_LOW:
+            decoder->state = BUS_DECODER_SOF;
+            if ((decoder->received_crc | byte) != decoder->crc) {
+                decoder->errors++;
+                return BUS_DECODE_ERROR;
+            }
+            decoder->frames++;
+            return BUS_DECODE_FRAME;
+
+        case BUS_DECODER_SKIP:
+        default:
+            if (--decoder->index == 0) {
+                decoder->state = BUS_DECODER_SOF;
+            }
+            return BUS_DECODE_BUSY;
+    }
+}
+
+void bus_responder_init(BusResponder *responder, uint8_t address) {
+    bus_decoder_init(&responder->decoder, address);
+    responder->status_pending = false;
+    responder->next_sequence = 1;
+    responder->command_ready = false;
+    responder->polls = 0;
+    responder->status_replies = 0;
+}
+
+void bus_responder_publish(BusResponder *responder, const BusStatus *status, uint32_t now_ms) {
+    responder->status = *status;
+    responder->status.sequence = responder->next_sequence++;
+    if (responder->next_sequence == 0) {
+        responder->next_sequence = 1;  // The master starts with ack 0
+    }
+    responder->status_ms = now_ms;
+    responder->status_pending = true;
+}
+
+size_t bus_responder_receive(BusResponder *responder, uint8_t byte, uint32_t now_ms,
+                             uint8_t *reply) {
+    if (bus_decoder_push(&responder->decoder, byte) != BUS_DECODE_FRAME) {
+        return 0;
+    }
+    const BusFrame *frame = &responder->decoder.frame;
+    uint8_t address = responder->decoder.address;
+
+    // Broadcasts are never answered
+    if (frame->dst != address ||
+        (frame->type != BUS_TYPE_POLL && frame->type != BUS_TYPE_COMMAND)) {
+        return 0;
+    }
+    responder->polls++;
+    if (frame->length >= sizeof(BusPoll) && responder->status_pending &&
+        frame->payload[0] == responder->status.sequence) {
+        responder->status_pending = false;
+    }
+    if (frame->type == BUS_TYPE_COMMAND && frame->length >= sizeof(BusPoll) + 1U) {
+        responder->command = frame->payload[sizeof(BusPoll)];
+        responder->command_ready = true;
+    }
+
+    if (!responder->status_pending) {
+        return bus_frame_encode(reply, BUS_ADDRESS_MASTER, address, BUS_TYPE_EMPTY, NULL, 0);
+    }
+    responder->status.age_ms = now_ms - responder->status_ms;
+    responder->status_replies++;
+    return bus_frame_encode(reply, BUS_ADDRESS_MASTER, address, BUS_TYPE_STATUS,
+                            &responder->status, sizeof(responder->status));
+}
+
+bool bus_responder_take_command(BusResponder *responder, uint8_t *command) {
+    if (!responder->command_ready) {
+        return false;
+    }
+    *command = responder->command;
+    responder->command_ready = false;
+    return true;
+}
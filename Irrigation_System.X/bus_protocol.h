@@ -0,0 +1,185 @@
+/**
+ * @file bus_protocol.h
+ * @brief Addressed frames for a shared half-duplex (RS-485) serial line.
+ *
+ * Many controllers share one twisted pair. A single master (the host)
+ * polls every node in turn; a node transmits only in answer to a frame
+ * addressed to it, so the line never has two drivers.
+ *
+ * Frame layout:
+ *
+ *     SOF | dst | src | type | length | payload[length] | CRC-16 (MSB first)
+ *
+ * The CRC is CRC-16/CCITT-FALSE over dst..payload. A frame with a payload
+ * of n bytes takes BUS_FRAME_SIZE(n) bytes on the wire.
+ *
+ * Address filtering happens in the decoder: once the dst byte shows that
+ * a frame is for another node, the rest of it is counted off using the
+ * length byte without buffering or CRC work, so a node on a busy bus
+ * spends a few cycles per foreign byte.
+ *
+ * Status reports are acknowledged: every POLL carries the sequence number
+ * of the last STATUS the master received from that node. A node answers a
+ * poll with STATUS while it has an unacknowledged report and with the
+ * short EMPTY frame otherwise, so an idle bus cycle is two short frames.
+ *
+ * The codec and the node's reply logic (BusResponder) have no hardware
+ * dependencies; bus_node.c binds them to a SERCOM on the target, and
+ * tools/bus_master.c and tools/bus_sim.c use them on the host.
+ */
+
+#ifndef BUS_PROTOCOL_H
+#define BUS_PROTOCOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BUS_SOF                 0xA5
+#define BUS_MAX_PAYLOAD         16
+#define BUS_FRAME_OVERHEAD      7       // SOF, dst, src, type, length, CRC
+#define BUS_FRAME_SIZE(length)  (BUS_FRAME_OVERHEAD + (length))
+#define BUS_FRAME_MAX           BUS_FRAME_SIZE(BUS_MAX_PAYLOAD)
+
+// Addresses
+#define BUS_ADDRESS_MIN         0x01    // Node addresses are 1..BUS_ADDRESS_MAX
+#define BUS_ADDRESS_MAX         0xEF
+#define BUS_ADDRESS_MASTER      0xFE
+#define BUS_ADDRESS_BROADCAST   0xFF    // Accepted by every node, never answered
+
+typedef enum {
+    BUS_TYPE_POLL = 0x01,       // master -> node, payload: BusPoll
+    BUS_TYPE_STATUS = 0x02,     // node -> master, payload: BusStatus
+    BUS_TYPE_EMPTY = 0x03,      // node -> master, nothing new since the last ack
+    BUS_TYPE_COMMAND = 0x04     // master -> node, payload: BusPoll + command byte
+} BusFrameType;
+
+// POLL payload
+typedef struct {
+    uint8_t ack_sequence;       // Sequence of the last STATUS received from this node
+} BusPoll;
+
+#define BUS_STATUS_TEMPERATURE_VALID  0x01
+#define BUS_STATUS_PUMP_RUNNING       0x02
+#define BUS_STATUS_CALIBRATED         0x04
+
+// STATUS payload, little-endian on the wire (both ends are little-endian)
+typedef struct __attribute__((packed)) {
+    uint8_t sequence;           // Incremented for every new report
+    uint8_t flags;              // BUS_STATUS_*
+    uint8_t moisture_percent;
+    uint8_t plant_index;
+    uint16_t moisture_raw;
+    int16_t temperature_x16;    // 1/16 degC, valid with BUS_STATUS_TEMPERATURE_VALID
+    uint32_t pump_total_ml;
+    uint32_t age_ms;            // Time from the measurement to this transmission
+} BusStatus;
+
+typedef struct {
+    uint8_t dst;
+    uint8_t src;
+    uint8_t type;
+    uint8_t length;
+    uint8_t payload[BUS_MAX_PAYLOAD];
+} BusFrame;
+
+typedef enum {
+    BUS_DECODE_BUSY,            // Need more bytes
+    BUS_DECODE_FRAME,           // A frame for this address is in decoder->frame
+    BUS_DECODE_ERROR            // CRC or length error; hunting for the next SOF
+} BusDecodeResult;
+
+typedef enum {
+    BUS_DECODER_SOF,
+    BUS_DECODER_DST,
+    BUS_DECODER_SRC,
+    BUS_DECODER_TYPE,
+    BUS_DECODER_LENGTH,
+    BUS_DECODER_PAYLOAD,
+    BUS_DECODER_CRC_HIGH,
+    BUS_DECODER_CRC_LOW,
+    BUS_DECODER_SKIP            // Counting off a frame for another node
+} BusDecoderState;
+
+typedef struct {
+    uint8_t address;            // Own address; frames to others are skipped
+    uint8_t state;              // BusDecoderState
+    uint8_t index;              // Payload bytes received / bytes left to skip
+    uint16_t crc;
+    uint16_t received_crc;
+    BusFrame frame;
+    // Statistics
+    uint32_t frames;            // Frames accepted for this address
+    uint32_t skipped;           // Frames for other addresses
+    uint32_t errors;            // CRC and length errors
+} BusDecoder;
+
+// Node state: decoder plus the report waiting for acknowledgement
+typedef struct {
+    BusDecoder decoder;
+    BusStatus status;
+    uint32_t status_ms;         // When status was published
+    bool status_pending;        // status not yet acknowledged
+    uint8_t next_sequence;
+    bool command_ready;
+    uint8_t command;
+    // Statistics
+    uint32_t polls;             // POLL and COMMAND frames for this node
+    uint32_t status_replies;    // Replies carrying a STATUS
+} BusResponder;
+
+/**
+ * @brief Continues a CRC-16/CCITT-FALSE; start with 0xFFFF.
+ */
+uint16_t bus_crc16(uint16_t crc, const void *data, size_t length);
+
+/**
+ * @brief Writes a complete frame to @p out (at least BUS_FRAME_MAX bytes).
+ * @return Number of bytes to transmit, or 0 if @p length is too long.
+ */
+size_t bus_frame_encode(uint8_t *out, uint8_t dst, uint8_t src, uint8_t type,
+                        const void *payload, uint8_t length);
+
+/**
+ * @brief Prepares a decoder that accepts frames to @p address and broadcasts.
+ */
+void bus_decoder_init(BusDecoder *decoder, uint8_t address);
+
+/**
+ * @brief Drops any partial frame; call after a framing error or line break.
+ */
+void bus_decoder_reset(BusDecoder *decoder);
+
+/**
+ * @brief Feeds one received byte.
+ *
+ * On BUS_DECODE_FRAME the frame stays valid in decoder->frame until the
+ * next call.
+ */
+BusDecodeResult bus_decoder_push(BusDecoder *decoder, uint8_t byte);
+
+/**
+ * @brief Prepares a node with bus address @p address and no report.
+ */
+void bus_responder_init(BusResponder *responder, uint8_t address);
+
+/**
+ * @brief Replaces the report; it is sent on every poll until acknowledged.
+ * Sets the sequence number; age_ms is filled in when the reply is built.
+ */
+void bus_responder_publish(BusResponder *responder, const BusStatus *status, uint32_t now_ms);
+
+/**
+ * @brief Feeds one received byte.
+ * @param reply Receives the answer (at least BUS_FRAME_MAX bytes).
+ * @return Number of reply bytes to transmit now, 0 to stay silent.
+ */
+size_t bus_responder_receive(BusResponder *responder, uint8_t byte, uint32_t now_ms,
+                             uint8_t *reply);
+
+/**
+ * @brief Takes the command byte last sent by the master, if any.
+ */
+bool bus_responder_take_command(BusResponder *responder, uint8_t *command);
+
+#endif // BUS_PROTOCOL_H
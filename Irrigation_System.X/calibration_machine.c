@@ -0,0 +1,157 @@
+/**
+ * @file calibration_machine.c
+ * @brief Dry/wet calibration states, polled from the main loop.
+ */
+
+#include "calibration_machine.h"
+#include "trace.h"
+#include <stddef.h>
+
+// Parent of DRY_WAIT to WET_RECORD: the sensor is held powered and read
+#define CALIBRATION_ACTIVE            (CALIBRATION_COMPLETE + 1)
+#define CALIBRATION_STATE_COUNT       (CALIBRATION_ACTIVE + 1)
+
+typedef enum {
+    CALIBRATION_EVT_START,
+    CALIBRATION_EVT_PRESS,            // Debounced button edges
+    CALIBRATION_EVT_RELEASE,
+    CALIBRATION_EVT_RETRY,            // Dry and wet readings were identical
+    CALIBRATION_EVT_COUNT
+} CalibrationEvent;
+
+static HsmEventId idle_poll(Hsm *fsm) {
+    (void)fsm;
+    return CALIBRATION_EVT_START;
+}
+
+static void active_entry(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    // The sensor is normally powered only during scans
+    machine->hardware->hold_power(true);
+    // A button already held down must be released first
+    machine->button_level = machine->hardware->button_pressed();
+    machine->button_edge_ms = machine->now_ms;
+}
+
+static void active_exit(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    // Release the ADC; the conversion ends within microseconds
+    uint16_t raw;
+    while (machine->adc_converting && !machine->hardware->convert_done(&raw));
+    machine->adc_converting = false;
+    machine->hardware->hold_power(false);
+}
+
+static HsmEventId active_poll(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    // Zone 0 is converted through the sensor code, which shares the ADC
+    // with the scan and the pump interlock; a conversion is started once
+    // the ADC is free and collected on a later poll
+    uint16_t raw;
+    if (!machine->adc_converting) {
+        machine->adc_converting = machine->hardware->convert_start();
+    } else if (machine->hardware->convert_done(&raw)) {
+        machine->adc_converting = false;
+        machine->current_adc_value = raw;
+    }
+
+    bool pressed = machine->hardware->button_pressed();
+    if (pressed == machine->button_level ||
+        machine->now_ms - machine->button_edge_ms < CALIBRATION_DEBOUNCE_MS) {
+        return HSM_NONE;
+    }
+    machine->button_level = pressed;
+    machine->button_edge_ms = machine->now_ms;
+    return pressed ? CALIBRATION_EVT_PRESS : CALIBRATION_EVT_RELEASE;
+}
+
+static void dry_wait_entry(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    machine->hardware->report(CALIBRATION_DRY_WAIT, 0);
+}
+
+// The reading is taken as the button is released
+static void dry_record_exit(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    machine->context->dry_calibration_value = machine->current_adc_value;
+    TRACE(TRACE_EVT_CALIBRATION, CALIBRATION_DRY_RECORD, machine->current_adc_value);
+    machine->hardware->report(CALIBRATION_DRY_RECORD, machine->current_adc_value);
+}
+
+static void wet_wait_entry(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    machine->hardware->report(CALIBRATION_WET_WAIT, 0);
+}
+
+static void wet_record_exit(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    machine->context->wet_calibration_value = machine->current_adc_value;
+    TRACE(TRACE_EVT_CALIBRATION, CALIBRATION_WET_RECORD, machine->current_adc_value);
+    machine->hardware->report(CALIBRATION_WET_RECORD, machine->current_adc_value);
+}
+
+static void complete_entry(Hsm *fsm) {
+    CalibrationMachine *machine = fsm->context;
+    // Values loaded from retained RAM or flash are already in use
+    if (machine->complete) {
+        return;
+    }
+    // Either sensor polarity works; only identical readings are unusable
+    if (machine->context->wet_calibration_value == machine->context->dry_calibration_value) {
+        machine->hardware->report(CALIBRATION_COMPLETE, 0);
+        hsm_post(fsm, CALIBRATION_EVT_RETRY);
+        return;
+    }
+    machine->complete = true;
+    TRACE(TRACE_EVT_CALIBRATION, CALIBRATION_COMPLETE, 0);
+    machine->hardware->report(CALIBRATION_COMPLETE, 1);
+}
+
+static const HsmState calibration_states[CALIBRATION_STATE_COUNT] = {
+    //                           parent              initial               entry           exit             poll
+    [CALIBRATION_IDLE]       = { HSM_NONE,           HSM_NONE,             NULL,           NULL,            idle_poll },
+    [CALIBRATION_DRY_WAIT]   = { CALIBRATION_ACTIVE, HSM_NONE,             dry_wait_entry, NULL,            NULL },
+    [CALIBRATION_DRY_RECORD] = { CALIBRATION_ACTIVE, HSM_NONE,             NULL,           dry_record_exit, NULL },
+    [CALIBRATION_WET_WAIT]   = { CALIBRATION_ACTIVE, HSM_NONE,             wet_wait_entry, NULL,            NULL },
+    [CALIBRATION_WET_RECORD] = { CALIBRATION_ACTIVE, HSM_NONE,             NULL,           wet_record_exit, NULL },
+    [CALIBRATION_COMPLETE]   = { HSM_NONE,           HSM_NONE,             complete_entry, NULL,            NULL },
+    [CALIBRATION_ACTIVE]     = { HSM_NONE,           CALIBRATION_DRY_WAIT, active_entry,   active_exit,     active_poll },
+};
+
+static const HsmStateId calibration_transitions[CALIBRATION_STATE_COUNT][CALIBRATION_EVT_COUNT] = {
+    [CALIBRATION_IDLE]       = { [CALIBRATION_EVT_START] = HSM_TO(CALIBRATION_DRY_WAIT) },
+    [CALIBRATION_DRY_WAIT]   = { [CALIBRATION_EVT_PRESS] = HSM_TO(CALIBRATION_DRY_RECORD) },
+    [CALIBRATION_DRY_RECORD] = { [CALIBRATION_EVT_RELEASE] = HSM_TO(CALIBRATION_WET_WAIT) },
+    [CALIBRATION_WET_WAIT]   = { [CALIBRATION_EVT_PRESS] = HSM_TO(CALIBRATION_WET_RECORD) },
+    [CALIBRATION_WET_RECORD] = { [CALIBRATION_EVT_RELEASE] = HSM_TO(CALIBRATION_COMPLETE) },
+    [CALIBRATION_COMPLETE]   = { [CALIBRATION_EVT_RETRY] = HSM_TO(CALIBRATION_DRY_WAIT) },
+};
+
+static const HsmDefinition calibration_machine = {
+    calibration_states,
+    &calibration_transitions[0][0],
+    CALIBRATION_STATE_COUNT,
+    CALIBRATION_EVT_COUNT,
+    TRACE_FSM_CALIBRATION,
+    TRACE_FSM_HOOK,
+};
+
+void calibration_machine_init(CalibrationMachine *machine, const CalibrationHardware *hardware,
+                              CalibrationContext *context, bool complete, uint32_t now_ms) {
+    machine->hardware = hardware;
+    machine->context = context;
+    machine->complete = complete;
+    machine->now_ms = now_ms;
+    machine->current_adc_value = 0;
+    machine->adc_converting = false;
+    machine->button_level = false;
+    machine->button_edge_ms = now_ms;
+    hsm_init(&machine->fsm, &calibration_machine, machine);
+    hsm_transition(&machine->fsm, complete ? CALIBRATION_COMPLETE : CALIBRATION_IDLE);
+}
+
+bool calibration_machine_run(CalibrationMachine *machine, uint32_t now_ms) {
+    machine->now_ms = now_ms;
+    hsm_run(&machine->fsm);
+    return machine->complete;
+}
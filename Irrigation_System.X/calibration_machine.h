@@ -0,0 +1,68 @@
+/**
+ * @file calibration_machine.h
+ * @brief Dry/wet calibration state machine (hsm.h).
+ *
+ * The user places the sensor in dry soil and presses SW0, then in wet
+ * soil and presses again. Zone 0 is read on every poll while the machine
+ * is active; each reading is taken as the button is released. Button
+ * edges closer together than CALIBRATION_DEBOUNCE_MS are bounce.
+ *
+ * The machine has no hardware dependencies; the ADC, SW0, the sensor
+ * supply and the user messages are reached through a CalibrationHardware
+ * table (moisture_calibration.c on the target, tools/input_replay.c on
+ * the host, which feeds it recorded SW0 and ADC events). Host builds set
+ * TRACE_ENABLED to 0.
+ */
+
+#ifndef CALIBRATION_MACHINE_H
+#define CALIBRATION_MACHINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hsm.h"
+#include "moisture_calibration.h"
+
+#define CALIBRATION_DEBOUNCE_MS       50U
+
+typedef struct {
+    bool (*convert_start)(void);            // Zone 0; false while the ADC is busy
+    bool (*convert_done)(uint16_t *raw);
+    bool (*button_pressed)(void);           // SW0 level
+    void (*hold_power)(bool on);            // Keep the zone 0 sensor powered
+    // Called on entering CALIBRATION_DRY_WAIT and CALIBRATION_WET_WAIT
+    // (value 0), with each recorded reading from the *_RECORD states, and
+    // from CALIBRATION_COMPLETE with value 1 if the readings were accepted
+    // and 0 if they were identical and the calibration starts again
+    void (*report)(CalibrationState state, uint16_t value);
+} CalibrationHardware;
+
+typedef struct {
+    Hsm fsm;
+    const CalibrationHardware *hardware;
+    CalibrationContext *context;            // Receives the dry and wet readings
+    bool complete;                          // Readings accepted or loaded
+    uint32_t now_ms;
+    uint16_t current_adc_value;
+    bool adc_converting;                    // Zone 0 conversion started, not yet read
+    bool button_level;
+    uint32_t button_edge_ms;
+} CalibrationMachine;
+
+/**
+ * @brief Starts the machine in CALIBRATION_COMPLETE if @p complete (values
+ * loaded from retained RAM or flash), otherwise in CALIBRATION_IDLE.
+ */
+void calibration_machine_init(CalibrationMachine *machine, const CalibrationHardware *hardware,
+                              CalibrationContext *context, bool complete, uint32_t now_ms);
+
+/**
+ * @brief One state step. Call from the main loop.
+ * @return true once the calibration is complete.
+ */
+bool calibration_machine_run(CalibrationMachine *machine, uint32_t now_ms);
+
+static inline CalibrationState calibration_machine_state(const CalibrationMachine *machine) {
+    return (CalibrationState)hsm_state(&machine->fsm);
+}
+
+#endif // CALIBRATION_MACHINE_H
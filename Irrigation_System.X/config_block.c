@@ -0,0 +1,126 @@
+/**
+ * @file config_block.c
+ * @brief Validation and double-buffered publishing of the runtime configuration.
+ */
+
+#include "config_block.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert(sizeof(ConfigBlock) == 224, "ConfigBlock is the upload and flash format");
+
+static bool plants_are_valid(const ConfigBlock *block) {
+    if (block->plant_count == 0 || block->plant_count > CONFIG_MAX_PLANTS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < block->plant_count; i++) {
+        const ConfigPlant *plant = &block->plants[i];
+        if (plant->name[0] == '\0' ||
+            memchr(plant->name, '\0', CONFIG_PLANT_NAME_LENGTH) == NULL) {
+            return false;
+        }
+        if (plant->moisture_low > plant->moisture_ideal_low ||
+            plant->moisture_ideal_low > plant->moisture_ideal_high ||
+            plant->moisture_ideal_high > plant->moisture_high ||
+            plant->moisture_high > 100U) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool pump_is_valid(const ConfigBlock *block) {
+    if (block->pump_pwm_period < CONFIG_MIN_PWM_PERIOD ||
+        block->pump_point_count < 2 || block->pump_point_count > CONFIG_MAX_PUMP_POINTS) {
+        return false;
+    }
+    float last_duty = 0.0f;
+    float last_flow = 0.0f;
+    for (uint8_t i = 0; i < block->pump_point_count; i++) {
+        const ConfigPumpPoint *point = &block->pump_points[i];
+        // The negated comparisons also reject NaN
+        if (!(point->duty_cycle_percent > last_duty) || !(point->duty_cycle_percent <= 100.0f) ||
+            !(point->flow_rate_ml_per_sec >= last_flow) || !(point->flow_rate_ml_per_sec < 1000.0f)) {
+            return false;
+        }
+        last_duty = point->duty_cycle_percent;
+        last_flow = point->flow_rate_ml_per_sec;
+    }
+    return true;
+}
+
+uint32_t config_block_crc(const ConfigBlock *block) {
+    return crc32_update(CRC32_INITIAL, block, offsetof(ConfigBlock, crc));
+}
+
+void config_block_seal(ConfigBlock *block) {
+    block->crc = config_block_crc(block);
+}
+
+ConfigResult config_block_validate(const ConfigBlock *block) {
+    if (block->magic != CONFIG_BLOCK_MAGIC) {
+        return CONFIG_ERROR_MAGIC;
+    }
+    if (block->format != CONFIG_BLOCK_FORMAT || block->size != sizeof(ConfigBlock)) {
+        return CONFIG_ERROR_FORMAT;
+    }
+    if (block->crc != config_block_crc(block)) {
+        return CONFIG_ERROR_CRC;
+    }
+    if (!plants_are_valid(block)) {
+        return CONFIG_ERROR_PLANTS;
+    }
+    if (!pump_is_valid(block)) {
+        return CONFIG_ERROR_PUMP;
+    }
+    if (block->sample_min_ms < CONFIG_MIN_SAMPLE_MS || block->sample_max_ms < block->sample_min_ms ||
+        block->moisture_level_threshold > 4095U) {
+        return CONFIG_ERROR_SAMPLING;
+    }
+    return CONFIG_OK;
+}
+
+void config_store_init(ConfigStore *store) {
+    memset(store, 0, sizeof(*store));
+    store->active = NULL;
+    store->last_result = CONFIG_OK;
+}
+
+ConfigResult config_store_publish(ConfigStore *store, const void *data, uint16_t length,
+                                  bool require_newer) {
+    ConfigBlock *active = store->active;
+    ConfigBlock *spare = (active == &store->buffers[0]) ? &store->buffers[1] : &store->buffers[0];
+    ConfigResult result;
+
+    if (length != sizeof(ConfigBlock)) {
+        result = CONFIG_ERROR_LENGTH;
+    } else {
+        // Readers only ever hold the active buffer, so the spare is free
+        memcpy(spare, data, sizeof(ConfigBlock));
+        result = config_block_validate(spare);
+        if (result == CONFIG_OK && require_newer && active != NULL &&
+            spare->version <= active->version) {
+            result = CONFIG_ERROR_VERSION;
+        }
+    }
+
+    store->last_result = result;
+    if (result != CONFIG_OK) {
+        store->rejects++;
+        return result;
+    }
+    // The copy is complete before the pointer changes
+    __atomic_store_n(&store->active, spare, __ATOMIC_RELEASE);
+    store->publishes++;
+    return CONFIG_OK;
+}
+
+const char *config_result_name(ConfigResult result) {
+    static const char *const NAMES[CONFIG_ERROR_COUNT] = {
+        "ok", "bad length", "bad magic", "unknown format", "CRC mismatch",
+        "version not newer", "invalid plant table", "invalid pump calibration",
+        "invalid sampling limits"
+    };
+    return (result < CONFIG_ERROR_COUNT) ? NAMES[result] : "?";
+}
@@ -0,0 +1,138 @@
+/**
+ * @file config_block.h
+ * @brief Versioned runtime configuration block and its double-buffered store.
+ *
+ * The block holds the tuning values that used to be compile-time
+ * constants:
+ *  - the plant thresholds (PLANT_THRESHOLDS);
+ *  - the pump's duty/flow calibration table and PWM period;
+ *  - the raw moisture threshold (MOISTURELEVELTHRESHOLD);
+ *  - the bounds of the adaptive sampling interval.
+ * The block is sent over the UART, stored in flash and applied at run
+ * time. It has a fixed little-endian layout with a trailing CRC-32, so
+ * the same bytes serve as the upload frame, the flash record and the RAM
+ * copy. tools/config_pack.py builds it.
+ *
+ * ConfigStore has two buffers. A new block is written into the one not in
+ * use and checked there. It goes live with a single pointer store, so
+ * readers see either the old block or the new one and never a mix. No
+ * reader is stopped and no interrupt is masked. The single-core rule for
+ * readers: take the pointer with config_store_active() and use it within
+ * the current interrupt or main-loop pass. The old buffer is overwritten
+ * by the next upload.
+ *
+ * The module has no hardware dependencies; runtime_config.c adds the
+ * defaults, the flash copy and the upload command.
+ */
+
+#ifndef CONFIG_BLOCK_H
+#define CONFIG_BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONFIG_BLOCK_MAGIC          0x47464352U // "RCFG" in memory order
+#define CONFIG_BLOCK_FORMAT         1
+#define CONFIG_MAX_PLANTS           8
+#define CONFIG_PLANT_NAME_LENGTH    12          // Including the terminating NUL
+#define CONFIG_MAX_PUMP_POINTS      8
+#define CONFIG_MIN_SAMPLE_MS        1000U
+#define CONFIG_MIN_PWM_PERIOD       99U         // 1 % duty resolution
+
+// Plant thresholds in percent, low <= ideal_low <= ideal_high <= high <= 100
+typedef struct {
+    char name[CONFIG_PLANT_NAME_LENGTH];
+    uint8_t moisture_low;
+    uint8_t moisture_ideal_low;
+    uint8_t moisture_ideal_high;
+    uint8_t moisture_high;
+} ConfigPlant;
+
+// One measured point of the pump; duty strictly rising, flow not falling
+typedef struct {
+    float duty_cycle_percent;
+    float flow_rate_ml_per_sec;
+} ConfigPumpPoint;
+
+// Layout is the upload and flash format; keep it fixed (224 bytes)
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t size;                         // sizeof(ConfigBlock)
+    uint32_t version;                      // Chosen by the uploader, must increase
+    uint16_t pump_pwm_period;              // TCC PER value
+    uint8_t plant_count;
+    uint8_t pump_point_count;
+    uint16_t moisture_level_threshold;     // Raw ADC counts
+    uint16_t reserved;
+    uint32_t sample_min_ms;                // Adaptive sampling interval bounds
+    uint32_t sample_max_ms;
+    ConfigPlant plants[CONFIG_MAX_PLANTS];
+    ConfigPumpPoint pump_points[CONFIG_MAX_PUMP_POINTS];
+    uint32_t crc;                          // CRC-32 of all bytes before it
+} ConfigBlock;
+
+typedef enum {
+    CONFIG_OK = 0,
+    CONFIG_ERROR_LENGTH,
+    CONFIG_ERROR_MAGIC,
+    CONFIG_ERROR_FORMAT,
+    CONFIG_ERROR_CRC,
+    CONFIG_ERROR_VERSION,                  // Not newer than the active block
+    CONFIG_ERROR_PLANTS,
+    CONFIG_ERROR_PUMP,
+    CONFIG_ERROR_SAMPLING,
+    CONFIG_ERROR_COUNT
+} ConfigResult;
+
+typedef struct {
+    ConfigBlock buffers[2];
+    ConfigBlock *volatile active;          // NULL until the first publish
+    uint32_t publishes;
+    uint32_t rejects;
+    ConfigResult last_result;
+} ConfigStore;
+
+/**
+ * @brief CRC-32 over the block as it would be stored.
+ */
+uint32_t config_block_crc(const ConfigBlock *block);
+
+/**
+ * @brief Sets the CRC so the block validates.
+ */
+void config_block_seal(ConfigBlock *block);
+
+/**
+ * @brief Checks the CRC, the layout and every value.
+ */
+ConfigResult config_block_validate(const ConfigBlock *block);
+
+/**
+ * @brief Empty store; config_store_active() returns NULL until a publish.
+ */
+void config_store_init(ConfigStore *store);
+
+/**
+ * @brief Copies @p length bytes into the spare buffer, checks them and
+ * makes them the active block. Main loop only. On failure the active
+ * block stays as it was.
+ * @param require_newer Reject blocks whose version is not above the
+ * active one (uploads); false for the defaults and the flash copy.
+ */
+ConfigResult config_store_publish(ConfigStore *store, const void *data, uint16_t length,
+                                  bool require_newer);
+
+/**
+ * @brief The active block. Safe from interrupts.
+ */
+static inline const ConfigBlock *config_store_active(const ConfigStore *store) {
+    return __atomic_load_n(&store->active, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Short description of a result for console messages.
+ */
+const char *config_result_name(ConfigResult result);
+
+#endif // CONFIG_BLOCK_H
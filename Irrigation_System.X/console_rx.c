@@ -0,0 +1,176 @@
+/**
+ * @file console_rx.c
+ * @brief Console UART receive through a DMAC ping-pong ring.
+ */
+
+#include "console_rx.h"
+#include "definitions.h"
+#include "sam.h"
+#include "cycle_counter.h"
+#include "input_record.h"
+
+// --- Configuration ---
+#define CONSOLE_SERCOM          SERCOM5
+#define CONSOLE_RX_DMA_CHANNEL  0
+#define CONSOLE_RX_DMA_TRIGGER  SERCOM5_DMAC_ID_RX
+#define CONSOLE_RX_HALF         (CONSOLE_RX_RING_SIZE / 2U)
+
+#define CONSOLE_RX_ERRORS       (SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_BUFOVF | \
+                                 SERCOM_USART_STATUS_PERR)
+
+#if (CONSOLE_RX_RING_SIZE & (CONSOLE_RX_RING_SIZE - 1U)) != 0
+#error "CONSOLE_RX_RING_SIZE must be a power of two"
+#endif
+
+extern volatile uint32_t systemTicks;
+
+// Descriptor and write-back sections, one entry per channel up to ours.
+// The second half's descriptor is linked from the first and back.
+static DmacDescriptor dma_descriptors[CONSOLE_RX_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static DmacDescriptor dma_writeback[CONSOLE_RX_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static DmacDescriptor second_half __attribute__((aligned(16)));
+
+static uint8_t rx_ring[CONSOLE_RX_RING_SIZE];
+static uint8_t rx_scratch[CONSOLE_RX_FRAME_MAX];
+static RxFramer framer;
+static uint32_t recorded;        // Running count of bytes passed to the input recorder
+
+// --- Shared with the DMAC interrupt ---
+static volatile uint32_t halves_done;
+static uint32_t dma_errors;
+static uint32_t isr_cycles;
+static uint32_t uart_errors;
+
+void DMAC_Handler(void) {
+    uint32_t start = cycle_counter_now();
+
+    DMAC->CHID.reg = DMAC_CHID_ID(CONSOLE_RX_DMA_CHANNEL);
+    uint8_t flags = DMAC->CHINTFLAG.reg;
+    DMAC->CHINTFLAG.reg = flags;
+    if (flags & DMAC_CHINTFLAG_TCMPL) {
+        halves_done++;
+    }
+    if (flags & DMAC_CHINTFLAG_TERR) {
+        // The channel stops on a bus error; pick up where it left off
+        dma_errors++;
+        DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    }
+    isr_cycles += cycle_counter_elapsed(start);
+}
+
+static void descriptor_init(DmacDescriptor *descriptor, uint8_t *destination,
+                            DmacDescriptor *next) {
+    descriptor->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE |
+                             DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_INT;
+    descriptor->BTCNT.reg = CONSOLE_RX_HALF;
+    descriptor->SRCADDR.reg = (uint32_t)&CONSOLE_SERCOM->USART.DATA.reg;
+    // With address increment, DSTADDR is the end of the block
+    descriptor->DSTADDR.reg = (uint32_t)(destination + CONSOLE_RX_HALF);
+    descriptor->DESCADDR.reg = (uint32_t)next;
+}
+
+// Offset in the ring the DMA writes next. With beat triggers the channel
+// is written back after every byte: BTCNT is what is left of the active
+// half and DESCADDR already points at the other half's descriptor.
+static uint16_t dma_position(void) {
+    DmacDescriptor *writeback = &dma_writeback[CONSOLE_RX_DMA_CHANNEL];
+    uint32_t next;
+    uint16_t remaining;
+
+    do {
+        next = writeback->DESCADDR.reg;
+        remaining = writeback->BTCNT.reg;
+    } while (next != writeback->DESCADDR.reg);
+
+    uint16_t base = (next == (uint32_t)&second_half) ? 0U : CONSOLE_RX_HALF;
+    return (uint16_t)(base + CONSOLE_RX_HALF - remaining);
+}
+
+// Hands the bytes received since the last poll to the input recorder, in
+// at most two pieces where they wrap round the ring
+static void record_input(uint32_t written) {
+#if INPUT_RECORD_ENABLED
+    if (written - recorded > CONSOLE_RX_RING_SIZE) {
+        recorded = written - CONSOLE_RX_RING_SIZE;
+    }
+    while (recorded != written) {
+        uint16_t offset = (uint16_t)(recorded & (CONSOLE_RX_RING_SIZE - 1U));
+        uint32_t length = written - recorded;
+        if (length > CONSOLE_RX_RING_SIZE - offset) {
+            length = CONSOLE_RX_RING_SIZE - offset;
+        }
+        input_record_uart(&rx_ring[offset], (uint16_t)length);
+        recorded += length;
+    }
+#else
+    (void)written;
+#endif
+}
+
+// --- Public API ---
+
+void console_rx_init(void) {
+    SercomUsart *usart = &CONSOLE_SERCOM->USART;
+
+    rx_framer_init(&framer, rx_ring, CONSOLE_RX_RING_SIZE, rx_scratch, CONSOLE_RX_FRAME_MAX,
+                   CONSOLE_RX_DELIMITER, CONSOLE_RX_IDLE_MS, systemTicks);
+    recorded = 0;
+
+    descriptor_init(&dma_descriptors[CONSOLE_RX_DMA_CHANNEL], rx_ring, &second_half);
+    descriptor_init(&second_half, rx_ring + CONSOLE_RX_HALF,
+                    &dma_descriptors[CONSOLE_RX_DMA_CHANNEL]);
+    // Reads before the first write-back see the start of the first half
+    dma_writeback[CONSOLE_RX_DMA_CHANNEL] = dma_descriptors[CONSOLE_RX_DMA_CHANNEL];
+
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+    DMAC->CTRL.reg = 0;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+    DMAC->BASEADDR.reg = (uint32_t)dma_descriptors;
+    DMAC->WRBADDR.reg = (uint32_t)dma_writeback;
+
+    DMAC->CHID.reg = DMAC_CHID_ID(CONSOLE_RX_DMA_CHANNEL);
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(CONSOLE_RX_DMA_TRIGGER) |
+                        DMAC_CHCTRLB_TRIGACT_BEAT;
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+    NVIC_EnableIRQ(DMAC_IRQn);
+
+    // The plib's receive interrupt would take the bytes before the DMA does
+    usart->INTENCLR.reg = SERCOM_USART_INTENCLR_RXC | SERCOM_USART_INTENCLR_ERROR;
+    while (usart->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC) {
+        (void)usart->DATA.reg;
+    }
+    usart->STATUS.reg = CONSOLE_RX_ERRORS;
+
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+}
+
+void console_rx_poll(RxFrameHandler handler, void *context) {
+    SercomUsart *usart = &CONSOLE_SERCOM->USART;
+
+    // Count first: the position may run ahead of it, never behind
+    uint32_t halves = halves_done;
+    uint32_t written = rx_framer_written(&framer, halves, dma_position());
+
+    if (usart->STATUS.reg & CONSOLE_RX_ERRORS) {
+        usart->STATUS.reg = CONSOLE_RX_ERRORS;
+        uart_errors++;
+    }
+    record_input(written);
+    rx_framer_poll(&framer, written, systemTicks, handler, context);
+}
+
+void console_rx_get_stats(ConsoleRxStats *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->halves = halves_done;
+    stats->dma_errors = dma_errors;
+    stats->isr_cycles = isr_cycles;
+    __set_PRIMASK(primask);
+    stats->framer = framer.stats;
+    stats->uart_errors = uart_errors;
+}
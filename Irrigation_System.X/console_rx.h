@@ -0,0 +1,72 @@
+/**
+ * @file console_rx.h
+ * @brief DMA receive on the console UART (SERCOM5), framed by rx_framer.
+ *
+ * Before, Check_Commands() took one byte per call with SERCOM5_USART_Read,
+ * and only when the main loop got round to it. The SERCOM holds two
+ * received bytes, so any burst longer than that overran whenever the loop
+ * was busy (LCD writes, 1-Wire, flash). Host tools could not send a
+ * config block or a firmware chunk at full baud.
+ *
+ * Here a DMAC channel moves every received byte into a ping-pong ring of
+ * CONSOLE_RX_RING_SIZE bytes, triggered by the SERCOM's receive-complete.
+ * The loop only has to come round once per half ring: about 44 ms at
+ * 115200 baud and 5 ms at 1 Mbaud for the default 1 KB ring.
+ * console_rx_poll() passes every complete frame to the handler. A frame
+ * ends when the line has been idle for CONSOLE_RX_IDLE_MS, or at
+ * CONSOLE_RX_DELIMITER if one is configured. Host tools should leave at
+ * least twice the idle time between frames when no delimiter is used.
+ *
+ * Single-character commands still work: a key press is a one-byte frame,
+ * and Check_Commands() becomes the frame handler, looping over the bytes.
+ *
+ * The driver owns the DMAC: it sets the descriptor base address and uses
+ * channel CONSOLE_RX_DMA_CHANNEL. Transmission is unchanged and stays
+ * with the Harmony SERCOM5 plib.
+ */
+
+#ifndef CONSOLE_RX_H
+#define CONSOLE_RX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rx_framer.h"
+
+#ifndef CONSOLE_RX_RING_SIZE
+#define CONSOLE_RX_RING_SIZE  1024U  // Power of two; two halves of 512
+#endif
+#ifndef CONSOLE_RX_FRAME_MAX
+#define CONSOLE_RX_FRAME_MAX  288U   // Firmware record: a row of literals plus header and CRC
+#endif
+#ifndef CONSOLE_RX_IDLE_MS
+#define CONSOLE_RX_IDLE_MS    5U     // Above USB-serial adapter packet gaps
+#endif
+#ifndef CONSOLE_RX_DELIMITER
+#define CONSOLE_RX_DELIMITER  RX_FRAMER_NO_DELIMITER
+#endif
+
+typedef struct {
+    RxFramerStats framer;
+    uint32_t halves;             // DMA block-complete interrupts
+    uint32_t uart_errors;        // Framing errors and hardware buffer overflows
+    uint32_t dma_errors;         // DMAC transfer errors
+    uint32_t isr_cycles;         // CPU cycles spent in the DMAC interrupt
+} ConsoleRxStats;
+
+/**
+ * @brief Takes the console receiver from the SERCOM5 plib and starts the
+ * DMA. Call after SYS_Initialize().
+ */
+void console_rx_init(void);
+
+/**
+ * @brief Delivers every frame completed since the last call. Main loop only.
+ */
+void console_rx_poll(RxFrameHandler handler, void *context);
+
+/**
+ * @brief Receive counters since console_rx_init().
+ */
+void console_rx_get_stats(ConsoleRxStats *stats);
+
+#endif // CONSOLE_RX_H
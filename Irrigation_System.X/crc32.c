@@ -0,0 +1,25 @@
+/**
+ * @file crc32.c
+ * @brief Nibble-table CRC-32 implementation.
+ */
+
+#include "crc32.h"
+
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU,
+    0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU,
+    0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+};
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (length--) {
+        crc ^= *bytes++;
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    }
+    return ~crc;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320).
+ *
+ * Uses a 16-entry nibble table: 64 bytes of flash and roughly two table
+ * lookups per byte, a good fit for the Cortex-M0+ which has no CRC unit
+ * usable on RAM data. The result matches zlib's crc32(), so host tools can
+ * compute the same value with binascii.crc32().
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC32_INITIAL 0x00000000U // Seed for the first call of a running CRC
+
+/**
+ * @brief Computes or continues a CRC-32 over a block of memory.
+ * @param crc Value returned by the previous call, or CRC32_INITIAL.
+ * @param data Bytes to process.
+ * @param length Number of bytes.
+ * @return Updated CRC-32.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length);
+
+#endif // CRC32_H
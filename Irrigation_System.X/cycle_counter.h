@@ -0,0 +1,41 @@
+/**
+ * @file cycle_counter.h
+ * @brief CPU cycle measurement helpers built on the SysTick down-counter.
+ *
+ * The Cortex-M0+ has no DWT cycle counter, so short code sections are timed
+ * by sampling SysTick->VAL before and after. SysTick is started by
+ * SYSTICK_TimerInitialize() from the processor clock (48 MHz), so one count
+ * is one CPU cycle. Measured sections must be shorter than one SysTick
+ * period (SysTick->LOAD + 1 cycles); longer work should be timed in a loop
+ * of shorter slices.
+ */
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <stdint.h>
+#include "definitions.h" // SysTick (CMSIS core_cm0plus.h)
+
+/**
+ * @brief Samples the current SysTick count.
+ * @return Opaque start value to hand to cycle_counter_elapsed().
+ */
+static inline uint32_t cycle_counter_now(void) {
+    return SysTick->VAL;
+}
+
+/**
+ * @brief Cycles elapsed since @p start, handling one SysTick reload.
+ * @param start Value returned by cycle_counter_now().
+ * @return Number of CPU cycles between the two samples.
+ */
+static inline uint32_t cycle_counter_elapsed(uint32_t start) {
+    uint32_t end = SysTick->VAL;
+    // SysTick counts down from LOAD to 0, then reloads
+    if (start >= end) {
+        return start - end;
+    }
+    return start + (SysTick->LOAD + 1U) - end;
+}
+
+#endif // CYCLE_COUNTER_H
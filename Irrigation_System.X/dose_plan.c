@@ -0,0 +1,36 @@
+/**
+ * @file dose_plan.c
+ * @brief Splits a dose's run time into one-shot timer segments.
+ */
+
+#include "dose_plan.h"
+
+bool dose_plan_make(DosePlan *plan, float volume_ml, float flow_ml_per_s,
+                    uint32_t timer_hz, uint32_t max_ms) {
+    if (!(volume_ml > 0.0f) || !(flow_ml_per_s > 0.0f) || timer_hz == 0) {
+        return false;
+    }
+    // Seconds to counts in float, compared before the conversion so a huge
+    // volume cannot overflow it
+    float counts = volume_ml / flow_ml_per_s * (float)timer_hz + 0.5f;
+    float limit = (float)max_ms * ((float)timer_hz / 1000.0f);
+    if (counts < 1.0f || counts > limit) {
+        return false;
+    }
+
+    plan->counts = (uint32_t)counts;
+    plan->segments = (uint16_t)((plan->counts + DOSE_PLAN_PERIOD_MAX - 1U) / DOSE_PLAN_PERIOD_MAX);
+    // Later segments round up, so the first is the shortest; with two or
+    // more segments each is above half a period
+    plan->rest = (plan->counts + plan->segments - 1U) / plan->segments;
+    plan->first = plan->counts - plan->rest * (plan->segments - 1U);
+    return true;
+}
+
+uint32_t dose_plan_ms(const DosePlan *plan, uint32_t timer_hz) {
+    return (uint32_t)(((uint64_t)plan->counts * 1000U + timer_hz / 2U) / timer_hz);
+}
+
+float dose_plan_volume_ml(const DosePlan *plan, float flow_ml_per_s, uint32_t timer_hz) {
+    return flow_ml_per_s * ((float)plan->counts / (float)timer_hz);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file dose_plan.h
+ * @brief Run time of a volume dose, cut into periods of a 16-bit timer.
+ *
+ * A dose of V mL at a calibrated flow of F mL/s runs V / F seconds. At
+ * the one-shot timer's rate that is a number of counts. Counts beyond one
+ * 16-bit period are split into nearly equal segments. Every segment
+ * after the first has the same length, so the timer's top value is
+ * written once, after the first overflow. The first segment is the
+ * shortest. Each segment of a multi-segment dose is at least half a
+ * period, so there is always time to reprogram between overflows.
+ *
+ * The module has no hardware dependencies; Pump_control.c runs the plan
+ * on TC5 and tools/dispense_sim.c measures the dose error.
+ */
+
+#ifndef DOSE_PLAN_H
+#define DOSE_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DOSE_PLAN_PERIOD_MAX   65536U  // Counts in one 16-bit timer period
+
+typedef struct {
+    uint32_t counts;             // Whole run
+    uint32_t first;              // Counts of the first segment
+    uint32_t rest;               // Counts of every later segment
+    uint16_t segments;
+} DosePlan;
+
+/**
+ * @brief Plans a dose of @p volume_ml at @p flow_ml_per_s on a timer
+ * counting at @p timer_hz.
+ * @return false if the dose rounds to no count or runs longer than
+ * @p max_ms.
+ */
+bool dose_plan_make(DosePlan *plan, float volume_ml, float flow_ml_per_s,
+                    uint32_t timer_hz, uint32_t max_ms);
+
+/**
+ * @brief Run time of @p plan in whole milliseconds, rounded.
+ */
+uint32_t dose_plan_ms(const DosePlan *plan, uint32_t timer_hz);
+
+/**
+ * @brief Volume the planned run gives at @p flow_ml_per_s; differs from
+ * the request only by the count rounding.
+ */
+float dose_plan_volume_ml(const DosePlan *plan, float flow_ml_per_s, uint32_t timer_hz);
+
+#endif // DOSE_PLAN_H
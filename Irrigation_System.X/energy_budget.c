@@ -0,0 +1,126 @@
+/**
+ * @file energy_budget.c
+ * @brief Active-time counters and the charge estimate per subsystem.
+ */
+
+#include "energy_budget.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert(sizeof(EnergyModel) == 44, "EnergyModel is the upload format");
+
+#define UA_MS_PER_NAH   3600U        // 1 nAh = 3600 uA*ms
+
+// Counts the open interval of one counter up to now_us
+static void fold(EnergyCounter *counter, uint32_t now_us) {
+    if (counter->level != 0) {
+        counter->level_us += (uint64_t)(uint32_t)(now_us - counter->since_us) * counter->level;
+    }
+    counter->since_us = now_us;
+}
+
+void energy_counters_init(EnergyCounters *counters, uint32_t now_us, uint32_t counts_per_ms) {
+    memset(counters, 0, sizeof(*counters));
+    counters->last_us = now_us;
+    counters->counts_per_ms = (counts_per_ms != 0) ? counts_per_ms : 1000U;
+}
+
+void energy_set_level(EnergyCounters *counters, EnergySubsystem subsystem, uint32_t now_us,
+                      uint16_t level) {
+    EnergyCounter *counter = &counters->counters[subsystem];
+    if (level > ENERGY_LEVEL_FULL) {
+        level = ENERGY_LEVEL_FULL;
+    }
+    fold(counter, now_us);
+    if (counter->level == 0 && level != 0) {
+        counter->events++;
+    }
+    counter->level = level;
+}
+
+void energy_advance(EnergyCounters *counters, uint32_t now_us) {
+    counters->uptime_us += (uint32_t)(now_us - counters->last_us);
+    counters->last_us = now_us;
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        fold(&counters->counters[i], now_us);
+    }
+}
+
+void energy_estimate(const EnergyCounters *counters, const EnergyModel *model,
+                     EnergyBudget *budget) {
+    memset(budget, 0, sizeof(*budget));
+    budget->uptime_us = counters->uptime_us;
+
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        const EnergyCounter *counter = &counters->counters[i];
+        budget->events[i] = counter->events;
+        budget->active_us[i] = counter->level_us >> ENERGY_LEVEL_SHIFT;
+    }
+    // Wakeups are counted as they happen, so the sleep time can run a
+    // little ahead of the uptime between two advances
+    uint64_t sleep_us = counters->sleep_counts * 1000U / counters->counts_per_ms;
+    budget->active_us[ENERGY_CPU] = (counters->uptime_us > sleep_us) ? counters->uptime_us - sleep_us : 0;
+
+    // In milliseconds, so a year at the highest current stays far from
+    // overflowing
+    budget->base_nah = (uint64_t)model->base_ua * (counters->uptime_us / 1000U) / UA_MS_PER_NAH;
+    budget->total_nah = budget->base_nah;
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        budget->charge_nah[i] =
+            (uint64_t)model->active_ua[i] * (budget->active_us[i] / 1000U) / UA_MS_PER_NAH;
+        budget->total_nah += budget->charge_nah[i];
+    }
+
+    if (counters->uptime_us >= 1000U) {
+        budget->average_ua = (uint32_t)(budget->total_nah * UA_MS_PER_NAH / (counters->uptime_us / 1000U));
+    }
+    if (model->battery_mah != 0 && budget->average_ua != 0) {
+        budget->battery_hours = (uint32_t)((uint64_t)model->battery_mah * 1000U / budget->average_ua);
+    }
+}
+
+void energy_model_seal(EnergyModel *model) {
+    model->crc = crc32_update(CRC32_INITIAL, model, offsetof(EnergyModel, crc));
+}
+
+EnergyModelResult energy_model_validate(const void *data, uint16_t length) {
+    EnergyModel model;
+
+    if (length != sizeof(EnergyModel)) {
+        return ENERGY_MODEL_ERROR_LENGTH;
+    }
+    memcpy(&model, data, sizeof(model));
+    if (model.magic != ENERGY_MODEL_MAGIC) {
+        return ENERGY_MODEL_ERROR_MAGIC;
+    }
+    if (model.format != ENERGY_MODEL_FORMAT || model.size != sizeof(EnergyModel)) {
+        return ENERGY_MODEL_ERROR_FORMAT;
+    }
+    if (model.crc != crc32_update(CRC32_INITIAL, &model, offsetof(EnergyModel, crc))) {
+        return ENERGY_MODEL_ERROR_CRC;
+    }
+    if (model.base_ua > ENERGY_MODEL_MAX_UA) {
+        return ENERGY_MODEL_ERROR_CURRENT;
+    }
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        if (model.active_ua[i] > ENERGY_MODEL_MAX_UA) {
+            return ENERGY_MODEL_ERROR_CURRENT;
+        }
+    }
+    return ENERGY_MODEL_OK;
+}
+
+const char *energy_subsystem_name(EnergySubsystem subsystem) {
+    static const char *const NAMES[ENERGY_SUBSYSTEM_COUNT] = {
+        "CPU", "ADC", "LCD", "UART", "Pump"
+    };
+    return (subsystem < ENERGY_SUBSYSTEM_COUNT) ? NAMES[subsystem] : "?";
+}
+
+const char *energy_model_result_name(EnergyModelResult result) {
+    static const char *const NAMES[ENERGY_MODEL_ERROR_COUNT] = {
+        "ok", "bad length", "bad magic", "unknown format", "CRC mismatch", "current out of range"
+    };
+    return (result < ENERGY_MODEL_ERROR_COUNT) ? NAMES[result] : "?";
+}
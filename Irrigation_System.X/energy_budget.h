@@ -0,0 +1,172 @@
+/**
+ * @file energy_budget.h
+ * @brief Per-subsystem active-time counters and the current model that
+ * turns them into a charge budget.
+ *
+ * Every subsystem that draws noticeably more than the sleeping board has
+ * an EnergyCounter. It holds the number of events (conversions, writes,
+ * runs) and the time the subsystem was active. Two kinds of update keep
+ * it current:
+ *  - energy_count() for work of a known length, such as one ADC
+ *    conversion, one LCD command or the bytes of one UART write. The
+ *    driver passes the length, so the counter costs an increment and an
+ *    add;
+ *  - energy_set_level() for states that last, such as the pump or the
+ *    free-running ADC window. The time is taken at each change of level.
+ *    The level scales the time, so a pump at 40 % PWM duty accrues 40 %
+ *    of its run time, which is the time the output is actually on.
+ * CPU time is the exception. The time spent asleep is counted
+ * (energy_sleep()), and the awake time is the uptime minus that. A wakeup
+ * happens every millisecond or more often, so the sleep is counted in
+ * ticks of the hardware timer, which are finer than microseconds and need
+ * no division, and converted only for the estimate.
+ *
+ * Times come from a free-running 32-bit microsecond clock, which wraps
+ * after 71 minutes. energy_advance() moves the uptime on and folds the
+ * open intervals into their counters. It must run at least once per wrap;
+ * the periodic report does.
+ *
+ * EnergyModel gives the board's current with everything asleep and the
+ * extra current of each subsystem while it is active.
+ * energy_estimate() multiplies the two into a charge per subsystem. The
+ * model has a fixed little-endian layout with a trailing CRC-32, so it can
+ * be uploaded as one console frame (tools/energy_model.py).
+ *
+ * The module has no hardware dependencies and does no locking;
+ * energy_monitor.c binds it to the drivers and the clock.
+ */
+
+#ifndef ENERGY_BUDGET_H
+#define ENERGY_BUDGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENERGY_LEVEL_SHIFT      10
+#define ENERGY_LEVEL_FULL       (1U << ENERGY_LEVEL_SHIFT)  // Active all the time
+
+#define ENERGY_MODEL_MAGIC      0x4C444D45U // "EMDL" in memory order
+#define ENERGY_MODEL_FORMAT     1
+#define ENERGY_MODEL_MAX_UA     5000000U    // 5 A, far above anything on the board
+
+typedef enum {
+    ENERGY_CPU,          // Awake, not in WFI; events are wakeups
+    ENERGY_ADC,          // Converting: sensor scans, pump current, window monitor
+    ENERGY_LCD,          // Commands and characters, including the controller's busy time
+    ENERGY_UART,         // Console bytes on the wire; events are writes
+    ENERGY_PUMP,         // PWM output on; events are runs
+    ENERGY_SUBSYSTEM_COUNT
+} EnergySubsystem;
+
+typedef struct {
+    uint32_t events;
+    uint64_t level_us;           // Active microseconds times the level
+    uint32_t since_us;           // Start of the open interval
+    uint16_t level;              // Of the open interval, 0 if none
+} EnergyCounter;
+
+typedef struct {
+    EnergyCounter counters[ENERGY_SUBSYSTEM_COUNT];
+    uint64_t uptime_us;
+    uint64_t sleep_counts;       // Timer counts asleep
+    uint32_t counts_per_ms;      // Of the timer energy_sleep() counts in
+    uint32_t last_us;            // Clock at the last energy_advance()
+} EnergyCounters;
+
+// Layout is the upload format; keep it fixed (44 bytes)
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t size;                                // sizeof(EnergyModel)
+    uint32_t version;
+    uint32_t base_ua;                             // Whole board, CPU asleep
+    uint32_t active_ua[ENERGY_SUBSYSTEM_COUNT];   // Added while active
+    uint32_t battery_mah;                         // 0 if unknown
+    uint32_t crc;                                 // CRC-32 of all bytes before it
+} EnergyModel;
+
+typedef enum {
+    ENERGY_MODEL_OK = 0,
+    ENERGY_MODEL_ERROR_LENGTH,
+    ENERGY_MODEL_ERROR_MAGIC,
+    ENERGY_MODEL_ERROR_FORMAT,
+    ENERGY_MODEL_ERROR_CRC,
+    ENERGY_MODEL_ERROR_CURRENT,
+    ENERGY_MODEL_ERROR_COUNT
+} EnergyModelResult;
+
+// Result of energy_estimate()
+typedef struct {
+    uint64_t uptime_us;
+    uint32_t events[ENERGY_SUBSYSTEM_COUNT];
+    uint64_t active_us[ENERGY_SUBSYSTEM_COUNT];
+    uint64_t charge_nah[ENERGY_SUBSYSTEM_COUNT];
+    uint64_t base_nah;
+    uint64_t total_nah;
+    uint32_t average_ua;
+    uint32_t battery_hours;      // Full battery at the average current, 0 if unknown
+} EnergyBudget;
+
+/**
+ * @brief Zero counters, the clock starting at @p now_us.
+ * @param counts_per_ms Rate of the timer for energy_sleep().
+ */
+void energy_counters_init(EnergyCounters *counters, uint32_t now_us, uint32_t counts_per_ms);
+
+/**
+ * @brief One event of @p subsystem that kept it active for @p active_us.
+ * Short enough to call from an interrupt.
+ */
+static inline void energy_count(EnergyCounters *counters, EnergySubsystem subsystem,
+                                uint32_t active_us) {
+    EnergyCounter *counter = &counters->counters[subsystem];
+    counter->events++;
+    counter->level_us += (uint64_t)active_us << ENERGY_LEVEL_SHIFT;
+}
+
+/**
+ * @brief Changes the level of a lasting state; 0 ends it,
+ * ENERGY_LEVEL_FULL is fully on. The time at the old level is counted
+ * first. Going from 0 to a level counts an event.
+ */
+void energy_set_level(EnergyCounters *counters, EnergySubsystem subsystem, uint32_t now_us,
+                      uint16_t level);
+
+/**
+ * @brief Adds @p slept timer counts to the sleep time and counts a wakeup.
+ */
+static inline void energy_sleep(EnergyCounters *counters, uint32_t slept) {
+    counters->sleep_counts += slept;
+    counters->counters[ENERGY_CPU].events++;
+}
+
+/**
+ * @brief Moves the uptime to @p now_us and folds the open intervals in.
+ */
+void energy_advance(EnergyCounters *counters, uint32_t now_us);
+
+/**
+ * @brief Charge per subsystem under @p model, as of the last
+ * energy_advance().
+ */
+void energy_estimate(const EnergyCounters *counters, const EnergyModel *model,
+                     EnergyBudget *budget);
+
+/**
+ * @brief Sets the CRC so the model validates.
+ */
+void energy_model_seal(EnergyModel *model);
+
+/**
+ * @brief Checks @p length bytes as an uploaded model.
+ */
+EnergyModelResult energy_model_validate(const void *data, uint16_t length);
+
+const char *energy_subsystem_name(EnergySubsystem subsystem);
+
+/**
+ * @brief Short description of a result for console messages.
+ */
+const char *energy_model_result_name(EnergyModelResult result);
+
+#endif // ENERGY_BUDGET_H
@@ -0,0 +1,285 @@
+/**
+ * @file energy_monitor.c
+ * @brief Energy counters on the target: clock, idle sleep, current model,
+ * telemetry line and report.
+ */
+
+#include "energy_monitor.h"
+#include "boot_monitor.h"
+#include "systime.h"
+#include "cycle_counter.h"
+#include "fmt.h"
+#include "definitions.h"
+#include "sam.h"          // TC4, PM and SCB registers
+#include <string.h>
+
+extern volatile uint32_t systemTicks;
+
+// Board estimate until a measured model is uploaded: SAMD21 at 48 MHz
+// with the CPU clock stopped in IDLE0, the LCD controller without
+// backlight, the sensor oscillator off between scans
+static const EnergyModel default_model = {
+    ENERGY_MODEL_MAGIC, ENERGY_MODEL_FORMAT, sizeof(EnergyModel), 0,
+    2100U,                        // base_ua
+    {
+        2400U,                    // CPU running from flash
+        400U,                     // ADC and reference
+        300U,                     // LCD controller busy
+        600U,                     // SERCOM and the USB-serial bridge input
+        250000U,                  // Pump at 100 % duty
+    },
+    0U,                           // battery_mah
+    0U
+};
+
+// Not static: energy_monitor_count() is inline
+EnergyCounters energy_counters;
+
+static EnergyModel model;
+static EnergyMonitorStats stats;
+static EnergyBudget last_line;           // Budget at the previous telemetry line
+static Timer report_timer;
+static uint32_t tick_counts;             // TC4 counts per 1 ms tick
+static uint32_t sample_counts;           // Cost of one masked_now_counts()
+
+// Tick count and TC4 position with interrupts masked: the tick may already
+// have wrapped TC4 without systemTicks having counted it yet
+static void masked_sample(uint32_t *ticks, uint32_t *counter) {
+    bool wrapped = (TC4->COUNT16.INTFLAG.reg & TC_INTFLAG_OVF) != 0;
+    *ticks = systemTicks;
+    *counter = TC4_Timer16bitCounterGet();
+    if (!wrapped && (TC4->COUNT16.INTFLAG.reg & TC_INTFLAG_OVF) != 0) {
+        // Wrapped between the two reads; the counter may be from either side
+        wrapped = true;
+        *counter = TC4_Timer16bitCounterGet();
+    }
+    if (wrapped) {
+        (*ticks)++;
+    }
+}
+
+// boot_monitor_now_us(), interrupts masked
+static uint32_t masked_now_us(void) {
+    uint32_t ticks, counter;
+    masked_sample(&ticks, &counter);
+    return ticks * 1000U + (counter * 1000U) / tick_counts;
+}
+
+// TC4 counts since reset, wrapping; only differences count
+static uint32_t masked_now_counts(void) {
+    uint32_t ticks, counter;
+    masked_sample(&ticks, &counter);
+    return ticks * tick_counts + counter;
+}
+
+static void advance(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    energy_advance(&energy_counters, masked_now_us());
+    __set_PRIMASK(primask);
+}
+
+static void fmt_charge(FmtBuffer *out, uint64_t nah) {
+    // mAh with three decimals
+    fmt_fixed(out, (int32_t)(nah / 1000U), 3, 0);
+    fmt_str(out, " mAh");
+}
+
+static void fmt_active(FmtBuffer *out, uint64_t us) {
+    uint64_t ms = us / 1000U;
+    if (ms <= INT32_MAX) {
+        fmt_fixed(out, (int32_t)ms, 3, 0);
+    } else {
+        fmt_u32(out, (uint32_t)(ms / 1000U), 0);
+    }
+    fmt_str(out, " s");
+}
+
+// Telemetry line: the activity since the previous line
+static void send_line(Timer *timer, void *context) {
+    (void)timer;
+    (void)context;
+    EnergyBudget now;
+    char storage[128];
+    FmtBuffer line;
+
+    energy_monitor_estimate(&now);
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "Energy: ");
+    fmt_u32(&line, (uint32_t)((now.uptime_us - last_line.uptime_us) / 1000U), 0);
+    fmt_str(&line, " ms");
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        fmt_str(&line, ", ");
+        fmt_str(&line, energy_subsystem_name((EnergySubsystem)i));
+        fmt_char(&line, ' ');
+        fmt_u32(&line, (uint32_t)((now.active_us[i] - last_line.active_us[i]) / 1000U), 0);
+        fmt_str(&line, " ms");
+    }
+    fmt_str(&line, ", ");
+    // uAh with three decimals
+    fmt_fixed(&line, (int32_t)(now.total_nah - last_line.total_nah), 3, 0);
+    fmt_str(&line, " uAh\r\n");
+    fmt_uart_write(&line);
+
+    last_line = now;
+    stats.reports++;
+}
+
+// --- Public API ---
+
+void energy_monitor_init(void) {
+    model = default_model;
+    energy_model_seal(&model);
+    memset(&stats, 0, sizeof(stats));
+    tick_counts = (uint32_t)TC4_Timer16bitPeriodGet() + 1U;
+    energy_counters_init(&energy_counters, boot_monitor_now_us(), tick_counts);
+    memset(&last_line, 0, sizeof(last_line));
+
+    // The time from the first timestamp to WFI and from the wake to the
+    // second is awake time; it is about one timestamp long
+    sample_counts = UINT32_MAX;
+    for (int i = 0; i < 8; i++) {
+        __disable_irq();
+        uint32_t first = masked_now_counts();
+        uint32_t elapsed = masked_now_counts() - first;
+        __enable_irq();
+        if (elapsed < sample_counts) {
+            sample_counts = elapsed;
+        }
+    }
+
+    // IDLE0: only the CPU clock stops, so the tick, the ADC and the
+    // SERCOMs run on
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+
+    timer_init(&report_timer, send_line, NULL);
+    systime_arm(&report_timer, ENERGY_MONITOR_REPORT_MS, ENERGY_MONITOR_REPORT_MS);
+}
+
+void energy_monitor_level(EnergySubsystem subsystem, uint16_t level) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    energy_set_level(&energy_counters, subsystem, masked_now_us(), level);
+    __set_PRIMASK(primask);
+}
+
+void energy_monitor_idle(void) {
+    // WFI wakes on a pending interrupt even while they are masked, so both
+    // timestamps are taken before the interrupt that woke the CPU runs
+    __disable_irq();
+    uint32_t start = masked_now_counts();
+    __DSB();
+    __WFI();
+    uint32_t slept = masked_now_counts() - start;
+    uint32_t bookkeeping = cycle_counter_now();
+    energy_sleep(&energy_counters, (slept > sample_counts) ? slept - sample_counts : 0U);
+    uint32_t cycles = cycle_counter_elapsed(bookkeeping);
+    __enable_irq();
+
+    if (cycles > stats.idle_cycles_max) {
+        stats.idle_cycles_max = cycles;
+    }
+}
+
+void energy_monitor_estimate(EnergyBudget *budget) {
+    advance();
+    energy_estimate(&energy_counters, &model, budget);
+}
+
+bool energy_monitor_handle_frame(const uint8_t *frame, uint16_t length) {
+    uint32_t magic;
+    EnergyModel uploaded;
+
+    if (length < sizeof(magic)) {
+        return false;
+    }
+    memcpy(&magic, frame, sizeof(magic));
+    if (magic != ENERGY_MODEL_MAGIC) {
+        return false;
+    }
+
+    EnergyModelResult result = energy_model_validate(frame, length);
+    stats.last_result = result;
+    char storage[80];
+    FmtBuffer message;
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, "Energy model");
+    if (result == ENERGY_MODEL_OK) {
+        // The counters hold time, not charge, so the new currents apply
+        // to everything counted since reset
+        memcpy(&uploaded, frame, sizeof(uploaded));
+        model = uploaded;
+        stats.model_version = model.version;
+        stats.model_applies++;
+        fmt_str(&message, " v");
+        fmt_u32(&message, model.version, 0);
+        fmt_str(&message, " applied.\r\n");
+    } else {
+        stats.model_rejects++;
+        fmt_str(&message, " rejected: ");
+        fmt_str(&message, energy_model_result_name(result));
+        fmt_str(&message, ".\r\n");
+    }
+    fmt_uart_write(&message);
+    return true;
+}
+
+void energy_monitor_report(void) {
+    EnergyBudget budget;
+    char storage[96];
+    FmtBuffer line;
+
+    energy_monitor_estimate(&budget);
+    uint64_t uptime_ms = budget.uptime_us / 1000U;
+
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "ENERGY BEGIN ");
+    fmt_active(&line, budget.uptime_us);
+    fmt_str(&line, " model v");
+    fmt_u32(&line, model.version, 0);
+    fmt_str(&line, "\r\n");
+    fmt_uart_write(&line);
+
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        fmt_init(&line, storage, sizeof(storage));
+        fmt_str(&line, energy_subsystem_name((EnergySubsystem)i));
+        fmt_char(&line, ' ');
+        fmt_u32(&line, budget.events[i], 0);
+        fmt_str(&line, " events ");
+        fmt_active(&line, budget.active_us[i]);
+        fmt_char(&line, ' ');
+        // Share of the uptime in percent with three decimals
+        fmt_fixed(&line, (uptime_ms != 0) ? (int32_t)(budget.active_us[i] * 100U / uptime_ms) : 0, 3, 0);
+        fmt_str(&line, "% ");
+        fmt_u32(&line, model.active_ua[i], 0);
+        fmt_str(&line, " uA ");
+        fmt_charge(&line, budget.charge_nah[i]);
+        fmt_str(&line, "\r\n");
+        fmt_uart_write(&line);
+    }
+
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "Base ");
+    fmt_u32(&line, model.base_ua, 0);
+    fmt_str(&line, " uA ");
+    fmt_charge(&line, budget.base_nah);
+    fmt_str(&line, "\r\nTotal ");
+    fmt_charge(&line, budget.total_nah);
+    fmt_str(&line, ", average ");
+    fmt_u32(&line, budget.average_ua, 0);
+    fmt_str(&line, " uA");
+    if (budget.battery_hours != 0) {
+        fmt_str(&line, ", ");
+        fmt_u32(&line, model.battery_mah, 0);
+        fmt_str(&line, " mAh battery lasts ");
+        fmt_u32(&line, budget.battery_hours, 0);
+        fmt_str(&line, " h");
+    }
+    fmt_str(&line, "\r\nENERGY END\r\n");
+    fmt_uart_write(&line);
+}
+
+void energy_monitor_get_stats(EnergyMonitorStats *result) {
+    *result = stats;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file energy_monitor.h
+ * @brief Binds the energy counters (energy_budget.h) to the drivers, the
+ * microsecond clock and the console.
+ *
+ * The drivers report their own activity:
+ *  - moisture_sensor.c: each sensor conversion, and the ADC window
+ *    monitor while it runs free;
+ *  - pump_interlock.c: each current-sense conversion, from the 1 ms
+ *    interrupt;
+ *  - LCD1602A.c: each command or character with its settle time, and the
+ *    long clear/home commands and power-up steps;
+ *  - fmt.c: the bytes of each console write;
+ *  - Pump_control.c: the PWM duty whenever it changes.
+ * Work of a fixed length is counted with the nominal lengths below, so a
+ * hook costs an increment and an add with interrupts masked. Lasting
+ * states are timed with the clock of boot_monitor_now_us().
+ *
+ * CPU time is measured around the idle sleep. The main loop calls
+ * energy_monitor_idle() when it has nothing to do. That sleeps in WFI until
+ * the next interrupt, at the latest the 1 ms tick, and counts the time
+ * asleep. Until the main loop does so, the CPU counts as awake all the
+ * time, which is then true.
+ *
+ * The current model starts from the defaults in energy_monitor.c. A
+ * console frame that starts with ENERGY_MODEL_MAGIC replaces it until the
+ * next reset (tools/energy_model.py builds one). The counters start at
+ * zero on every reset.
+ *
+ * Every ENERGY_MONITOR_REPORT_MS a telemetry line goes out on the console
+ * with the activity since the previous line:
+ * @code
+ *   Energy: 60000 ms, CPU 1210 ms, ADC 4 ms, LCD 41 ms, UART 152 ms, Pump 0 ms, 36.130 uAh
+ * @endcode
+ * That is the interval, the active milliseconds per subsystem and the
+ * charge including the sleeping board. tools/telemetry/ingestd.cpp stores
+ * it. Deltas keep the numbers small and sum over any time range.
+ * energy_monitor_report() (bound to ENERGY_MONITOR_REPORT_COMMAND in
+ * Check_Commands) prints the full budget: events, active time, share of
+ * the uptime and charge per subsystem, the average current and the
+ * battery life it gives.
+ *
+ * Main loop:
+ * @code
+ *   energy_monitor_init();              // Boot, after the tick timer runs
+ *   ...
+ *   if (!runtime_config_handle_frame(frame, length) &&
+ *       !energy_monitor_handle_frame(frame, length)) {
+ *       // Single-character commands
+ *   }
+ *   ...
+ *   if (systime_ms_until_next() > 0) {
+ *       energy_monitor_idle();
+ *   }
+ * @endcode
+ */
+
+#ifndef ENERGY_MONITOR_H
+#define ENERGY_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "energy_budget.h"
+#include "definitions.h" // __disable_irq / __get_PRIMASK
+
+#define ENERGY_MONITOR_REPORT_COMMAND  'E'     // UART command character for energy_monitor_report()
+#define ENERGY_MONITOR_REPORT_MS       60000U  // Telemetry line interval
+
+// Nominal length of fixed work, for the hooks; must match the drivers
+#define ENERGY_ADC_CONVERSION_US       12U     // One 12-bit conversion at the plib's prescaler
+#define ENERGY_LCD_SEND_US             202U    // Two nibbles, each 1 us strobe + 100 us settle
+#define ENERGY_CONSOLE_BAUD            115200U // SERCOM5
+#define ENERGY_UART_BYTE_US_X16        ((10U * 1000000U * 16U + ENERGY_CONSOLE_BAUD / 2U) / ENERGY_CONSOLE_BAUD)
+
+typedef struct {
+    uint32_t model_version;      // 0 for the defaults
+    uint32_t model_applies;
+    uint32_t model_rejects;
+    EnergyModelResult last_result;
+    uint32_t reports;            // Telemetry lines sent
+    uint32_t idle_cycles_max;    // Longest energy_monitor_idle() bookkeeping, sleep excluded
+} EnergyMonitorStats;
+
+extern EnergyCounters energy_counters;
+
+/**
+ * @brief Counts one event of @p subsystem that was active @p active_us.
+ * Safe from interrupt and main context.
+ */
+static inline void energy_monitor_count(EnergySubsystem subsystem, uint32_t active_us) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    energy_count(&energy_counters, subsystem, active_us);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Counts @p bytes sent on the console UART as one write.
+ */
+static inline void energy_monitor_uart(uint32_t bytes) {
+    energy_monitor_count(ENERGY_UART, (bytes * ENERGY_UART_BYTE_US_X16) >> 4);
+}
+
+/**
+ * @brief Starts the counters and the telemetry timer. Boot step.
+ */
+void energy_monitor_init(void);
+
+/**
+ * @brief Sets the level of a lasting state (energy_set_level()). Main
+ * loop only.
+ */
+void energy_monitor_level(EnergySubsystem subsystem, uint16_t level);
+
+/**
+ * @brief Sleeps until the next interrupt and counts the time asleep.
+ * Main loop only; the interrupt that woke the CPU runs before it returns.
+ */
+void energy_monitor_idle(void);
+
+/**
+ * @brief Budget under the active model, as of now.
+ */
+void energy_monitor_estimate(EnergyBudget *budget);
+
+/**
+ * @brief Console frame handler hook.
+ * @return true if the frame was a current model (applied or rejected),
+ * false if it is for another handler.
+ */
+bool energy_monitor_handle_frame(const uint8_t *frame, uint16_t length);
+
+/**
+ * @brief Prints the budget to the UART between "ENERGY BEGIN" and
+ * "ENERGY END".
+ */
+void energy_monitor_report(void);
+
+void energy_monitor_get_stats(EnergyMonitorStats *stats);
+
+#endif // ENERGY_MONITOR_H
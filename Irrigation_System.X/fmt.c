@@ -0,0 +1,163 @@
+/**
+ * @file fmt.c
+ * @brief Integer and fixed-point text formatting without printf.
+ */
+
+#include "fmt.h"
+#include <stdbool.h>
+#include "definitions.h" // SERCOM5_USART_Write
+#include "energy_monitor.h"
+#include "cycle_counter.h"
+
+#define FMT_MAX_DIGITS 10   // Digits in UINT32_MAX
+
+static const uint32_t powers_of_ten[FMT_MAX_DIGITS] = {
+    1000000000U, 100000000U, 10000000U, 1000000U, 100000U,
+    10000U, 1000U, 100U, 10U, 1U
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Writes the decimal digits of value into digits[] (no terminator) and
+// returns how many were written. Each digit is found by repeated
+// subtraction, at most nine per digit.
+static uint8_t to_decimal(uint32_t value, char digits[FMT_MAX_DIGITS]) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < FMT_MAX_DIGITS; i++) {
+        uint32_t power = powers_of_ten[i];
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        // Skip leading zeros but always keep the units digit
+        if (count > 0 || digit != '0' || i == FMT_MAX_DIGITS - 1) {
+            digits[count++] = digit;
+        }
+    }
+    return count;
+}
+
+static void fmt_repeat(FmtBuffer *out, char c, uint8_t count) {
+    while (count-- > 0) {
+        fmt_char(out, c);
+    }
+}
+
+void fmt_init(FmtBuffer *out, char *storage, uint16_t capacity) {
+    out->data = storage;
+    out->length = 0;
+    out->capacity = capacity;
+    storage[0] = '\0';
+}
+
+void fmt_char(FmtBuffer *out, char c) {
+    // Keep room for the terminator; extra characters are dropped
+    if (out->length + 1U < out->capacity) {
+        out->data[out->length++] = c;
+        out->data[out->length] = '\0';
+    }
+}
+
+void fmt_str(FmtBuffer *out, const char *text) {
+    while (*text) {
+        fmt_char(out, *text++);
+    }
+}
+
+// Emits [sign] digits with the decimal point placed decimals from the
+// right, right-aligned in width columns
+static void fmt_number(FmtBuffer *out, uint32_t magnitude, bool negative,
+                       uint8_t decimals, uint8_t width) {
+    char digits[FMT_MAX_DIGITS];
+    uint8_t count = to_decimal(magnitude, digits);
+
+    // A fraction always has at least one integer digit: 5 with 3 decimals is 0.005
+    uint8_t leading_zeros = (decimals >= count) ? (uint8_t)(decimals + 1U - count) : 0U;
+    uint8_t total = (uint8_t)(count + leading_zeros + (decimals ? 1U : 0U) + (negative ? 1U : 0U));
+
+    if (width > total) {
+        fmt_repeat(out, ' ', (uint8_t)(width - total));
+    }
+    if (negative) {
+        fmt_char(out, '-');
+    }
+
+    uint8_t integer_digits = (uint8_t)(count + leading_zeros - decimals);
+    for (uint8_t i = 0; i < count + leading_zeros; i++) {
+        if (decimals && i == integer_digits) {
+            fmt_char(out, '.');
+        }
+        fmt_char(out, (i < leading_zeros) ? '0' : digits[i - leading_zeros]);
+    }
+}
+
+void fmt_u32(FmtBuffer *out, uint32_t value, uint8_t width) {
+    fmt_number(out, value, false, 0, width);
+}
+
+void fmt_i32(FmtBuffer *out, int32_t value, uint8_t width) {
+    // Negate in unsigned arithmetic so INT32_MIN does not overflow
+    uint32_t magnitude = (value < 0) ? 0U - (uint32_t)value : (uint32_t)value;
+    fmt_number(out, magnitude, value < 0, 0, width);
+}
+
+void fmt_hex(FmtBuffer *out, uint32_t value, uint8_t digits) {
+    if (digits < 1) digits = 1;
+    if (digits > 8) digits = 8;
+    for (int8_t shift = (int8_t)((digits - 1) * 4); shift >= 0; shift -= 4) {
+        fmt_char(out, hex_digits[(value >> shift) & 0x0F]);
+    }
+}
+
+void fmt_fixed(FmtBuffer *out, int32_t scaled, uint8_t decimals, uint8_t width) {
+    if (decimals > FMT_MAX_DIGITS - 1) decimals = FMT_MAX_DIGITS - 1;
+    uint32_t magnitude = (scaled < 0) ? 0U - (uint32_t)scaled : (uint32_t)scaled;
+    fmt_number(out, magnitude, scaled < 0, decimals, width);
+}
+
+void fmt_pad(FmtBuffer *out, uint8_t column) {
+    while (out->length < column && out->length + 1U < out->capacity) {
+        fmt_char(out, ' ');
+    }
+}
+
+int32_t fmt_scale(float value, uint8_t decimals) {
+    if (decimals > FMT_MAX_DIGITS - 1) decimals = FMT_MAX_DIGITS - 1;
+    float scaled = value * (float)powers_of_ten[FMT_MAX_DIGITS - 1 - decimals];
+    return (int32_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+void fmt_uart_write(const FmtBuffer *out) {
+    if (out->length > 0) {
+        energy_monitor_uart(out->length);
+        SERCOM5_USART_Write(out->data, out->length);
+    }
+}
+
+void fmt_uart_str(const char *text) {
+    const char *end = text;
+    while (*end) {
+        end++;
+    }
+    if (end != text) {
+        energy_monitor_uart((uint32_t)(end - text));
+        SERCOM5_USART_Write((void *)text, (size_t)(end - text));
+    }
+}
+
+uint32_t fmt_measure_cost(void) {
+    char storage[32];
+    FmtBuffer line;
+
+    uint32_t start = cycle_counter_now();
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "Moisture: ");
+    fmt_u32(&line, 42, 0);
+    fmt_str(&line, "% (Raw: ");
+    fmt_u32(&line, 2048, 0);
+    fmt_str(&line, ")\r\n");
+    // Keep the compiler from discarding the unused result
+    __asm__ volatile ("" : : "r"(storage) : "memory");
+    return cycle_counter_elapsed(start);
+}
@@ -0,0 +1,95 @@
+/**
+ * @file fmt.h
+ * @brief Small integer and fixed-point text formatter for the UART and LCD.
+ *
+ * Replaces printf/snprintf/vsnprintf in the application modules. Text is
+ * appended piece by piece to a caller-owned FmtBuffer, one function per
+ * value type, so there is no format string to parse and no varargs to get
+ * wrong. Output is always NUL-terminated and silently truncated at the
+ * buffer capacity.
+ *
+ * Decimal conversion subtracts powers of ten instead of dividing: the
+ * Cortex-M0+ has no divide instruction, and a library division per digit
+ * costs far more than at most nine subtractions.
+ *
+ * Fractional values are passed as scaled integers, e.g. 1.234 mL is
+ * fmt_fixed(&out, 1234, 3, 0). Use fmt_scale() to convert a float once at
+ * the call site.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+#define FMT_LCD_COLUMNS 16   // Characters per LCD line
+#define FMT_LINE_SIZE   (FMT_LCD_COLUMNS + 1)
+
+typedef struct {
+    char *data;
+    uint16_t length;     // Characters written, excluding the terminator
+    uint16_t capacity;   // Size of data, including the terminator
+} FmtBuffer;
+
+/**
+ * @brief Attaches a buffer to @p storage and makes it empty.
+ * @param capacity Size of @p storage in bytes (at least 1).
+ */
+void fmt_init(FmtBuffer *out, char *storage, uint16_t capacity);
+
+void fmt_char(FmtBuffer *out, char c);
+void fmt_str(FmtBuffer *out, const char *text);
+
+/**
+ * @brief Appends an unsigned decimal, right-aligned in @p width columns.
+ * A width of 0 uses as many columns as needed.
+ */
+void fmt_u32(FmtBuffer *out, uint32_t value, uint8_t width);
+
+/**
+ * @brief Appends a signed decimal, right-aligned in @p width columns.
+ */
+void fmt_i32(FmtBuffer *out, int32_t value, uint8_t width);
+
+/**
+ * @brief Appends lowercase hex, zero-padded to @p digits (1 to 8).
+ */
+void fmt_hex(FmtBuffer *out, uint32_t value, uint8_t digits);
+
+/**
+ * @brief Appends a fixed-point decimal.
+ * @param scaled Value multiplied by 10^decimals.
+ * @param decimals Digits after the decimal point (0 to 9).
+ * @param width Minimum total columns, right-aligned; 0 for none.
+ */
+void fmt_fixed(FmtBuffer *out, int32_t scaled, uint8_t decimals, uint8_t width);
+
+/**
+ * @brief Pads with spaces up to @p column characters.
+ * Used to blank the rest of an LCD line instead of clearing the display.
+ */
+void fmt_pad(FmtBuffer *out, uint8_t column);
+
+/**
+ * @brief Rounds @p value * 10^decimals to the nearest integer for fmt_fixed().
+ */
+int32_t fmt_scale(float value, uint8_t decimals);
+
+/**
+ * @brief Sends the buffer contents over the console UART (SERCOM5).
+ */
+void fmt_uart_write(const FmtBuffer *out);
+
+/**
+ * @brief Sends a constant string over the console UART.
+ */
+void fmt_uart_str(const char *text);
+
+/**
+ * @brief Measures the cost of formatting one typical status line.
+ * Formats "Moisture: 42% (Raw: 2048)\r\n" into a local buffer; nothing is sent.
+ * @return CPU cycles per formatted line.
+ */
+uint32_t fmt_measure_cost(void);
+
+#endif // FMT_H
@@ -0,0 +1,425 @@
+/**
+ * @file fw_patch.c
+ * @brief Patch decoding, staging into slot B and the resumable install.
+ */
+
+#include "fw_patch.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert(sizeof(FwPatchHeader) == 32, "FwPatchHeader is the header frame");
+_Static_assert(sizeof(FwRecordHeader) == 12, "FwRecordHeader is the record frame layout");
+_Static_assert(sizeof(FwProgress) <= FW_PAGE_SIZE, "FwProgress must fit one page");
+
+// Streams the bytes of a record's ops
+typedef struct {
+    const uint8_t *ops;
+    uint16_t length;
+    uint16_t position;                  // Next op
+    uint8_t op;                         // Op being expanded
+    uint16_t remaining;                 // Its bytes still to produce
+    uint32_t source;                    // Literal position, base offset or fill value
+    const uint8_t *base;
+    uint32_t base_size;
+} Decoder;
+
+static uint16_t read_u16(const uint8_t *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static bool next_op(Decoder *decoder) {
+    const uint8_t *ops = decoder->ops;
+    uint16_t position = decoder->position;
+    uint16_t left = decoder->length - position;
+
+    if (left == 0) {
+        return false;
+    }
+    uint8_t op = ops[position];
+    if (op < FW_OP_LITERAL_MAX) {
+        decoder->remaining = (uint16_t)(op + 1U);
+        decoder->source = position + 1U;
+        if (decoder->remaining > left - 1U) {
+            return false;
+        }
+        position = (uint16_t)(position + 1U + decoder->remaining);
+    } else if (op == FW_OP_COPY) {
+        if (left < 6U) {
+            return false;
+        }
+        decoder->source = ops[position + 1] | ((uint32_t)ops[position + 2] << 8) |
+                          ((uint32_t)ops[position + 3] << 16);
+        decoder->remaining = read_u16(&ops[position + 4]);
+        if (decoder->source + decoder->remaining > decoder->base_size) {
+            return false;
+        }
+        position = (uint16_t)(position + 6U);
+    } else if (op == FW_OP_FILL) {
+        if (left < 4U) {
+            return false;
+        }
+        decoder->remaining = read_u16(&ops[position + 1]);
+        decoder->source = ops[position + 3];
+        position = (uint16_t)(position + 4U);
+    } else {
+        return false;
+    }
+    decoder->op = op;
+    decoder->position = position;
+    return decoder->remaining != 0;
+}
+
+// Produces the next @p count bytes; false if the ops run out or are invalid
+static bool decode(Decoder *decoder, uint8_t *out, uint32_t count) {
+    while (count != 0) {
+        if (decoder->remaining == 0 && !next_op(decoder)) {
+            return false;
+        }
+        uint16_t take = (count < decoder->remaining) ? (uint16_t)count : decoder->remaining;
+        if (decoder->op < FW_OP_LITERAL_MAX) {
+            memcpy(out, &decoder->ops[decoder->source], take);
+        } else if (decoder->op == FW_OP_COPY) {
+            memcpy(out, &decoder->base[decoder->source], take);
+        } else {
+            memset(out, (int)decoder->source, take);
+        }
+        decoder->source += (decoder->op == FW_OP_FILL) ? 0U : take;
+        decoder->remaining = (uint16_t)(decoder->remaining - take);
+        out += take;
+        count -= take;
+    }
+    return true;
+}
+
+static uint32_t progress_crc(const FwProgress *progress) {
+    return crc32_update(CRC32_INITIAL, progress, offsetof(FwProgress, crc));
+}
+
+static uint32_t progress_address(uint8_t slot) {
+    return FW_PROGRESS_ADDRESS + (uint32_t)slot * FW_ROW_SIZE;
+}
+
+static bool is_blank(const uint8_t *bytes) {
+    for (uint32_t i = 0; i < FW_ROW_SIZE; i++) {
+        if (bytes[i] != 0xFFU) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Erases and programs one row from @p data unless it already holds it.
+// A blank row is not erased first.
+static FwResult write_row(const FwFlash *flash, uint32_t address, const uint8_t *data,
+                          bool *written) {
+    uint32_t page[FW_PAGE_SIZE / sizeof(uint32_t)];
+    const uint8_t *current = flash->map(flash->context, address);
+
+    *written = false;
+    if (memcmp(current, data, FW_ROW_SIZE) == 0) {
+        return FW_OK;
+    }
+    if (!is_blank(current)) {
+        flash->erase_row(flash->context, address);
+    }
+    for (uint32_t offset = 0; offset < FW_ROW_SIZE; offset += FW_PAGE_SIZE) {
+        memcpy(page, data + offset, FW_PAGE_SIZE);
+        flash->write_page(flash->context, address + offset, page);
+    }
+    *written = true;
+    return (memcmp(flash->map(flash->context, address), data, FW_ROW_SIZE) == 0) ? FW_OK
+                                                                               : FW_ERROR_FLASH;
+}
+
+static bool frame_crc_ok(const uint8_t *frame, uint16_t length) {
+    uint32_t crc;
+    memcpy(&crc, frame + length - sizeof(crc), sizeof(crc));
+    return crc == crc32_update(CRC32_INITIAL, frame, length - sizeof(crc));
+}
+
+static void checkpoint(FwUpdater *updater) {
+    fw_progress_save(updater->flash, &updater->progress, &updater->progress_slot);
+    updater->checkpoint_row = updater->progress.next_row;
+    updater->stats.checkpoints++;
+}
+
+static FwResult finish(FwUpdater *updater, FwResult result) {
+    updater->stats.last_result = result;
+    if (result != FW_OK) {
+        updater->stats.rejects++;
+    }
+    return result;
+}
+
+// --- Public API ---
+
+uint32_t fw_flash_crc(const FwFlash *flash, uint32_t address, uint32_t size) {
+    return crc32_update(CRC32_INITIAL, flash->map(flash->context, address), size);
+}
+
+void fw_progress_load(const FwFlash *flash, FwProgress *progress, uint8_t *slot) {
+    int8_t newest = -1;
+    const FwProgress *records[2];
+
+    for (uint8_t i = 0; i < 2U; i++) {
+        records[i] = (const FwProgress *)flash->map(flash->context, progress_address(i));
+        if (records[i]->magic == FW_PROGRESS_MAGIC && records[i]->crc == progress_crc(records[i]) &&
+            records[i]->state < FW_STATE_COUNT &&
+            (newest < 0 || records[i]->sequence > records[newest]->sequence)) {
+            newest = (int8_t)i;
+        }
+    }
+    if (newest >= 0) {
+        *progress = *records[newest];
+    } else {
+        memset(progress, 0, sizeof(*progress));
+        progress->state = FW_STATE_IDLE;
+        newest = 1;                     // The first save goes to row 0
+    }
+    if (slot != NULL) {
+        *slot = (uint8_t)newest;
+    }
+}
+
+void fw_progress_save(const FwFlash *flash, FwProgress *progress, uint8_t *slot) {
+    uint32_t page[FW_PAGE_SIZE / sizeof(uint32_t)];
+    uint8_t target = (uint8_t)(*slot ^ 1U);
+
+    // The other row keeps the previous record until this one is complete
+    progress->magic = FW_PROGRESS_MAGIC;
+    progress->sequence++;
+    progress->crc = progress_crc(progress);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, progress, sizeof(*progress));
+    flash->erase_row(flash->context, progress_address(target));
+    flash->write_page(flash->context, progress_address(target), page);
+    *slot = target;
+}
+
+void fw_updater_init(FwUpdater *updater, const FwFlash *flash) {
+    memset(updater, 0, sizeof(*updater));
+    updater->flash = flash;
+    fw_progress_load(flash, &updater->progress, &updater->progress_slot);
+    updater->checkpoint_row = updater->progress.next_row;
+}
+
+uint16_t fw_image_rows(const FwProgress *progress) {
+    return (uint16_t)((progress->image_size + FW_ROW_SIZE - 1U) / FW_ROW_SIZE);
+}
+
+FwResult fw_updater_header(FwUpdater *updater, const uint8_t *frame, uint16_t length) {
+    FwPatchHeader header;
+    FwProgress *progress = &updater->progress;
+
+    if (length != sizeof(header)) {
+        return finish(updater, FW_ERROR_LENGTH);
+    }
+    memcpy(&header, frame, sizeof(header));
+    if (header.magic != FW_HEADER_MAGIC) {
+        return finish(updater, FW_ERROR_MAGIC);
+    }
+    if (header.format != FW_PATCH_FORMAT || header.row_size != FW_ROW_SIZE) {
+        return finish(updater, FW_ERROR_FORMAT);
+    }
+    if (!frame_crc_ok(frame, length)) {
+        return finish(updater, FW_ERROR_CRC);
+    }
+    if (header.image_size == 0 || header.image_size > FW_SLOT_SIZE ||
+        header.base_size > FW_SLOT_SIZE) {
+        return finish(updater, FW_ERROR_SIZE);
+    }
+
+    // Same image: resume, or report that it is staged or already running
+    bool same = progress->image_crc == header.image_crc &&
+                progress->image_size == header.image_size;
+    if (same && (progress->state == FW_STATE_INSTALLED || progress->state == FW_STATE_READY ||
+                 (progress->state == FW_STATE_RECEIVING &&
+                  progress->base_crc == header.base_crc &&
+                  progress->base_size == header.base_size))) {
+        return finish(updater, FW_OK);
+    }
+    if (progress->state == FW_STATE_INSTALLING) {
+        return finish(updater, FW_ERROR_STATE);
+    }
+    if (header.base_size != 0 &&
+        fw_flash_crc(updater->flash, FW_SLOT_A_ADDRESS, header.base_size) != header.base_crc) {
+        return finish(updater, FW_ERROR_BASE);
+    }
+
+    progress->state = FW_STATE_RECEIVING;
+    progress->next_row = 0;
+    progress->image_size = header.image_size;
+    progress->image_crc = header.image_crc;
+    progress->base_size = header.base_size;
+    progress->base_crc = header.base_crc;
+    progress->version = header.version;
+    checkpoint(updater);
+    return finish(updater, FW_OK);
+}
+
+FwResult fw_updater_record(FwUpdater *updater, const uint8_t *frame, uint16_t length) {
+    FwRecordHeader header;
+    FwProgress *progress = &updater->progress;
+    const FwFlash *flash = updater->flash;
+    uint8_t row[FW_ROW_SIZE];
+
+    if (length < sizeof(header) + sizeof(uint32_t)) {
+        return finish(updater, FW_ERROR_LENGTH);
+    }
+    memcpy(&header, frame, sizeof(header));
+    if (header.magic != FW_RECORD_MAGIC) {
+        return finish(updater, FW_ERROR_MAGIC);
+    }
+    if (header.ops_length > FW_RECORD_OPS_MAX ||
+        length != sizeof(header) + header.ops_length + sizeof(uint32_t)) {
+        return finish(updater, FW_ERROR_LENGTH);
+    }
+    if (!frame_crc_ok(frame, length)) {
+        return finish(updater, FW_ERROR_CRC);
+    }
+    if (header.session != (uint16_t)progress->image_crc) {
+        return finish(updater, FW_ERROR_SESSION);
+    }
+    if (progress->state == FW_STATE_READY) {
+        updater->stats.repeats++;
+        return finish(updater, FW_OK);
+    }
+    if (progress->state != FW_STATE_RECEIVING) {
+        return finish(updater, FW_ERROR_STATE);
+    }
+    uint16_t rows = fw_image_rows(progress);
+    uint32_t end = (uint32_t)header.first_row + header.row_count;
+    if (header.row_count == 0 || end > rows) {
+        return finish(updater, FW_ERROR_OPS);
+    }
+    if (header.first_row > progress->next_row) {
+        return finish(updater, FW_ERROR_ORDER);
+    }
+    if (end <= progress->next_row) {
+        updater->stats.repeats++;
+        return finish(updater, FW_OK);
+    }
+
+    Decoder decoder = {
+        .ops = frame + sizeof(header),
+        .length = header.ops_length,
+        .base = flash->map(flash->context, FW_SLOT_A_ADDRESS),
+        .base_size = progress->base_size,
+    };
+    for (uint16_t index = header.first_row; index < end; index++) {
+        uint32_t offset = (uint32_t)index * FW_ROW_SIZE;
+        uint32_t count = progress->image_size - offset;
+        if (count > FW_ROW_SIZE) {
+            count = FW_ROW_SIZE;
+        }
+        // The tail of the last row stays erased
+        memset(row + count, 0xFF, FW_ROW_SIZE - count);
+        if (!decode(&decoder, row, count)) {
+            return finish(updater, FW_ERROR_OPS);
+        }
+        bool written;
+        FwResult result = write_row(flash, FW_SLOT_B_ADDRESS + offset, row, &written);
+        if (result != FW_OK) {
+            return finish(updater, result);
+        }
+        if (written) {
+            updater->stats.rows_written++;
+        } else {
+            updater->stats.rows_skipped++;
+        }
+    }
+    if (decoder.remaining != 0 || decoder.position != decoder.length) {
+        return finish(updater, FW_ERROR_OPS);
+    }
+    progress->next_row = (uint16_t)end;
+    updater->stats.records++;
+
+    if (progress->next_row == rows) {
+        bool good = fw_flash_crc(flash, FW_SLOT_B_ADDRESS, progress->image_size) ==
+                    progress->image_crc;
+        progress->state = good ? FW_STATE_READY : FW_STATE_IDLE;
+        checkpoint(updater);
+        return finish(updater, good ? FW_OK : FW_ERROR_IMAGE);
+    }
+    if ((uint16_t)(progress->next_row - updater->checkpoint_row) >= FW_CHECKPOINT_ROWS) {
+        checkpoint(updater);
+    }
+    return finish(updater, FW_OK);
+}
+
+FwResult fw_updater_activate(FwUpdater *updater, const uint8_t *frame, uint16_t length) {
+    FwActivateCommand command;
+
+    if (length != sizeof(command)) {
+        return finish(updater, FW_ERROR_LENGTH);
+    }
+    memcpy(&command, frame, sizeof(command));
+    if (command.magic != FW_ACTIVATE_MAGIC) {
+        return finish(updater, FW_ERROR_MAGIC);
+    }
+    if (command.image_crc != updater->progress.image_crc) {
+        return finish(updater, FW_ERROR_SESSION);
+    }
+    if (updater->progress.state != FW_STATE_READY) {
+        return finish(updater, FW_ERROR_STATE);
+    }
+    return finish(updater, FW_OK);
+}
+
+FwResult fw_install(const FwFlash *flash) {
+    FwProgress progress;
+    uint8_t slot;
+    uint8_t row[FW_ROW_SIZE];
+
+    fw_progress_load(flash, &progress, &slot);
+    if (progress.state != FW_STATE_READY && progress.state != FW_STATE_INSTALLING) {
+        return FW_OK;
+    }
+    // Slot B is never written during the copy, so it must still match
+    if (fw_flash_crc(flash, FW_SLOT_B_ADDRESS, progress.image_size) != progress.image_crc) {
+        if (progress.state == FW_STATE_READY) {
+            progress.state = FW_STATE_IDLE;
+            fw_progress_save(flash, &progress, &slot);
+        }
+        return FW_ERROR_IMAGE;
+    }
+    if (progress.state == FW_STATE_READY) {
+        progress.state = FW_STATE_INSTALLING;
+        progress.next_row = 0;
+        fw_progress_save(flash, &progress, &slot);
+    }
+
+    uint16_t rows = fw_image_rows(&progress);
+    uint16_t checkpoint_row = progress.next_row;
+    while (progress.next_row < rows) {
+        uint32_t offset = (uint32_t)progress.next_row * FW_ROW_SIZE;
+        bool written;
+        memcpy(row, flash->map(flash->context, FW_SLOT_B_ADDRESS + offset), FW_ROW_SIZE);
+        if (write_row(flash, FW_SLOT_A_ADDRESS + offset, row, &written) != FW_OK) {
+            return FW_ERROR_FLASH;
+        }
+        progress.next_row++;
+        if ((uint16_t)(progress.next_row - checkpoint_row) >= FW_CHECKPOINT_ROWS &&
+            progress.next_row < rows) {
+            fw_progress_save(flash, &progress, &slot);
+            checkpoint_row = progress.next_row;
+        }
+    }
+
+    if (fw_flash_crc(flash, FW_SLOT_A_ADDRESS, progress.image_size) != progress.image_crc) {
+        return FW_ERROR_IMAGE;
+    }
+    progress.state = FW_STATE_INSTALLED;
+    fw_progress_save(flash, &progress, &slot);
+    return FW_OK;
+}
+
+const char *fw_result_name(FwResult result) {
+    static const char *const NAMES[FW_ERROR_COUNT] = {
+        "ok", "bad length", "bad magic", "unknown format", "CRC mismatch", "image too large",
+        "base image mismatch", "other image", "out of order", "invalid ops", "flash verify failed",
+        "image CRC mismatch", "wrong state"
+    };
+    return (result < FW_ERROR_COUNT) ? NAMES[result] : "?";
+}
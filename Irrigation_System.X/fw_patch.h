@@ -0,0 +1,233 @@
+/**
+ * @file fw_patch.h
+ * @brief Delta firmware update: patch format, staging and install.
+ *
+ * Flash layout (SAMD21G17D, 128 KB main array, 256-byte rows):
+ *  - 0x00000 bootloader, 4 KB, protected by the BOOTPROT fuse;
+ *  - 0x01000 data rows (the moisture calibration record);
+ *  - 0x02000 slot A, the running application, 56 KB;
+ *  - 0x10000 slot B, where an update is staged, 56 KB;
+ *  - 0x1E000 the watering schedule.
+ * Progress lives in RWW EEPROM rows 2 and 3, written alternately (the
+ * runtime configuration has rows 0 and 1).
+ *
+ * The application is linked for slot A only. Cortex-M0+ code is not
+ * position independent, so slot B is a staging area and not a second
+ * bootable slot. A patch rebuilds the new image row by row into slot B.
+ * Each row is produced from bytes of the running image in slot A (COPY),
+ * literal bytes (LITERAL) and runs of one value (FILL). A rebuilt
+ * function usually keeps most of its old bytes at a shifted address, so
+ * these ops suit it.
+ *
+ * The patch is a header frame followed by record frames. Each frame has a
+ * CRC-32 and fits one console frame. A record rebuilds one or more whole
+ * rows, so a stretch of unchanged rows costs one COPY. Slot B is written
+ * only as whole rows, and records are accepted in row order:
+ *  - a record ending at or before the next row is acknowledged again and
+ *    ignored, so the host can simply resend;
+ *  - the receive position is checkpointed to RWW EEPROM every
+ *    FW_CHECKPOINT_ROWS rows and at the end.
+ * After a reset the host resends the header, gets back the checkpointed
+ * row and carries on from the record that starts there. Slot A is not
+ * touched while a patch is received, so rows are rebuilt the same way
+ * however often they are redone.
+ *
+ * When the last row is written, the whole of slot B is checked against
+ * the header's image CRC and the update becomes READY. An activate
+ * command then resets into the bootloader. fw_install() copies slot B
+ * over slot A, checkpointing as it goes, so an interrupted copy resumes.
+ * It checks slot A against the CRC again before starting it. CRC-32
+ * guards against corruption in transfer and in flash, not against a
+ * deliberately forged image.
+ *
+ * The module has no hardware dependencies. Flash goes through FwFlash:
+ *  - fw_update.c implements it with the NVMCTRL plib for the firmware;
+ *  - bootloader/bootloader.c implements it with NVMCTRL registers;
+ *  - tools/fw_update_sim.c runs it against the host NVM simulator.
+ * tools/fw_delta.py builds and sends patches.
+ */
+
+#ifndef FW_PATCH_H
+#define FW_PATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FW_ROW_SIZE             256U
+#define FW_PAGE_SIZE            64U
+#define FW_BOOTLOADER_SIZE      0x00001000U
+#define FW_SLOT_A_ADDRESS       0x00002000U
+#define FW_SLOT_B_ADDRESS       0x00010000U
+#define FW_SLOT_SIZE            0x0000E000U
+#define FW_SLOT_ROWS            (FW_SLOT_SIZE / FW_ROW_SIZE)
+#define FW_PROGRESS_ADDRESS     (0x00400000U + 2U * FW_ROW_SIZE) // RWW EEPROM rows 2 and 3
+#define FW_CHECKPOINT_ROWS      8U       // Rows redone at most after a reset
+
+#define FW_HEADER_MAGIC         0x50555746U // "FWUP" in memory order
+#define FW_RECORD_MAGIC         0x43525746U // "FWRC"
+#define FW_ACTIVATE_MAGIC       0x4F475746U // "FWGO"
+#define FW_PROGRESS_MAGIC       0x53505746U // "FWPS"
+#define FW_PATCH_FORMAT         1
+
+// Record ops, in a byte stream after the record header
+#define FW_OP_LITERAL_MAX       0x80U    // 0x00-0x7F: n + 1 literal bytes follow
+#define FW_OP_COPY              0x80U    // u24 offset in slot A, u16 length
+#define FW_OP_FILL              0x81U    // u16 length, byte value
+#define FW_RECORD_OPS_MAX       272U     // A row of literals plus slack
+
+// First frame; also the resume query
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t row_size;                  // FW_ROW_SIZE
+    uint32_t image_size;                // New image, at most FW_SLOT_SIZE
+    uint32_t image_crc;
+    uint32_t base_size;                 // Image the COPY ops read, 0 for a full image
+    uint32_t base_crc;                  // Its CRC-32, checked against slot A
+    uint32_t version;                   // Reported only
+    uint32_t crc;                       // CRC-32 of all bytes before it
+} FwPatchHeader;
+
+// Then ops_length bytes of ops and a CRC-32 of everything before it
+typedef struct {
+    uint32_t magic;
+    uint16_t session;                   // Low half of image_crc
+    uint16_t first_row;
+    uint16_t row_count;
+    uint16_t ops_length;
+} FwRecordHeader;
+
+// Activates the staged image with this CRC
+typedef struct {
+    uint32_t magic;
+    uint32_t image_crc;
+} FwActivateCommand;
+
+typedef enum {
+    FW_STATE_IDLE = 0,                  // Nothing staged
+    FW_STATE_RECEIVING,                 // Rows before next_row are in slot B
+    FW_STATE_READY,                     // Slot B checked, waiting for activate
+    FW_STATE_INSTALLING,                // Rows before next_row copied to slot A
+    FW_STATE_INSTALLED,                 // Slot A holds the image described
+    FW_STATE_COUNT
+} FwState;
+
+// One RWW EEPROM page; the valid one with the highest sequence wins
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint8_t state;                      // FwState
+    uint8_t reserved;
+    uint16_t next_row;
+    uint32_t image_size;
+    uint32_t image_crc;
+    uint32_t base_size;
+    uint32_t base_crc;
+    uint32_t version;
+    uint32_t crc;
+} FwProgress;
+
+typedef enum {
+    FW_OK = 0,
+    FW_ERROR_LENGTH,
+    FW_ERROR_MAGIC,
+    FW_ERROR_FORMAT,
+    FW_ERROR_CRC,
+    FW_ERROR_SIZE,                      // Image or base larger than a slot
+    FW_ERROR_BASE,                      // Slot A is not the patch's base image
+    FW_ERROR_SESSION,                   // Record or activate for another image
+    FW_ERROR_ORDER,                     // Record starts after the next row
+    FW_ERROR_OPS,                       // Ops overrun the rows or read outside the base
+    FW_ERROR_FLASH,                     // Verify after write failed
+    FW_ERROR_IMAGE,                     // Staged image CRC mismatch
+    FW_ERROR_STATE,                     // Not valid in the current state
+    FW_ERROR_COUNT
+} FwResult;
+
+// Flash access. Addresses are the target's; erase and write return once done.
+typedef struct {
+    const uint8_t *(*map)(void *context, uint32_t address);
+    void (*erase_row)(void *context, uint32_t address);
+    void (*write_page)(void *context, uint32_t address, const uint32_t *data);
+    void *context;
+} FwFlash;
+
+typedef struct {
+    uint32_t records;                   // Records applied
+    uint32_t repeats;                   // Records already applied, acknowledged again
+    uint32_t rows_written;
+    uint32_t rows_skipped;              // Already held the rebuilt bytes
+    uint32_t checkpoints;
+    uint32_t rejects;
+    FwResult last_result;
+} FwUpdaterStats;
+
+typedef struct {
+    const FwFlash *flash;
+    FwProgress progress;                // Newest checkpoint, updated in RAM first
+    uint8_t progress_slot;              // Row holding it
+    uint16_t checkpoint_row;            // next_row as of the last checkpoint
+    FwUpdaterStats stats;
+} FwUpdater;
+
+/**
+ * @brief CRC-32 of @p size bytes of flash from @p address.
+ */
+uint32_t fw_flash_crc(const FwFlash *flash, uint32_t address, uint32_t size);
+
+/**
+ * @brief Newest valid progress record; a zeroed IDLE one if there is none.
+ * @param slot Receives the row holding it (0 or 1); may be NULL.
+ */
+void fw_progress_load(const FwFlash *flash, FwProgress *progress, uint8_t *slot);
+
+/**
+ * @brief Writes @p progress with the next sequence into the other row.
+ * @param slot Row of the current record, updated to the new one.
+ */
+void fw_progress_save(const FwFlash *flash, FwProgress *progress, uint8_t *slot);
+
+/**
+ * @brief Loads the progress record. An update that was being received
+ * resumes at its checkpoint.
+ */
+void fw_updater_init(FwUpdater *updater, const FwFlash *flash);
+
+/**
+ * @brief Handles a header frame. The same image as the one in progress
+ * resumes; another image restarts at row 0 once slot A matches its base.
+ */
+FwResult fw_updater_header(FwUpdater *updater, const uint8_t *frame, uint16_t length);
+
+/**
+ * @brief Handles a record frame: rebuilds its rows and writes them to
+ * slot B. After the last row the image is checked and becomes READY.
+ */
+FwResult fw_updater_record(FwUpdater *updater, const uint8_t *frame, uint16_t length);
+
+/**
+ * @brief Checks an activate frame against the READY image.
+ */
+FwResult fw_updater_activate(FwUpdater *updater, const uint8_t *frame, uint16_t length);
+
+/**
+ * @brief Rows of the new image, from the header.
+ */
+uint16_t fw_image_rows(const FwProgress *progress);
+
+/**
+ * @brief Bootloader step: copies a READY or INSTALLING image from slot B
+ * to slot A, resuming an interrupted copy.
+ * @return FW_OK if slot A holds a checked image afterwards, or there was
+ * nothing to install and slot A is as it was; FW_ERROR_IMAGE if slot B
+ * does not match the staged CRC (the update is dropped and slot A is
+ * untouched) or slot A does not after the copy.
+ */
+FwResult fw_install(const FwFlash *flash);
+
+/**
+ * @brief Short description of a result for console messages.
+ */
+const char *fw_result_name(FwResult result);
+
+#endif // FW_PATCH_H
@@ -0,0 +1,128 @@
+/**
+ * @file fw_update.c
+ * @brief NVMCTRL flash access and console frames of the firmware update.
+ */
+
+#include "fw_update.h"
+#include "console_rx.h"           // CONSOLE_RX_FRAME_MAX
+#include "cycle_counter.h"
+#include "trace.h"
+#include "fmt.h"
+#include "definitions.h"          // NVMCTRL and SERCOM5 plibs
+#include <string.h>
+
+_Static_assert(sizeof(FwRecordHeader) + FW_RECORD_OPS_MAX + sizeof(uint32_t) <= CONSOLE_RX_FRAME_MAX,
+               "A firmware record must fit one console frame");
+
+typedef enum {
+    FRAME_HEADER,
+    FRAME_RECORD,
+    FRAME_ACTIVATE
+} FrameKind;
+
+static FwUpdater updater;
+static uint32_t record_cycles_max;
+
+static const uint8_t *flash_map(void *context, uint32_t address) {
+    (void)context;
+    return (const uint8_t *)address;
+}
+
+static bool is_rww(uint32_t address) {
+    return address >= NVMCTRL_RWWEEPROM_START_ADDRESS;
+}
+
+static void flash_erase_row(void *context, uint32_t address) {
+    (void)context;
+    while (NVMCTRL_IsBusy());
+    if (is_rww(address)) {
+        NVMCTRL_RWWEEPROM_RowErase(address);
+    } else {
+        NVMCTRL_RowErase(address);
+    }
+    while (NVMCTRL_IsBusy());
+}
+
+static void flash_write_page(void *context, uint32_t address, const uint32_t *data) {
+    (void)context;
+    while (NVMCTRL_IsBusy());
+    if (is_rww(address)) {
+        NVMCTRL_RWWEEPROM_PageWrite((uint32_t *)data, address);
+    } else {
+        NVMCTRL_PageWrite(data, address);
+    }
+    while (NVMCTRL_IsBusy());
+}
+
+static const FwFlash flash = { flash_map, flash_erase_row, flash_write_page, NULL };
+
+static void report(FwResult result) {
+    static const char *const STATE_NAMES[FW_STATE_COUNT] = {
+        "IDLE", "RECEIVING", "READY", "INSTALLING", "INSTALLED"
+    };
+    const FwProgress *progress = &updater.progress;
+    char storage[64];
+    FmtBuffer line;
+
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "FW ");
+    fmt_str(&line, STATE_NAMES[progress->state]);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, progress->next_row, 0);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, fw_image_rows(progress), 0);
+    fmt_char(&line, ' ');
+    fmt_str(&line, fw_result_name(result));
+    fmt_str(&line, "\r\n");
+    fmt_uart_write(&line);
+}
+
+// --- Public API ---
+
+void fw_update_init(void) {
+    fw_updater_init(&updater, &flash);
+    record_cycles_max = 0;
+}
+
+bool fw_update_handle_frame(const uint8_t *frame, uint16_t length) {
+    uint32_t magic;
+    FrameKind kind;
+    FwResult result;
+
+    if (length < sizeof(magic)) {
+        return false;
+    }
+    memcpy(&magic, frame, sizeof(magic));
+    if (magic == FW_HEADER_MAGIC) {
+        kind = FRAME_HEADER;
+        result = fw_updater_header(&updater, frame, length);
+    } else if (magic == FW_RECORD_MAGIC) {
+        kind = FRAME_RECORD;
+        uint32_t start = cycle_counter_now();
+        result = fw_updater_record(&updater, frame, length);
+        uint32_t cycles = cycle_counter_elapsed(start);
+        if (cycles > record_cycles_max) {
+            record_cycles_max = cycles;
+        }
+    } else if (magic == FW_ACTIVATE_MAGIC) {
+        kind = FRAME_ACTIVATE;
+        result = fw_updater_activate(&updater, frame, length);
+    } else {
+        return false;
+    }
+
+    TRACE(TRACE_EVT_FW_UPDATE, (kind << 4) | result, updater.progress.next_row);
+    report(result);
+    if (kind == FRAME_ACTIVATE && result == FW_OK) {
+        // Let the answer leave the UART; the bootloader installs the image
+        while (!SERCOM5_USART_TransmitComplete());
+        NVIC_SystemReset();
+    }
+    return true;
+}
+
+void fw_update_get_stats(FwUpdateStats *stats) {
+    stats->updater = updater.stats;
+    stats->progress = updater.progress;
+    stats->record_cycles_max = record_cycles_max;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file fw_update.h
+ * @brief Delta firmware update over the console (fw_patch.h) on the target.
+ *
+ * Three console frames, told apart by their magic like the configuration
+ * upload:
+ *  - header: starts or resumes an update;
+ *  - record: rebuilds rows of the new image into slot B;
+ *  - activate: resets into the bootloader once the image is READY.
+ * Each frame is answered with one line for tools/fw_delta.py:
+ *
+ *     FW <state> <next row> <rows> <result>
+ *
+ * where state is IDLE, RECEIVING, READY, INSTALLING or INSTALLED. The
+ * host sends the next record only once it has the answer. After an error
+ * or a reset it resends the header and continues from the row given.
+ *
+ * Slot B is in the main flash array, so each row written stalls the CPU
+ * for one erase and four page writes, about 16 ms at most. The
+ * interrupts stall with it, since the vector table is in flash too. The
+ * progress checkpoint goes to the RWW EEPROM. The bootloader
+ * (bootloader/bootloader.c) installs the image at the next reset. The
+ * project's linker macros ROM_ORIGIN=0x2000 and ROM_LENGTH=0xE000 link the
+ * application for slot A, so the bootloader must be flashed once first.
+ *
+ * Main loop:
+ * @code
+ *   static void console_frame(const uint8_t *frame, uint16_t length, void *context) {
+ *       if (!runtime_config_handle_frame(frame, length) &&
+ *           !fw_update_handle_frame(frame, length)) {
+ *           // Single-character commands
+ *       }
+ *   }
+ * @endcode
+ */
+
+#ifndef FW_UPDATE_H
+#define FW_UPDATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fw_patch.h"
+
+typedef struct {
+    FwUpdaterStats updater;
+    FwProgress progress;
+    uint32_t record_cycles_max;  // Longest record: decode, erase, write, verify
+} FwUpdateStats;
+
+/**
+ * @brief Loads the update progress, including an install done by the
+ * bootloader. Boot step.
+ */
+void fw_update_init(void);
+
+/**
+ * @brief Console frame handler hook.
+ * @return true if the frame was an update frame (handled or rejected),
+ * false if it is for another handler.
+ */
+bool fw_update_handle_frame(const uint8_t *frame, uint16_t length);
+
+void fw_update_get_stats(FwUpdateStats *stats);
+
+#endif // FW_UPDATE_H
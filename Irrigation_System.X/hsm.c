@@ -0,0 +1,134 @@
+/**
+ * @file hsm.c
+ * @brief Hierarchical state machine dispatch and transitions.
+ */
+
+#include "hsm.h"
+#include <stddef.h>
+
+#define QUEUE_MASK (HSM_QUEUE_SIZE - 1U)
+
+// true if @p ancestor contains @p state (not counting the state itself)
+static bool contains(const HsmState *states, HsmStateId ancestor, HsmStateId state) {
+    for (state = states[state].parent; state != HSM_NONE; state = states[state].parent) {
+        if (state == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void move_to(Hsm *hsm, HsmStateId target, HsmEventId event) {
+    const HsmDefinition *definition = hsm->definition;
+    const HsmState *states = definition->states;
+    HsmStateId source = hsm->state;
+    HsmStateId path[HSM_MAX_DEPTH];
+    uint8_t depth = 0;
+
+    // Exit from the leaf up to the closest state that contains the target
+    HsmStateId common = source;
+    while (common != HSM_NONE && !contains(states, common, target)) {
+        if (states[common].exit) {
+            states[common].exit(hsm);
+        }
+        common = states[common].parent;
+    }
+
+    // Enter downwards from just below that state, then into initial children
+    for (HsmStateId state = target; state != common; state = states[state].parent) {
+        path[depth++] = state;
+    }
+    while (depth != 0) {
+        HsmStateId state = path[--depth];
+        if (states[state].entry) {
+            states[state].entry(hsm);
+        }
+    }
+    HsmStateId leaf = target;
+    while (states[leaf].initial != HSM_NONE) {
+        leaf = states[leaf].initial;
+        if (states[leaf].entry) {
+            states[leaf].entry(hsm);
+        }
+    }
+
+    hsm->state = leaf;
+    hsm->transitions++;
+    if (definition->trace) {
+        definition->trace(definition->machine, source, leaf, event);
+    }
+}
+
+void hsm_init(Hsm *hsm, const HsmDefinition *definition, void *context) {
+    hsm->definition = definition;
+    hsm->context = context;
+    hsm->state = HSM_NONE;
+    hsm->head = 0;
+    hsm->tail = 0;
+    hsm->transitions = 0;
+    hsm->unhandled = 0;
+    hsm->dropped = 0;
+}
+
+void hsm_transition(Hsm *hsm, HsmStateId target) {
+    move_to(hsm, target, HSM_NONE);
+}
+
+bool hsm_post(Hsm *hsm, HsmEventId event) {
+    uint8_t head = hsm->head;
+    uint8_t next = (uint8_t)((head + 1U) & QUEUE_MASK);
+
+    if (next == hsm->tail) {
+        hsm->dropped++;
+        return false;
+    }
+    hsm->queue[head] = event;
+    hsm->head = next;
+    return true;
+}
+
+bool hsm_dispatch(Hsm *hsm, HsmEventId event) {
+    const HsmDefinition *definition = hsm->definition;
+
+    if (event >= definition->event_count) {
+        hsm->unhandled++;
+        return false;
+    }
+    for (HsmStateId state = hsm->state; state != HSM_NONE;
+         state = definition->states[state].parent) {
+        HsmStateId target = definition->transitions[state * definition->event_count + event];
+        if (target != 0) {
+            move_to(hsm, (HsmStateId)(target - 1U), event);
+            return true;
+        }
+    }
+    hsm->unhandled++;
+    return false;
+}
+
+void hsm_run(Hsm *hsm) {
+    const HsmState *states = hsm->definition->states;
+
+    // Includes anything the actions of these transitions post
+    while (hsm->tail != hsm->head) {
+        uint8_t tail = hsm->tail;
+        HsmEventId event = hsm->queue[tail];
+        hsm->tail = (uint8_t)((tail + 1U) & QUEUE_MASK);
+        hsm_dispatch(hsm, event);
+    }
+
+    for (HsmStateId state = hsm->state; state != HSM_NONE; state = states[state].parent) {
+        if (states[state].poll) {
+            HsmEventId event = states[state].poll(hsm);
+            if (event != HSM_NONE) {
+                hsm_dispatch(hsm, event);
+            }
+            break;
+        }
+    }
+}
+
+bool hsm_in_state(const Hsm *hsm, HsmStateId state) {
+    return hsm->state != HSM_NONE &&
+           (hsm->state == state || contains(hsm->definition->states, state, hsm->state));
+}
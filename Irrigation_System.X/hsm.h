@@ -0,0 +1,125 @@
+/**
+ * @file hsm.h
+ * @brief Table-driven hierarchical state machine engine.
+ *
+ * A machine is described entirely by const tables built at compile time:
+ *  - one HsmState per state, naming its parent, the child entered with it
+ *    (composite states) and its entry, exit and poll actions;
+ *  - a [state][event] transition table holding HSM_TO(target), or 0 where
+ *    the state does not handle the event.
+ *
+ * An event is looked up in the table row of the current leaf state and, if
+ * not handled there, of each ancestor in turn: one array read per level,
+ * so dispatch is constant time for the HSM_MAX_DEPTH bound. A transition
+ * runs the exit actions from the leaf up to the closest common ancestor,
+ * then the entry actions down to the target and its initial children.
+ * A transition to the state itself or to an ancestor exits and re-enters
+ * it; a transition from a parent to one of its children leaves the parent
+ * entered.
+ *
+ * Events come from two places:
+ *  - hsm_post() queues them, e.g. from an entry action or an interrupt;
+ *  - the poll action of the current state (or of its closest ancestor
+ *    that has one) returns one for each hsm_run() call. This suits the
+ *    firmware's polled machines: one poll per main-loop pass, like one
+ *    pass through a switch.
+ *
+ * Every transition is reported to the definition's trace hook.
+ * The module has no hardware dependencies; tools/hsm_bench.c compares its
+ * dispatch cost with a switch.
+ */
+
+#ifndef HSM_H
+#define HSM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HSM_NONE        0xFFU  // No state, no event
+#define HSM_MAX_DEPTH   4U     // Nesting levels, top level included
+#define HSM_QUEUE_SIZE  8U     // Must be a power of two; holds one less
+
+// Transition table entry for @p state; 0 means "not handled here"
+#define HSM_TO(state)   ((HsmStateId)((state) + 1U))
+
+typedef uint8_t HsmStateId;
+typedef uint8_t HsmEventId;
+typedef struct Hsm Hsm;
+
+typedef void (*HsmAction)(Hsm *hsm);
+// Returns the event to dispatch, or HSM_NONE
+typedef HsmEventId (*HsmPoll)(Hsm *hsm);
+// event is HSM_NONE for hsm_transition(); from is HSM_NONE on the first one
+typedef void (*HsmTraceHook)(uint8_t machine, HsmStateId from, HsmStateId to,
+                             HsmEventId event);
+
+typedef struct {
+    HsmStateId parent;                // HSM_NONE at the top level
+    HsmStateId initial;               // Child entered with this state; HSM_NONE for a leaf
+    HsmAction entry;                  // Each may be NULL
+    HsmAction exit;
+    HsmPoll poll;
+} HsmState;
+
+typedef struct {
+    const HsmState *states;
+    const HsmStateId *transitions;    // [state_count][event_count] of HSM_TO() or 0
+    uint8_t state_count;
+    uint8_t event_count;
+    uint8_t machine;                  // Identifies the machine to the trace hook
+    HsmTraceHook trace;               // May be NULL
+} HsmDefinition;
+
+struct Hsm {
+    const HsmDefinition *definition;
+    void *context;                    // For the actions
+    HsmStateId state;                 // Current leaf state
+    volatile uint8_t head;            // Written by hsm_post()
+    volatile uint8_t tail;            // Written by hsm_run()
+    HsmEventId queue[HSM_QUEUE_SIZE];
+    uint32_t transitions;
+    uint16_t unhandled;               // Events no state handled
+    uint16_t dropped;                 // hsm_post() with the queue full
+};
+
+/**
+ * @brief Binds @p hsm to its tables. No state is entered until the first
+ * hsm_transition().
+ */
+void hsm_init(Hsm *hsm, const HsmDefinition *definition, void *context);
+
+/**
+ * @brief Moves to @p target unconditionally, with the same exit and entry
+ * actions as an event-driven transition. Used to start the machine.
+ */
+void hsm_transition(Hsm *hsm, HsmStateId target);
+
+/**
+ * @brief Queues @p event for the next hsm_run(). Safe from one interrupt
+ * (or other single producer) while the main loop runs the machine.
+ * @return false, dropping the event, if the queue is full.
+ */
+bool hsm_post(Hsm *hsm, HsmEventId event);
+
+/**
+ * @brief Dispatches @p event now.
+ * @return true if a state handled it.
+ */
+bool hsm_dispatch(Hsm *hsm, HsmEventId event);
+
+/**
+ * @brief Dispatches the queued events, then runs the current state's poll
+ * action once and dispatches the event it returns.
+ */
+void hsm_run(Hsm *hsm);
+
+static inline HsmStateId hsm_state(const Hsm *hsm) {
+    return hsm->state;
+}
+
+/**
+ * @brief true if @p state is the current leaf state or one of its ancestors.
+ */
+bool hsm_in_state(const Hsm *hsm, HsmStateId state);
+
+#endif // HSM_H
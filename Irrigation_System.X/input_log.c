@@ -0,0 +1,175 @@
+/**
+ * @file input_log.c
+ * @brief Encoding and decoding of the input record stream.
+ */
+
+#include "input_log.h"
+#include <string.h>
+
+#define TYPE_SHIFT  5U
+#define DELTA_MASK  0x1FU
+
+static uint32_t payload_size(const InputEvent *event) {
+    switch (event->type) {
+        case INPUT_EVT_SYNC: return 4U;
+        case INPUT_EVT_ADC:  return 2U;
+        case INPUT_EVT_UART: return 1U + event->length;
+        default:             return 0U;
+    }
+}
+
+static uint32_t varint_size(uint32_t value) {
+    uint32_t size = 1;
+    while (value >= 0x80U) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// Encodes one record at writer->used; the caller has checked the space
+static void encode(InputLogWriter *writer, const InputEvent *event) {
+    uint8_t *out = writer->data + writer->used;
+    uint32_t delta = (event->type == INPUT_EVT_SYNC) ? 0U : event->time_ms - writer->last_ms;
+
+    if (delta < INPUT_LOG_DELTA_ESCAPE) {
+        *out++ = (uint8_t)((event->type << TYPE_SHIFT) | delta);
+    } else {
+        *out++ = (uint8_t)((event->type << TYPE_SHIFT) | INPUT_LOG_DELTA_ESCAPE);
+        while (delta >= 0x80U) {
+            *out++ = (uint8_t)(delta | 0x80U);
+            delta >>= 7;
+        }
+        *out++ = (uint8_t)delta;
+    }
+
+    switch (event->type) {
+        case INPUT_EVT_SYNC:
+            for (uint32_t i = 0; i < 4U; i++) {
+                *out++ = (uint8_t)(event->time_ms >> (8U * i));
+            }
+            break;
+        case INPUT_EVT_ADC: {
+            uint16_t word = (uint16_t)(((uint16_t)event->source << 12) | (event->value & 0x0FFFU));
+            *out++ = (uint8_t)word;
+            *out++ = (uint8_t)(word >> 8);
+            break;
+        }
+        case INPUT_EVT_UART:
+            *out++ = event->length;
+            memcpy(out, event->bytes, event->length);
+            out += event->length;
+            break;
+        default:
+            break;
+    }
+    writer->used = (uint32_t)(out - writer->data);
+    writer->last_ms = event->time_ms;
+}
+
+void input_log_writer_init(InputLogWriter *writer, uint8_t *data, uint32_t size) {
+    writer->data = data;
+    writer->size = size;
+    writer->used = 0;
+    writer->last_ms = 0;
+    writer->synced = false;
+}
+
+bool input_log_put(InputLogWriter *writer, const InputEvent *event) {
+    InputEvent sync = { event->time_ms, INPUT_EVT_SYNC, 0, 0, 0, NULL };
+    uint32_t need = 0;
+
+    if (event->type >= INPUT_EVT_COUNT || (event->type == INPUT_EVT_UART && event->length == 0)) {
+        return false;
+    }
+    if (!writer->synced && event->type != INPUT_EVT_SYNC) {
+        need += 1U + payload_size(&sync);
+    }
+    uint32_t delta = (writer->synced && event->type != INPUT_EVT_SYNC)
+        ? event->time_ms - writer->last_ms : 0U;
+    need += 1U + ((delta < INPUT_LOG_DELTA_ESCAPE) ? 0U : varint_size(delta)) + payload_size(event);
+    if (need > writer->size - writer->used) {
+        return false;
+    }
+
+    if (!writer->synced && event->type != INPUT_EVT_SYNC) {
+        encode(writer, &sync);
+    }
+    encode(writer, event);
+    writer->synced = true;
+    return true;
+}
+
+void input_log_reader_init(InputLogReader *reader, const uint8_t *data, uint32_t size) {
+    reader->data = data;
+    reader->size = size;
+    reader->position = 0;
+    reader->time_ms = 0;
+}
+
+int input_log_next(InputLogReader *reader, InputEvent *event) {
+    const uint8_t *data = reader->data;
+    uint32_t end = reader->size;
+    uint32_t at = reader->position;
+
+    if (at >= end) {
+        return 0;
+    }
+    uint8_t header = data[at++];
+    uint32_t delta = header & DELTA_MASK;
+    if (delta == INPUT_LOG_DELTA_ESCAPE) {
+        delta = 0;
+        for (uint32_t shift = 0;; shift += 7U) {
+            if (at >= end || shift > 28U) {
+                return -1;
+            }
+            uint8_t byte = data[at++];
+            delta |= (uint32_t)(byte & 0x7FU) << shift;
+            if (!(byte & 0x80U)) {
+                break;
+            }
+        }
+    }
+
+    memset(event, 0, sizeof(*event));
+    event->type = (uint8_t)(header >> TYPE_SHIFT);
+    event->time_ms = reader->time_ms + delta;
+
+    switch (event->type) {
+        case INPUT_EVT_SYNC:
+            if (end - at < 4U) {
+                return -1;
+            }
+            event->time_ms = (uint32_t)data[at] | ((uint32_t)data[at + 1] << 8) |
+                             ((uint32_t)data[at + 2] << 16) | ((uint32_t)data[at + 3] << 24);
+            at += 4U;
+            break;
+        case INPUT_EVT_ADC: {
+            if (end - at < 2U) {
+                return -1;
+            }
+            uint16_t word = (uint16_t)(data[at] | (data[at + 1] << 8));
+            event->source = (uint8_t)(word >> 12);
+            event->value = word & 0x0FFFU;
+            at += 2U;
+            break;
+        }
+        case INPUT_EVT_UART:
+            if (at >= end || data[at] == 0 || end - at - 1U < data[at]) {
+                return -1;
+            }
+            event->length = data[at];
+            event->bytes = &data[at + 1];
+            at += 1U + event->length;
+            break;
+        case INPUT_EVT_RESET:
+        case INPUT_EVT_SW0_DOWN:
+        case INPUT_EVT_SW0_UP:
+            break;
+        default:
+            return -1;
+    }
+    reader->position = at;
+    reader->time_ms = event->time_ms;
+    return 1;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file input_log.h
+ * @brief Compact timestamped stream of the firmware's inputs.
+ *
+ * One record per input event: ADC results, SW0 edges and received UART
+ * bytes. Each record starts with one byte holding the event type (top 3
+ * bits) and the milliseconds since the previous record (low 5 bits).
+ * Longer gaps set the low bits to INPUT_LOG_DELTA_ESCAPE and follow the
+ * byte with the gap as a LEB128 varint. Then comes the payload:
+ *
+ *   SYNC    4 bytes, absolute time (ms, little endian)
+ *   RESET   none; the firmware restarted. Follows the SYNC of the new
+ *           time base
+ *   ADC     2 bytes, source << 12 | 12-bit result
+ *   SW0     none; SW0_DOWN and SW0_UP are separate types
+ *   UART    1 byte length (1-255), then the bytes
+ *
+ * A stream starts with a SYNC, so blocks of it can be cut and joined
+ * freely. A 4-zone scan costs 12 bytes, a console key press 3.
+ *
+ * The module has no hardware dependencies; input_record.c records the
+ * target's inputs with it and tools/input_replay.c replays them on the host.
+ */
+
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INPUT_LOG_DELTA_ESCAPE  31U
+#define INPUT_LOG_RECORD_MAX    (1U + 5U + 1U + 255U)  // Longest record: UART with varint gap
+
+// Sources of ADC records
+#define INPUT_ADC_ZONE(zone)    ((uint8_t)(zone))      // Sensor scan, zones 0-7
+#define INPUT_ADC_CALIBRATION   8U                     // calibration_process() reading
+#define INPUT_ADC_WINDOW        9U                     // Window-monitor wake result
+
+typedef enum {
+    INPUT_EVT_SYNC = 0,
+    INPUT_EVT_RESET,
+    INPUT_EVT_ADC,
+    INPUT_EVT_SW0_DOWN,
+    INPUT_EVT_SW0_UP,
+    INPUT_EVT_UART,
+    INPUT_EVT_COUNT
+} InputEventType;
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t type;                // InputEventType
+    uint8_t source;              // ADC: INPUT_ADC_*
+    uint16_t value;              // ADC: 12-bit result
+    uint8_t length;              // UART: byte count
+    const uint8_t *bytes;        // UART: points into the stream
+} InputEvent;
+
+// Writes records into a caller-provided buffer
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t used;
+    uint32_t last_ms;
+    bool synced;                 // A SYNC opens the stream
+} InputLogWriter;
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t position;
+    uint32_t time_ms;
+} InputLogReader;
+
+void input_log_writer_init(InputLogWriter *writer, uint8_t *data, uint32_t size);
+
+/**
+ * @brief Appends @p event (and the SYNC a fresh stream needs).
+ * @return false, writing nothing, if it does not fit.
+ */
+bool input_log_put(InputLogWriter *writer, const InputEvent *event);
+
+void input_log_reader_init(InputLogReader *reader, const uint8_t *data, uint32_t size);
+
+/**
+ * @brief Decodes the next record; SYNC records are returned too.
+ * @return 1 for an event, 0 at the end, -1 on a malformed record.
+ */
+int input_log_next(InputLogReader *reader, InputEvent *event);
+
+#endif // INPUT_LOG_H
@@ -0,0 +1,173 @@
+/**
+ * @file input_record.c
+ * @brief Input recording into persistent RAM and its UART dump.
+ */
+
+#include "input_record.h"
+
+#if INPUT_RECORD_ENABLED
+
+#include "fmt.h"
+#include <stddef.h>
+#include <string.h>
+
+#define DUMP_BYTES_PER_LINE 32U
+
+typedef struct {
+    uint32_t magic;
+    uint8_t current;                       // Block being written
+    uint16_t used[2];
+    uint32_t block_records[2];
+    uint32_t records;
+    uint32_t lost;
+    uint8_t blocks[2][INPUT_RECORD_BLOCK_SIZE];
+} InputRecordBuffer;
+
+extern volatile uint32_t systemTicks;
+
+// Not cleared by the startup code so it survives warm resets
+static InputRecordBuffer record_buffer __attribute__((persistent));
+
+static InputLogWriter writer;
+static bool writer_ready = false;
+static bool sw0_level = false;
+static uint16_t cal_value;
+static uint32_t cal_time_ms;
+static bool cal_recorded = false;
+
+static void open_block(uint8_t block) {
+    record_buffer.current = block;
+    record_buffer.used[block] = 0;
+    record_buffer.block_records[block] = 0;
+    input_log_writer_init(&writer, record_buffer.blocks[block], INPUT_RECORD_BLOCK_SIZE);
+}
+
+static void record(InputEvent *event);
+
+// First record since boot: keep a retained stream and mark the restart
+static void writer_init(void) {
+    uint8_t block = record_buffer.current;
+    writer_ready = true;
+    if (record_buffer.magic != INPUT_RECORD_MAGIC || block > 1U ||
+        record_buffer.used[block] > INPUT_RECORD_BLOCK_SIZE) {
+        input_record_clear();
+        return;
+    }
+    // Appends after the retained records, with a SYNC for the new time base
+    input_log_writer_init(&writer, record_buffer.blocks[block], INPUT_RECORD_BLOCK_SIZE);
+    writer.used = record_buffer.used[block];
+    if (writer.used != 0) {
+        InputEvent reset = { 0, INPUT_EVT_RESET, 0, 0, 0, NULL };
+        record(&reset);
+    }
+}
+
+static void record(InputEvent *event) {
+    if (!writer_ready) {
+        writer_init();
+    }
+    event->time_ms = systemTicks;
+    if (!input_log_put(&writer, event)) {
+        // The other block holds the oldest records
+        uint8_t next = record_buffer.current ^ 1U;
+        record_buffer.lost += record_buffer.block_records[next];
+        open_block(next);
+        input_log_put(&writer, event);
+    }
+    record_buffer.used[record_buffer.current] = (uint16_t)writer.used;
+    record_buffer.block_records[record_buffer.current]++;
+    record_buffer.records++;
+}
+
+static void dump_block(const uint8_t *data, uint16_t length) {
+    char storage[2U * DUMP_BYTES_PER_LINE + 4U];
+    FmtBuffer line;
+
+    for (uint16_t offset = 0; offset < length; offset += DUMP_BYTES_PER_LINE) {
+        fmt_init(&line, storage, sizeof(storage));
+        for (uint16_t i = offset; i < length && i < offset + DUMP_BYTES_PER_LINE; i++) {
+            fmt_hex(&line, data[i], 2);
+        }
+        fmt_str(&line, "\r\n");
+        fmt_uart_write(&line);
+    }
+}
+
+// --- Public API ---
+
+void input_record_adc(uint8_t source, uint16_t value) {
+    InputEvent event = { 0, INPUT_EVT_ADC, source, value, 0, NULL };
+    record(&event);
+}
+
+void input_record_calibration_adc(uint16_t value) {
+    uint32_t now = systemTicks;
+    uint16_t change = (value > cal_value) ? value - cal_value : cal_value - value;
+    if (cal_recorded && change <= INPUT_RECORD_CAL_DEADBAND &&
+        now - cal_time_ms < INPUT_RECORD_CAL_HOLD_MS) {
+        return;
+    }
+    cal_value = value;
+    cal_time_ms = now;
+    cal_recorded = true;
+    input_record_adc(INPUT_ADC_CALIBRATION, value);
+}
+
+void input_record_sw0(bool pressed) {
+    if (pressed == sw0_level) {
+        return;
+    }
+    sw0_level = pressed;
+    InputEvent event = { 0, pressed ? INPUT_EVT_SW0_DOWN : INPUT_EVT_SW0_UP, 0, 0, 0, NULL };
+    record(&event);
+}
+
+void input_record_uart(const uint8_t *bytes, uint16_t length) {
+    while (length != 0) {
+        uint8_t chunk = (length > 255U) ? 255U : (uint8_t)length;
+        InputEvent event = { 0, INPUT_EVT_UART, 0, 0, chunk, bytes };
+        record(&event);
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+void input_record_dump(void) {
+    uint8_t current = record_buffer.current;
+    uint8_t older = current ^ 1U;
+    InputRecordStats stats;
+    char storage[32];
+    FmtBuffer line;
+
+    if (!writer_ready) {
+        writer_init();
+    }
+    input_record_get_stats(&stats);
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "INPUT BEGIN ");
+    fmt_u32(&line, stats.bytes, 0);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, stats.lost, 0);
+    fmt_str(&line, "\r\n");
+    fmt_uart_write(&line);
+    // Each block opens with a SYNC, so the two simply follow each other
+    dump_block(record_buffer.blocks[older], record_buffer.used[older]);
+    dump_block(record_buffer.blocks[current], record_buffer.used[current]);
+    fmt_uart_str("INPUT END\r\n");
+}
+
+void input_record_clear(void) {
+    memset(&record_buffer, 0, offsetof(InputRecordBuffer, blocks));
+    record_buffer.magic = INPUT_RECORD_MAGIC;
+    open_block(0);
+    writer_ready = true;
+    cal_recorded = false;
+}
+
+void input_record_get_stats(InputRecordStats *stats) {
+    stats->records = record_buffer.records;
+    stats->lost = record_buffer.lost;
+    stats->bytes = (uint32_t)record_buffer.used[0] + record_buffer.used[1];
+}
+
+#endif // INPUT_RECORD_ENABLED
@@ -0,0 +1,93 @@
+/**
+ * @file input_record.h
+ * @brief Records the firmware's inputs for replay on the host.
+ *
+ * Field problems such as calibration_process() staying in
+ * CALIBRATION_DRY_WAIT, or a moisture spike, depend on exactly what the
+ * board read and when. The recorder keeps those inputs as an input_log.h
+ * stream, stamped with systemTicks: every sensor scan result, the
+ * calibration and window-wake ADC readings, SW0 edges and every byte
+ * received on the console.
+ *
+ * The stream fills two blocks of INPUT_RECORD_BLOCK_SIZE bytes. When one
+ * is full, recording moves to the other and overwrites it, so the dump
+ * always holds the most recent one to two blocks. The blocks are in
+ * persistent RAM, like the trace. After a watchdog or brownout reset they
+ * still hold the inputs that led up to it; a RESET record marks the
+ * restart.
+ *
+ * Calibration reads the ADC on every pass of the main loop. Those readings
+ * are only recorded when they move by more than INPUT_RECORD_CAL_DEADBAND
+ * or every INPUT_RECORD_CAL_HOLD_MS; replay holds the last value between
+ * records. The pump current sense runs in the 1 ms interrupt and is not
+ * recorded.
+ *
+ * Dump with input_record_dump() (bound to INPUT_RECORD_DUMP_COMMAND in
+ * Check_Commands), then replay with tools/input_replay.c. All functions
+ * are for the main loop only.
+ */
+
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "input_log.h"
+
+#ifndef INPUT_RECORD_ENABLED
+#define INPUT_RECORD_ENABLED 1
+#endif
+
+#define INPUT_RECORD_BLOCK_SIZE    1024U   // Two blocks: 2 KB of RAM
+#define INPUT_RECORD_MAGIC         0x474C4E49 // "INLG", marks a valid retained buffer
+#define INPUT_RECORD_DUMP_COMMAND  'R'     // UART command character for input_record_dump()
+#define INPUT_RECORD_CAL_DEADBAND  8U      // ADC counts
+#define INPUT_RECORD_CAL_HOLD_MS   1000U
+
+typedef struct {
+    uint32_t records;            // Records written since the buffer was cleared
+    uint32_t lost;               // Records in overwritten blocks
+    uint32_t bytes;              // Stream bytes currently held
+} InputRecordStats;
+
+#if INPUT_RECORD_ENABLED
+
+void input_record_adc(uint8_t source, uint16_t value);
+
+/**
+ * @brief A calibration reading, subject to the deadband.
+ */
+void input_record_calibration_adc(uint16_t value);
+
+/**
+ * @brief The SW0 level as the firmware read it; only changes are recorded.
+ */
+void input_record_sw0(bool pressed);
+
+void input_record_uart(const uint8_t *bytes, uint16_t length);
+
+/**
+ * @brief Writes the stream, oldest block first, to the UART.
+ * Output is line based: "INPUT BEGIN <bytes> <lost>", up to 32 hex-encoded
+ * stream bytes per line, then "INPUT END".
+ */
+void input_record_dump(void);
+
+void input_record_clear(void);
+void input_record_get_stats(InputRecordStats *stats);
+
+#else
+
+#include <string.h>
+
+#define input_record_adc(source, value)          ((void)0)
+#define input_record_calibration_adc(value)      ((void)0)
+#define input_record_sw0(pressed)                ((void)0)
+#define input_record_uart(bytes, length)         ((void)0)
+#define input_record_dump()                      ((void)0)
+#define input_record_clear()                     ((void)0)
+#define input_record_get_stats(stats)            memset((stats), 0, sizeof(InputRecordStats))
+
+#endif // INPUT_RECORD_ENABLED
+
+#endif // INPUT_RECORD_H
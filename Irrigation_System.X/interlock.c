@@ -0,0 +1,130 @@
+/**
+ * @file interlock.c
+ * @brief Pump on-time, volume, dry-run and leak interlocks.
+ */
+
+#include "interlock.h"
+#include "ramfunc.h"
+
+#define NL_PER_ML  1000000UL
+
+static uint32_t ml_to_nl(uint32_t ml) {
+    return (ml < UINT32_MAX / NL_PER_ML) ? ml * NL_PER_ML : UINT32_MAX;
+}
+
+RAMFUNC static InterlockTrip trip(Interlock *interlock, InterlockTrip reason) {
+    interlock->trip = reason;
+    interlock->running = false;
+    return reason;
+}
+
+void interlock_init(Interlock *interlock, const InterlockZoneLimits *limits,
+                    uint8_t zone_count, const InterlockConfig *config) {
+    interlock->limits = limits;
+    interlock->zone_count = zone_count;
+    interlock->config = config;
+    interlock->running = false;
+    interlock->zone = 0;
+    interlock->flow_nl_per_ms = 0;
+    interlock->on_ms = 0;
+    interlock->volume_nl = 0;
+    interlock->max_volume_nl = 0;
+    interlock->leak_volume_nl = 0;
+    interlock->low_since_ms = UINT32_MAX;
+    interlock->moisture_start = 0;
+    interlock->moisture_start_valid = false;
+    interlock->leak_marked = false;
+    interlock->leak_done = false;
+    interlock->leak_mark_readings = 0;
+    interlock->moisture_latest = 0;
+    interlock->readings = 0;
+    interlock->trip = INTERLOCK_OK;
+}
+
+bool interlock_start(Interlock *interlock, uint8_t zone, uint32_t flow_nl_per_ms,
+                     uint32_t on_ms, uint32_t volume_nl) {
+    if (interlock->trip != INTERLOCK_OK) {
+        return false;
+    }
+    interlock->zone = (zone < interlock->zone_count) ? zone : 0;
+    interlock->flow_nl_per_ms = flow_nl_per_ms;
+    interlock->on_ms = on_ms;
+    interlock->volume_nl = volume_nl;
+    // Thresholds in nanolitres, so the tick does not divide
+    interlock->max_volume_nl = ml_to_nl(interlock->limits[interlock->zone].max_volume_ml);
+    interlock->leak_volume_nl = ml_to_nl(interlock->config->leak_volume_ml);
+    interlock->low_since_ms = UINT32_MAX;
+    // Baseline for the leak check: the last reading before the run
+    interlock->moisture_start = interlock->moisture_latest;
+    interlock->moisture_start_valid = interlock->readings != 0;
+    interlock->leak_marked = false;
+    interlock->leak_done = false;
+    interlock->running = true;
+    return true;
+}
+
+void interlock_set_flow(Interlock *interlock, uint32_t flow_nl_per_ms) {
+    interlock->flow_nl_per_ms = flow_nl_per_ms;
+}
+
+void interlock_stop(Interlock *interlock) {
+    interlock->running = false;
+}
+
+void interlock_report_moisture(Interlock *interlock, uint8_t percent) {
+    interlock->moisture_latest = percent;
+    interlock->readings++;
+}
+
+RAMFUNC InterlockTrip interlock_tick(Interlock *interlock, uint16_t current_raw) {
+    if (!interlock->running) {
+        return interlock->trip;
+    }
+    const InterlockZoneLimits *limits = &interlock->limits[interlock->zone];
+    const InterlockConfig *config = interlock->config;
+
+    interlock->on_ms++;
+    uint32_t volume = interlock->volume_nl + interlock->flow_nl_per_ms;
+    interlock->volume_nl = (volume >= interlock->volume_nl) ? volume : UINT32_MAX;
+
+    if (interlock->on_ms >= limits->max_on_ms) {
+        return trip(interlock, INTERLOCK_TRIP_ON_TIME);
+    }
+    if (interlock->volume_nl >= interlock->max_volume_nl) {
+        return trip(interlock, INTERLOCK_TRIP_VOLUME);
+    }
+
+    // Dry run: every sample since the first low one was low too. Ticks
+    // without a sample neither confirm nor clear it.
+    if (current_raw != INTERLOCK_NO_CURRENT && interlock->on_ms > config->spin_up_ms) {
+        if (current_raw >= config->dry_current_raw) {
+            interlock->low_since_ms = UINT32_MAX;
+        } else if (interlock->low_since_ms == UINT32_MAX) {
+            interlock->low_since_ms = interlock->on_ms;
+        }
+    }
+    if (interlock->low_since_ms != UINT32_MAX &&
+        interlock->on_ms - interlock->low_since_ms >= config->dry_run_ms) {
+        return trip(interlock, INTERLOCK_TRIP_DRY_RUN);
+    }
+
+    // Leak: judged on the first reading taken after leak_volume_ml
+    if (interlock->moisture_start_valid && !interlock->leak_done &&
+        interlock->volume_nl >= interlock->leak_volume_nl) {
+        uint32_t readings = interlock->readings;
+        if (!interlock->leak_marked) {
+            interlock->leak_marked = true;
+            interlock->leak_mark_readings = readings;
+        } else if (readings != interlock->leak_mark_readings) {
+            if (interlock->moisture_latest < interlock->moisture_start + config->leak_min_rise) {
+                return trip(interlock, INTERLOCK_TRIP_LEAK);
+            }
+            interlock->leak_done = true;
+        }
+    }
+    return INTERLOCK_OK;
+}
+
+void interlock_clear(Interlock *interlock) {
+    interlock->trip = INTERLOCK_OK;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file interlock.h
+ * @brief Pump safety interlocks evaluated every millisecond.
+ *
+ * The interlock watches a pump run independently of the main loop and
+ * trips on the first of:
+ *  - on-time: the run has lasted the zone's max_on_ms;
+ *  - volume: the run has dispensed the zone's max_volume_ml;
+ *  - dry run: the pump current stayed below dry_current_raw for
+ *    dry_run_ms, after the spin-up time;
+ *  - leak: after leak_volume_ml, a moisture reading taken since then has
+ *    not risen by leak_min_rise over the reading at the start of the run.
+ *    The water is going somewhere other than the pot.
+ *
+ * interlock_tick() is called from the 1 ms timer interrupt, so a stuck
+ * main loop cannot keep the pump running. A trip is latched until
+ * interlock_clear(). The caller cuts the output from the same interrupt
+ * when the tick reports one.
+ *
+ * Volume is integrated from the flow rate of the current duty cycle, in
+ * nanolitres, so one run can count up to 4.2 L. The module has no
+ * hardware dependencies; pump_interlock.c binds it to the pump and
+ * tools/interlock_sim.c measures its trip latency.
+ */
+
+#ifndef INTERLOCK_H
+#define INTERLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INTERLOCK_NO_CURRENT  UINT16_MAX  // No current sample this tick
+
+typedef enum {
+    INTERLOCK_OK = 0,
+    INTERLOCK_TRIP_ON_TIME,
+    INTERLOCK_TRIP_VOLUME,
+    INTERLOCK_TRIP_DRY_RUN,
+    INTERLOCK_TRIP_LEAK,
+    INTERLOCK_TRIP_COUNT
+} InterlockTrip;
+
+typedef struct {
+    uint32_t max_on_ms;          // Longest single run
+    uint32_t max_volume_ml;      // Most water per run, up to 4000
+} InterlockZoneLimits;
+
+typedef struct {
+    uint16_t dry_current_raw;    // Current-sense reading of a pump moving water
+    uint32_t spin_up_ms;         // No current check right after starting
+    uint32_t dry_run_ms;         // Low current this long trips
+    uint32_t leak_volume_ml;     // Moisture must have moved after this much
+    uint8_t leak_min_rise;       // Percentage points
+} InterlockConfig;
+
+typedef struct {
+    const InterlockZoneLimits *limits;
+    uint8_t zone_count;
+    const InterlockConfig *config;
+    // Current run; the tick owns these while running is set
+    volatile bool running;
+    uint8_t zone;
+    uint32_t flow_nl_per_ms;
+    uint32_t on_ms;
+    uint32_t volume_nl;
+    uint32_t max_volume_nl;
+    uint32_t leak_volume_nl;
+    uint32_t low_since_ms;       // on_ms of the first low sample, or UINT32_MAX
+    // Leak check
+    uint8_t moisture_start;
+    bool moisture_start_valid;
+    bool leak_marked;            // leak_volume_ml reached
+    bool leak_done;              // Moisture rose; no further check this run
+    uint32_t leak_mark_readings;
+    // Written by the main loop
+    volatile uint8_t moisture_latest;
+    volatile uint32_t readings;  // Moisture readings reported so far
+    volatile InterlockTrip trip;
+} Interlock;
+
+/**
+ * @brief Sets up an idle, untripped interlock. @p limits has one entry per
+ * zone; the tables must outlive the interlock.
+ */
+void interlock_init(Interlock *interlock, const InterlockZoneLimits *limits,
+                    uint8_t zone_count, const InterlockConfig *config);
+
+/**
+ * @brief Starts watching a run of @p zone at @p flow_nl_per_ms.
+ *
+ * @p on_ms and @p volume_nl carry over what a run interrupted by a warm
+ * reset had already used. Does nothing while tripped. Call with the tick
+ * masked.
+ * @return false if tripped.
+ */
+bool interlock_start(Interlock *interlock, uint8_t zone, uint32_t flow_nl_per_ms,
+                     uint32_t on_ms, uint32_t volume_nl);
+
+/**
+ * @brief New flow rate for the running pump (duty cycle changed).
+ */
+void interlock_set_flow(Interlock *interlock, uint32_t flow_nl_per_ms);
+
+/**
+ * @brief The pump was switched off normally.
+ */
+void interlock_stop(Interlock *interlock);
+
+/**
+ * @brief Passes on a new moisture reading of the zone being watered.
+ */
+void interlock_report_moisture(Interlock *interlock, uint8_t percent);
+
+/**
+ * @brief One millisecond of a run. Interrupt context.
+ * @param current_raw Current-sense reading taken this tick, or
+ * INTERLOCK_NO_CURRENT.
+ * @return The latched trip, INTERLOCK_OK if none.
+ */
+InterlockTrip interlock_tick(Interlock *interlock, uint16_t current_raw);
+
+/**
+ * @brief Releases a latched trip so the pump may run again.
+ */
+void interlock_clear(Interlock *interlock);
+
+#endif // INTERLOCK_H
@@ -5,14 +5,9 @@
 #include "../Irrigation_System.X/moisture_sensor.h"
 #include "../Irrigation_System.X/moisture_calibration.h"
 #include "../Irrigation_System.X/LCD1602A.h"
-
-typedef enum {
-    STATE_IDLE,
-    STATE_INIT,
-    STATE_RUNNING,
-    STATE_ERROR,
-    STATE_STANDBY
-} State_t;
+#include "../Irrigation_System.X/runtime_config.h"
+#include "../Irrigation_System.X/ramfunc.h"
+#include "../Irrigation_System.X/app_state.h" // State_t
 // *****************************************************************************
 // *****************************************************************************
 // Section:Definitions
@@ -23,7 +18,7 @@ typedef enum {
 #define DEBOUNCE_TIME_MS    50         // Debounce time in milliseconds
 #define NUMADCMEASUREMENTSTOAVERAGE 16
 #define NUMLIGHTSENSORMEASUREMENTSTOBUFFER 20 
-#define MOISTURELEVELTHRESHOLD 2300
+#define MOISTURELEVELTHRESHOLD (runtime_config_get()->moisture_level_threshold) // Default 2300, see runtime_config.h
 #define ADC_VREF                (1650)   //1650 mV (1.65V)
 // *****************************************************************************
 // *****************************************************************************
@@ -50,4 +45,4 @@ void Check_Commands (void);
 void Clear_buffer(void);
 void execute_state_actions(void);
 void handle_button_press(void);
-void Interval1mS(TC_TIMER_STATUS status, uintptr_t context);
+RAMFUNC void Interval1mS(TC_TIMER_STATUS status, uintptr_t context); // 1 ms TC4 callback, runs from RAM
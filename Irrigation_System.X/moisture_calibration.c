@@ -1,41 +1,111 @@
 #include "moisture_calibration.h"
+#include "calibration_machine.h"
+#include "trace.h"
+#include "warm_state.h"
+#include "fmt.h"
+#include "crc32.h"
+#include "cycle_counter.h"
+#include "moisture_sensor.h"
+#include "input_record.h"
 #include "sam.h"
 #include "peripheral/port/plib_port.h"
 #include "definitions.h" // Or your specific NVM header
 #include <string.h> // For memory operations if needed
 
-// External function prototypes
-
-extern void ADC_ConversionStart(void);
-extern uint16_t ADC_ConversionResultGet(void);
+#define CALIBRATION_BENCHMARK_STRIDE  64
+#define CALIBRATION_BENCHMARK_SAMPLES ((MOISTURE_LUT_RAW_MAX + 1U) / CALIBRATION_BENCHMARK_STRIDE)
 
 // Global calibration context
 static CalibrationContext calibration_ctx;
-static bool calibration_complete = false;
+static CalibrationMachine calibration;
 
+// Raw-to-percent table compiled from calibration_ctx.curve
+static MoistureLut calibration_lut;
+static bool calibration_lut_ready = false;
 
 // Check if button is pressed (active low)
 static bool is_button_pressed(void) {
     // Adjust pin number as needed
-    return SW0_Get();
+    bool pressed = SW0_Get();
+    input_record_sw0(pressed);
+    return pressed;
+}
+
+// Send "<label><value>[<label2><value2>]<suffix>" over the UART
+static void print_values(const char *label, uint16_t value,
+                         const char *label2, uint16_t value2, const char *suffix) {
+    char storage[64];
+    FmtBuffer message;
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, label);
+    fmt_u32(&message, value, 0);
+    if (label2) {
+        fmt_str(&message, label2);
+        fmt_u32(&message, value2, 0);
+    }
+    fmt_str(&message, suffix);
+    fmt_uart_write(&message);
+}
+
+// Keep the active calibration values in the warm-reset retention block
+static void retain_calibration_values(void) {
+    WarmState *retained = warm_state_get();
+    retained->dry_calibration_value = calibration_ctx.dry_calibration_value;
+    retained->wet_calibration_value = calibration_ctx.wet_calibration_value;
+    retained->calibration_valid = 1;
+    warm_state_commit();
+}
+
+// Flash layout of the calibration record. The first three fields match
+// the original two-value record, so data saved by older firmware still
+// loads and falls back to a two-point curve.
+typedef struct {
+    uint16_t dry_value;
+    uint16_t wet_value;
+    uint32_t magic_number;
+    MoistureCurve curve;
+    uint32_t curve_crc;
+} CalibrationRecord;
+
+// Use the stored curve if it is intact and was built from the same end
+// points, otherwise derive the two-point curve from dry/wet
+static void select_calibration_curve(CalibrationContext *context, const CalibrationRecord *record) {
+    if (record->magic_number == CALIBRATION_MAGIC_NUMBER &&
+        record->dry_value == context->dry_calibration_value &&
+        record->wet_value == context->wet_calibration_value &&
+        record->curve_crc == crc32_update(CRC32_INITIAL, &record->curve, sizeof(record->curve)) &&
+        moisture_curve_is_valid(&record->curve)) {
+        context->curve = record->curve;
+    } else {
+        moisture_curve_two_point(&context->curve, context->dry_calibration_value,
+                                 context->wet_calibration_value);
+    }
+}
+
+// Rebuild the lookup table used by the sampling path
+static void compile_calibration_curve(void) {
+    if (!moisture_curve_is_valid(&calibration_ctx.curve)) {
+        moisture_curve_two_point(&calibration_ctx.curve, calibration_ctx.dry_calibration_value,
+                                 calibration_ctx.wet_calibration_value);
+    }
+    calibration_lut_ready = moisture_curve_compile(&calibration_ctx.curve, &calibration_lut);
 }
 
 // Function to save the relevant calibration data to flash
 bool save_calibration_data(const CalibrationContext *calibration_data) {
-    // We only want to save the dry and wet calibration values
-    // along with the magic number for validation.
-    struct {
-        uint16_t dry_value;
-        uint16_t wet_value;
-        uint32_t magic_number;
-    } data_to_save;  // a bit of a mystery, research more **
-    //alt route, make a buffer array of the page size and initialize at 0 and
-    //copy my values on buffer
-    //how would this change by using arrays instead of structs
+    // PageWrite always programs a full page, so stage the record in a
+    // zeroed page-sized buffer
+    uint32_t page[NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+    CalibrationRecord data_to_save;
 
+    memset(&data_to_save, 0, sizeof(data_to_save));
     data_to_save.dry_value = calibration_data->dry_calibration_value;
     data_to_save.wet_value = calibration_data->wet_calibration_value;
     data_to_save.magic_number = CALIBRATION_MAGIC_NUMBER;
+    data_to_save.curve = calibration_data->curve;
+    data_to_save.curve_crc = crc32_update(CRC32_INITIAL, &data_to_save.curve, sizeof(data_to_save.curve));
+    memset(page, 0, sizeof(page));
+    memcpy(page, &data_to_save, sizeof(data_to_save));
 
     // Wait for any ongoing NVM operations to complete
     while (NVMCTRL_IsBusy());
@@ -48,140 +118,135 @@ bool save_calibration_data(const CalibrationContext *calibration_data) {
     while (NVMCTRL_IsBusy());
 
     // Write the calibration data
-    NVMCTRL_PageWrite((uint32_t *)&data_to_save, CALIBRATION_FLASH_ADDRESS);
+    NVMCTRL_PageWrite(page, CALIBRATION_FLASH_ADDRESS);
     while (NVMCTRL_IsBusy());
 
     // Optionally, verify the write
-    struct {
-        uint16_t dry_value;
-        uint16_t wet_value;
-        uint32_t magic_number;
-    } verified_data;
-    memcpy(&verified_data, (const void *)CALIBRATION_FLASH_ADDRESS, sizeof(verified_data));
-
-    if (verified_data.magic_number == CALIBRATION_MAGIC_NUMBER &&
-        verified_data.dry_value == calibration_data->dry_calibration_value &&
-        verified_data.wet_value == calibration_data->wet_calibration_value) {
-        printf("Calibration data saved to flash.\r\n");
+    if (memcmp((const void *)CALIBRATION_FLASH_ADDRESS, &data_to_save, sizeof(data_to_save)) == 0) {
+        fmt_uart_str("Calibration data saved to flash.\r\n");
         return true;
     } else {
-        printf("Error saving calibration data to flash!\r\n");
+        fmt_uart_str("Error saving calibration data to flash!\r\n");
         return false;
     }
 }
-// Initialize calibration routine
-void calibration_init(void) {
-    // Initialize calibration context
-    calibration_ctx.current_state = CALIBRATION_DRY_WAIT;
-    calibration_ctx.dry_calibration_value = 0;
-    calibration_ctx.wet_calibration_value = 0;
-    calibration_ctx.calibration_attempts = 0;
-    calibration_complete = false;
-    current_button_state = BUTTON_RELEASED;
-    
-      // Attempt to load calibration data from flash
-    if (load_calibration_data(&calibration_ctx)) {
-        calibration_complete = true;
-        printf("Using loaded calibration values (Dry: %d, Wet: %d).\r\n",
-               calibration_ctx.dry_calibration_value, calibration_ctx.wet_calibration_value);
-        calibration_ctx.current_state = CALIBRATION_COMPLETE; // Optionally skip calibration
-    } else {
-        printf("Starting new calibration.\r\n");
+
+// --- Calibration state machine hardware ---
+
+static bool calibration_convert_start(void) {
+    return moisture_sensor_convert_start(0);
+}
+
+static bool calibration_convert_done(uint16_t *raw) {
+    if (!moisture_sensor_convert_done(raw)) {
+        return false;
     }
+    input_record_calibration_adc(*raw);
+    return true;
 }
 
-// Main calibration process
-bool calibration_process(void) {
-    // Get current ADC value
-    ADC_ConversionStart();
-    uint16_t current_adc_value = ADC_ConversionResultGet();
-    
-    // Button state management
-    bool button_currently_pressed = is_button_pressed();
-    
-    switch (calibration_ctx.current_state) {
+static void calibration_report_step(CalibrationState state, uint16_t value) {
+    switch (state) {
         case CALIBRATION_DRY_WAIT:
-            // Only print message once when entering this state
-            if (current_button_state == BUTTON_RELEASED) {
-                printf("Place sensor in DRY condition and press button\r\n");
-                current_button_state = BUTTON_PRESSED;
-            }
-            if (button_currently_pressed && current_button_state == BUTTON_PRESSED) {
-                // Wait for button release
-                if (!is_button_pressed()) {
-                    // Small delay to debounce
-                    for(volatile int i = 0; i < 50000; i++) {}
-                    
-                    // Record dry calibration value
-                    calibration_ctx.dry_calibration_value = current_adc_value;
-                    calibration_ctx.current_state = CALIBRATION_WET_WAIT;
-                    current_button_state = BUTTON_RELEASED;
-                    
-                    // Send confirmation
-                    printf("Dry calibration recorded: %d\r\n", calibration_ctx.dry_calibration_value);
-                }
-            }
+            fmt_uart_str("Place sensor in DRY condition and press button\r\n");
+            break;
+        case CALIBRATION_DRY_RECORD:
+            print_values("Dry calibration recorded: ", value, NULL, 0, "\r\n");
             break;
-        
         case CALIBRATION_WET_WAIT:
-             // Only print message once when entering this state
-            if (current_button_state == BUTTON_RELEASED) {
-                printf("Place sensor in WET condition and press button\r\n");
-                current_button_state = BUTTON_PRESSED;
-            }
-            
-            // Wait for button press and release
-            if (button_currently_pressed && current_button_state == BUTTON_PRESSED) {
-                // Wait for button release
-                if (!is_button_pressed()) {
-                    // Small delay to debounce
-                    for(volatile int i = 0; i < 50000; i++) {}
-                    
-                    // Record wet calibration value
-                    calibration_ctx.wet_calibration_value = current_adc_value;
-                    calibration_ctx.current_state = CALIBRATION_COMPLETE;
-                    current_button_state = BUTTON_RELEASED;
-                    
-                    // Send confirmation
-                    printf("Wet calibration recorded: %d\r\n", calibration_ctx.wet_calibration_value);
-                }
-            }
+            fmt_uart_str("Place sensor in WET condition and press button\r\n");
+            break;
+        case CALIBRATION_WET_RECORD:
+            print_values("Wet calibration recorded: ", value, NULL, 0, "\r\n");
             break;
-        
         case CALIBRATION_COMPLETE:
-             // Validate calibration values
-            if (calibration_ctx.wet_calibration_value < calibration_ctx.dry_calibration_value) {
-                printf("Calibration successful!\r\n");
-                printf("Dry value: %d, Wet value: %d\r\n", 
-                       calibration_ctx.dry_calibration_value, 
-                       calibration_ctx.wet_calibration_value);
-                calibration_complete = true;
-                
-                // Save the calibration data to flash
-                save_calibration_data(&calibration_ctx);
-                
-                return true;
-            } else {
-                // Invalid calibration
-                printf("Calibration failed. Retry.\r\n");
-                calibration_ctx.current_state = CALIBRATION_DRY_WAIT;
-                calibration_complete = false;
-                current_button_state = BUTTON_RELEASED;
+            if (!value) {
+                fmt_uart_str("Calibration failed. Retry.\r\n");
+                break;
             }
+            fmt_uart_str("Calibration successful!\r\n");
+            print_values("Dry value: ", calibration_ctx.dry_calibration_value,
+                         ", Wet value: ", calibration_ctx.wet_calibration_value, "\r\n");
+
+            // New end points invalidate any intermediate points
+            moisture_curve_two_point(&calibration_ctx.curve,
+                                     calibration_ctx.dry_calibration_value,
+                                     calibration_ctx.wet_calibration_value);
+            compile_calibration_curve();
+
+            // Save the calibration data to flash
+            save_calibration_data(&calibration_ctx);
+            retain_calibration_values();
             break;
-        
         default:
-            calibration_ctx.current_state = CALIBRATION_DRY_WAIT;            
-            current_button_state = BUTTON_RELEASED;
             break;
     }
-    
-    return false;
+}
+
+static const CalibrationHardware calibration_hardware = {
+    calibration_convert_start,
+    calibration_convert_done,
+    is_button_pressed,
+    moisture_sensor_hold_power,
+    calibration_report_step,
+};
+
+// Load calibration values from retained RAM or flash without UART output
+bool calibration_load(void) {
+    // Initialize calibration context
+    calibration_ctx.dry_calibration_value = 0;
+    calibration_ctx.wet_calibration_value = 0;
+    calibration_ctx.calibration_attempts = 0;
+    calibration_lut_ready = false;
+    bool loaded = false;
+
+    // After a warm reset the retained values are already validated by CRC,
+    // so skip the flash read
+    if (warm_state_is_warm() && warm_state_get()->calibration_valid) {
+        calibration_ctx.dry_calibration_value = warm_state_get()->dry_calibration_value;
+        calibration_ctx.wet_calibration_value = warm_state_get()->wet_calibration_value;
+        loaded = true;
+        select_calibration_curve(&calibration_ctx, (const CalibrationRecord *)CALIBRATION_FLASH_ADDRESS);
+        compile_calibration_curve();
+    } else if (load_calibration_data(&calibration_ctx)) {
+        // Attempt to load calibration data from flash
+        loaded = true; // Optionally skip calibration
+        compile_calibration_curve();
+        retain_calibration_values();
+    }
+
+    calibration_machine_init(&calibration, &calibration_hardware, &calibration_ctx, loaded, systemTicks);
+    return loaded;
+}
+
+// Print which calibration values are in use
+void calibration_report(void) {
+    if (calibration.complete) {
+        print_values("Using loaded calibration values (Dry: ", calibration_ctx.dry_calibration_value,
+                     ", Wet: ", calibration_ctx.wet_calibration_value, ").\r\n");
+    } else {
+        fmt_uart_str("No valid calibration data found in flash.\r\n");
+        fmt_uart_str("Starting new calibration.\r\n");
+    }
+}
+
+// Initialize calibration routine
+void calibration_init(void) {
+    // A warm boot resumes silently with the retained values
+    if (calibration_load() && warm_state_is_warm()) {
+        return;
+    }
+    calibration_report();
+}
+
+// Main calibration process: one state step per call
+bool calibration_process(void) {
+    return calibration_machine_run(&calibration, systemTicks);
 }
 
 // Get calibration status
 bool get_calibration_status(void) {
-    return calibration_complete;
+    return calibration.complete;
 }
 
 // Retrieve calibration values
@@ -192,20 +257,68 @@ void get_calibration_values(uint16_t* dry_value, uint16_t* wet_value) {
 
 // Function to load the calibration data from flash into the CalibrationContext
 bool load_calibration_data(CalibrationContext *calibration_data) {
-    struct {
-        uint16_t dry_value;
-        uint16_t wet_value;
-        uint32_t magic_number;
-    } loaded_data;
+    CalibrationRecord loaded_data;
     memcpy(&loaded_data, (const void *)CALIBRATION_FLASH_ADDRESS, sizeof(loaded_data));
 
     if (loaded_data.magic_number == CALIBRATION_MAGIC_NUMBER) {
         calibration_data->dry_calibration_value = loaded_data.dry_value;
         calibration_data->wet_calibration_value = loaded_data.wet_value;
-        printf("Calibration data loaded from flash.\r\n");
+        select_calibration_curve(calibration_data, &loaded_data);
         return true;
     } else {
-        printf("No valid calibration data found in flash.\r\n");
         return false;
     }
-}
\ No newline at end of file
+}
+
+bool calibration_add_point(uint8_t percent) {
+    if (!calibration.complete) {
+        return false;
+    }
+    // Latest scan result; the sensor is powered only while scanning
+    uint16_t raw = moisture_sensor_scan_result(0);
+
+    MoistureCurve curve = calibration_ctx.curve;
+    if (!moisture_curve_set_point(&curve, raw, percent) ||
+        !moisture_curve_is_valid(&curve)) {
+        return false;
+    }
+    calibration_ctx.curve = curve;
+    compile_calibration_curve();
+    TRACE(TRACE_EVT_CALIBRATION, CALIBRATION_COMPLETE, raw);
+    print_values("Calibration point recorded: ", raw,
+                 " = ", percent, "%\r\n");
+    return save_calibration_data(&calibration_ctx);
+}
+
+const MoistureLut *calibration_get_lut(void) {
+    return calibration_lut_ready ? &calibration_lut : NULL;
+}
+
+void calibration_benchmark(CalibrationBenchmark *result) {
+    const MoistureCurve *curve = &calibration_ctx.curve;
+    MoistureLut lut;
+    volatile uint8_t sink;
+
+    // Benchmark the active curve, or a typical capacitive sensor before calibration
+    MoistureCurve default_curve;
+    if (!moisture_curve_is_valid(curve)) {
+        moisture_curve_two_point(&default_curve, 3000, 1500);
+        curve = &default_curve;
+    }
+    moisture_curve_compile(curve, &lut);
+    result->max_error_percent = moisture_lut_max_error(curve, &lut);
+
+    // Time a sweep across the ADC range, short enough to fit one SysTick period
+    uint32_t start = cycle_counter_now();
+    for (uint16_t raw = 0; raw <= MOISTURE_LUT_RAW_MAX; raw += CALIBRATION_BENCHMARK_STRIDE) {
+        sink = moisture_lut_convert(&lut, raw);
+    }
+    result->cycles_lookup = cycle_counter_elapsed(start) / CALIBRATION_BENCHMARK_SAMPLES;
+
+    start = cycle_counter_now();
+    for (uint16_t raw = 0; raw <= MOISTURE_LUT_RAW_MAX; raw += CALIBRATION_BENCHMARK_STRIDE) {
+        sink = moisture_curve_evaluate(curve, raw);
+    }
+    result->cycles_exact = cycle_counter_elapsed(start) / CALIBRATION_BENCHMARK_SAMPLES;
+    (void)sink;
+}
@@ -3,11 +3,14 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "moisture_curve.h"
+#include "hsm.h"
 #define CALIBRATION_FLASH_ADDRESS ((uint32_t)0x00001000) // Replace with your actual address
 // Magic number for data validation (optional but recommended)
 #define CALIBRATION_MAGIC_NUMBER 0xCA11B8A7 // Changed magic number for distinction
 
-// Calibration States
+// Calibration States (hsm.h state ids). The *_RECORD states last while the
+// button is held; the reading is taken as it is released.
 typedef enum {
     CALIBRATION_IDLE,
     CALIBRATION_DRY_WAIT,
@@ -19,12 +22,19 @@ typedef enum {
 
 // Calibration Context Structure
 typedef struct {
-    CalibrationState current_state;
     uint16_t dry_calibration_value;
     uint16_t wet_calibration_value;
     uint8_t calibration_attempts;
+    MoistureCurve curve;              // Dry/wet end points plus any intermediate points
 } CalibrationContext;
 
+// Result of calibration_benchmark()
+typedef struct {
+    uint8_t max_error_percent;        // Table vs exact curve over all 4096 ADC values
+    uint32_t cycles_lookup;           // Per conversion, compiled table
+    uint32_t cycles_exact;            // Per conversion, exact curve with division
+} CalibrationBenchmark;
+
 // Button state tracking
 typedef enum {
     BUTTON_RELEASED,
@@ -32,12 +42,25 @@ typedef enum {
     BUTTON_HANDLED
 } ButtonState;
 
-static ButtonState current_button_state = BUTTON_RELEASED;
-
 // Function Prototypes
 void calibration_init(void);
+bool calibration_load(void);
+void calibration_report(void);
 bool calibration_process(void);
 bool get_calibration_status(void);
 void get_calibration_values(uint16_t* dry_value, uint16_t* wet_value);
+bool save_calibration_data(const CalibrationContext *calibration_data);
+bool load_calibration_data(CalibrationContext *calibration_data);
+
+// Records the current ADC reading as a reference point (e.g. from a weighed
+// soil sample) at the given moisture percent, recompiles the lookup table
+// and saves the curve. Requires a completed dry/wet calibration.
+bool calibration_add_point(uint8_t percent);
+
+// Compiled raw-to-percent table, or NULL until calibration values exist
+const MoistureLut *calibration_get_lut(void);
+
+// Compares the table against the exact curve; blocks for a few milliseconds
+void calibration_benchmark(CalibrationBenchmark *result);
 
 #endif // MOISTURE_CALIBRATION_H
\ No newline at end of file
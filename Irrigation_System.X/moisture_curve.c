@@ -0,0 +1,124 @@
+/**
+ * @file moisture_curve.c
+ * @brief Piecewise-linear calibration curves and their lookup-table compiler.
+ */
+
+#include "moisture_curve.h"
+#include <string.h>
+
+// Points are kept sorted by ascending raw value so evaluation can walk
+// them in order
+
+// Signed division rounded to nearest; den must be positive
+static int32_t divide_rounded(int32_t num, int32_t den) {
+    return (num >= 0) ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+// Curve value at raw in percent << MOISTURE_LUT_FRACTION
+static int32_t curve_value_q8(const MoistureCurve *curve, uint32_t raw) {
+    const MoistureCurvePoint *points = curve->points;
+    uint8_t last = curve->count - 1U;
+
+    if (raw <= points[0].raw) {
+        return (int32_t)points[0].percent << MOISTURE_LUT_FRACTION;
+    }
+    if (raw >= points[last].raw) {
+        return (int32_t)points[last].percent << MOISTURE_LUT_FRACTION;
+    }
+
+    uint8_t i = 0;
+    while (raw > points[i + 1].raw) {
+        i++;
+    }
+    // Signed arithmetic throughout: the percent falls with raw on a
+    // capacitive sensor and rises on a resistive one
+    int32_t span_raw = (int32_t)points[i + 1].raw - (int32_t)points[i].raw;
+    int32_t span_percent = (int32_t)points[i + 1].percent - (int32_t)points[i].percent;
+    int32_t offset = (int32_t)raw - (int32_t)points[i].raw;
+    return ((int32_t)points[i].percent << MOISTURE_LUT_FRACTION)
+           + divide_rounded((span_percent << MOISTURE_LUT_FRACTION) * offset, span_raw);
+}
+
+void moisture_curve_two_point(MoistureCurve *curve, uint16_t dry_raw, uint16_t wet_raw) {
+    memset(curve, 0, sizeof(*curve));
+    moisture_curve_set_point(curve, dry_raw, 0);
+    moisture_curve_set_point(curve, wet_raw, 100);
+}
+
+bool moisture_curve_set_point(MoistureCurve *curve, uint16_t raw, uint8_t percent) {
+    if (percent > 100) {
+        return false;
+    }
+
+    // Drop the point this one replaces, if any
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < curve->count; i++) {
+        if (curve->points[i].percent != percent) {
+            curve->points[count++] = curve->points[i];
+        }
+    }
+    if (count >= MOISTURE_CURVE_MAX_POINTS) {
+        return false;
+    }
+
+    // Insertion into the sorted list; a point with an equal raw value is replaced
+    uint8_t slot = 0;
+    while (slot < count && curve->points[slot].raw < raw) {
+        slot++;
+    }
+    if (slot < count && curve->points[slot].raw == raw) {
+        curve->points[slot].percent = percent;
+    } else {
+        memmove(&curve->points[slot + 1], &curve->points[slot],
+                (size_t)(count - slot) * sizeof(curve->points[0]));
+        curve->points[slot].raw = raw;
+        curve->points[slot].percent = percent;
+        curve->points[slot].reserved = 0;
+        count++;
+    }
+    curve->count = count;
+    return true;
+}
+
+bool moisture_curve_is_valid(const MoistureCurve *curve) {
+    if (curve->count < 2 || curve->count > MOISTURE_CURVE_MAX_POINTS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < curve->count; i++) {
+        if (curve->points[i].percent > 100 || curve->points[i].raw > MOISTURE_LUT_RAW_MAX) {
+            return false;
+        }
+        if (i > 0 && curve->points[i].raw <= curve->points[i - 1].raw) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t moisture_curve_evaluate(const MoistureCurve *curve, uint16_t raw) {
+    int32_t value = curve_value_q8(curve, raw);
+    return (uint8_t)((value + (1 << (MOISTURE_LUT_FRACTION - 1))) >> MOISTURE_LUT_FRACTION);
+}
+
+bool moisture_curve_compile(const MoistureCurve *curve, MoistureLut *lut) {
+    if (!moisture_curve_is_valid(curve)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < MOISTURE_LUT_KNOTS; i++) {
+        lut->knots[i] = (uint16_t)curve_value_q8(curve, i << MOISTURE_LUT_SHIFT);
+    }
+    return true;
+}
+
+uint8_t moisture_lut_max_error(const MoistureCurve *curve, const MoistureLut *lut) {
+    uint8_t max_error = 0;
+    for (uint16_t raw = 0; raw <= MOISTURE_LUT_RAW_MAX; raw++) {
+        uint8_t expected = moisture_curve_evaluate(curve, raw);
+        uint8_t actual = moisture_lut_convert(lut, raw);
+        uint8_t error = (actual > expected) ? actual - expected : expected - actual;
+        if (error > max_error) {
+            max_error = error;
+        }
+    }
+    return max_error;
+}
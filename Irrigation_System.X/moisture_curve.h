@@ -0,0 +1,95 @@
+/**
+ * @file moisture_curve.h
+ * @brief Multi-point moisture calibration curves and the compiled
+ * raw-to-percent lookup table used in the sampling path.
+ *
+ * A MoistureCurve holds up to MOISTURE_CURVE_MAX_POINTS measured
+ * (raw ADC, percent) pairs in any order, so both sensor polarities work:
+ * capacitive sensors read lower when wet, resistive ones read higher.
+ * Between points the curve is piecewise linear; outside the measured range
+ * it holds the value of the nearest end point.
+ *
+ * moisture_curve_compile() evaluates the curve once, at calibration time,
+ * at every MOISTURE_LUT_STEP ADC counts. moisture_lut_convert() then needs
+ * one table read and a two-knot blend with a shift, and no division.
+ */
+
+#ifndef MOISTURE_CURVE_H
+#define MOISTURE_CURVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOISTURE_CURVE_MAX_POINTS 8
+#define MOISTURE_LUT_RAW_MAX      4095U   // 12-bit ADC
+#define MOISTURE_LUT_SHIFT        5       // 32 ADC counts between knots
+#define MOISTURE_LUT_STEP         (1U << MOISTURE_LUT_SHIFT)
+#define MOISTURE_LUT_KNOTS        (((MOISTURE_LUT_RAW_MAX + 1U) >> MOISTURE_LUT_SHIFT) + 1U)
+#define MOISTURE_LUT_FRACTION     8       // Knots hold percent * 256
+
+typedef struct {
+    uint16_t raw;        // ADC reading
+    uint8_t percent;     // Reference moisture at that reading (0-100)
+    uint8_t reserved;
+} MoistureCurvePoint;
+
+// Stored in flash as part of the calibration record; keep the layout fixed
+typedef struct {
+    uint8_t count;
+    uint8_t reserved[3];
+    MoistureCurvePoint points[MOISTURE_CURVE_MAX_POINTS];
+} MoistureCurve;
+
+typedef struct {
+    uint16_t knots[MOISTURE_LUT_KNOTS];  // Percent << MOISTURE_LUT_FRACTION at raw = i * STEP
+} MoistureLut;
+
+/**
+ * @brief Sets @p curve to the classic two-point mapping: dry is 0 %, wet is 100 %.
+ */
+void moisture_curve_two_point(MoistureCurve *curve, uint16_t dry_raw, uint16_t wet_raw);
+
+/**
+ * @brief Adds a point, or moves the existing point with the same percent.
+ * @return false if the curve is full or percent is above 100.
+ */
+bool moisture_curve_set_point(MoistureCurve *curve, uint16_t raw, uint8_t percent);
+
+/**
+ * @brief Checks the point count, ranges and that no two points share a raw value.
+ */
+bool moisture_curve_is_valid(const MoistureCurve *curve);
+
+/**
+ * @brief Evaluates the curve exactly, with division. Reference for the table.
+ * @return Moisture percent rounded to the nearest integer.
+ */
+uint8_t moisture_curve_evaluate(const MoistureCurve *curve, uint16_t raw);
+
+/**
+ * @brief Compiles @p curve into @p lut.
+ * @return false, leaving @p lut untouched, if the curve is not valid.
+ */
+bool moisture_curve_compile(const MoistureCurve *curve, MoistureLut *lut);
+
+/**
+ * @brief Largest difference in percent between the table and the exact
+ * curve over every 12-bit ADC value.
+ */
+uint8_t moisture_lut_max_error(const MoistureCurve *curve, const MoistureLut *lut);
+
+/**
+ * @brief Converts a raw ADC reading to moisture percent using a compiled table.
+ */
+static inline uint8_t moisture_lut_convert(const MoistureLut *lut, uint16_t raw) {
+    if (raw > MOISTURE_LUT_RAW_MAX) {
+        raw = MOISTURE_LUT_RAW_MAX;
+    }
+    uint32_t index = raw >> MOISTURE_LUT_SHIFT;
+    uint32_t fraction = raw & (MOISTURE_LUT_STEP - 1U);
+    uint32_t blended = (lut->knots[index] * (MOISTURE_LUT_STEP - fraction)
+                        + lut->knots[index + 1] * fraction) >> MOISTURE_LUT_SHIFT;
+    return (uint8_t)((blended + (1U << (MOISTURE_LUT_FRACTION - 1))) >> MOISTURE_LUT_FRACTION);
+}
+
+#endif // MOISTURE_CURVE_H
@@ -1,114 +1,553 @@
 #include "moisture_sensor.h"
+#include "trace.h"
+#include "boot_monitor.h"
+#include "fmt.h"
+#include "moisture_calibration.h"
+#include "temperature_sensor.h"
+#include "LCD1602A.h" // current_plant_index
+#include "runtime_config.h"
+#include "sensor_scan.h"
+#include "adc_window.h"
+#include "Pump_control.h"
+#include "pump_interlock.h"
+#include "app_msg.h"
+#include "ramfunc.h"
+#include "input_record.h"
+#include "energy_monitor.h"
+#include "definitions.h"  // PORT and ADC plibs
+#include "sam.h"          // ADC window registers
 //#include "core_cm0plus.h"
-#include <stdio.h>
 
-// External Helper Function Prototypes 
-// (These should match the declarations in your driver files)
-extern void ADC_ConversionStart(void);
-extern bool ADC_ConversionStatusGet(void);
-extern uint16_t ADC_ConversionResultGet(void);
 //extern void uart_send_string(const char* str);
 //extern uint32_t get_system_time_ms(void);
 
+// Per-zone sensor supply pin and ADC input; adjust to the board wiring
+typedef struct {
+    PORT_PIN power_pin;
+    ADC_POSINPUT input;
+} MoistureZonePins;
+
+static const MoistureZonePins zone_pins[MOISTURE_ZONE_COUNT] = {
+    { PORT_PIN_PA06, ADC_POSINPUT_PIN5 },   // Zone 0: TL555 output on PA05 (AIN5)
+};
+
+static SensorScan sensor_scan;
+static bool sensor_scan_ready = false;
+static bool zone0_power_held = false;
+// Set while a sensor or calibration conversion is in flight or the window
+// monitor runs; the pump interlock samples its current sense only when it
+// is clear
+static volatile bool adc_in_use = false;
+
+static void zone_power(uint8_t zone, bool on) {
+    if (!on && zone == 0 && zone0_power_held) {
+        return;
+    }
+    PORT_PinWrite(zone_pins[zone].power_pin, on);
+}
+
+bool moisture_sensor_adc_claim(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    // The interlock tick only starts a conversion while adc_in_use is
+    // clear, so checking both with interrupts masked cannot race it
+    bool claimed = !adc_in_use && !pump_interlock_adc_busy();
+    if (claimed) {
+        adc_in_use = true;
+    }
+    __set_PRIMASK(primask);
+    return claimed;
+}
+
+bool moisture_sensor_convert_start(uint8_t zone) {
+    if (zone >= MOISTURE_ZONE_COUNT || !moisture_sensor_adc_claim()) {
+        return false;
+    }
+    ADC_ChannelSelect(zone_pins[zone].input, ADC_NEGINPUT_GND);
+    ADC_ConversionStart();
+    return true;
+}
+
+bool moisture_sensor_convert_done(uint16_t *raw) {
+    if (!ADC_ConversionStatusGet()) {
+        return false;
+    }
+    *raw = ADC_ConversionResultGet();
+    energy_monitor_count(ENERGY_ADC, ENERGY_ADC_CONVERSION_US);
+    adc_in_use = false;
+    return true;
+}
+
+// The scan's conversion waits in conversion_done() while the ADC is busy
+static uint8_t scan_zone;
+static bool scan_start_deferred = false;
+static uint16_t scan_raw;
+
+static void zone_start_conversion(uint8_t zone) {
+    scan_zone = zone;
+    scan_start_deferred = !moisture_sensor_convert_start(zone);
+}
+
+static bool zone_conversion_done(void) {
+    if (scan_start_deferred) {
+        scan_start_deferred = !moisture_sensor_convert_start(scan_zone);
+        return false;
+    }
+    return moisture_sensor_convert_done(&scan_raw);
+}
+
+static uint16_t zone_result(void) {
+    return scan_raw;
+}
+
+static const SensorScanHardware zone_hardware = {
+    zone_power,
+    zone_start_conversion,
+    zone_conversion_done,
+    zone_result,
+};
+
+static void moisture_sensor_scan_init(void) {
+    if (sensor_scan_ready) {
+        return;
+    }
+    for (uint8_t zone = 0; zone < MOISTURE_ZONE_COUNT; zone++) {
+        PORT_PinOutputEnable(zone_pins[zone].power_pin);
+    }
+    sensor_scan_init(&sensor_scan, &zone_hardware, MOISTURE_ZONE_COUNT);
+    sensor_scan_ready = true;
+}
+
+void moisture_sensor_scan_start(void) {
+    moisture_sensor_scan_init();
+    sensor_scan_start(&sensor_scan, systemTicks);
+}
+
+bool moisture_sensor_scan_poll(void) {
+    if (!sensor_scan_run(&sensor_scan, systemTicks)) {
+        return false;
+    }
+    for (uint8_t zone = 0; zone < MOISTURE_ZONE_COUNT; zone++) {
+        input_record_adc(INPUT_ADC_ZONE(zone), sensor_scan_result(&sensor_scan, zone));
+    }
+    return true;
+}
+
+uint16_t moisture_sensor_scan_result(uint8_t zone) {
+    return sensor_scan_result(&sensor_scan, zone);
+}
+
+const SensorScan *moisture_sensor_scan_stats(void) {
+    return &sensor_scan;
+}
+
+void moisture_sensor_hold_power(bool on) {
+    moisture_sensor_scan_init();
+    zone0_power_held = on;
+    PORT_PinWrite(zone_pins[0].power_pin, on);
+}
+
+bool moisture_sensor_adc_in_use(void) {
+    return adc_in_use;
+}
+
+
+// Counts the temperature compensation adds to the raw reading
+static int16_t moisture_sensor_raw_offset(const MoistureSensorContext* context) {
+    if (!context->temperature_valid) {
+        return 0;
+    }
+    // (counts/degC * 16) * (degC * 16) / 256 = counts
+    return (int16_t)((MOISTURE_TEMP_COEFF_X16 *
+                      (MOISTURE_TEMP_REFERENCE_X16 - (int32_t)context->temperature_x16)) >> 8);
+}
+
+// Raw reading corrected to the calibration reference temperature
+static uint16_t moisture_sensor_compensated_raw(const MoistureSensorContext* context) {
+    int32_t raw = (int32_t)context->moisture_raw_value + moisture_sensor_raw_offset(context);
+    if (raw < 0) raw = 0;
+    if (raw > MOISTURE_LUT_RAW_MAX) raw = MOISTURE_LUT_RAW_MAX;
+    return (uint16_t)raw;
+}
 
 // Calibration and Conversion Function
 void moisture_sensor_calibrate(MoistureSensorContext* context, 
                                 uint16_t dry_calibration_value, 
                                 uint16_t wet_calibration_value) {
-    // Convert raw ADC value to percentage
-    if (context->moisture_raw_value >= dry_calibration_value) {
-        context->moisture_percentage = 0;
-    } else if (context->moisture_raw_value <= wet_calibration_value) {
-        context->moisture_percentage = 100;
-    } else {
-        // Linear interpolation between dry and wet values
-        context->moisture_percentage = (
-            (context->moisture_raw_value - dry_calibration_value) * 100 / 
-            (wet_calibration_value - dry_calibration_value)
-        );
+    uint16_t raw = moisture_sensor_compensated_raw(context);
+
+    // Normal path: one lookup in the table compiled at calibration time
+    const MoistureLut *lut = calibration_get_lut();
+    if (lut) {
+        context->moisture_percentage = moisture_lut_convert(lut, raw);
+        return;
     }
+
+    // No table yet: exact two-point mapping, valid for either sensor polarity
+    MoistureCurve curve;
+    moisture_curve_two_point(&curve, dry_calibration_value, wet_calibration_value);
+    context->moisture_percentage = moisture_curve_is_valid(&curve)
+        ? moisture_curve_evaluate(&curve, raw)
+        : 0;
 }
 
 // Initialize the Moisture Sensor State Machine
+#if MOISTURE_WINDOW_ENABLED
+// --- ADC window monitoring (see adc_window.h) ---
+
+static volatile bool window_crossed = false;
+static volatile uint16_t window_result;   // Averaged result that left the band
+static uint8_t window_saved_avgctrl;
+static uint16_t window_saved_ctrlb;
+
+RAMFUNC void ADC_Handler(void) {
+    if (ADC->INTFLAG.reg & ADC_INTFLAG_WINMON) {
+        // One wake per arming; the main loop disarms and measures
+        ADC->INTENCLR.reg = ADC_INTENCLR_WINMON;
+        ADC->INTFLAG.reg = ADC_INTFLAG_WINMON;
+        window_result = ADC->RESULT.reg;
+        window_crossed = true;
+    }
+}
+
+static void adc_sync(void) {
+    while (ADC->STATUS.reg & ADC_STATUS_SYNCBUSY);
+}
+
+// Lets the ADC convert the zone back to back and compare every result with
+// the band of the plant's thresholds; the CPU is not involved until a
+// result falls outside
+static bool moisture_window_arm(MoistureSensorContext *context) {
+    const MoistureLut *lut = calibration_get_lut();
+    const ConfigPlant *plant = runtime_config_plant(current_plant_index);
+    uint8_t low = plant->moisture_low;
+    uint8_t high = plant->moisture_high;
+    uint16_t percent = context->moisture_percentage;
+    AdcWindow window;
+
+    if (percent <= low || percent >= high) {
+        context->window_margin = MOISTURE_WINDOW_HYSTERESIS;
+        return false;
+    }
+    // While watering the interlock needs the ADC for the pump current and
+    // regular readings for its leak check
+    if (pump_get_status()) {
+        return false;
+    }
+    if (percent < low + context->window_margin || percent > high - context->window_margin ||
+        lut == NULL ||
+        !adc_window_around(lut, context->moisture_raw_value, moisture_sensor_raw_offset(context),
+                           low, high, &window)) {
+        return false;
+    }
+    if (!moisture_sensor_adc_claim()) {
+        return false;
+    }
+    context->window_margin = 0;
+
+    moisture_sensor_hold_power(true);
+    ADC_ChannelSelect(zone_pins[context->zone].input, ADC_NEGINPUT_GND);
+
+    // Free-running, each result the hardware average of 16 samples scaled
+    // back to 12 bits, so single-sample noise does not wake the CPU
+    window_saved_avgctrl = ADC->AVGCTRL.reg;
+    window_saved_ctrlb = ADC->CTRLB.reg;
+    ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_16 | ADC_AVGCTRL_ADJRES(4);
+    ADC->CTRLB.reg = (window_saved_ctrlb & ADC_CTRLB_PRESCALER_Msk) |
+                     ADC_CTRLB_RESSEL_16BIT | ADC_CTRLB_FREERUN;
+    adc_sync();
+
+    // Mode 4 flags results outside WINLT < result < WINUT
+    ADC->WINLT.reg = (window.lower > 0) ? (uint16_t)(window.lower - 1U) : 0U;
+    adc_sync();
+    ADC->WINUT.reg = (uint16_t)(window.upper + 1U);
+    adc_sync();
+    ADC->WINCTRL.reg = ADC_WINCTRL_WINMODE_MODE4;
+    adc_sync();
+
+    window_crossed = false;
+    ADC->INTFLAG.reg = ADC_INTFLAG_WINMON | ADC_INTFLAG_RESRDY;
+    ADC->INTENSET.reg = ADC_INTENSET_WINMON;
+    NVIC_EnableIRQ(ADC_IRQn);
+    ADC->SWTRIG.reg = ADC_SWTRIG_START;
+    adc_sync();
+    // Converting back to back until disarmed
+    energy_monitor_level(ENERGY_ADC, ENERGY_LEVEL_FULL);
+    return true;
+}
+
+// Takes the result that left the band, if one did
+static bool moisture_window_crossed(uint16_t *raw) {
+    if (!window_crossed) {
+        return false;
+    }
+    *raw = window_result;
+    input_record_adc(INPUT_ADC_WINDOW, *raw);
+    return true;
+}
+
+// Returns the ADC to single conversions for the sensor scan
+static void moisture_window_disarm(void) {
+    ADC->INTENCLR.reg = ADC_INTENCLR_WINMON;
+    ADC->WINCTRL.reg = ADC_WINCTRL_WINMODE_DISABLE;
+    adc_sync();
+    ADC->CTRLB.reg = window_saved_ctrlb;
+    adc_sync();
+    ADC->AVGCTRL.reg = window_saved_avgctrl;
+    // Drop the free-running conversion still in progress
+    ADC->SWTRIG.reg = ADC_SWTRIG_FLUSH;
+    adc_sync();
+    energy_monitor_level(ENERGY_ADC, 0);
+    ADC->INTFLAG.reg = ADC_INTFLAG_WINMON | ADC_INTFLAG_RESRDY;
+    moisture_sensor_hold_power(false);
+    adc_in_use = false;
+}
+#else
+static bool moisture_window_arm(MoistureSensorContext *context) {
+    (void)context;
+    return false;
+}
+
+static bool moisture_window_crossed(uint16_t *raw) {
+    (void)raw;
+    return false;
+}
+
+static void moisture_window_disarm(void) {
+}
+#endif
+
+// Reading for the pump interlock, the bus master and the display. The
+// payload is written straight into the topic's slot
+static void moisture_sensor_publish(const MoistureSensorContext *context) {
+    MoistureMessage *reading = msgbus_claim(&app_msgbus, MSG_MOISTURE);
+
+    reading->zone = context->zone;
+    reading->percent = (uint8_t)context->moisture_percentage;
+    reading->plant_index = (uint8_t)current_plant_index;
+    reading->temperature_valid = context->temperature_valid;
+    reading->raw = context->moisture_raw_value;
+    reading->temperature_x16 = context->temperature_x16;
+    reading->input_voltage_mv = context->input_voltage_mv;
+    msgbus_commit(&app_msgbus, MSG_MOISTURE);
+}
+
+// Waiting states share the timeout back to IDLE
+#define MOISTURE_STATE_WAITING      (MOISTURE_STATE_MONITOR + 1)
+#define MOISTURE_STATE_COUNT        (MOISTURE_STATE_WAITING + 1)
+
+typedef enum {
+    MOISTURE_EVT_DONE,                // The state's work is finished
+    MOISTURE_EVT_ARMED,               // The ADC window took over monitoring
+    MOISTURE_EVT_CROSSED,             // A window crossing woke the CPU
+    MOISTURE_EVT_TIMEOUT,             // Time for the next full measurement
+    MOISTURE_EVT_COUNT
+} MoistureSensorEvent;
+
+static HsmEventId idle_poll(Hsm *fsm) {
+    (void)fsm;
+    // Transition to start measurement
+    return MOISTURE_EVT_DONE;
+}
+
+static HsmEventId init_measurement_poll(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+
+    // Power up, settle and convert every zone's sensor
+    moisture_sensor_scan_start();
+    // Bus traffic for the temperature runs from the SERCOM interrupt
+    // while the sensors settle
+    temperature_sensor_start_cycle(systemTicks);
+    context->measurement_start_time = systemTicks;
+    return MOISTURE_EVT_DONE;
+}
+
+static HsmEventId wait_conversion_poll(Hsm *fsm) {
+    (void)fsm;
+    // Check if the scan is complete
+    return moisture_sensor_scan_poll() ? MOISTURE_EVT_DONE : HSM_NONE;
+}
+
+static HsmEventId process_data_poll(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+
+    // Read this zone's moisture value from the scan
+    context->moisture_raw_value = moisture_sensor_scan_result(context->zone);
+    context->temperature_valid = temperature_sensor_get(systemTicks, &context->temperature_x16);
+    return MOISTURE_EVT_DONE;
+}
+
+// Runs on entry so a reading from the scan or the ADC window is converted
+// in the same pass that produced it
+static void convert_entry(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+
+    uint16_t dry_value, wet_value;
+
+    context->input_voltage_mv = context->moisture_raw_value * ADC_VREF / 4095U;
+
+    // Perform moisture percentage conversion 
+    get_calibration_values(&dry_value, &wet_value);
+    moisture_sensor_calibrate(context, dry_value, wet_value);
+    TRACE(TRACE_EVT_MOISTURE_READING,
+          context->moisture_percentage,
+          context->moisture_raw_value);
+    boot_monitor_mark(BOOT_MILESTONE_FIRST_CONTROL_ACTION);
+
+    // Next sample time from the drying trend of the selected plant,
+    // within the configured bounds
+    const ConfigBlock *config = runtime_config_get();
+    const ConfigPlant *plant = runtime_config_plant(current_plant_index);
+    context->sampler.config.min_interval_ms = config->sample_min_ms;
+    context->sampler.config.max_interval_ms = config->sample_max_ms;
+    // Readings taken while watering do not predict the drying that
+    // follows, so the trend starts again once the pump stops
+    bool pump_on = pump_get_status();
+    if (context->pump_was_on && !pump_on) {
+        adaptive_sampling_reset(&context->sampler);
+    }
+    context->pump_was_on = pump_on;
+    context->wait_timer_duration = adaptive_sampling_update(
+        &context->sampler, systemTicks, (uint8_t)context->moisture_percentage,
+        plant->moisture_low, plant->moisture_high);
+}
+
+static HsmEventId convert_poll(Hsm *fsm) {
+    (void)fsm;
+    return MOISTURE_EVT_DONE;
+}
+
+static HsmEventId send_uart_poll(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+    FmtBuffer message;
+
+    // Prepare and send UART message
+    fmt_init(&message, context->uart_message_buffer, UART_BUFFER_SIZE);
+    fmt_str(&message, "Moisture: ");
+    fmt_u32(&message, context->moisture_percentage, 0);
+    fmt_str(&message, "% (Raw: ");
+    fmt_u32(&message, context->moisture_raw_value, 0);
+    fmt_char(&message, ')');
+    if (context->temperature_valid) {
+        // 1/16 degC = 625/10000 degC, so this is exact to 4 decimals
+        fmt_str(&message, " Temp: ");
+        fmt_fixed(&message, (int32_t)context->temperature_x16 * 625, 4, 0);
+        fmt_str(&message, " C");
+    }
+    fmt_str(&message, "\r\n");
+    fmt_uart_write(&message);
+    moisture_sensor_publish(context);
+
+    // The input voltage is in mV, shown as volts with three decimals
+    fmt_init(&message, context->display_message_buffer, UART_BUFFER_SIZE);
+    fmt_str(&message, "ADC Count = 0x");
+    fmt_hex(&message, context->moisture_raw_value, 3);
+    fmt_str(&message, " \n Vadc = ");
+    fmt_fixed(&message, (int32_t)context->input_voltage_mv, 3, 0);
+    fmt_str(&message, " V ");
+    fmt_uart_write(&message);
+
+    // Inside the plant's band the ADC takes over until a crossing
+    return moisture_window_arm(context) ? MOISTURE_EVT_ARMED : MOISTURE_EVT_DONE;
+}
+
+static void waiting_entry(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+    context->measurement_start_time = systemTicks;
+}
+
+static HsmEventId wait_timer_poll(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+    uint32_t elapsed = systemTicks - context->measurement_start_time;
+
+    // Wait for specified duration before next measurement; while
+    // watering, sample at the fastest rate for the leak check
+    if (elapsed >= context->wait_timer_duration ||
+        (pump_get_status() && elapsed >= context->sampler.config.min_interval_ms)) {
+        return MOISTURE_EVT_TIMEOUT;
+    }
+    return HSM_NONE;
+}
+
+static HsmEventId monitor_poll(Hsm *fsm) {
+    MoistureSensorContext *context = fsm->context;
+
+    // A crossing is reported from the averaged result that tripped
+    // the window, with the temperature the window was set up for,
+    // so the reading agrees with the wake. A full measurement
+    // follows periodically to track the temperature compensation
+    // and refresh the bus report
+    if (moisture_window_crossed(&context->moisture_raw_value)) {
+        context->window_wakeups++;
+        return MOISTURE_EVT_CROSSED;
+    }
+    if (systemTicks - context->measurement_start_time >= MOISTURE_WINDOW_REFRESH_MS ||
+        pump_get_status()) {
+        context->window_refreshes++;
+        return MOISTURE_EVT_TIMEOUT;
+    }
+    return HSM_NONE;
+}
+
+static void monitor_exit(Hsm *fsm) {
+    (void)fsm;
+    moisture_window_disarm();
+}
+
+static const HsmState moisture_states[MOISTURE_STATE_COUNT] = {
+    //                                    parent                  initial                    entry          exit          poll
+    [MOISTURE_STATE_IDLE]             = { HSM_NONE,               HSM_NONE,                  NULL,          NULL,         idle_poll },
+    [MOISTURE_STATE_INIT_MEASUREMENT] = { HSM_NONE,               HSM_NONE,                  NULL,          NULL,         init_measurement_poll },
+    [MOISTURE_STATE_WAIT_CONVERSION]  = { HSM_NONE,               HSM_NONE,                  NULL,          NULL,         wait_conversion_poll },
+    [MOISTURE_STATE_PROCESS_DATA]     = { HSM_NONE,               HSM_NONE,                  NULL,          NULL,         process_data_poll },
+    [MOISTURE_STATE_CONVERT]          = { HSM_NONE,               HSM_NONE,                  convert_entry, NULL,         convert_poll },
+    [MOISTURE_STATE_SEND_UART]        = { HSM_NONE,               HSM_NONE,                  NULL,          NULL,         send_uart_poll },
+    [MOISTURE_STATE_WAIT_TIMER]       = { MOISTURE_STATE_WAITING, HSM_NONE,                  NULL,          NULL,         wait_timer_poll },
+    [MOISTURE_STATE_MONITOR]          = { MOISTURE_STATE_WAITING, HSM_NONE,                  NULL,          monitor_exit, monitor_poll },
+    [MOISTURE_STATE_WAITING]          = { HSM_NONE,               MOISTURE_STATE_WAIT_TIMER, waiting_entry, NULL,         NULL },
+};
+
+static const HsmStateId moisture_transitions[MOISTURE_STATE_COUNT][MOISTURE_EVT_COUNT] = {
+    [MOISTURE_STATE_IDLE]             = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_INIT_MEASUREMENT) },
+    [MOISTURE_STATE_INIT_MEASUREMENT] = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_WAIT_CONVERSION) },
+    [MOISTURE_STATE_WAIT_CONVERSION]  = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_PROCESS_DATA) },
+    [MOISTURE_STATE_PROCESS_DATA]     = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_CONVERT) },
+    [MOISTURE_STATE_CONVERT]          = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_SEND_UART) },
+    [MOISTURE_STATE_SEND_UART]        = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_WAIT_TIMER),
+                                          [MOISTURE_EVT_ARMED] = HSM_TO(MOISTURE_STATE_MONITOR) },
+    [MOISTURE_STATE_MONITOR]          = { [MOISTURE_EVT_CROSSED] = HSM_TO(MOISTURE_STATE_CONVERT) },
+    [MOISTURE_STATE_WAITING]          = { [MOISTURE_EVT_TIMEOUT] = HSM_TO(MOISTURE_STATE_IDLE) },
+};
+
+static const HsmDefinition moisture_machine = {
+    moisture_states,
+    &moisture_transitions[0][0],
+    MOISTURE_STATE_COUNT,
+    MOISTURE_EVT_COUNT,
+    TRACE_FSM_MOISTURE,
+    TRACE_FSM_HOOK,
+};
+
 void moisture_sensor_state_machine_init(MoistureSensorContext* context) {
-    context->current_state = MOISTURE_STATE_IDLE;
+    context->zone = 0;
     context->moisture_raw_value = 0;
     context->moisture_percentage = 0;
     context->measurement_start_time = 0;
-    context->wait_timer_duration = 300; // Default 30 seconds between measurements
+    context->input_voltage_mv = 0;
+    adaptive_sampling_init(&context->sampler, NULL);
+    context->pump_was_on = false;
+    context->wait_timer_duration = context->sampler.interval_ms;
     context->conversion_complete = false;
+    context->temperature_x16 = 0;
+    context->temperature_valid = false;
+    context->window_margin = 0;
+    context->window_wakeups = 0;
+    context->window_refreshes = 0;
+    hsm_init(&context->fsm, &moisture_machine, context);
+    hsm_transition(&context->fsm, MOISTURE_STATE_IDLE);
 }
 
-// Main State Machine Run Function
+// Main State Machine Run Function: one state step per call
 void moisture_sensor_state_machine_run(MoistureSensorContext* context) {
-    uint32_t current_time = systemTicks;
-    
-    switch (context->current_state) {
-        case MOISTURE_STATE_IDLE:
-            // Transition to start measurement
-            context->current_state = MOISTURE_STATE_INIT_MEASUREMENT;
-            break;
-
-        case MOISTURE_STATE_INIT_MEASUREMENT:
-            // Start ADC conversion (SW trigger)
-            ADC_ConversionStart();
-            context->measurement_start_time = current_time;
-            context->current_state = MOISTURE_STATE_WAIT_CONVERSION;
-            break;
-
-        case MOISTURE_STATE_WAIT_CONVERSION:
-            // Check if conversion is complete
-            if (ADC_ConversionStatusGet()) {
-                context->current_state = MOISTURE_STATE_PROCESS_DATA;
-            }
-            break;
-
-        case MOISTURE_STATE_PROCESS_DATA:
-            // Read moisture value from ADC
-            context->moisture_raw_value = ADC_ConversionResultGet();
-            input_voltage = context->moisture_raw_value * ADC_VREF / 4095U;
-            
-            // Perform moisture percentage conversion 
-            // Note: You'll need to provide calibration values specific to your sensor
-            moisture_sensor_calibrate(context, 
-                                      dry_calibration_value,   // dry_calibration_value 
-                                      wet_calibration_value); // wet_calibration_value
-
-            context->current_state = MOISTURE_STATE_SEND_UART;
-            break;
-
-        case MOISTURE_STATE_SEND_UART:
-            // Prepare and send UART message
-            snprintf(context->uart_message_buffer, 
-                     UART_BUFFER_SIZE, 
-                     "Moisture: %d%% (Raw: %d)\r\n", 
-                     context->moisture_percentage,
-                     context->moisture_raw_value);
-            
-            
-            printf(context->uart_message_buffer);
-            snprintf(context->display_message_buffer,
-                    UART_BUFFER_SIZE,
-                    "ADC Count = 0x%x \n Vadc = %d.%03d V ",
-                    context->moisture_raw_value,
-                    (int)(input_voltage/1000),
-                    (int)(input_voltage%1000));
-            printf(context->display_message_buffer,
-                    UART_BUFFER_SIZE,
-                    "ADC Count = 0x%x \n Vadc = %d.%03d V ",
-                    context->moisture_raw_value,
-                    (int)(input_voltage/1000),
-                    (int)(input_voltage%1000));
-            
-            context->measurement_start_time = current_time;
-            context->current_state = MOISTURE_STATE_WAIT_TIMER;
-            break;
-
-        case MOISTURE_STATE_WAIT_TIMER:
-            // Wait for specified duration before next measurement
-            if (current_time - context->measurement_start_time >= context->wait_timer_duration) {
-                context->current_state = MOISTURE_STATE_IDLE;
-            }
-            break;
-    }
-}
\ No newline at end of file
+    hsm_run(&context->fsm);
+}
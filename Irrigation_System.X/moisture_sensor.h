@@ -3,35 +3,67 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "adaptive_sampling.h"
+#include "sensor_scan.h"
+#include "hsm.h"
 
 // Moisture Sensor Configuration
 #define MOISTURE_ADC_RESOLUTION    (4096)  // 12-bit resolution
 #define UART_BUFFER_SIZE           (64)    // Buffer for UART message
 #define ADC_VREF                (1650)   //1650 mV (1.65V)
+#define MOISTURE_ZONE_COUNT        (1)     // Sensors scanned per measurement
+
+// Temperature compensation of the raw reading before calibration:
+// raw += coefficient * (reference - temperature). The coefficient is in raw
+// ADC counts per degC, scaled by 16; measure it per sensor type by logging
+// the raw value of a sealed soil sample across temperatures. 0 disables.
+#define MOISTURE_TEMP_REFERENCE_X16 (25 * 16) // 25 degC in 1/16 degC
+#define MOISTURE_TEMP_COEFF_X16     (0)
+
+// Between measurements in the plant's band, the ADC watches the sensor on
+// its own and wakes the CPU only when a reading leaves the band (see
+// adc_window.h). The ADC compares one input at a time, so this needs a
+// single zone.
+#ifndef MOISTURE_WINDOW_ENABLED
+#define MOISTURE_WINDOW_ENABLED     (MOISTURE_ZONE_COUNT == 1)
+#endif
+#define MOISTURE_WINDOW_REFRESH_MS  (1800000U) // Full measurement at least every 30 min
+// After a reading at or beyond a threshold, the window is armed again only
+// once a reading is this many percent inside the band; until then the
+// adaptive interval applies. Stops noise at a threshold from waking the
+// CPU on every conversion.
+#define MOISTURE_WINDOW_HYSTERESIS  (2)
 
 extern volatile uint32_t systemTicks;
-extern uint32_t input_voltage;
-extern uint16_t dry_calibration_value;
-extern uint16_t wet_calibration_value;
-extern bool calibration_completed;
-// Moisture Sensor State Machine States
+// Moisture Sensor State Machine States (hsm.h state ids)
 typedef enum {
     MOISTURE_STATE_IDLE,
     MOISTURE_STATE_INIT_MEASUREMENT,
     MOISTURE_STATE_WAIT_CONVERSION,
     MOISTURE_STATE_PROCESS_DATA,
+    MOISTURE_STATE_CONVERT,           // Raw value ready (scan or ADC window)
     MOISTURE_STATE_SEND_UART,
-    MOISTURE_STATE_WAIT_TIMER
+    MOISTURE_STATE_WAIT_TIMER,
+    MOISTURE_STATE_MONITOR            // ADC window armed, waiting for a crossing
 } MoistureSensorState;
 
 // Moisture Sensor Context Structure
 typedef struct {
-    MoistureSensorState current_state;
+    Hsm fsm;                          // State machine; the leaf is a MoistureSensorState
+    uint8_t zone;                     // Index into the sensor scan
     uint16_t moisture_raw_value;      // Raw 12-bit ADC value
     uint16_t moisture_percentage;     // Converted to percentage
+    uint32_t input_voltage_mv;        // Sensor output voltage
     uint32_t measurement_start_time;
-    uint32_t wait_timer_duration;     // Configurable measurement interval
+    uint32_t wait_timer_duration;     // Interval until the next measurement (ms)
     bool conversion_complete;
+    int16_t temperature_x16;          // Soil temperature, 1/16 degC
+    bool temperature_valid;           // temperature_x16 is recent
+    AdaptiveSampler sampler;          // Sets wait_timer_duration for this zone
+    bool pump_was_on;                 // Pump state at the previous reading
+    uint8_t window_margin;            // Current re-arm hysteresis, percent
+    uint32_t window_wakeups;          // Monitoring ended by a crossing
+    uint32_t window_refreshes;        // Monitoring ended by the refresh interval
     char *uart_message_buffer;
     char *display_message_buffer;
 } MoistureSensorContext;
@@ -39,6 +71,24 @@ typedef struct {
 // Function Prototypes
 void moisture_sensor_state_machine_init(MoistureSensorContext* context);
 void moisture_sensor_state_machine_run(MoistureSensorContext* context);
+// Power-gated sensor scan shared by all zones (see sensor_scan.h)
+void moisture_sensor_scan_start(void);
+bool moisture_sensor_scan_poll(void);      // true once every zone has a result
+uint16_t moisture_sensor_scan_result(uint8_t zone);
+const SensorScan *moisture_sensor_scan_stats(void);
+// Keeps zone 0 powered outside scans, e.g. while calibrating
+void moisture_sensor_hold_power(bool on);
+// The sensor code has the ADC: a conversion in flight or the window armed
+bool moisture_sensor_adc_in_use(void);
+// Takes the ADC for main-context use; false while it is in use or the pump
+// interlock's current-sense conversion is in flight
+bool moisture_sensor_adc_claim(void);
+// Claims the ADC, selects @p zone's input and starts one conversion;
+// false if the ADC is busy, so try again on a later poll
+bool moisture_sensor_convert_start(uint8_t zone);
+// Once the started conversion is done, stores it in @p raw and releases
+// the ADC
+bool moisture_sensor_convert_done(uint16_t *raw);
 void moisture_sensor_calibrate(MoistureSensorContext* context, 
                                 uint16_t dry_calibration_value, 
                                 uint16_t wet_calibration_value);
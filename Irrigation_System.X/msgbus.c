@@ -0,0 +1,92 @@
+/**
+ * @file msgbus.c
+ * @brief Publish, dispatch and accounting of the message bus.
+ */
+
+#include "msgbus.h"
+#include <stddef.h>
+#include <string.h>
+
+static uint8_t slot_of(const MsgbusTopic *topic, uint16_t sequence) {
+    return (uint8_t)(sequence & (topic->slot_count - 1U));
+}
+
+void *msgbus_claim(Msgbus *bus, MsgbusTopicId topic) {
+    MsgbusTopic *entry = &bus->topics[topic];
+    return (uint8_t *)entry->slots + (uint32_t)slot_of(entry, entry->sequence) * entry->payload_size;
+}
+
+void msgbus_commit(Msgbus *bus, MsgbusTopicId topic) {
+    MsgbusTopic *entry = &bus->topics[topic];
+    MsgbusMessage message;
+
+    message.topic = topic;
+    message.slot = slot_of(entry, entry->sequence);
+    message.sequence = entry->sequence;
+    message.stamp = bus->clock ? bus->clock() : 0U;
+    entry->sequence++;
+
+    for (uint8_t i = 0; i < bus->subscriber_count; i++) {
+        MsgbusSubscriber *subscriber = &bus->subscribers[i];
+        if (!(subscriber->topics & MSGBUS_TOPIC_BIT(topic))) {
+            continue;
+        }
+        uint8_t mask = (uint8_t)(subscriber->queue_size - 1U);
+        uint8_t next = (uint8_t)((subscriber->head + 1U) & mask);
+        if (next == subscriber->tail) {
+            // Full: give up the oldest message, so the newest is always delivered
+            subscriber->tail = (uint8_t)((subscriber->tail + 1U) & mask);
+            subscriber->stats.dropped++;
+        }
+        subscriber->queue[subscriber->head] = message;
+        subscriber->head = next;
+    }
+}
+
+bool msgbus_publish(Msgbus *bus, MsgbusTopicId topic, const void *payload, uint16_t size) {
+    if (topic >= bus->topic_count || size != bus->topics[topic].payload_size) {
+        return false;
+    }
+    memcpy(msgbus_claim(bus, topic), payload, size);
+    msgbus_commit(bus, topic);
+    return true;
+}
+
+const void *msgbus_latest(const Msgbus *bus, MsgbusTopicId topic) {
+    const MsgbusTopic *entry = &bus->topics[topic];
+    if (entry->sequence == 0) {
+        return NULL;
+    }
+    uint8_t slot = slot_of(entry, (uint16_t)(entry->sequence - 1U));
+    return (const uint8_t *)entry->slots + (uint32_t)slot * entry->payload_size;
+}
+
+void msgbus_dispatch(Msgbus *bus) {
+    for (uint8_t i = 0; i < bus->subscriber_count; i++) {
+        MsgbusSubscriber *subscriber = &bus->subscribers[i];
+
+        while (subscriber->tail != subscriber->head) {
+            const MsgbusMessage *message = &subscriber->queue[subscriber->tail];
+            const MsgbusTopic *entry = &bus->topics[message->topic];
+
+            if ((uint16_t)(entry->sequence - message->sequence) > entry->slot_count) {
+                subscriber->stats.overrun++;
+            } else {
+                uint32_t latency = bus->clock ? bus->clock() - message->stamp : 0U;
+                if (latency > subscriber->stats.latency_max) {
+                    subscriber->stats.latency_max = latency;
+                }
+                subscriber->stats.latency_total += latency;
+                subscriber->stats.handled++;
+                subscriber->handler(message, (const uint8_t *)entry->slots +
+                                             (uint32_t)message->slot * entry->payload_size);
+            }
+            subscriber->tail = (uint8_t)((subscriber->tail + 1U) & (subscriber->queue_size - 1U));
+        }
+    }
+}
+
+uint32_t msgbus_topic_bytes(const Msgbus *bus, MsgbusTopicId topic) {
+    const MsgbusTopic *entry = &bus->topics[topic];
+    return (uint32_t)entry->slot_count * entry->payload_size + sizeof(*entry);
+}
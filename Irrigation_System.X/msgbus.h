@@ -0,0 +1,120 @@
+/**
+ * @file msgbus.h
+ * @brief Static publish/subscribe message bus between modules.
+ *
+ * Topics and subscribers are statically allocated and listed at compile
+ * time; nothing is allocated at run time. Each topic owns a small ring of
+ * payload slots. Publishing writes the payload into the next slot once
+ * (or the publisher fills the slot in place with msgbus_claim()) and
+ * queues an 8-byte MsgbusMessage on every subscriber of the topic. The
+ * subscriber's handler later gets a pointer into the slot, so payloads
+ * are never copied per subscriber.
+ *
+ * A slot is reused after slot_count further publishes. A message whose
+ * slot was reused before its subscriber got to it is skipped and counted
+ * as an overrun; size the slots for the burst between two dispatches.
+ * A full subscriber queue drops its oldest message and counts it, so
+ * the newest message of a burst is always delivered.
+ *
+ * Publish and dispatch are for the main loop only. The module has no
+ * hardware dependencies; app_msg.c declares the firmware's topics and
+ * subscribers and tools/msgbus_bench.c measures it on the host.
+ */
+
+#ifndef MSGBUS_H
+#define MSGBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MSGBUS_MAX_TOPICS  32U
+#define MSGBUS_TOPIC_BIT(topic) (1UL << (topic))
+
+typedef uint8_t MsgbusTopicId;
+
+// What a subscriber queue holds
+typedef struct {
+    MsgbusTopicId topic;
+    uint8_t slot;                     // Payload slot in the topic's ring
+    uint16_t sequence;                // Topic's publish count, detects a reused slot
+    uint32_t stamp;                   // Bus clock at publish
+} MsgbusMessage;
+
+typedef void (*MsgbusHandler)(const MsgbusMessage *message, const void *payload);
+
+typedef struct {
+    void *slots;                      // slot_count payloads of payload_size bytes
+    uint16_t payload_size;
+    uint8_t slot_count;               // Must be a power of two
+    uint16_t sequence;                // Messages published
+} MsgbusTopic;
+
+typedef struct {
+    uint32_t handled;
+    uint16_t dropped;                 // Oldest message given up to a full queue
+    uint16_t overrun;                 // Payload slot reused before handling
+    uint32_t latency_max;             // Publish to handler, in bus clock units
+    uint32_t latency_total;           // Over the handled messages
+} MsgbusSubscriberStats;
+
+typedef struct {
+    MsgbusHandler handler;
+    uint32_t topics;                  // MSGBUS_TOPIC_BIT() of each topic taken
+    MsgbusMessage *queue;
+    uint8_t queue_size;               // Must be a power of two; holds one less
+    uint8_t head;
+    uint8_t tail;
+    MsgbusSubscriberStats stats;
+} MsgbusSubscriber;
+
+typedef struct {
+    MsgbusTopic *topics;
+    MsgbusSubscriber *subscribers;
+    uint8_t topic_count;
+    uint8_t subscriber_count;
+    uint32_t (*clock)(void);          // Stamps messages; may be NULL
+} Msgbus;
+
+// Static initializers, sized from the storage arrays
+#define MSGBUS_TOPIC_INIT(storage) \
+    { (storage), sizeof((storage)[0]), sizeof(storage) / sizeof((storage)[0]), 0 }
+#define MSGBUS_SUBSCRIBER_INIT(handler, topics, queue) \
+    { (handler), (topics), (queue), sizeof(queue) / sizeof((queue)[0]), 0, 0, { 0 } }
+
+/**
+ * @brief Slot the next message of @p topic will carry, for the publisher
+ * to fill in place. msgbus_commit() sends it.
+ */
+void *msgbus_claim(Msgbus *bus, MsgbusTopicId topic);
+
+/**
+ * @brief Queues the claimed slot on every subscriber of @p topic.
+ */
+void msgbus_commit(Msgbus *bus, MsgbusTopicId topic);
+
+/**
+ * @brief Copies @p payload into the next slot and commits it.
+ * @return false, publishing nothing, if @p size is not the topic's
+ * payload size.
+ */
+bool msgbus_publish(Msgbus *bus, MsgbusTopicId topic, const void *payload, uint16_t size);
+
+/**
+ * @brief Most recent payload of @p topic, or NULL before the first.
+ * Valid until slot_count further publishes.
+ */
+const void *msgbus_latest(const Msgbus *bus, MsgbusTopicId topic);
+
+/**
+ * @brief Hands every queued message to its subscriber's handler, in
+ * subscriber order.
+ */
+void msgbus_dispatch(Msgbus *bus);
+
+/**
+ * @brief RAM taken by @p topic: its payload slots and descriptor. Each
+ * subscriber adds queue_size * sizeof(MsgbusMessage) for all its topics.
+ */
+uint32_t msgbus_topic_bytes(const Msgbus *bus, MsgbusTopicId topic);
+
+#endif // MSGBUS_H
@@ -0,0 +1,115 @@
+/**
+ * @file onewire.c
+ * @brief 1-Wire slot state machine, one call per UART echo.
+ */
+
+#include "onewire.h"
+#include <stddef.h>
+
+uint8_t onewire_crc8(const uint8_t *data, uint8_t length) {
+    uint8_t crc = 0;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x01) ? (uint8_t)((crc >> 1) ^ 0x8C) : (uint8_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+// Transmit the frame for the slot the current op needs next
+static void onewire_send_slot(OneWireBus *bus) {
+    const OneWireOp *op = bus->op;
+    uint8_t frame = ONEWIRE_SLOT_ONE;
+
+    if (op->code == ONEWIRE_OP_RESET) {
+        bus->hardware->set_baud(ONEWIRE_RESET_BAUD);
+        frame = ONEWIRE_RESET_FRAME;
+    } else if (op->code == ONEWIRE_OP_WRITE && !((op->value >> bus->slot_bit) & 0x01)) {
+        frame = ONEWIRE_SLOT_ZERO;
+    }
+    bus->hardware->send(frame);
+}
+
+static void onewire_finish(OneWireBus *bus, bool success) {
+    bus->op = NULL;
+    bus->hardware->done(success, bus->data, success ? bus->read_length : 0);
+}
+
+void onewire_init(OneWireBus *bus, const OneWireHardware *hardware) {
+    bus->hardware = hardware;
+    bus->op = NULL;
+    bus->read_length = 0;
+}
+
+bool onewire_start(OneWireBus *bus, const OneWireOp *program) {
+    if (bus->op != NULL) {
+        return false;
+    }
+    bus->slot_bit = 0;
+    bus->read_index = 0;
+    bus->read_shift = 0;
+    bus->read_length = 0;
+    bus->op = program;
+    onewire_send_slot(bus);
+    return true;
+}
+
+// The echo is the bus level the device left during the slot
+void onewire_slot_done(OneWireBus *bus, uint8_t echo) {
+    const OneWireOp *op = bus->op;
+    bool op_complete = false;
+
+    if (op == NULL) {
+        return;
+    }
+    switch (op->code) {
+        case ONEWIRE_OP_RESET:
+            if (echo == ONEWIRE_RESET_FRAME) {
+                onewire_finish(bus, false);  // No presence pulse
+                return;
+            }
+            bus->hardware->set_baud(ONEWIRE_SLOT_BAUD);
+            op_complete = true;
+            break;
+
+        case ONEWIRE_OP_WRITE:
+            op_complete = (++bus->slot_bit == 8);
+            break;
+
+        case ONEWIRE_OP_READ:
+            if (echo == ONEWIRE_SLOT_ONE) {
+                bus->read_shift |= (uint8_t)(1U << bus->slot_bit);
+            }
+            if (++bus->slot_bit == 8) {
+                bus->data[bus->read_index++] = bus->read_shift;
+                bus->read_shift = 0;
+                bus->slot_bit = 0;
+                if (bus->read_index == op->value) {
+                    if (onewire_crc8(bus->data, (uint8_t)(op->value - 1U)) != bus->data[op->value - 1U]) {
+                        onewire_finish(bus, false);
+                        return;
+                    }
+                    bus->read_length = op->value;
+                    op_complete = true;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (op_complete) {
+        op++;
+        bus->slot_bit = 0;
+        bus->read_index = 0;
+        bus->read_shift = 0;
+        bus->op = op;
+    }
+    if (op->code == ONEWIRE_OP_END) {
+        onewire_finish(bus, true);
+        return;
+    }
+    onewire_send_slot(bus);
+}
@@ -0,0 +1,89 @@
+/**
+ * @file onewire.h
+ * @brief 1-Wire transactions run one time slot per UART frame.
+ *
+ * A transaction is a short program of bus operations (reset, write a
+ * byte, read bytes). onewire_start() sends the first frame; every echo
+ * received afterwards is passed to onewire_slot_done(), which decodes it
+ * and sends the next frame, so the whole transaction runs from the
+ * receive interrupt. Each READ ends with a Dallas/Maxim CRC-8 byte, which
+ * is checked before the transaction goes on.
+ *
+ * The module has no hardware dependencies; the baud rate, the frame
+ * output and the end of a transaction are reached through a
+ * OneWireHardware table (temperature_sensor.c on the target,
+ * tools/onewire_sim.c on the host).
+ */
+
+#ifndef ONEWIRE_H
+#define ONEWIRE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ONEWIRE_RESET_BAUD      9600U    // One frame covers the 480 us reset and presence
+#define ONEWIRE_SLOT_BAUD       115200U  // One frame is one 1-Wire time slot
+
+#define ONEWIRE_RESET_FRAME     0xF0     // Echo is unchanged when no device answers
+#define ONEWIRE_SLOT_ONE        0xFF     // Write 1 / read slot
+#define ONEWIRE_SLOT_ZERO       0x00     // Write 0 slot
+
+#define ONEWIRE_READ_MAX        9        // Longest READ, a DS18B20 scratchpad
+
+typedef enum {
+    ONEWIRE_OP_RESET,
+    ONEWIRE_OP_WRITE,    // value: byte to send, LSB first
+    ONEWIRE_OP_READ,     // value: number of bytes to receive, CRC last
+    ONEWIRE_OP_END
+} OneWireOpCode;
+
+typedef struct {
+    uint8_t code;
+    uint8_t value;
+} OneWireOp;
+
+typedef struct {
+    void (*set_baud)(uint32_t baud);
+    void (*send)(uint8_t frame);
+    // End of a transaction. On success @p data holds the last READ;
+    // failure is a missing presence pulse or a CRC error
+    void (*done)(bool success, const uint8_t *data, uint8_t length);
+} OneWireHardware;
+
+typedef struct {
+    const OneWireHardware *hardware;
+    const OneWireOp *volatile op;    // NULL while the bus is idle
+    uint8_t slot_bit;                // Bit within the current byte
+    uint8_t read_index;              // Bytes received by the current READ
+    uint8_t read_shift;
+    uint8_t read_length;             // Bytes of the last complete READ
+    uint8_t data[ONEWIRE_READ_MAX];
+} OneWireBus;
+
+/**
+ * @brief Prepares an idle bus. The caller sets the slot baud rate.
+ */
+void onewire_init(OneWireBus *bus, const OneWireHardware *hardware);
+
+/**
+ * @brief Starts @p program, which must end with ONEWIRE_OP_END.
+ * @return false if a transaction is still on the bus.
+ */
+bool onewire_start(OneWireBus *bus, const OneWireOp *program);
+
+/**
+ * @brief Takes the echo of the last frame and sends the next one, or
+ * ends the transaction. Call from the receive interrupt.
+ */
+void onewire_slot_done(OneWireBus *bus, uint8_t echo);
+
+static inline bool onewire_busy(const OneWireBus *bus) {
+    return bus->op != 0;
+}
+
+/**
+ * @brief Dallas/Maxim CRC-8 (x^8 + x^5 + x^4 + 1, reflected).
+ */
+uint8_t onewire_crc8(const uint8_t *data, uint8_t length);
+
+#endif // ONEWIRE_H
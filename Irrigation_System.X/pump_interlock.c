@@ -0,0 +1,201 @@
+/**
+ * @file pump_interlock.c
+ * @brief Pump interlock on the 1 ms tick, with current sense and output cut.
+ */
+
+#include "pump_interlock.h"
+#include "definitions.h"  // ADC plib
+#include "sam.h"
+#include "cycle_counter.h"
+#include "moisture_sensor.h"
+#include "ramfunc.h"
+#include "app_msg.h"
+#include "energy_monitor.h"
+
+// --- Configuration (must match the board wiring) ---
+#define PUMP_OUTPUT_GROUP       0
+#define PUMP_OUTPUT_PIN         8       // PA08, TCC0 WO[0] -> pump driver gate
+#define PUMP_CURRENT_INPUT      ADC_POSINPUT_PIN2   // PB08 (AIN2), shunt amplifier
+
+static const InterlockZoneLimits zone_limits[PUMP_INTERLOCK_ZONES] = {
+    // max_on_ms, max_volume_ml
+    { 900000UL, 3000U },   // 15 min, above the schedule's own 10 min limit
+    { 900000UL, 3000U },
+    { 900000UL, 3000U },
+    { 900000UL, 3000U },
+};
+
+static const InterlockConfig interlock_config = {
+    300U,      // dry_current_raw: about half the running current at 20 % duty
+    500U,      // spin_up_ms
+    3000U,     // dry_run_ms
+    1000U,     // leak_volume_ml
+    2U,        // leak_min_rise
+};
+
+// --- Shared with the tick interrupt ---
+static Interlock interlock;
+static uint8_t sample_countdown;
+static volatile bool current_pending;     // Current-sense conversion not yet read
+static uint32_t saved_inputctrl;          // ADC input selection before it
+static PumpInterlockStats stats;
+
+static uint32_t flow_to_nl_per_ms(float flow_ml_per_s) {
+    // 1 mL/s is 1000 nL/ms
+    return (flow_ml_per_s > 0.0f) ? (uint32_t)(flow_ml_per_s * 1000.0f + 0.5f) : 0U;
+}
+
+RAMFUNC static void output_to_tcc(bool on) {
+    PortGroup *group = &PORT->Group[PUMP_OUTPUT_GROUP];
+    if (on) {
+        group->PINCFG[PUMP_OUTPUT_PIN].reg |= PORT_PINCFG_PMUXEN;
+    } else {
+        // OUT is kept low, so the GPIO drives the gate off at once
+        group->PINCFG[PUMP_OUTPUT_PIN].reg &= (uint8_t)~PORT_PINCFG_PMUXEN;
+    }
+}
+
+// Starts a conversion of the current sense if the ADC is free; the result
+// is collected on the next tick, so the interrupt never waits for it
+RAMFUNC static void start_current_sample(void) {
+    if (moisture_sensor_adc_in_use()) {
+        stats.samples_skipped++;
+        return;
+    }
+    saved_inputctrl = ADC->INPUTCTRL.reg;
+    ADC_ChannelSelect(PUMP_CURRENT_INPUT, ADC_NEGINPUT_GND);
+    ADC_ConversionStart();
+    current_pending = true;
+}
+
+// Takes the result of start_current_sample() once it is ready and puts
+// back the input that was selected before
+RAMFUNC static uint16_t finish_current_sample(void) {
+    if (!current_pending || !ADC_ConversionStatusGet()) {
+        return INTERLOCK_NO_CURRENT;
+    }
+    stats.current_raw = ADC_ConversionResultGet();
+    ADC_ChannelSelect((ADC_POSINPUT)(saved_inputctrl & ADC_INPUTCTRL_MUXPOS_Msk),
+                      (ADC_NEGINPUT)(saved_inputctrl & ADC_INPUTCTRL_MUXNEG_Msk));
+    current_pending = false;
+    energy_monitor_count(ENERGY_ADC, ENERGY_ADC_CONVERSION_US);
+    stats.samples++;
+    return stats.current_raw;
+}
+
+// --- Public API ---
+
+void pump_interlock_init(InterlockTrip latched) {
+    interlock_init(&interlock, zone_limits, PUMP_INTERLOCK_ZONES, &interlock_config);
+    if (latched > INTERLOCK_OK && latched < INTERLOCK_TRIP_COUNT) {
+        interlock.trip = latched;
+        stats.trip = latched;
+    }
+
+    PortGroup *group = &PORT->Group[PUMP_OUTPUT_GROUP];
+    group->OUTCLR.reg = 1UL << PUMP_OUTPUT_PIN;
+    group->DIRSET.reg = 1UL << PUMP_OUTPUT_PIN;
+    sample_countdown = PUMP_INTERLOCK_SAMPLE_MS;
+}
+
+bool pump_interlock_start(uint8_t zone, float flow_ml_per_s, uint32_t on_ms, uint32_t volume_ml) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t volume_nl = (volume_ml < UINT32_MAX / 1000000UL) ? volume_ml * 1000000UL : UINT32_MAX;
+    bool started = interlock_start(&interlock, zone, flow_to_nl_per_ms(flow_ml_per_s),
+                                   on_ms, volume_nl);
+    if (started) {
+        output_to_tcc(true);
+    }
+    __set_PRIMASK(primask);
+    return started;
+}
+
+void pump_interlock_set_flow(float flow_ml_per_s) {
+    interlock_set_flow(&interlock, flow_to_nl_per_ms(flow_ml_per_s));
+}
+
+void pump_interlock_stop(void) {
+    interlock_stop(&interlock);
+}
+
+RAMFUNC void pump_interlock_output_off(void) {
+    output_to_tcc(false);
+}
+
+void pump_interlock_report_moisture(uint8_t percent) {
+    interlock_report_moisture(&interlock, percent);
+}
+
+void pump_interlock_on_message(const MsgbusMessage *message, const void *payload) {
+    (void)message;
+    const MoistureMessage *reading = payload;
+    if (reading->zone == interlock.zone) {
+        pump_interlock_report_moisture(reading->percent);
+    }
+}
+
+RAMFUNC void pump_interlock_tick(void) {
+    // A conversion started before the run stopped still holds the ADC
+    uint16_t current = finish_current_sample();
+    if (!interlock.running) {
+        return;
+    }
+    uint32_t start = cycle_counter_now();
+
+    if (--sample_countdown == 0) {
+        sample_countdown = PUMP_INTERLOCK_SAMPLE_MS;
+        if (!current_pending) {
+            start_current_sample();
+        }
+    }
+    if (interlock_tick(&interlock, current) != INTERLOCK_OK) {
+        output_to_tcc(false);
+        stats.trip = interlock.trip;
+        stats.zone = interlock.zone;
+        stats.on_ms = interlock.on_ms;
+        stats.volume_ml = interlock.volume_nl / 1000000UL;
+        stats.trips++;
+    }
+
+    uint32_t cycles = cycle_counter_elapsed(start);
+    if (cycles > stats.tick_cycles_max) {
+        stats.tick_cycles_max = cycles;
+    }
+    stats.tick_cycles_total += cycles;
+    stats.ticks++;
+}
+
+RAMFUNC bool pump_interlock_adc_busy(void) {
+    return current_pending;
+}
+
+InterlockTrip pump_interlock_trip(void) {
+    return interlock.trip;
+}
+
+void pump_interlock_clear(void) {
+    interlock_clear(&interlock);
+}
+
+void pump_interlock_usage(uint32_t *on_ms, uint32_t *volume_ml) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *on_ms = interlock.running ? interlock.on_ms : 0;
+    *volume_ml = interlock.running ? interlock.volume_nl / 1000000UL : 0;
+    __set_PRIMASK(primask);
+}
+
+void pump_interlock_get_stats(PumpInterlockStats *result) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *result = stats;
+    __set_PRIMASK(primask);
+}
+
+const char *pump_interlock_trip_name(InterlockTrip trip) {
+    static const char *const NAMES[INTERLOCK_TRIP_COUNT] = {
+        "none", "max on-time", "max volume", "dry run", "leak"
+    };
+    return (trip < INTERLOCK_TRIP_COUNT) ? NAMES[trip] : "?";
+}
@@ -0,0 +1,112 @@
+/**
+ * @file pump_interlock.h
+ * @brief Binds the interlock (interlock.h) to the pump output, the pump
+ * current sense and the 1 ms timer interrupt.
+ *
+ * pump_interlock_tick() must be called from Interval1mS(), the TC4
+ * callback that counts systemTicks. Every PUMP_INTERLOCK_SAMPLE_MS it
+ * starts a conversion of the current-sense input, unless the moisture or
+ * calibration code has the ADC at that moment, and reads the result on
+ * the following tick. Until then pump_interlock_adc_busy() keeps the
+ * other ADC users off; afterwards the previous input is selected again.
+ * On a trip it takes the pump pin away from TCC0 and
+ * drives it low, in the same interrupt. This does not depend on the TCC,
+ * its compare buffering or the main loop. The pin goes back to TCC0 when
+ * the next run starts.
+ *
+ * The main loop sees the trip in pump_checkpoint(). That switches the
+ * pump off properly (compare value 0, volume accounting) and reports the
+ * trip once on the UART and in the trace. The pump stays locked out
+ * until pump_interlock_clear(), and the lockout survives warm resets.
+ */
+
+#ifndef PUMP_INTERLOCK_H
+#define PUMP_INTERLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "interlock.h"
+#include "msgbus.h"
+
+#define PUMP_INTERLOCK_ZONES        4
+#define PUMP_INTERLOCK_SAMPLE_MS    4U      // Current-sense conversion interval
+
+typedef struct {
+    InterlockTrip trip;
+    uint8_t zone;
+    uint32_t on_ms;              // Run time when it tripped
+    uint32_t volume_ml;
+    uint32_t trips;              // Trips since cold boot
+    uint32_t samples;            // Current-sense conversions
+    uint32_t samples_skipped;    // Sample ticks with the ADC in use
+    uint16_t current_raw;        // Last current-sense reading
+    uint32_t tick_cycles_max;    // Longest pump_interlock_tick()
+    uint32_t tick_cycles_total;
+    uint32_t ticks;
+} PumpInterlockStats;
+
+/**
+ * @brief Sets the limits and prepares the pin and current-sense input.
+ * Called by pump_init().
+ * @param latched Trip retained across a warm reset, or INTERLOCK_OK.
+ */
+void pump_interlock_init(InterlockTrip latched);
+
+/**
+ * @brief Starts watching a run and gives the pin back to TCC0.
+ * @return false while tripped: the pump must stay off.
+ */
+bool pump_interlock_start(uint8_t zone, float flow_ml_per_s, uint32_t on_ms, uint32_t volume_ml);
+
+void pump_interlock_set_flow(float flow_ml_per_s);
+void pump_interlock_stop(void);
+
+/**
+ * @brief Takes the pin away from TCC0 and drives it low, as a trip does,
+ * without tripping. For the end of a timed dose; safe from an interrupt.
+ * The next pump_interlock_start() gives the pin back.
+ */
+void pump_interlock_output_off(void);
+
+/**
+ * @brief Latest moisture reading, for the leak check.
+ */
+void pump_interlock_report_moisture(uint8_t percent);
+
+/**
+ * @brief MSG_MOISTURE subscriber (app_msg.h): reports readings of the
+ * zone being watered.
+ */
+void pump_interlock_on_message(const MsgbusMessage *message, const void *payload);
+
+/**
+ * @brief 1 ms tick; call from Interval1mS().
+ */
+void pump_interlock_tick(void);
+
+/**
+ * @brief A current-sense conversion is in flight; the ADC must not be
+ * reprogrammed until it clears. Checked by moisture_sensor_adc_claim().
+ */
+bool pump_interlock_adc_busy(void);
+
+InterlockTrip pump_interlock_trip(void);
+
+/**
+ * @brief Releases the lockout after a trip has been dealt with.
+ */
+void pump_interlock_clear(void);
+
+/**
+ * @brief On-time and volume of the run in progress, for warm-reset retention.
+ */
+void pump_interlock_usage(uint32_t *on_ms, uint32_t *volume_ml);
+
+void pump_interlock_get_stats(PumpInterlockStats *stats);
+
+/**
+ * @brief Short name of a trip reason for reports.
+ */
+const char *pump_interlock_trip_name(InterlockTrip trip);
+
+#endif // PUMP_INTERLOCK_H
@@ -0,0 +1,91 @@
+/**
+ * @file ramfunc.c
+ * @brief Copy-down, size and benchmark of the RAM-resident code section.
+ */
+
+#include "ramfunc.h"
+#include "interlock.h"
+#include "pump_interlock.h"
+#include "cycle_counter.h"
+#include "fmt.h"
+#include "definitions.h"
+#include "sam.h"
+#include <string.h>
+
+// Defined by ramfunc.ld
+extern uint32_t __ramcode_start[];
+extern uint32_t __ramcode_end[];
+extern const uint32_t __ramcode_load_start[];
+
+// Limits the benchmark run never reaches
+static const InterlockZoneLimits bench_limits = { UINT32_MAX, UINT32_MAX / 1000000UL };
+static const InterlockConfig bench_config = { 0U, UINT32_MAX, UINT32_MAX, UINT32_MAX / 1000000UL, 0U };
+
+void ramfunc_init(void) {
+    uint32_t *destination = __ramcode_start;
+    const uint32_t *source = __ramcode_load_start;
+
+    // Word by word: memcpy itself may be relocated one day
+    while (destination < __ramcode_end) {
+        *destination++ = *source++;
+    }
+    // Nothing is fetched from the new code before the copy has landed
+    __DSB();
+    __ISB();
+}
+
+// Harmony's startup_xc32.c calls this after the data initialization and
+// before main(), with interrupts still off
+void _on_bootstrap(void) {
+    ramfunc_init();
+}
+
+uint32_t ramfunc_size(void) {
+    return (uint32_t)((uintptr_t)__ramcode_end - (uintptr_t)__ramcode_start);
+}
+
+void ramfunc_benchmark(RamfuncBenchmark *result) {
+    Interlock interlock;
+    PumpInterlockStats live;
+
+    result->ram_bytes = ramfunc_size();
+    result->copy_ok = memcmp(__ramcode_start, __ramcode_load_start, result->ram_bytes) == 0;
+    result->flash_wait_states = (uint8_t)NVMCTRL->CTRLB.bit.RWS;
+
+    // The per-millisecond accounting of a running pump, without the 1 ms
+    // interrupt landing in the middle
+    interlock_init(&interlock, &bench_limits, 1, &bench_config);
+    interlock_start(&interlock, 0, 1900U, 0, 0);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t start = cycle_counter_now();
+    for (uint32_t i = 0; i < RAMFUNC_BENCH_TICKS; i++) {
+        interlock_tick(&interlock, INTERLOCK_NO_CURRENT);
+    }
+    uint32_t cycles = cycle_counter_elapsed(start);
+    __set_PRIMASK(primask);
+    result->tick_cycles = cycles / RAMFUNC_BENCH_TICKS;
+
+    pump_interlock_get_stats(&live);
+    result->isr_cycles = (live.ticks != 0) ? live.tick_cycles_total / live.ticks : 0;
+}
+
+void ramfunc_report(void) {
+    RamfuncBenchmark bench;
+    char storage[128];
+    FmtBuffer message;
+
+    ramfunc_benchmark(&bench);
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, "RAM code: ");
+    fmt_u32(&message, bench.ram_bytes, 0);
+    fmt_str(&message, bench.copy_ok ? " B, copy ok" : " B, COPY BAD");
+    fmt_str(&message, ", flash wait states ");
+    fmt_u32(&message, bench.flash_wait_states, 0);
+    fmt_str(&message, ", tick ");
+    fmt_u32(&message, bench.tick_cycles, 0);
+    fmt_str(&message, " cycles, 1 ms ISR ");
+    fmt_u32(&message, bench.isr_cycles, 0);
+    fmt_str(&message, " cycles\r\n");
+    fmt_uart_write(&message);
+}
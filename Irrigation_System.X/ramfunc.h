@@ -0,0 +1,75 @@
+/**
+ * @file ramfunc.h
+ * @brief Runs selected hot paths from RAM instead of flash.
+ *
+ * At 48 MHz the NVM controller needs one read wait state
+ * (NVMCTRL CTRLB.RWS), so every flash fetch that misses its small cache
+ * costs an extra cycle. SRAM has no wait states. Functions marked RAMFUNC
+ * go into the .ramcode section. ramfunc.ld links that section to run from
+ * RAM and load from flash, and ramfunc.c copies it into RAM before main(),
+ * from the startup's _on_bootstrap() hook. No code runs from RAM before
+ * that.
+ *
+ * Only code on the 1 ms interrupt and the other per-event paths belongs
+ * here, because it takes RAM from the 16 KB for good. The post-build step
+ * (tools/ramfunc_size.py) prints how much RAM the section takes, per object
+ * file.
+ *
+ * RAM sits 512 MB away from flash, beyond the range of a BL. RAMFUNC
+ * therefore makes callers reach these functions through a register
+ * (long_call). Calls from them back into flash go through veneers that the
+ * linker adds. Build with RAMFUNC_ENABLED=0 to leave everything in flash,
+ * e.g. for the "before" numbers of ramfunc_benchmark().
+ */
+
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef RAMFUNC_ENABLED
+#define RAMFUNC_ENABLED 1
+#endif
+
+#if RAMFUNC_ENABLED && defined(__XC32__)
+#define RAMFUNC __attribute__((section(".ramcode"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif
+
+#define RAMFUNC_BENCH_TICKS  256U    // interlock_tick() calls per benchmark
+
+// Result of ramfunc_benchmark()
+typedef struct {
+    uint32_t ram_bytes;          // RAM taken by the relocated code
+    bool copy_ok;                // RAM copy matches its load image in flash
+    uint8_t flash_wait_states;   // NVMCTRL CTRLB.RWS
+    uint32_t tick_cycles;        // interlock_tick() on a running pump, per call
+    uint32_t isr_cycles;         // Average pump_interlock_tick() in the live 1 ms
+                                 // interrupt, 0 until the pump has run
+} RamfuncBenchmark;
+
+/**
+ * @brief Copies .ramcode from flash into RAM. Called once by the startup
+ * code through _on_bootstrap(); calling it again does no harm.
+ */
+void ramfunc_init(void);
+
+/**
+ * @brief Bytes of code placed in RAM.
+ */
+uint32_t ramfunc_size(void);
+
+/**
+ * @brief Times the relocated pump accounting and checks the RAM copy.
+ * Interrupts are off for about RAMFUNC_BENCH_TICKS x 100 cycles.
+ */
+void ramfunc_benchmark(RamfuncBenchmark *result);
+
+/**
+ * @brief Prints ramfunc_benchmark() on the UART.
+ */
+void ramfunc_report(void);
+
+#endif // RAMFUNC_H
@@ -0,0 +1,248 @@
+/**
+ * @file runtime_config.c
+ * @brief Defaults, RWW EEPROM copy and console upload of the runtime configuration.
+ */
+
+#include "runtime_config.h"
+#include "LCD1602A.h"            // PLANT_THRESHOLDS
+#include "Pump_control.h"        // PUMP_PWM_PERIOD
+#include "adaptive_sampling.h"
+#include "systime.h"
+#include "cycle_counter.h"
+#include "trace.h"
+#include "fmt.h"
+#include "definitions.h"         // NVMCTRL plib
+#include <stddef.h>
+#include <string.h>
+
+// Two rows at the start of the RWW EEPROM section, written alternately
+#define CONFIG_SLOT_COUNT        2U
+#define CONFIG_SLOT_ADDRESS(slot) \
+    (NVMCTRL_RWWEEPROM_START_ADDRESS + (uint32_t)(slot) * NVMCTRL_RWWEEPROM_ROWSIZE)
+#define CONFIG_PAGES \
+    ((sizeof(ConfigBlock) + NVMCTRL_RWWEEPROM_PAGESIZE - 1U) / NVMCTRL_RWWEEPROM_PAGESIZE)
+
+_Static_assert(sizeof(ConfigBlock) <= NVMCTRL_RWWEEPROM_ROWSIZE, "ConfigBlock must fit one row");
+
+// Default pump calibration (duty % vs. mL/s); replace with values measured
+// on the installed pump, or upload them
+static const ConfigPumpPoint default_pump_points[] = {
+    { 20.0f, 0.8f },
+    { 40.0f, 1.9f },
+    { 60.0f, 3.1f },
+    { 80.0f, 4.5f },
+    { 100.0f, 5.8f },
+};
+
+typedef enum {
+    SAVE_IDLE,
+    SAVE_ERASE,
+    SAVE_WRITE,
+    SAVE_VERIFY
+} SaveState;
+
+static ConfigStore store;
+static RuntimeConfigStats stats;
+static SaveState save_state = SAVE_IDLE;
+static uint8_t save_slot;                // Row being written
+static uint8_t save_page;
+static int8_t newest_slot = -1;          // Row with the newest saved block
+static uint64_t save_start_ms;
+
+static const ConfigBlock *slot_block(uint8_t slot) {
+    return (const ConfigBlock *)CONFIG_SLOT_ADDRESS(slot);
+}
+
+static void build_defaults(ConfigBlock *block) {
+    memset(block, 0, sizeof(*block));
+    block->magic = CONFIG_BLOCK_MAGIC;
+    block->format = CONFIG_BLOCK_FORMAT;
+    block->size = sizeof(ConfigBlock);
+    block->version = 0;
+    block->pump_pwm_period = PUMP_PWM_PERIOD;
+    block->moisture_level_threshold = RUNTIME_CONFIG_MOISTURE_THRESHOLD;
+    block->sample_min_ms = ADAPTIVE_SAMPLING_MIN_MS;
+    block->sample_max_ms = ADAPTIVE_SAMPLING_MAX_MS;
+
+    for (int i = 0; i < PLANT_THRESHOLDS_COUNT && i < CONFIG_MAX_PLANTS; i++) {
+        ConfigPlant *plant = &block->plants[block->plant_count++];
+        strncpy(plant->name, PLANT_THRESHOLDS[i].name, CONFIG_PLANT_NAME_LENGTH - 1);
+        plant->moisture_low = (uint8_t)PLANT_THRESHOLDS[i].moisture_low;
+        plant->moisture_ideal_low = (uint8_t)PLANT_THRESHOLDS[i].moisture_ideal_low;
+        plant->moisture_ideal_high = (uint8_t)PLANT_THRESHOLDS[i].moisture_ideal_high;
+        plant->moisture_high = (uint8_t)PLANT_THRESHOLDS[i].moisture_high;
+    }
+    block->pump_point_count = sizeof(default_pump_points) / sizeof(default_pump_points[0]);
+    memcpy(block->pump_points, default_pump_points, sizeof(default_pump_points));
+    config_block_seal(block);
+}
+
+static void report_upload(ConfigResult result, uint32_t version, uint32_t cycles) {
+    char storage[80];
+    FmtBuffer message;
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, "Config v");
+    fmt_u32(&message, version, 0);
+    if (result == CONFIG_OK) {
+        fmt_str(&message, " applied in ");
+        fmt_u32(&message, cycles, 0);
+        fmt_str(&message, " cycles, saving.\r\n");
+    } else {
+        fmt_str(&message, " rejected: ");
+        fmt_str(&message, config_result_name(result));
+        fmt_str(&message, ".\r\n");
+    }
+    fmt_uart_write(&message);
+}
+
+static void start_save(void) {
+    // A save in progress starts over with the newer block, in the same row,
+    // which is never the one holding the newest saved block
+    if (save_state == SAVE_IDLE) {
+        save_slot = (newest_slot == 0) ? 1U : 0U;
+        save_start_ms = systime_now_ms();
+    }
+    save_state = SAVE_ERASE;
+    stats.save_pending = true;
+}
+
+// --- Public API ---
+
+void runtime_config_init(void) {
+    config_store_init(&store);
+    memset(&stats, 0, sizeof(stats));
+    save_state = SAVE_IDLE;
+    newest_slot = -1;
+
+    for (uint8_t slot = 0; slot < CONFIG_SLOT_COUNT; slot++) {
+        if (config_block_validate(slot_block(slot)) == CONFIG_OK &&
+            (newest_slot < 0 || slot_block(slot)->version > slot_block((uint8_t)newest_slot)->version)) {
+            newest_slot = (int8_t)slot;
+        }
+    }
+    if (newest_slot >= 0 &&
+        config_store_publish(&store, slot_block((uint8_t)newest_slot), sizeof(ConfigBlock),
+                             false) == CONFIG_OK) {
+        stats.from_flash = true;
+    } else {
+        ConfigBlock defaults;
+        build_defaults(&defaults);
+        config_store_publish(&store, &defaults, sizeof(defaults), false);
+    }
+    stats.version = config_store_active(&store)->version;
+}
+
+const ConfigBlock *runtime_config_get(void) {
+    const ConfigBlock *active = config_store_active(&store);
+    // main() may read MOISTURELEVELTHRESHOLD before the boot step runs
+    if (active == NULL) {
+        runtime_config_init();
+        active = config_store_active(&store);
+    }
+    return active;
+}
+
+const ConfigPlant *runtime_config_plant(int index) {
+    const ConfigBlock *config = runtime_config_get();
+    return &config->plants[(index >= 0 && index < config->plant_count) ? index : 0];
+}
+
+bool runtime_config_handle_frame(const uint8_t *frame, uint16_t length) {
+    uint32_t magic;
+    uint32_t version = 0;
+
+    if (length < sizeof(magic)) {
+        return false;
+    }
+    memcpy(&magic, frame, sizeof(magic));
+    if (magic != CONFIG_BLOCK_MAGIC) {
+        return false;
+    }
+    if (length >= offsetof(ConfigBlock, version) + sizeof(version)) {
+        memcpy(&version, frame + offsetof(ConfigBlock, version), sizeof(version));
+    }
+
+    // The whole apply: copy into the spare buffer, check, swap
+    uint32_t start = cycle_counter_now();
+    ConfigResult result = config_store_publish(&store, frame, length, true);
+    uint32_t cycles = cycle_counter_elapsed(start);
+
+    stats.last_result = result;
+    if (result == CONFIG_OK) {
+        stats.applies++;
+        stats.version = version;
+        stats.from_flash = false;
+        stats.apply_cycles = cycles;
+        if (cycles > stats.apply_cycles_max) {
+            stats.apply_cycles_max = cycles;
+        }
+        start_save();
+    } else {
+        stats.rejects++;
+    }
+    TRACE(TRACE_EVT_CONFIG, result, (uint16_t)version);
+    report_upload(result, version, cycles);
+    return true;
+}
+
+void runtime_config_poll(void) {
+    // The RWW section is busy for milliseconds per command; come back later
+    if (save_state == SAVE_IDLE || NVMCTRL_IsBusy()) {
+        return;
+    }
+    uint32_t start = cycle_counter_now();
+    const ConfigBlock *active = runtime_config_get();
+    uint32_t address = CONFIG_SLOT_ADDRESS(save_slot);
+
+    switch (save_state) {
+        case SAVE_ERASE:
+            NVMCTRL_RWWEEPROM_RowErase(address);
+            save_page = 0;
+            save_state = SAVE_WRITE;
+            break;
+
+        case SAVE_WRITE: {
+            // Every page comes from the same block: a newer upload restarts
+            // the save at the erase
+            uint32_t page[NVMCTRL_RWWEEPROM_PAGESIZE / sizeof(uint32_t)];
+            uint32_t offset = (uint32_t)save_page * NVMCTRL_RWWEEPROM_PAGESIZE;
+            uint32_t count = sizeof(ConfigBlock) - offset;
+            if (count > NVMCTRL_RWWEEPROM_PAGESIZE) {
+                count = NVMCTRL_RWWEEPROM_PAGESIZE;
+            }
+            memset(page, 0xFF, sizeof(page));
+            memcpy(page, (const uint8_t *)active + offset, count);
+            NVMCTRL_RWWEEPROM_PageWrite(page, address + offset);
+            if (++save_page == CONFIG_PAGES) {
+                save_state = SAVE_VERIFY;
+            }
+            break;
+        }
+
+        case SAVE_VERIFY:
+            if (memcmp(slot_block(save_slot), active, sizeof(ConfigBlock)) == 0) {
+                newest_slot = (int8_t)save_slot;
+                stats.saves++;
+            } else {
+                fmt_uart_str("Error saving config to flash!\r\n");
+                stats.save_errors++;
+            }
+            stats.save_ms = (uint32_t)(systime_now_ms() - save_start_ms);
+            stats.save_pending = false;
+            save_state = SAVE_IDLE;
+            break;
+
+        default:
+            save_state = SAVE_IDLE;
+            break;
+    }
+
+    uint32_t cycles = cycle_counter_elapsed(start);
+    if (cycles > stats.poll_cycles_max) {
+        stats.poll_cycles_max = cycles;
+    }
+}
+
+void runtime_config_get_stats(RuntimeConfigStats *result) {
+    *result = stats;
+}
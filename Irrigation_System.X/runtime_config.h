@@ -0,0 +1,95 @@
+/**
+ * @file runtime_config.h
+ * @brief The active runtime configuration (config_block.h) on the target:
+ * compiled-in defaults, the flash copy and the upload over the console.
+ *
+ * At boot the newest valid block in flash is applied, or the defaults if
+ * there is none. The defaults come from PLANT_THRESHOLDS, the pump
+ * calibration below, PUMP_PWM_PERIOD and the adaptive sampling bounds.
+ * A console frame that starts with the block magic is an upload.
+ * runtime_config_handle_frame() checks it and swaps it in within the same
+ * call, then reports the result. Any main-loop or interrupt code reading
+ * the block sees the new values from then on.
+ *
+ * The flash copy lives in the RWW EEPROM section of the SAMD21 D variant,
+ * which can be erased and written while the CPU runs from the main
+ * array. runtime_config_poll() issues one NVM command per call and
+ * returns; neither the main loop nor an interrupt waits for the flash.
+ * Two rows are used alternately, so a reset during a save keeps the
+ * previous block.
+ *
+ * Consumers read values through runtime_config_get() when they need them.
+ * Derived state is rebuilt when the version changes: the pump reprograms
+ * its PWM period and flow rate, and the sensor picks up new thresholds on
+ * its next reading.
+ *
+ * Main loop:
+ * @code
+ *   static void console_frame(const uint8_t *frame, uint16_t length, void *context) {
+ *       if (!runtime_config_handle_frame(frame, length)) {
+ *           // Single-character commands
+ *       }
+ *   }
+ *   ...
+ *   console_rx_poll(console_frame, NULL);
+ *   runtime_config_poll();
+ * @endcode
+ */
+
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config_block.h"
+
+#define RUNTIME_CONFIG_MOISTURE_THRESHOLD  2300U  // Default raw threshold
+
+typedef struct {
+    uint32_t version;            // Active block, 0 for the defaults
+    bool from_flash;             // Active block was loaded at boot
+    uint32_t applies;            // Uploads swapped in
+    uint32_t rejects;
+    ConfigResult last_result;
+    uint32_t apply_cycles;       // Last upload: copy, check and swap
+    uint32_t apply_cycles_max;
+    uint32_t poll_cycles_max;    // Longest runtime_config_poll() call
+    uint32_t saves;              // Blocks written and verified
+    uint32_t save_errors;
+    uint32_t save_ms;            // Last save, first erase to verify
+    bool save_pending;
+} RuntimeConfigStats;
+
+/**
+ * @brief Applies the newest valid block from flash, else the defaults.
+ * Boot step; runs before anything that reads the configuration.
+ */
+void runtime_config_init(void);
+
+/**
+ * @brief The active block. Do not keep the pointer past the current main
+ * loop pass or interrupt.
+ */
+const ConfigBlock *runtime_config_get(void);
+
+/**
+ * @brief Thresholds of plant @p index, or of the first plant if the
+ * active block has fewer plants.
+ */
+const ConfigPlant *runtime_config_plant(int index);
+
+/**
+ * @brief Console frame handler hook.
+ * @return true if the frame was a configuration upload (applied or
+ * rejected), false if it is for another handler.
+ */
+bool runtime_config_handle_frame(const uint8_t *frame, uint16_t length);
+
+/**
+ * @brief Advances a pending flash save by at most one NVM command.
+ */
+void runtime_config_poll(void);
+
+void runtime_config_get_stats(RuntimeConfigStats *stats);
+
+#endif // RUNTIME_CONFIG_H
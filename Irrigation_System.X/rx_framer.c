@@ -0,0 +1,120 @@
+/**
+ * @file rx_framer.c
+ * @brief Idle-line and delimiter framing over a DMA receive ring.
+ */
+
+#include "rx_framer.h"
+#include <stddef.h>
+#include <string.h>
+
+static void deliver(RxFramer *framer, uint32_t start, uint16_t length,
+                    RxFrameHandler handler, void *context) {
+    uint16_t mask = (uint16_t)(framer->size - 1U);
+    uint16_t offset = (uint16_t)(start & mask);
+
+    if ((uint32_t)offset + length <= framer->size) {
+        handler(framer->ring + offset, length, context);
+    } else {
+        uint16_t first = (uint16_t)(framer->size - offset);
+        memcpy(framer->scratch, framer->ring + offset, first);
+        memcpy(framer->scratch + first, framer->ring, (size_t)(length - first));
+        framer->stats.copied++;
+        handler(framer->scratch, length, context);
+    }
+    framer->stats.frames++;
+    framer->stats.bytes += length;
+}
+
+// Ends the current frame at @p end; the next one starts at @p next
+static void frame_end(RxFramer *framer, uint32_t end, uint32_t next,
+                      RxFrameHandler handler, void *context) {
+    uint32_t length = end - framer->frame_start;
+
+    if (framer->discarding) {
+        framer->stats.dropped += length;
+        framer->discarding = false;
+    } else if (length > framer->frame_max) {
+        framer->stats.oversize++;
+        framer->stats.dropped += length;
+    } else if (length > 0) {
+        deliver(framer, framer->frame_start, (uint16_t)length, handler, context);
+    }
+    framer->frame_start = next;
+}
+
+void rx_framer_init(RxFramer *framer, const uint8_t *ring, uint16_t size,
+                    uint8_t *scratch, uint16_t frame_max,
+                    int16_t delimiter, uint32_t idle_ms, uint32_t now_ms) {
+    framer->ring = ring;
+    framer->size = size;
+    framer->scratch = scratch;
+    framer->frame_max = frame_max;
+    framer->delimiter = delimiter;
+    framer->idle_ms = idle_ms;
+    framer->written = 0;
+    framer->frame_start = 0;
+    framer->scanned = 0;
+    framer->last_activity_ms = now_ms;
+    framer->discarding = false;
+    memset(&framer->stats, 0, sizeof(framer->stats));
+}
+
+uint32_t rx_framer_written(const RxFramer *framer, uint32_t halves_done, uint16_t position) {
+    // The count is exact at each half boundary; the position adds how far
+    // the DMA is past the last counted one (up to a half plus a pending one)
+    uint32_t counted = halves_done * (framer->size / 2U);
+    return counted + (((uint32_t)position - counted) & (framer->size - 1U));
+}
+
+void rx_framer_poll(RxFramer *framer, uint32_t written, uint32_t now_ms,
+                    RxFrameHandler handler, void *context) {
+    if (written != framer->written) {
+        framer->written = written;
+        framer->last_activity_ms = now_ms;
+    }
+
+    // Lapped: the start of the pending frame is already overwritten
+    if (written - framer->frame_start > framer->size) {
+        framer->stats.overruns++;
+        framer->stats.dropped += written - framer->frame_start;
+        framer->frame_start = written;
+        framer->scanned = written;
+        framer->discarding = true;
+    }
+
+    if (framer->delimiter != RX_FRAMER_NO_DELIMITER) {
+        uint16_t mask = (uint16_t)(framer->size - 1U);
+        while (framer->scanned != written) {
+            uint16_t offset = (uint16_t)(framer->scanned & mask);
+            uint32_t chunk = written - framer->scanned;
+            if (chunk > (uint32_t)(framer->size - offset)) {
+                chunk = framer->size - offset;
+            }
+            const uint8_t *hit = memchr(framer->ring + offset, framer->delimiter, chunk);
+            if (hit == NULL) {
+                framer->scanned += chunk;
+            } else {
+                uint32_t end = framer->scanned + (uint32_t)(hit - (framer->ring + offset));
+                frame_end(framer, end, end + 1U, handler, context);
+                framer->scanned = end + 1U;
+            }
+        }
+    }
+
+    if (framer->idle_ms != 0 && written != framer->frame_start &&
+        now_ms - framer->last_activity_ms >= framer->idle_ms) {
+        frame_end(framer, written, written, handler, context);
+        framer->scanned = written;
+    }
+
+    // No boundary within frame_max: drop up to the next one rather than
+    // let the frame grow until the DMA laps it
+    if (written - framer->frame_start > framer->frame_max) {
+        if (!framer->discarding) {
+            framer->stats.oversize++;
+            framer->discarding = true;
+        }
+        framer->stats.dropped += written - framer->frame_start;
+        framer->frame_start = written;
+    }
+}
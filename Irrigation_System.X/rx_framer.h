@@ -0,0 +1,92 @@
+/**
+ * @file rx_framer.h
+ * @brief Frames received bytes straight out of a DMA receive ring.
+ *
+ * The DMA controller writes received bytes into a ring made of two
+ * halves (ping-pong): each half is one linked block transfer, and the
+ * controller moves on to the other half without CPU involvement. The
+ * only interrupt is the block-complete one, once per half, which counts
+ * halves. Nothing runs per byte.
+ *
+ * rx_framer_poll() runs from the main loop. It works out how far the DMA
+ * has written, from the half count and the DMA's position in the ring,
+ * and cuts frames from the bytes not yet consumed. A frame ends either
+ * at an idle line (no new byte for idle_ms) or at a delimiter byte. It is
+ * passed to the handler in place; only a frame that wraps around the end
+ * of the ring is first copied into the scratch buffer.
+ *
+ * If the main loop falls more than a ring behind, the DMA overwrites
+ * unconsumed bytes. The framer detects this, drops everything up to the
+ * write position and counts the lost bytes. Framing restarts at the next
+ * boundary.
+ *
+ * The module has no hardware dependencies; console_rx.c binds it to the
+ * console UART and tools/uart_rx_sim.c measures it on the host.
+ */
+
+#ifndef RX_FRAMER_H
+#define RX_FRAMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RX_FRAMER_NO_DELIMITER  (-1)
+
+typedef void (*RxFrameHandler)(const uint8_t *frame, uint16_t length, void *context);
+
+typedef struct {
+    uint32_t frames;             // Frames passed to the handler
+    uint32_t bytes;              // Bytes in those frames (delimiters excluded)
+    uint32_t dropped;            // Bytes lost to overruns or oversize frames
+    uint32_t overruns;           // Times the DMA lapped the reader
+    uint32_t oversize;           // Frames longer than frame_max
+    uint32_t copied;             // Frames linearized into the scratch buffer
+} RxFramerStats;
+
+typedef struct {
+    const uint8_t *ring;
+    uint16_t size;               // Power of two; two halves of size / 2
+    uint8_t *scratch;            // frame_max bytes
+    uint16_t frame_max;
+    int16_t delimiter;           // RX_FRAMER_NO_DELIMITER: idle line only
+    uint32_t idle_ms;
+    // Positions as running byte counts since init
+    uint32_t written;            // Written by the DMA, as of the last poll
+    uint32_t frame_start;        // First byte of the frame being received
+    uint32_t scanned;            // Bytes already searched for the delimiter
+    uint32_t last_activity_ms;
+    bool discarding;             // Dropping bytes up to the next boundary
+    RxFramerStats stats;
+} RxFramer;
+
+/**
+ * @brief Sets up framing over @p ring, which the DMA starts filling at
+ * offset 0.
+ * @param size Ring size in bytes; must be a power of two.
+ * @param delimiter Byte value ending a frame, or RX_FRAMER_NO_DELIMITER.
+ * @param idle_ms Line idle time that ends a frame; 0 disables it.
+ */
+void rx_framer_init(RxFramer *framer, const uint8_t *ring, uint16_t size,
+                    uint8_t *scratch, uint16_t frame_max,
+                    int16_t delimiter, uint32_t idle_ms, uint32_t now_ms);
+
+/**
+ * @brief Running count of bytes the DMA has written.
+ *
+ * @p halves_done is the block-complete count and @p position the DMA's
+ * current offset in the ring. The two are read without locking: the
+ * count may lag the position by up to one half (interrupt still pending),
+ * which this resolves. Valid while the reader is less than a ring behind.
+ */
+uint32_t rx_framer_written(const RxFramer *framer, uint32_t halves_done, uint16_t position);
+
+/**
+ * @brief Cuts and delivers every complete frame up to @p written.
+ *
+ * Frames are delivered in order. The handler must be done with the frame
+ * before it returns; it may not call back into the framer.
+ */
+void rx_framer_poll(RxFramer *framer, uint32_t written, uint32_t now_ms,
+                    RxFrameHandler handler, void *context);
+
+#endif // RX_FRAMER_H
@@ -0,0 +1,243 @@
+/**
+ * @file schedule_runner.c
+ * @brief Wall clock, flash copy and pump jobs for the watering schedule.
+ */
+
+#include "schedule_runner.h"
+#include "Pump_control.h"
+#include "crc32.h"
+#include "fmt.h"
+#include "definitions.h"
+#include <string.h>
+
+#define SCHEDULE_FORMAT_VERSION  1
+
+// Flash layout: header, then count entries
+typedef struct {
+    uint32_t magic_number;
+    uint16_t count;
+    uint16_t version;
+    uint32_t entries_crc;        // CRC-32 of the count entries
+    uint32_t reserved;
+} ScheduleFlashHeader;
+
+#define SCHEDULE_FLASH_MAX_SIZE (sizeof(ScheduleFlashHeader) + SCHEDULE_MAX_ENTRIES * sizeof(ScheduleEntry))
+
+typedef struct {
+    bool active;
+    ScheduleEntry entry;
+    float baseline_ml;           // Pump total when the job started
+    float delivered_ml;
+    uint64_t start_ms;
+} WateringJob;
+
+static WateringSchedule schedule;
+
+// Wall clock: base_s was the time at base_ms
+static bool clock_valid = false;
+static uint32_t clock_base_s;
+static uint64_t clock_base_ms;
+
+static ScheduleEntry queue[SCHEDULE_QUEUE_LENGTH];
+static uint8_t queue_head;
+static uint8_t queue_count;
+static WateringJob job;
+
+static void report_job(const char *label, const ScheduleEntry *entry, uint32_t value,
+                       const char *unit) {
+    char storage[64];
+    FmtBuffer message;
+    fmt_init(&message, storage, sizeof(storage));
+    fmt_str(&message, "Schedule: zone ");
+    fmt_u32(&message, entry->zone, 0);
+    fmt_str(&message, label);
+    fmt_u32(&message, value, 0);
+    fmt_str(&message, unit);
+    fmt_uart_write(&message);
+}
+
+static uint32_t clock_now(uint64_t now_ms) {
+    return clock_base_s + (uint32_t)((now_ms - clock_base_ms) / 1000U);
+}
+
+// --- Flash copy ---
+
+static void load_from_flash(void) {
+    const ScheduleFlashHeader *header = (const ScheduleFlashHeader *)SCHEDULE_FLASH_ADDRESS;
+    const ScheduleEntry *stored = (const ScheduleEntry *)(header + 1);
+
+    schedule_init(&schedule);
+    if (header->magic_number != SCHEDULE_MAGIC_NUMBER ||
+        header->version != SCHEDULE_FORMAT_VERSION ||
+        header->count > SCHEDULE_MAX_ENTRIES ||
+        header->entries_crc != crc32_update(CRC32_INITIAL, stored, header->count * sizeof(ScheduleEntry))) {
+        return;
+    }
+    for (uint16_t i = 0; i < header->count; i++) {
+        if (schedule_entry_is_valid(&stored[i])) {
+            schedule.entries[schedule.count++] = stored[i];
+        }
+    }
+}
+
+bool schedule_runner_save(void) {
+    // PageWrite always programs a full page; pages are staged one at a time
+    // from the header and the entry table
+    uint32_t page[NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+    ScheduleFlashHeader header;
+    uint32_t entries_size = schedule.count * sizeof(ScheduleEntry);
+    uint32_t size = sizeof(header) + entries_size;
+
+    memset(&header, 0, sizeof(header));
+    header.magic_number = SCHEDULE_MAGIC_NUMBER;
+    header.count = schedule.count;
+    header.version = SCHEDULE_FORMAT_VERSION;
+    header.entries_crc = crc32_update(CRC32_INITIAL, schedule.entries, entries_size);
+
+    while (NVMCTRL_IsBusy());
+    for (uint32_t row = 0; row < size; row += NVMCTRL_FLASH_ROWSIZE) {
+        NVMCTRL_RowErase(SCHEDULE_FLASH_ADDRESS + row);
+        while (NVMCTRL_IsBusy());
+    }
+
+    const uint8_t *entries = (const uint8_t *)schedule.entries;
+    for (uint32_t offset = 0; offset < size; offset += NVMCTRL_FLASH_PAGESIZE) {
+        uint8_t *bytes = (uint8_t *)page;
+        memset(page, 0, sizeof(page));
+        for (uint32_t i = 0; i < NVMCTRL_FLASH_PAGESIZE && offset + i < size; i++) {
+            uint32_t position = offset + i;
+            bytes[i] = (position < sizeof(header))
+                ? ((const uint8_t *)&header)[position]
+                : entries[position - sizeof(header)];
+        }
+        NVMCTRL_PageWrite(page, SCHEDULE_FLASH_ADDRESS + offset);
+        while (NVMCTRL_IsBusy());
+    }
+
+    const uint8_t *flash = (const uint8_t *)SCHEDULE_FLASH_ADDRESS;
+    if (memcmp(flash, &header, sizeof(header)) == 0 &&
+        memcmp(flash + sizeof(header), schedule.entries, entries_size) == 0) {
+        fmt_uart_str("Schedule saved to flash.\r\n");
+        return true;
+    }
+    fmt_uart_str("Error saving schedule to flash!\r\n");
+    return false;
+}
+
+// --- Pump jobs ---
+
+static void start_job(uint64_t now_ms) {
+    // Manual watering owns the pump until it is switched off
+    if (queue_count == 0 || pump_get_status()) {
+        return;
+    }
+    job.entry = queue[queue_head];
+    queue_head = (uint8_t)((queue_head + 1U) % SCHEDULE_QUEUE_LENGTH);
+    queue_count--;
+
+    job.active = true;
+    job.baseline_ml = pump_get_total_volume_ml();
+    job.delivered_ml = 0.0f;
+    job.start_ms = now_ms;
+    pump_set_zone(job.entry.zone);
+    pump_activate(SCHEDULE_PUMP_PERCENT);
+    report_job(": watering ", &job.entry, job.entry.volume_ml, " mL\r\n");
+}
+
+static void run_job(uint64_t now_ms) {
+    float total_ml = pump_get_total_volume_ml();
+    uint32_t elapsed_ms = (uint32_t)(now_ms - job.start_ms);
+
+    // The counter may have been reset underneath the job
+    if (total_ml < job.baseline_ml) {
+        job.baseline_ml = total_ml - job.delivered_ml;
+    }
+    job.delivered_ml = total_ml - job.baseline_ml;
+
+    if (job.delivered_ml >= (float)job.entry.volume_ml) {
+        pump_deactivate();
+        report_job(": done in ", &job.entry, elapsed_ms / 1000U, " s\r\n");
+    } else if (elapsed_ms >= SCHEDULE_MAX_RUN_MS) {
+        pump_deactivate();
+        report_job(": time limit, delivered ", &job.entry,
+                   (uint32_t)job.delivered_ml, " mL\r\n");
+    } else if (!pump_get_status()) {
+        // Switched off by someone else
+        report_job(": stopped, delivered ", &job.entry,
+                   (uint32_t)job.delivered_ml, " mL\r\n");
+    } else {
+        return;
+    }
+    job.active = false;
+}
+
+// --- Public API ---
+
+void schedule_runner_init(void) {
+    load_from_flash();
+    clock_valid = false;
+    queue_head = 0;
+    queue_count = 0;
+    job.active = false;
+}
+
+void schedule_runner_set_time(uint32_t local_s, uint64_t now_ms) {
+    clock_base_s = local_s;
+    clock_base_ms = now_ms;
+    clock_valid = true;
+    schedule_rebuild(&schedule, local_s);
+}
+
+uint32_t schedule_runner_time(uint64_t now_ms) {
+    return clock_valid ? clock_now(now_ms) : SCHEDULE_NEVER;
+}
+
+bool schedule_runner_add(const ScheduleEntry *entry, uint64_t now_ms) {
+    return schedule_add(&schedule, entry, clock_valid ? clock_now(now_ms) : 0);
+}
+
+bool schedule_runner_remove(uint16_t index, uint64_t now_ms) {
+    return schedule_remove(&schedule, index, clock_valid ? clock_now(now_ms) : 0);
+}
+
+void schedule_runner_poll(uint64_t now_ms) {
+    if (clock_valid) {
+        ScheduleEntry due;
+        uint32_t now_s = clock_now(now_ms);
+        while (schedule_pop_due(&schedule, now_s, &due)) {
+            if (queue_count < SCHEDULE_QUEUE_LENGTH) {
+                queue[(queue_head + queue_count) % SCHEDULE_QUEUE_LENGTH] = due;
+                queue_count++;
+            } else {
+                report_job(": queue full, skipped ", &due, due.volume_ml, " mL\r\n");
+            }
+        }
+    }
+
+    if (job.active) {
+        run_job(now_ms);
+    }
+    if (!job.active) {
+        start_job(now_ms);
+    }
+}
+
+uint32_t schedule_runner_ms_until_next(uint64_t now_ms) {
+    if (job.active || queue_count > 0) {
+        return 0;
+    }
+    uint32_t next_s = schedule_next_fire(&schedule);
+    if (!clock_valid || next_s == SCHEDULE_NEVER) {
+        return UINT32_MAX;
+    }
+    // Whole seconds from the clock's base, minus what has passed since
+    uint64_t due_ms = clock_base_ms + (uint64_t)(next_s - clock_base_s) * 1000U;
+    if (next_s <= clock_base_s || due_ms <= now_ms) {
+        return 0;
+    }
+    return (due_ms - now_ms < UINT32_MAX) ? (uint32_t)(due_ms - now_ms) : UINT32_MAX - 1U;
+}
+
+const WateringSchedule *schedule_runner_get(void) {
+    return &schedule;
+}
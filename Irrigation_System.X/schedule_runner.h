@@ -0,0 +1,87 @@
+/**
+ * @file schedule_runner.h
+ * @brief Runs the watering schedule (watering_schedule.h) on the target.
+ *
+ * Adds what the schedule core leaves out: a wall clock, the copy of the
+ * table in flash, and the pump. The board has no RTC or battery, so the
+ * clock is unset after every reset. It is set with schedule_runner_set_time()
+ * and then runs from systime_now_ms(). Nothing fires until the clock is set.
+ *
+ * Due events are queued and watered one after another through the pump's
+ * volume accounting. The pump runs until pump_get_total_volume_ml() has
+ * grown by the entry's volume, or until SCHEDULE_MAX_RUN_MS as a safety
+ * limit. The board has a single pump and no valves, so the zone only
+ * selects the pump interlock's limits and is reported.
+ *
+ * Main loop:
+ * @code
+ *   schedule_runner_poll(systime_now_ms());
+ *   // Idle until the next event or sensor sample, whichever comes first
+ *   uint32_t idle_ms = schedule_runner_ms_until_next(systime_now_ms());
+ * @endcode
+ */
+
+#ifndef SCHEDULE_RUNNER_H
+#define SCHEDULE_RUNNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "watering_schedule.h"
+
+// Top rows of the 128 KB flash, clear of the application image
+#define SCHEDULE_FLASH_ADDRESS ((uint32_t)0x0001E000)
+#define SCHEDULE_MAGIC_NUMBER  0x5343484E // "SCHN"
+
+#define SCHEDULE_PUMP_PERCENT  100.0f    // Duty used for scheduled watering
+#define SCHEDULE_MAX_RUN_MS    600000UL  // Longest single watering (10 min)
+#define SCHEDULE_QUEUE_LENGTH  8         // Due events waiting for the pump
+
+/**
+ * @brief Loads the table from flash; an empty schedule if there is none.
+ */
+void schedule_runner_init(void);
+
+/**
+ * @brief Sets the wall clock (local seconds since 1970-01-01) and
+ * recomputes every occurrence from it.
+ */
+void schedule_runner_set_time(uint32_t local_s, uint64_t now_ms);
+
+/**
+ * @brief Current wall clock, or SCHEDULE_NEVER while it is unset.
+ */
+uint32_t schedule_runner_time(uint64_t now_ms);
+
+/**
+ * @brief Adds an entry to the table in RAM; schedule_runner_save() makes
+ * it persistent.
+ */
+bool schedule_runner_add(const ScheduleEntry *entry, uint64_t now_ms);
+
+/**
+ * @brief Removes entry @p index from the table in RAM.
+ */
+bool schedule_runner_remove(uint16_t index, uint64_t now_ms);
+
+/**
+ * @brief Writes the table to flash and verifies it.
+ */
+bool schedule_runner_save(void);
+
+/**
+ * @brief Queues due events and drives the running watering job.
+ */
+void schedule_runner_poll(uint64_t now_ms);
+
+/**
+ * @brief Milliseconds until the next event, 0 while watering is running or
+ * queued, UINT32_MAX if nothing is scheduled.
+ */
+uint32_t schedule_runner_ms_until_next(uint64_t now_ms);
+
+/**
+ * @brief Read access to the table, e.g. for listing it on the console.
+ */
+const WateringSchedule *schedule_runner_get(void);
+
+#endif // SCHEDULE_RUNNER_H
@@ -0,0 +1,88 @@
+/**
+ * @file sensor_scan.c
+ * @brief Staggered sensor power-up and sequential conversion.
+ */
+
+#include "sensor_scan.h"
+#include <stddef.h>
+
+void sensor_scan_init(SensorScan *scan, const SensorScanHardware *hardware, uint8_t zone_count) {
+    if (zone_count > SENSOR_SCAN_MAX_ZONES) {
+        zone_count = SENSOR_SCAN_MAX_ZONES;
+    }
+    scan->hardware = hardware;
+    scan->zone_count = zone_count;
+    scan->max_powered = SENSOR_SCAN_MAX_POWERED;
+    scan->settle_ms = SENSOR_SCAN_SETTLE_MS;
+    scan->active = false;
+    scan->converting = false;
+    scan->powered = 0;
+    scan->last_scan_ms = 0;
+    scan->powered_ms_total = 0;
+    scan->scans = 0;
+    for (uint8_t zone = 0; zone < zone_count; zone++) {
+        scan->results[zone] = 0;
+        hardware->power(zone, false);
+    }
+}
+
+void sensor_scan_start(SensorScan *scan, uint32_t now_ms) {
+    if (scan->active) {
+        return;
+    }
+    scan->active = true;
+    scan->converting = false;
+    scan->next_to_power = 0;
+    scan->next_to_convert = 0;
+    scan->powered = 0;
+    scan->scan_start_ms = now_ms;
+}
+
+bool sensor_scan_run(SensorScan *scan, uint32_t now_ms) {
+    const SensorScanHardware *hardware = scan->hardware;
+
+    if (!scan->active) {
+        return true;
+    }
+
+    // Finish the running conversion and release that zone's supply
+    if (scan->converting) {
+        if (!hardware->conversion_done()) {
+            return false;
+        }
+        uint8_t zone = scan->next_to_convert;
+        scan->results[zone] = hardware->result();
+        hardware->power(zone, false);
+        scan->powered_ms_total += now_ms - scan->power_on_ms[zone];
+        scan->powered--;
+        scan->converting = false;
+        scan->next_to_convert++;
+    }
+
+    // Keep the settle pipeline full, in conversion order
+    while (scan->next_to_power < scan->zone_count && scan->powered < scan->max_powered) {
+        uint8_t zone = scan->next_to_power++;
+        hardware->power(zone, true);
+        scan->power_on_ms[zone] = now_ms;
+        scan->powered++;
+    }
+
+    if (scan->next_to_convert == scan->zone_count) {
+        scan->active = false;
+        scan->last_scan_ms = now_ms - scan->scan_start_ms;
+        scan->scans++;
+        return true;
+    }
+
+    // Zones were powered in order, so the next one to convert settles first
+    uint8_t zone = scan->next_to_convert;
+    if (zone < scan->next_to_power && now_ms - scan->power_on_ms[zone] >= scan->settle_ms) {
+        hardware->start_conversion(zone);
+        scan->converting = true;
+    }
+    return false;
+}
+
+uint16_t sensor_scan_result(const SensorScan *scan, uint8_t zone) {
+    return (zone < scan->zone_count) ? scan->results[zone] : 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file sensor_scan.h
+ * @brief Power-gated, pipelined scan of the moisture sensors.
+ *
+ * Each zone's TL555 sensor is powered from a GPIO only for its measurement
+ * window: it is switched on, left to settle for SENSOR_SCAN_SETTLE_MS,
+ * converted, and switched off again. Settling is overlapped across zones:
+ * up to SENSOR_SCAN_MAX_POWERED sensors are powered and settling at once,
+ * so while one zone converts the next ones are already settling. A scan of
+ * N zones takes about ceil(N / MAX_POWERED) settle windows plus N
+ * conversions instead of N of each.
+ *
+ * The scan is a polled state machine with no hardware dependencies; the
+ * GPIO and ADC are reached through a SensorScanHardware table supplied by
+ * the caller (moisture_sensor.c on the target, tools/sensor_scan_sim.c on
+ * the host).
+ */
+
+#ifndef SENSOR_SCAN_H
+#define SENSOR_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SENSOR_SCAN_MAX_ZONES    8
+#define SENSOR_SCAN_SETTLE_MS    20U   // TL555 output stable after power-up
+#define SENSOR_SCAN_MAX_POWERED  4     // Limits the supply current peak
+
+typedef struct {
+    void (*power)(uint8_t zone, bool on);      // Switch the zone's sensor supply
+    void (*start_conversion)(uint8_t zone);    // Select the zone's ADC input and start
+    bool (*conversion_done)(void);
+    uint16_t (*result)(void);
+} SensorScanHardware;
+
+typedef struct {
+    const SensorScanHardware *hardware;
+    uint8_t zone_count;
+    uint8_t max_powered;
+    uint32_t settle_ms;
+    // Scan progress
+    uint8_t next_to_power;
+    uint8_t next_to_convert;
+    uint8_t powered;
+    bool converting;
+    bool active;
+    uint32_t scan_start_ms;
+    uint32_t power_on_ms[SENSOR_SCAN_MAX_ZONES];
+    uint16_t results[SENSOR_SCAN_MAX_ZONES];
+    // Statistics
+    uint32_t last_scan_ms;       // Duration of the last complete scan
+    uint32_t powered_ms_total;   // Sum over zones of time switched on
+    uint32_t scans;
+} SensorScan;
+
+/**
+ * @brief Prepares a scanner; all sensors are switched off.
+ */
+void sensor_scan_init(SensorScan *scan, const SensorScanHardware *hardware, uint8_t zone_count);
+
+/**
+ * @brief Starts a new scan of all zones. Ignored while a scan is running.
+ */
+void sensor_scan_start(SensorScan *scan, uint32_t now_ms);
+
+/**
+ * @brief Advances the scan. Call from the main loop.
+ * @return true once every zone of the current scan has a result.
+ */
+bool sensor_scan_run(SensorScan *scan, uint32_t now_ms);
+
+/**
+ * @brief Raw ADC result of @p zone from the last complete scan.
+ */
+uint16_t sensor_scan_result(const SensorScan *scan, uint8_t zone);
+
+#endif // SENSOR_SCAN_H
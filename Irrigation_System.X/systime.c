@@ -0,0 +1,48 @@
+/**
+ * @file systime.c
+ * @brief 64-bit extension of systemTicks and the shared timer wheel.
+ */
+
+#include "systime.h"
+#include "definitions.h"
+
+extern volatile uint32_t systemTicks;
+
+static TickExtender extender;
+static TimerWheel wheel;
+
+uint64_t systime_now_ms(void) {
+    // An interrupt reading the clock between the wrap test and the update
+    // would count the wrap twice
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t now = tick_extender_update(&extender, systemTicks);
+    __set_PRIMASK(primask);
+    return now;
+}
+
+void systime_run(void) {
+    timer_wheel_advance(&wheel, systime_now_ms());
+}
+
+void systime_arm(Timer *timer, uint32_t delay_ms, uint32_t period_ms) {
+    // Relative to the clock, not to the wheel, which may lag behind it
+    timer_arm_at(&wheel, timer, systime_now_ms() + delay_ms, period_ms);
+}
+
+void systime_cancel(Timer *timer) {
+    timer_cancel(&wheel, timer);
+}
+
+uint32_t systime_ms_until_next(void) {
+    uint64_t next = timer_wheel_next_event(&wheel);
+    uint64_t now = systime_now_ms();
+
+    if (next == TIMER_WHEEL_NEVER) {
+        return UINT32_MAX;
+    }
+    if (next <= now) {
+        return 0;
+    }
+    return (next - now < UINT32_MAX) ? (uint32_t)(next - now) : UINT32_MAX - 1U;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file systime.h
+ * @brief Shared timing service: 64-bit monotonic milliseconds and timers.
+ *
+ * systemTicks is a 32-bit count of the 1 ms TC4 interrupt (Interval1mS)
+ * and wraps after 49.7 days. systime_now_ms() extends it to 64 bits, which
+ * does not wrap, so deadlines can be compared directly. It may be called
+ * from the main loop and from interrupts; the few cycles of the extension
+ * run with interrupts masked.
+ *
+ * Timers run on one shared timer_wheel.h wheel. They are armed, cancelled
+ * and fired in main-loop context only, from systime_run():
+ * @code
+ *   static Timer blink;
+ *   timer_init(&blink, blink_toggle, NULL);
+ *   systime_arm(&blink, 0, 500);        // Now, then every 500 ms
+ *   ...
+ *   while (true) {
+ *       systime_run();
+ *       ...
+ *   }
+ * @endcode
+ * systime_run() also keeps the extension current; it must run at least
+ * once per 49 days, which any main loop does. Static storage makes the
+ * service usable from reset, before any boot step has run.
+ */
+
+#ifndef SYSTIME_H
+#define SYSTIME_H
+
+#include <stdint.h>
+#include "timer_wheel.h"
+
+/**
+ * @brief Milliseconds since the tick started, 64 bits.
+ */
+uint64_t systime_now_ms(void);
+
+/**
+ * @brief Runs every timer callback due by now.
+ */
+void systime_run(void);
+
+/**
+ * @brief Arms @p timer @p delay_ms from now, repeating every @p period_ms
+ * unless 0. O(1).
+ */
+void systime_arm(Timer *timer, uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Disarms @p timer. O(1).
+ */
+void systime_cancel(Timer *timer);
+
+/**
+ * @brief Milliseconds until the service next needs systime_run(),
+ * UINT32_MAX if no timer is armed; a bound for idling the CPU.
+ */
+uint32_t systime_ms_until_next(void);
+
+#endif // SYSTIME_H
@@ -0,0 +1,170 @@
+/**
+ * @file temperature_sensor.c
+ * @brief DS18B20 over 1-Wire, timed by a SERCOM USART and driven from its
+ * receive interrupt. The slot sequencing lives in onewire.c.
+ */
+
+#include "temperature_sensor.h"
+#include "definitions.h"
+#include "sam.h"
+#include "cycle_counter.h"
+#include "onewire.h"
+
+// --- Configuration (must match the board wiring) ---
+#define ONEWIRE_SERCOM          SERCOM2
+#define ONEWIRE_SERCOM_IRQn     SERCOM2_IRQn
+#define ONEWIRE_SERCOM_APB      PM_APBCMASK_SERCOM2
+#define ONEWIRE_SERCOM_GCLK_ID  SERCOM2_GCLK_ID_CORE
+#define ONEWIRE_TX_PIN          12      // PA12, SERCOM2 PAD0 (peripheral function C)
+#define ONEWIRE_RX_PIN          13      // PA13, SERCOM2 PAD1 (peripheral function C)
+#define ONEWIRE_PIN_FUNCTION    2       // PMUX value for function C
+#define ONEWIRE_CLOCK_HZ        48000000UL  // GCLK0 feeding the SERCOM core clock
+
+// Arithmetic baud generator: BAUD = 65536 * (1 - 16 * f_baud / f_ref)
+#define ONEWIRE_BAUD_REG(baud)  ((uint16_t)(65536ULL - (65536ULL * 16U * (baud)) / ONEWIRE_CLOCK_HZ))
+
+// DS18B20 commands
+#define DS18B20_SKIP_ROM        0xCC
+#define DS18B20_CONVERT_T       0x44
+#define DS18B20_READ_SCRATCHPAD 0xBE
+#define DS18B20_SCRATCHPAD_SIZE 9        // Temperature LSB/MSB first, CRC last
+
+// --- Bus programs ---
+static const OneWireOp program_convert[] = {
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_CONVERT_T },
+    { ONEWIRE_OP_END, 0 }
+};
+
+// Collect the finished conversion, then start the next one in the same transaction
+static const OneWireOp program_read_and_convert[] = {
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_READ_SCRATCHPAD },
+    { ONEWIRE_OP_READ, DS18B20_SCRATCHPAD_SIZE },
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_CONVERT_T },
+    { ONEWIRE_OP_END, 0 }
+};
+
+// --- Driver state (shared with the SERCOM interrupt) ---
+extern volatile uint32_t systemTicks;
+
+static OneWireBus bus;
+
+static volatile bool conversion_pending = false;
+static volatile uint32_t conversion_start_ms;
+static volatile int16_t latest_temperature_x16;
+static volatile uint32_t latest_temperature_ms;
+static volatile bool latest_temperature_valid = false;
+static TemperatureSensorStats stats;
+
+// BAUD is enable-protected, so the SERCOM is briefly disabled
+static void onewire_set_baud(uint32_t baud) {
+    SercomUsart *usart = &ONEWIRE_SERCOM->USART;
+    usart->CTRLA.reg &= ~SERCOM_USART_CTRLA_ENABLE;
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_ENABLE);
+    usart->BAUD.reg = ONEWIRE_BAUD_REG(baud);
+    usart->CTRLA.reg |= SERCOM_USART_CTRLA_ENABLE;
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_ENABLE);
+}
+
+static void onewire_send(uint8_t frame) {
+    ONEWIRE_SERCOM->USART.DATA.reg = frame;
+}
+
+static void onewire_done(bool success, const uint8_t *data, uint8_t length) {
+    stats.transactions++;
+    if (!success) {
+        stats.failures++;
+        conversion_pending = false;
+        return;
+    }
+    if (length == DS18B20_SCRATCHPAD_SIZE) {
+        latest_temperature_x16 = (int16_t)((data[1] << 8) | data[0]);
+        latest_temperature_ms = systemTicks;
+        latest_temperature_valid = true;
+    }
+    // Every program ends with Convert T
+    conversion_pending = true;
+    conversion_start_ms = systemTicks;
+}
+
+static const OneWireHardware sercom_hardware = {
+    .set_baud = onewire_set_baud,
+    .send = onewire_send,
+    .done = onewire_done
+};
+
+void SERCOM2_Handler(void) {
+    uint32_t start = cycle_counter_now();
+    uint8_t echo = (uint8_t)ONEWIRE_SERCOM->USART.DATA.reg;  // Clears RXC
+
+    onewire_slot_done(&bus, echo);
+    stats.slots++;
+    stats.isr_cycles += cycle_counter_elapsed(start);
+}
+
+// --- Public API ---
+
+void temperature_sensor_init(void) {
+    SercomUsart *usart = &ONEWIRE_SERCOM->USART;
+
+    PM->APBCMASK.reg |= ONEWIRE_SERCOM_APB;
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(ONEWIRE_SERCOM_GCLK_ID) | GCLK_CLKCTRL_GEN_GCLK0 |
+                        GCLK_CLKCTRL_CLKEN;
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY);
+
+    // TX and RX on peripheral function C; RX needs the input buffer
+    PORT->Group[0].PINCFG[ONEWIRE_TX_PIN].reg = PORT_PINCFG_PMUXEN;
+    PORT->Group[0].PINCFG[ONEWIRE_RX_PIN].reg = PORT_PINCFG_PMUXEN | PORT_PINCFG_INEN;
+    PORT->Group[0].PMUX[ONEWIRE_TX_PIN >> 1].reg = PORT_PMUX_PMUXE(ONEWIRE_PIN_FUNCTION) |
+                                                   PORT_PMUX_PMUXO(ONEWIRE_PIN_FUNCTION);
+
+    usart->CTRLA.reg = SERCOM_USART_CTRLA_SWRST;
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_SWRST);
+
+    // 8N1, LSB first, internal clock, TX on PAD0, RX on PAD1
+    usart->CTRLA.reg = SERCOM_USART_CTRLA_MODE_USART_INT_CLK | SERCOM_USART_CTRLA_DORD |
+                       SERCOM_USART_CTRLA_TXPO(0) | SERCOM_USART_CTRLA_RXPO(1);
+    usart->CTRLB.reg = SERCOM_USART_CTRLB_TXEN | SERCOM_USART_CTRLB_RXEN |
+                       SERCOM_USART_CTRLB_CHSIZE(0);
+    while (usart->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_CTRLB);
+    usart->INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+    NVIC_EnableIRQ(ONEWIRE_SERCOM_IRQn);
+
+    onewire_init(&bus, &sercom_hardware);
+    conversion_pending = false;
+    latest_temperature_valid = false;
+    onewire_set_baud(ONEWIRE_SLOT_BAUD);
+}
+
+void temperature_sensor_start_cycle(uint32_t now_ms) {
+    if (onewire_busy(&bus)) {
+        return;  // Previous transaction still on the bus
+    }
+    if (conversion_pending && (now_ms - conversion_start_ms) < TEMPERATURE_CONVERSION_MS) {
+        return;  // Sensor still converting; the last reading stays current
+    }
+
+    onewire_start(&bus, conversion_pending ? program_read_and_convert : program_convert);
+}
+
+bool temperature_sensor_get(uint32_t now_ms, int16_t *temperature_x16) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool valid = latest_temperature_valid &&
+                 (now_ms - latest_temperature_ms) <= TEMPERATURE_STALE_MS;
+    *temperature_x16 = latest_temperature_x16;
+    __set_PRIMASK(primask);
+    return valid;
+}
+
+void temperature_sensor_get_stats(TemperatureSensorStats *result) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *result = stats;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file temperature_sensor.h
+ * @brief Non-blocking DS18B20 soil temperature driver.
+ *
+ * The 1-Wire bus is driven by a SERCOM in USART mode instead of
+ * bit-banging: every UART frame at 115200 baud is one 1-Wire time slot
+ * (0xFF writes a 1 or reads a bit, 0x00 writes a 0), and a 0xF0 frame at
+ * 9600 baud is the reset/presence pulse. The SERCOM generates all bit
+ * timing; the CPU only handles one receive interrupt per slot. The slot
+ * sequencing is in onewire.c, which tools/onewire_sim.c runs against a
+ * scripted sensor.
+ *
+ * Wiring: the SERCOM TX pad drives the bus through an open-drain stage
+ * (a small N-MOSFET or a Schottky diode), and the RX pad is connected
+ * directly to the bus with the usual 4.7 kOhm pull-up to 3.3 V. A single
+ * sensor is assumed (Skip ROM addressing).
+ *
+ * The 750 ms temperature conversion runs inside the sensor while the
+ * moisture state machine waits for its next slot. Each call to
+ * temperature_sensor_start_cycle() collects the previous conversion, if
+ * it has finished, and immediately starts the next one, so a temperature
+ * is always available when the moisture ADC result is processed.
+ */
+
+#ifndef TEMPERATURE_SENSOR_H
+#define TEMPERATURE_SENSOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TEMPERATURE_CONVERSION_MS   750U   // DS18B20 12-bit conversion time
+#define TEMPERATURE_STALE_MS        5000U  // Readings older than this are not used
+#define TEMPERATURE_FRACTION_BITS   4      // Readings are in 1/16 degC, as the DS18B20 reports
+
+typedef struct {
+    uint32_t transactions;       // Completed bus transactions
+    uint32_t failures;           // No presence pulse or scratchpad CRC error
+    uint32_t slots;              // 1-Wire slots (receive interrupts) handled
+    uint32_t isr_cycles;         // CPU cycles spent in the receive interrupt
+} TemperatureSensorStats;
+
+/**
+ * @brief Configures the SERCOM and its pins. Call once at startup.
+ */
+void temperature_sensor_init(void);
+
+/**
+ * @brief Advances the conversion pipeline. Returns immediately.
+ * Call once per moisture sample, next to ADC_ConversionStart(), so the bus
+ * traffic overlaps the ADC conversion.
+ * @param now_ms Current systemTicks.
+ */
+void temperature_sensor_start_cycle(uint32_t now_ms);
+
+/**
+ * @brief Latest valid temperature.
+ * @param now_ms Current systemTicks, used to reject stale readings.
+ * @param temperature_x16 Receives the temperature in 1/16 degC.
+ * @return false if no reading newer than TEMPERATURE_STALE_MS exists.
+ */
+bool temperature_sensor_get(uint32_t now_ms, int16_t *temperature_x16);
+
+/**
+ * @brief Bus and CPU cost counters since startup.
+ */
+void temperature_sensor_get_stats(TemperatureSensorStats *stats);
+
+#endif // TEMPERATURE_SENSOR_H
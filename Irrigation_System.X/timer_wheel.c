@@ -0,0 +1,210 @@
+/**
+ * @file timer_wheel.c
+ * @brief Hierarchical timer wheel with O(1) arm and cancel.
+ */
+
+#include "timer_wheel.h"
+#include <stddef.h>
+
+#define SLOT_MASK       (TIMER_WHEEL_SLOTS - 1U)
+#define WHEEL_RANGE_MS  (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS))
+
+#if TIMER_WHEEL_SLOT_BITS > 5
+#error "Slot occupancy is a 32-bit mask per level"
+#endif
+#if TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS > 256
+#error "Slot numbers are stored in a uint8_t"
+#endif
+
+static void slot_insert(TimerWheel *wheel, Timer *timer, uint8_t slot) {
+    Timer **head = &wheel->slots[slot];
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+    timer->slot = slot;
+    wheel->occupied[slot / TIMER_WHEEL_SLOTS] |= 1UL << (slot & SLOT_MASK);
+}
+
+static void slot_unlink(TimerWheel *wheel, Timer *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->pprev = NULL;
+    timer->next = NULL;
+    // Timers being expired sit on a detached list, so test the slot itself
+    if (wheel->slots[timer->slot] == NULL) {
+        wheel->occupied[timer->slot / TIMER_WHEEL_SLOTS] &= ~(1UL << (timer->slot & SLOT_MASK));
+    }
+}
+
+// Puts an armed timer where time @p base (the next millisecond to be
+// processed) will find it
+static void place(TimerWheel *wheel, Timer *timer, uint64_t base) {
+    uint64_t expires = (timer->expires_ms < base) ? base : timer->expires_ms;
+    uint64_t delta = expires - base;
+    uint8_t level = 0;
+
+    if (delta >= WHEEL_RANGE_MS) {
+        // Park in the top level's furthest slot and re-place from there
+        expires = base + WHEEL_RANGE_MS - 1U;
+        level = TIMER_WHEEL_LEVELS - 1U;
+    } else {
+        while (delta >= (1ULL << ((level + 1U) * TIMER_WHEEL_SLOT_BITS))) {
+            level++;
+        }
+    }
+    uint8_t index = (uint8_t)((expires >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK);
+    slot_insert(wheel, timer, (uint8_t)(level * TIMER_WHEEL_SLOTS + index));
+}
+
+// Distance 1..TIMER_WHEEL_SLOTS from @p index to the next occupied slot,
+// going round; 0 if the level is empty
+static uint32_t slots_ahead(uint32_t occupied, uint32_t index) {
+    if (occupied == 0) {
+        return 0;
+    }
+    uint32_t shift = index + 1U;
+    uint32_t rotated = occupied >> (shift % TIMER_WHEEL_SLOTS);
+    if (shift % TIMER_WHEEL_SLOTS != 0) {
+        rotated |= occupied << (TIMER_WHEEL_SLOTS - shift);
+    }
+    if (TIMER_WHEEL_SLOTS < 32U) {
+        rotated &= (1UL << TIMER_WHEEL_SLOTS) - 1U;
+    }
+    return (uint32_t)__builtin_ctz(rotated) + 1U;
+}
+
+// Moves every timer of a level's slot down towards level 0
+static void cascade(TimerWheel *wheel, uint8_t level, uint64_t base) {
+    uint8_t index = (uint8_t)((base >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK);
+    uint8_t slot = (uint8_t)(level * TIMER_WHEEL_SLOTS + index);
+    Timer *timer = wheel->slots[slot];
+
+    wheel->slots[slot] = NULL;
+    wheel->occupied[level] &= ~(1UL << index);
+    while (timer != NULL) {
+        Timer *next = timer->next;
+        place(wheel, timer, base);
+        timer = next;
+    }
+}
+
+static void expire(TimerWheel *wheel, uint8_t index, uint64_t now_ms) {
+    // Detach the slot so callbacks can arm timers into it for the next lap
+    Timer *pending = wheel->slots[index];
+    wheel->slots[index] = NULL;
+    wheel->occupied[0] &= ~(1UL << index);
+    pending->pprev = &pending;
+
+    while (pending != NULL) {
+        Timer *timer = pending;
+        slot_unlink(wheel, timer);
+        if (timer->period_ms != 0) {
+            timer->expires_ms += timer->period_ms;
+            if (timer->expires_ms <= now_ms) {
+                timer->expires_ms = now_ms + timer->period_ms;
+            }
+            place(wheel, timer, now_ms + 1U);
+        }
+        timer->callback(timer, timer->context);
+    }
+}
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_ms) {
+    wheel->now_ms = now_ms;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        wheel->occupied[level] = 0;
+    }
+    for (uint16_t slot = 0; slot < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; slot++) {
+        wheel->slots[slot] = NULL;
+    }
+}
+
+void timer_init(Timer *timer, TimerCallback callback, void *context) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires_ms = 0;
+    timer->period_ms = 0;
+    timer->slot = 0;
+    timer->callback = callback;
+    timer->context = context;
+}
+
+void timer_arm_at(TimerWheel *wheel, Timer *timer, uint64_t expires_ms, uint32_t period_ms) {
+    if (timer_is_armed(timer)) {
+        slot_unlink(wheel, timer);
+    }
+    // The current millisecond is already processed; the period runs from
+    // the first firing
+    timer->expires_ms = (expires_ms > wheel->now_ms) ? expires_ms : wheel->now_ms + 1U;
+    timer->period_ms = period_ms;
+    place(wheel, timer, wheel->now_ms + 1U);
+}
+
+void timer_arm(TimerWheel *wheel, Timer *timer, uint32_t delay_ms, uint32_t period_ms) {
+    timer_arm_at(wheel, timer, wheel->now_ms + delay_ms, period_ms);
+}
+
+void timer_cancel(TimerWheel *wheel, Timer *timer) {
+    if (timer_is_armed(timer)) {
+        slot_unlink(wheel, timer);
+    }
+}
+
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now_ms) {
+    while (wheel->now_ms < now_ms) {
+        uint64_t t = wheel->now_ms + 1U;
+        wheel->now_ms = t;
+
+        // Start of a new lap on level 0: cascade from the highest level
+        // whose lap also starts here, so its timers can land in the slots
+        // cascaded after it
+        if ((t & SLOT_MASK) == 0) {
+            uint8_t top = 1;
+            while (top + 1U < TIMER_WHEEL_LEVELS &&
+                   (t & ((1ULL << ((top + 1U) * TIMER_WHEEL_SLOT_BITS)) - 1U)) == 0) {
+                top++;
+            }
+            for (uint8_t level = top; level >= 1; level--) {
+                if (wheel->occupied[level] != 0) {
+                    cascade(wheel, level, t);
+                }
+            }
+        }
+
+        uint8_t index = (uint8_t)(t & SLOT_MASK);
+        if (wheel->occupied[0] & (1UL << index)) {
+            expire(wheel, index, t);
+        }
+
+        // Jump over the empty stretch to just before the next expiry or
+        // cascade; an empty wheel catches up in one step
+        uint64_t next = timer_wheel_next_event(wheel);
+        uint64_t skip_to = (next - 1U < now_ms) ? next - 1U : now_ms;
+        if (skip_to > wheel->now_ms) {
+            wheel->now_ms = skip_to;
+        }
+    }
+}
+
+uint64_t timer_wheel_next_event(const TimerWheel *wheel) {
+    uint64_t next = TIMER_WHEEL_NEVER;
+    uint64_t now = wheel->now_ms;
+
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint8_t shift = (uint8_t)(level * TIMER_WHEEL_SLOT_BITS);
+        uint32_t ahead = slots_ahead(wheel->occupied[level], (uint32_t)((now >> shift) & SLOT_MASK));
+        if (ahead != 0) {
+            // Level 0: expiry time. Above: start of the block that cascades the slot
+            uint64_t when = ((now >> shift) + ahead) << shift;
+            if (when < next) {
+                next = when;
+            }
+        }
+    }
+    return next;
+}
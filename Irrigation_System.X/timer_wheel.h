@@ -0,0 +1,131 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel and 64-bit extension of the 1 ms tick.
+ *
+ * Timers are caller-owned structs linked into the wheel, so arming and
+ * cancelling never allocate. The wheel has TIMER_WHEEL_LEVELS levels of
+ * TIMER_WHEEL_SLOTS slots. Level 0 has 1 ms slots, and every level above
+ * has slots one full lap of the level below wide. A timer goes into the
+ * lowest level whose lap covers its delay, and into the slot its expiry
+ * time falls in. Arming and cancelling are therefore O(1). Whenever a
+ * lower level completes a lap, the next slot of the level above is
+ * cascaded: its timers move down to their exact position. Each timer
+ * moves at most TIMER_WHEEL_LEVELS - 1 times before it fires. Timers
+ * beyond the top level's range wait in its furthest slot and are
+ * re-placed when it comes around.
+ *
+ * An occupancy bitmap per level lets timer_wheel_advance() skip empty
+ * stretches. It also gives timer_wheel_next_event() the time the main
+ * loop may sleep until.
+ *
+ * Callbacks run from timer_wheel_advance(), in the caller's context. They
+ * may arm or cancel any timer, including their own. The module has no
+ * hardware dependencies; systime.h binds it to the 1 ms tick.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 4 levels of 32 slots: 2^20 ms (17.5 min) before timers need re-placing
+#ifndef TIMER_WHEEL_SLOT_BITS
+#define TIMER_WHEEL_SLOT_BITS 5
+#endif
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS    4
+#endif
+
+#define TIMER_WHEEL_SLOTS     (1U << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_NEVER     UINT64_MAX
+
+typedef struct Timer Timer;
+typedef void (*TimerCallback)(Timer *timer, void *context);
+
+struct Timer {
+    Timer *next;                 // Slot list; pprev is NULL while disarmed
+    Timer **pprev;
+    uint64_t expires_ms;
+    uint32_t period_ms;          // 0 for one-shot timers
+    uint8_t slot;                // level * TIMER_WHEEL_SLOTS + index
+    TimerCallback callback;
+    void *context;
+};
+
+typedef struct {
+    uint64_t now_ms;             // Last time processed
+    uint32_t occupied[TIMER_WHEEL_LEVELS];
+    Timer *slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+} TimerWheel;
+
+// Extends a wrapping 32-bit millisecond count to 64 bits
+typedef struct {
+    uint32_t high;
+    uint32_t last_low;
+} TickExtender;
+
+/**
+ * @brief Empties the wheel and starts it at @p now_ms.
+ */
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_ms);
+
+/**
+ * @brief Prepares a timer; it starts disarmed.
+ */
+void timer_init(Timer *timer, TimerCallback callback, void *context);
+
+/**
+ * @brief Arms (or re-arms) @p timer to fire @p delay_ms after the wheel's
+ * current time, then every @p period_ms if that is not 0. O(1).
+ *
+ * A delay of 0 fires on the next timer_wheel_advance() that moves time
+ * forward.
+ */
+void timer_arm(TimerWheel *wheel, Timer *timer, uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Arms @p timer for an absolute time; past times fire at the next
+ * advance. O(1).
+ */
+void timer_arm_at(TimerWheel *wheel, Timer *timer, uint64_t expires_ms, uint32_t period_ms);
+
+/**
+ * @brief Disarms @p timer; harmless if it is not armed. O(1).
+ */
+void timer_cancel(TimerWheel *wheel, Timer *timer);
+
+static inline bool timer_is_armed(const Timer *timer) {
+    return timer->pprev != 0;
+}
+
+/**
+ * @brief Moves the wheel to @p now_ms and runs every callback due by then,
+ * in expiry order per millisecond.
+ *
+ * Periodic timers keep their phase. A periodic timer that fell more than
+ * one period behind fires once and then resumes from now.
+ */
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now_ms);
+
+/**
+ * @brief Earliest time the wheel has work: a timer expiry or a cascade
+ * of a non-empty slot. TIMER_WHEEL_NEVER if the wheel is empty.
+ */
+uint64_t timer_wheel_next_event(const TimerWheel *wheel);
+
+/**
+ * @brief Extends a 32-bit tick reading to 64 bits.
+ *
+ * Must see every wrap, so it must be called at least once per 2^32 ms
+ * (49.7 days). The caller provides any locking.
+ */
+static inline uint64_t tick_extender_update(TickExtender *extender, uint32_t low) {
+    if (low < extender->last_low) {
+        extender->high++;
+    }
+    extender->last_low = low;
+    return ((uint64_t)extender->high << 32) | low;
+}
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,98 @@
+/**
+ * @file trace.c
+ * @brief Event trace ring buffer: retention across reset, UART dump and
+ * cost measurement.
+ */
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include "definitions.h"
+#include "fmt.h"
+#include "cycle_counter.h"
+
+#define TRACE_COST_SAMPLES 16
+
+// Not cleared by the startup code so it survives warm resets
+TraceBuffer trace_buffer __attribute__((persistent));
+
+void trace_init(void) {
+    if (trace_buffer.magic != TRACE_MAGIC) {
+        trace_clear();
+    }
+    TRACE(TRACE_EVT_BOOT, PM->RCAUSE.reg, 0);
+}
+
+void trace_clear(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    trace_buffer.head = 0;
+    trace_buffer.magic = TRACE_MAGIC;
+    __set_PRIMASK(primask);
+}
+
+void trace_dump(void) {
+    // Snapshot the head so events recorded while dumping do not shift the window
+    uint32_t head = trace_buffer.head;
+    uint32_t count = (head < TRACE_BUFFER_RECORDS) ? head : TRACE_BUFFER_RECORDS;
+    uint32_t lost = head - count;
+
+    char storage[24];
+    FmtBuffer line;
+    fmt_init(&line, storage, sizeof(storage));
+    fmt_str(&line, "TRACE BEGIN ");
+    fmt_u32(&line, count, 0);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, lost, 0);
+    fmt_str(&line, "\r\n");
+    fmt_uart_write(&line);
+    for (uint32_t i = head - count; i != head; i++) {
+        const TraceRecord *record = &trace_buffer.records[i & (TRACE_BUFFER_RECORDS - 1)];
+        fmt_init(&line, storage, sizeof(storage));
+        fmt_hex(&line, record->timestamp, 8);
+        fmt_char(&line, ' ');
+        fmt_hex(&line, record->event, 2);
+        fmt_char(&line, ' ');
+        fmt_hex(&line, record->arg8, 2);
+        fmt_char(&line, ' ');
+        fmt_hex(&line, record->arg16, 4);
+        fmt_str(&line, "\r\n");
+        fmt_uart_write(&line);
+    }
+    fmt_uart_str("TRACE END\r\n");
+}
+
+void trace_fsm_transition(uint8_t machine, uint8_t from, uint8_t to, uint8_t event) {
+    TRACE(TRACE_EVT_FSM_TRANSITION, (machine << 5) | (event & 0x1FU),
+          ((uint16_t)from << 8) | to);
+}
+
+uint32_t trace_measure_cost(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Record into the live buffer, then restore the overwritten slots and
+    // roll the head back so the benchmark leaves no marks behind
+    TraceRecord saved[TRACE_COST_SAMPLES];
+    uint32_t saved_head = trace_buffer.head;
+    for (uint32_t i = 0; i < TRACE_COST_SAMPLES; i++) {
+        saved[i] = trace_buffer.records[(saved_head + i) & (TRACE_BUFFER_RECORDS - 1)];
+    }
+
+    uint32_t start = cycle_counter_now();
+    for (uint32_t i = 0; i < TRACE_COST_SAMPLES; i++) {
+        TRACE(TRACE_EVT_MARK, i, 0);
+    }
+    uint32_t cycles = cycle_counter_elapsed(start);
+
+    for (uint32_t i = 0; i < TRACE_COST_SAMPLES; i++) {
+        trace_buffer.records[(saved_head + i) & (TRACE_BUFFER_RECORDS - 1)] = saved[i];
+    }
+    trace_buffer.head = saved_head;
+
+    __set_PRIMASK(primask);
+    return cycles / TRACE_COST_SAMPLES;
+}
+
+#endif // TRACE_ENABLED
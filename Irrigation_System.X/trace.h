@@ -0,0 +1,157 @@
+/**
+ * @file trace.h
+ * @brief Low-overhead binary event trace kept in a RAM ring buffer.
+ *
+ * Each event is an 8-byte record (millisecond timestamp, event id and two
+ * small arguments) written into a power-of-two ring buffer. The buffer lives
+ * in persistent (not initialized at startup) RAM, so the events leading up
+ * to a watchdog or brownout reset can still be dumped after the warm boot.
+ *
+ * Instrument code with the TRACE() macro. Building with TRACE_ENABLED set
+ * to 0 removes every TRACE() site and the buffer from the image.
+ *
+ * The buffer is retrieved over the UART with trace_dump() (bound to the
+ * TRACE_DUMP_COMMAND character in Check_Commands) and decoded on the host
+ * with tools/trace_decode.py.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_BUFFER_RECORDS 128     // Must be a power of two (1 KB of RAM)
+#define TRACE_MAGIC          0x54524345 // "TRCE", marks a valid retained buffer
+#define TRACE_DUMP_COMMAND   'T'     // UART command character for trace_dump()
+
+// Event identifiers. Keep in sync with EVENT_NAMES in tools/trace_decode.py.
+typedef enum {
+    TRACE_EVT_BOOT = 1,          // arg8: PM->RCAUSE
+    TRACE_EVT_STATE_CHANGE,      // arg8: old State_t, arg16: new State_t
+    TRACE_EVT_PUMP_ON,           // arg16: TCC compare value
+    TRACE_EVT_PUMP_OFF,          // arg16: total volume dispensed (whole mL, saturated)
+    TRACE_EVT_MOISTURE_READING,  // arg8: moisture %, arg16: raw ADC value
+    TRACE_EVT_CALIBRATION,       // arg8: CalibrationState, arg16: ADC value
+    TRACE_EVT_MARK,              // Free-form marker for debugging
+    TRACE_EVT_BOOT_MILESTONE,    // arg8: BootMilestone, arg16: us since timer start
+    TRACE_EVT_INTERLOCK_TRIP,    // arg8: InterlockTrip, arg16: volume of the run (mL, saturated)
+    TRACE_EVT_CONFIG,            // arg8: ConfigResult, arg16: block version (low 16 bits)
+    TRACE_EVT_FSM_TRANSITION,    // arg8: machine << 5 | event, arg16: from << 8 | to
+    TRACE_EVT_FW_UPDATE          // arg8: frame kind << 4 | FwResult, arg16: next row
+} TraceEventId;
+
+// Machines in TRACE_EVT_FSM_TRANSITION records (see hsm.h)
+#define TRACE_FSM_APP          0U   // State_t, app_state.c
+#define TRACE_FSM_MOISTURE     1U   // MoistureSensorState
+#define TRACE_FSM_CALIBRATION  2U   // CalibrationState
+
+// One trace record. The layout is part of the dump format.
+typedef struct {
+    uint32_t timestamp;  // systemTicks (ms) when the event was recorded
+    uint8_t event;       // TraceEventId
+    uint8_t arg8;
+    uint16_t arg16;
+} TraceRecord;
+
+/**
+ * @brief Converts a count to an arg16, saturating at 65535 instead of
+ * wrapping.
+ */
+static inline uint16_t trace_arg16(uint32_t value) {
+    return value > 0xFFFFU ? 0xFFFFU : (uint16_t)value;
+}
+
+/**
+ * @brief Converts a non-negative quantity (e.g. mL) to an arg16, rounded
+ * to the nearest whole unit and saturated at 65535.
+ */
+static inline uint16_t trace_arg16_f(float value) {
+    if (!(value > 0.0f)) {
+        return 0U;
+    }
+    return value >= 65534.5f ? 0xFFFFU : (uint16_t)(value + 0.5f);
+}
+
+#if TRACE_ENABLED
+
+#include "definitions.h" // __disable_irq / __get_PRIMASK
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head;       // Total records written; index = head % size
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+} TraceBuffer;
+
+extern TraceBuffer trace_buffer;
+extern volatile uint32_t systemTicks;
+
+/**
+ * @brief Appends one record to the ring buffer. Safe from ISR and main context.
+ * Only the slot reservation runs with interrupts masked.
+ */
+static inline void trace_record(uint8_t event, uint8_t arg8, uint16_t arg16) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t index = trace_buffer.head++;
+    __set_PRIMASK(primask);
+
+    TraceRecord *record = &trace_buffer.records[index & (TRACE_BUFFER_RECORDS - 1)];
+    record->timestamp = systemTicks;
+    record->event = event;
+    record->arg8 = arg8;
+    record->arg16 = arg16;
+}
+
+#define TRACE(event, arg8, arg16) \
+    trace_record((uint8_t)(event), (uint8_t)(arg8), (uint16_t)(arg16))
+
+/**
+ * @brief hsm.h trace hook: records a TRACE_EVT_FSM_TRANSITION. A forced
+ * transition (no event) is recorded as event 31.
+ */
+void trace_fsm_transition(uint8_t machine, uint8_t from, uint8_t to, uint8_t event);
+#define TRACE_FSM_HOOK trace_fsm_transition
+
+/**
+ * @brief Validates the retained buffer after reset and logs a boot event.
+ * Clears the buffer only on a cold boot (magic number missing).
+ * Call once at startup, before any TRACE() site can run.
+ */
+void trace_init(void);
+
+/**
+ * @brief Discards all recorded events.
+ */
+void trace_clear(void);
+
+/**
+ * @brief Writes the buffer contents, oldest first, to the UART.
+ * Output is line based: "TRACE BEGIN <count> <lost>", one hex record per
+ * line, then "TRACE END".
+ */
+void trace_dump(void);
+
+/**
+ * @brief Measures the average cost of one TRACE() call.
+ * The buffer contents are left unchanged.
+ * @return CPU cycles per recorded event.
+ */
+uint32_t trace_measure_cost(void);
+
+#else
+
+#define TRACE(event, arg8, arg16) ((void)0)
+#define trace_init()              ((void)0)
+#define trace_clear()             ((void)0)
+#define trace_dump()              ((void)0)
+#define trace_measure_cost()      (0U)
+#define TRACE_FSM_HOOK            NULL
+
+#endif // TRACE_ENABLED
+
+#endif // TRACE_H
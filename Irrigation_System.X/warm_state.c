@@ -0,0 +1,67 @@
+/**
+ * @file warm_state.c
+ * @brief CRC-guarded persistent RAM block and warm/cold boot detection.
+ */
+
+#include "warm_state.h"
+#include <stddef.h>
+#include <string.h>
+#include "definitions.h"
+#include "crc32.h"
+#include "LCD1602A.h"
+
+// Not cleared by the startup code so it survives warm resets
+static WarmState warm_state __attribute__((persistent));
+
+static bool warm_boot = false;
+static bool resume_allowed = false;
+
+static uint32_t warm_state_crc(void) {
+    return crc32_update(CRC32_INITIAL, &warm_state, offsetof(WarmState, crc));
+}
+
+BootKind warm_state_init(void) {
+    uint8_t reset_cause = PM->RCAUSE.reg;
+    bool power_lost = (reset_cause & PM_RCAUSE_POR_Msk) != 0;
+    bool brownout = (reset_cause & (PM_RCAUSE_BOD12_Msk | PM_RCAUSE_BOD33_Msk)) != 0;
+
+    // RAM survives a brownout often enough to be worth checking; the CRC
+    // decides whether it actually did
+    warm_boot = !power_lost &&
+                warm_state.magic == WARM_STATE_MAGIC &&
+                warm_state.crc == warm_state_crc();
+    resume_allowed = warm_boot && !brownout;
+
+    if (warm_boot) {
+        warm_state.warm_boot_count++;
+        current_plant_index = warm_state.current_plant_index;
+        if (!resume_allowed) {
+            warm_state.pump_percentage = 0.0f;
+        }
+    } else {
+        memset(&warm_state, 0, sizeof(warm_state));
+        warm_state.magic = WARM_STATE_MAGIC;
+        warm_state.current_plant_index = current_plant_index;
+    }
+    warm_state_commit();
+
+    boot_monitor_set_kind(warm_boot ? BOOT_WARM : BOOT_COLD, reset_cause);
+    boot_monitor_mark(BOOT_MILESTONE_STATE_RESTORED);
+    return warm_boot ? BOOT_WARM : BOOT_COLD;
+}
+
+bool warm_state_is_warm(void) {
+    return warm_boot;
+}
+
+bool warm_state_resume_allowed(void) {
+    return resume_allowed;
+}
+
+WarmState *warm_state_get(void) {
+    return &warm_state;
+}
+
+void warm_state_commit(void) {
+    warm_state.crc = warm_state_crc();
+}
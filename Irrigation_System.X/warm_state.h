@@ -0,0 +1,73 @@
+/**
+ * @file warm_state.h
+ * @brief Runtime state retained across warm resets in persistent RAM.
+ *
+ * The block is not cleared by the startup code and is guarded by a magic
+ * number and a CRC-32. After a watchdog, system or external reset with a
+ * valid block, the firmware restores pump accounting, the selected plant
+ * and the calibration values without touching flash or the UART.
+ * Power-on resets and any CRC mismatch fall back to a cold boot.
+ *
+ * Writers modify fields through warm_state_get() and then call
+ * warm_state_commit(). A reset between the two leaves a CRC mismatch and
+ * the next boot is treated as cold, which is always safe.
+ */
+
+#ifndef WARM_STATE_H
+#define WARM_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "boot_monitor.h"
+
+#define WARM_STATE_MAGIC 0x57524D53 // "WRMS"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t warm_boot_count;         // Consecutive warm boots since the last cold boot
+    float total_volume_ml;            // Pump accounting, including checkpointed run time
+    float pump_percentage;            // Duty cycle of the run in progress, 0 if stopped
+    int32_t current_plant_index;
+    uint16_t dry_calibration_value;
+    uint16_t wet_calibration_value;
+    uint8_t calibration_valid;
+    uint8_t interlock_trip;           // Latched InterlockTrip, keeps the pump locked out
+    uint8_t pump_zone;
+    uint8_t reserved;
+    uint32_t pump_run_ms;             // Interlock usage of the run in progress
+    uint32_t pump_run_ml;
+    uint32_t crc;                     // CRC-32 of all fields above
+} WarmState;
+
+/**
+ * @brief Classifies the boot from PM->RCAUSE and the retained block.
+ * Initializes the block on a cold boot, restores current_plant_index on a
+ * warm boot and marks BOOT_MILESTONE_STATE_RESTORED.
+ * Call right after SYS_Initialize(), before pump_init() and calibration_init().
+ * @return BOOT_WARM if the retained state is valid and may be used.
+ */
+BootKind warm_state_init(void);
+
+/**
+ * @brief Returns true if this boot restored retained state.
+ */
+bool warm_state_is_warm(void);
+
+/**
+ * @brief Returns true if a watering run interrupted by the reset may be
+ * resumed. False after a brownout, which the pump itself may have caused.
+ */
+bool warm_state_resume_allowed(void);
+
+/**
+ * @brief Gives write access to the retained block. Call warm_state_commit()
+ * after changing fields.
+ */
+WarmState *warm_state_get(void);
+
+/**
+ * @brief Recomputes the CRC after fields were changed.
+ */
+void warm_state_commit(void);
+
+#endif // WARM_STATE_H
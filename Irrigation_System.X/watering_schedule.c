@@ -0,0 +1,149 @@
+/**
+ * @file watering_schedule.c
+ * @brief Schedule table and binary min-heap of next occurrences.
+ */
+
+#include "watering_schedule.h"
+#include <string.h>
+
+#define SECONDS_PER_DAY     86400UL
+#define EPOCH_WEEKDAY       3       // 1970-01-01 was a Thursday (Monday = 0)
+
+// Heap order: earlier fire time first, table order breaks ties
+static bool heap_before(const ScheduleHeapNode *a, const ScheduleHeapNode *b) {
+    return (a->fire_s < b->fire_s) || (a->fire_s == b->fire_s && a->entry < b->entry);
+}
+
+static void heap_sift_down(WateringSchedule *schedule, uint16_t index) {
+    ScheduleHeapNode *heap = schedule->heap;
+    uint16_t size = schedule->heap_size;
+    ScheduleHeapNode node = heap[index];
+
+    for (;;) {
+        uint16_t child = (uint16_t)(2U * index + 1U);
+        if (child >= size) {
+            break;
+        }
+        if (child + 1U < size && heap_before(&heap[child + 1U], &heap[child])) {
+            child++;
+        }
+        if (!heap_before(&heap[child], &node)) {
+            break;
+        }
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = node;
+}
+
+static void heap_sift_up(WateringSchedule *schedule, uint16_t index) {
+    ScheduleHeapNode *heap = schedule->heap;
+    ScheduleHeapNode node = heap[index];
+
+    while (index > 0) {
+        uint16_t parent = (uint16_t)((index - 1U) / 2U);
+        if (!heap_before(&node, &heap[parent])) {
+            break;
+        }
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = node;
+}
+
+uint32_t schedule_entry_next_fire(const ScheduleEntry *entry, uint32_t now_s) {
+    if ((entry->weekdays & SCHEDULE_DAILY) == 0) {
+        return SCHEDULE_NEVER;
+    }
+    uint32_t day = now_s / SECONDS_PER_DAY;
+    uint32_t fire_offset = (uint32_t)entry->minute_of_day * 60U;
+    uint8_t weekday = (uint8_t)((day + EPOCH_WEEKDAY) % 7U);
+
+    // Today if the time is still ahead, otherwise the first masked day after
+    uint8_t first = (now_s - day * SECONDS_PER_DAY < fire_offset) ? 0U : 1U;
+    for (uint8_t ahead = first; ahead <= 7U; ahead++) {
+        uint8_t candidate = (uint8_t)((weekday + ahead) % 7U);
+        if (entry->weekdays & (1U << candidate)) {
+            uint64_t fire = (uint64_t)(day + ahead) * SECONDS_PER_DAY + fire_offset;
+            return (fire < SCHEDULE_NEVER) ? (uint32_t)fire : SCHEDULE_NEVER;
+        }
+    }
+    return SCHEDULE_NEVER;
+}
+
+void schedule_init(WateringSchedule *schedule) {
+    schedule->count = 0;
+    schedule->heap_size = 0;
+}
+
+bool schedule_entry_is_valid(const ScheduleEntry *entry) {
+    return entry->minute_of_day < SCHEDULE_MINUTES_PER_DAY &&
+           (entry->weekdays & ~SCHEDULE_DAILY) == 0 && entry->volume_ml > 0;
+}
+
+void schedule_rebuild(WateringSchedule *schedule, uint32_t now_s) {
+    uint16_t size = 0;
+    for (uint16_t i = 0; i < schedule->count; i++) {
+        uint32_t fire = schedule_entry_next_fire(&schedule->entries[i], now_s);
+        if (fire != SCHEDULE_NEVER) {
+            schedule->heap[size].fire_s = fire;
+            schedule->heap[size].entry = i;
+            schedule->heap[size].reserved = 0;
+            size++;
+        }
+    }
+    schedule->heap_size = size;
+    // Bottom-up heap construction
+    for (uint16_t i = size / 2U; i-- > 0;) {
+        heap_sift_down(schedule, i);
+    }
+}
+
+bool schedule_add(WateringSchedule *schedule, const ScheduleEntry *entry, uint32_t now_s) {
+    if (schedule->count >= SCHEDULE_MAX_ENTRIES || !schedule_entry_is_valid(entry)) {
+        return false;
+    }
+    uint16_t index = schedule->count++;
+    schedule->entries[index] = *entry;
+    schedule->entries[index].reserved = 0;
+
+    uint32_t fire = schedule_entry_next_fire(entry, now_s);
+    if (fire != SCHEDULE_NEVER) {
+        uint16_t slot = schedule->heap_size++;
+        schedule->heap[slot].fire_s = fire;
+        schedule->heap[slot].entry = index;
+        schedule->heap[slot].reserved = 0;
+        heap_sift_up(schedule, slot);
+    }
+    return true;
+}
+
+bool schedule_remove(WateringSchedule *schedule, uint16_t index, uint32_t now_s) {
+    if (index >= schedule->count) {
+        return false;
+    }
+    memmove(&schedule->entries[index], &schedule->entries[index + 1U],
+            (size_t)(schedule->count - index - 1U) * sizeof(ScheduleEntry));
+    schedule->count--;
+    // Indices shifted; removal is rare, so rebuild instead of patching
+    schedule_rebuild(schedule, now_s);
+    return true;
+}
+
+uint32_t schedule_next_fire(const WateringSchedule *schedule) {
+    return (schedule->heap_size > 0) ? schedule->heap[0].fire_s : SCHEDULE_NEVER;
+}
+
+bool schedule_pop_due(WateringSchedule *schedule, uint32_t now_s, ScheduleEntry *entry) {
+    if (schedule->heap_size == 0 || schedule->heap[0].fire_s > now_s) {
+        return false;
+    }
+    ScheduleHeapNode *root = &schedule->heap[0];
+    *entry = schedule->entries[root->entry];
+
+    // Re-key the root with the entry's next occurrence after now and sift
+    // it down; a late clock skips the missed days instead of replaying them
+    root->fire_s = schedule_entry_next_fire(entry, now_s);
+    heap_sift_down(schedule, 0);
+    return true;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file watering_schedule.h
+ * @brief Time-based watering schedule with a heap-ordered next-event index.
+ *
+ * Each entry waters one zone with a fixed volume at a time of day on the
+ * weekdays in its mask ("zone 3, daily 06:00, 120 mL"). Next to the entry
+ * table the schedule keeps a binary min-heap of (next fire time, entry),
+ * so the next due event is at the root: looking it up is O(1), and firing
+ * it and re-inserting the entry at its following occurrence is one
+ * O(log n) sift. Entries are not rescanned when the clock ticks, and the
+ * main loop can sleep until schedule_next_fire().
+ *
+ * Times are local wall-clock seconds since 1970-01-01 00:00 (a Thursday).
+ * Time zones and DST are left to whoever sets the clock. The module has no
+ * hardware dependencies; schedule_runner.c adds the clock, flash storage
+ * and the pump, and tools/schedule_bench.c benchmarks it on the host.
+ */
+
+#ifndef WATERING_SCHEDULE_H
+#define WATERING_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Entries held in RAM; the host benchmark builds with a larger table
+#ifndef SCHEDULE_MAX_ENTRIES
+#define SCHEDULE_MAX_ENTRIES 64
+#endif
+
+#define SCHEDULE_NEVER       UINT32_MAX   // Next fire time of an empty schedule
+#define SCHEDULE_MINUTES_PER_DAY 1440U
+
+// Weekday mask bits
+#define SCHEDULE_MONDAY      0x01
+#define SCHEDULE_TUESDAY     0x02
+#define SCHEDULE_WEDNESDAY   0x04
+#define SCHEDULE_THURSDAY    0x08
+#define SCHEDULE_FRIDAY      0x10
+#define SCHEDULE_SATURDAY    0x20
+#define SCHEDULE_SUNDAY      0x40
+#define SCHEDULE_DAILY       0x7F
+
+// One table entry; the layout is part of the flash format
+typedef struct {
+    uint8_t zone;
+    uint8_t weekdays;            // SCHEDULE_* mask, 0 disables the entry
+    uint16_t minute_of_day;      // 0..1439
+    uint16_t volume_ml;
+    uint16_t reserved;
+} ScheduleEntry;
+
+typedef struct {
+    uint32_t fire_s;             // Next occurrence of the entry
+    uint16_t entry;              // Index into entries[]
+    uint16_t reserved;
+} ScheduleHeapNode;
+
+typedef struct {
+    ScheduleEntry entries[SCHEDULE_MAX_ENTRIES];
+    uint16_t count;
+    uint16_t heap_size;          // Enabled entries
+    ScheduleHeapNode heap[SCHEDULE_MAX_ENTRIES];
+} WateringSchedule;
+
+/**
+ * @brief Empties the schedule.
+ */
+void schedule_init(WateringSchedule *schedule);
+
+/**
+ * @brief Checks an entry's fields.
+ */
+bool schedule_entry_is_valid(const ScheduleEntry *entry);
+
+/**
+ * @brief Adds an entry; its first occurrence is the next one after @p now_s.
+ * @return false if the entry is invalid or the table is full.
+ */
+bool schedule_add(WateringSchedule *schedule, const ScheduleEntry *entry, uint32_t now_s);
+
+/**
+ * @brief Removes entry @p index; later entries move down by one.
+ */
+bool schedule_remove(WateringSchedule *schedule, uint16_t index, uint32_t now_s);
+
+/**
+ * @brief Recomputes every occurrence from @p now_s, e.g. after the clock
+ * was set or the table was loaded. O(n).
+ */
+void schedule_rebuild(WateringSchedule *schedule, uint32_t now_s);
+
+/**
+ * @brief Time of the next due event, SCHEDULE_NEVER if there is none. O(1).
+ */
+uint32_t schedule_next_fire(const WateringSchedule *schedule);
+
+/**
+ * @brief Takes the next event if it is due at @p now_s and moves the entry
+ * to its following occurrence. O(log n).
+ *
+ * Occurrences missed while the clock was behind fire once, not once per
+ * missed day.
+ * @param entry Receives the due entry.
+ * @return true if an event was due.
+ */
+bool schedule_pop_due(WateringSchedule *schedule, uint32_t now_s, ScheduleEntry *entry);
+
+/**
+ * @brief First occurrence of @p entry strictly after @p now_s, or
+ * SCHEDULE_NEVER for a disabled entry.
+ */
+uint32_t schedule_entry_next_fire(const ScheduleEntry *entry, uint32_t now_s);
+
+#endif // WATERING_SCHEDULE_H
@@ -0,0 +1,103 @@
+/**
+ * @file bootloader.c
+ * @brief Resident bootloader: installs a staged update, then starts slot A.
+ *
+ * Lives in the first 4 KB of flash (see fw_patch.h for the layout) and
+ * uses no Harmony code, only the device header and NVMCTRL registers.
+ * At every reset:
+ *  - a READY or INSTALLING update is copied from slot B to slot A with
+ *    fw_install(), at 8 MHz, and the chip resets again so the application
+ *    starts from a clean reset state;
+ *  - otherwise the application in slot A is started if its vector table
+ *    looks valid.
+ * If the copy fails halfway, slot A is incomplete and the bootloader
+ * stops. The next reset retries the copy, which resumes at its last
+ * checkpoint.
+ *
+ * Built as its own XC32 project for the ATSAMD21G17D, without MCC:
+ *  - sources: this file, ../Irrigation_System.X/fw_patch.c and
+ *    ../Irrigation_System.X/crc32.c, with ../Irrigation_System.X on the
+ *    include path;
+ *  - -Os -ffunction-sections and the linker's --gc-sections, so only the
+ *    install half of fw_patch.c is kept;
+ *  - linker macro ROM_LENGTH=0x1000;
+ *  - the BOOTPROT fuse set to 4 KB so the application cannot erase it.
+ */
+
+#include "sam.h"
+#include "fw_patch.h"
+
+static const uint8_t *flash_map(void *context, uint32_t address) {
+    (void)context;
+    return (const uint8_t *)address;
+}
+
+static void nvm_command(uint32_t address, uint32_t command) {
+    NVMCTRL->ADDR.reg = address / 2U;   // 16-bit word address
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | command;
+    while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+static bool is_rww(uint32_t address) {
+    return address >= NVMCTRL_RWW_EEPROM_ADDR;
+}
+
+static void flash_erase_row(void *context, uint32_t address) {
+    (void)context;
+    nvm_command(address, is_rww(address) ? NVMCTRL_CTRLA_CMD_RWWEEER : NVMCTRL_CTRLA_CMD_ER);
+}
+
+static void flash_write_page(void *context, uint32_t address, const uint32_t *data) {
+    (void)context;
+    volatile uint32_t *buffer = (volatile uint32_t *)address;
+
+    nvm_command(address, NVMCTRL_CTRLA_CMD_PBC);
+    // Writes to the flash address range fill the page buffer
+    for (uint32_t i = 0; i < FW_PAGE_SIZE / sizeof(uint32_t); i++) {
+        buffer[i] = data[i];
+    }
+    nvm_command(address, is_rww(address) ? NVMCTRL_CTRLA_CMD_RWWEEWP : NVMCTRL_CTRLA_CMD_WP);
+}
+
+static const FwFlash flash = { flash_map, flash_erase_row, flash_write_page, NULL };
+
+static void halt(void) {
+    while (1) {
+        __WFI();
+    }
+}
+
+static void start_application(void) {
+    const uint32_t *vectors = (const uint32_t *)FW_SLOT_A_ADDRESS;
+    uint32_t stack = vectors[0];
+    uint32_t reset = vectors[1];
+
+    // Erased or foreign flash: nothing to start
+    if ((stack & 0xFFF00000U) != HMCRAMC0_ADDR || reset < FW_SLOT_A_ADDRESS ||
+        reset >= FW_SLOT_A_ADDRESS + FW_SLOT_SIZE) {
+        halt();
+    }
+    SCB->VTOR = FW_SLOT_A_ADDRESS;
+    __set_MSP(stack);
+    ((void (*)(void))reset)();
+}
+
+int main(void) {
+    FwProgress progress;
+
+    // Page writes only on command, as the FwFlash functions issue them
+    NVMCTRL->CTRLB.bit.MANW = 1;
+
+    fw_progress_load(&flash, &progress, NULL);
+    if (progress.state == FW_STATE_READY || progress.state == FW_STATE_INSTALLING) {
+        SYSCTRL->OSC8M.bit.PRESC = 0;   // 8 MHz for the CRCs and the copy
+        fw_install(&flash);
+        fw_progress_load(&flash, &progress, NULL);
+        if (progress.state == FW_STATE_INSTALLING) {
+            halt();
+        }
+        NVIC_SystemReset();
+    }
+    start_application();
+    halt();
+}
@@ -0,0 +1,186 @@
+/*
+ * Host-side master for the shared RS-485 bus; see bus_master.h.
+ */
+
+#include "bus_master.h"
+#include <string.h>
+
+static uint64_t char_time_us(const BusMaster *master, uint32_t characters) {
+    return ((uint64_t)characters * master->char_us_x16 + 15U) / 16U;
+}
+
+void bus_master_init(BusMaster *master, const BusMasterConfig *config) {
+    memset(master, 0, sizeof(*master));
+    master->config = *config;
+    // 10 bits per character (start, 8 data, stop)
+    master->char_us_x16 = (uint32_t)((16ULL * 10U * 1000000U + config->baud - 1U) / config->baud);
+    bus_decoder_init(&master->decoder, BUS_ADDRESS_MASTER);
+}
+
+bool bus_master_add_node(BusMaster *master, uint8_t address) {
+    if (master->count == BUS_MASTER_MAX_NODES || address < BUS_ADDRESS_MIN ||
+        address > BUS_ADDRESS_MAX) {
+        return false;
+    }
+    BusMasterNode *node = &master->nodes[master->count++];
+    memset(node, 0, sizeof(*node));
+    node->address = address;
+    node->online = true;
+    return true;
+}
+
+bool bus_master_queue_command(BusMaster *master, uint8_t address, uint8_t command) {
+    for (size_t i = 0; i < master->count; i++) {
+        if (master->nodes[i].address == address) {
+            master->nodes[i].command = command;
+            master->nodes[i].command_pending = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Round robin; an offline node is passed over until its skip count runs out
+static BusMasterNode *bus_master_pick(BusMaster *master) {
+    size_t limit = master->count * ((size_t)master->config.offline_rounds + 1U);
+    for (size_t tries = 0; tries < limit; tries++) {
+        BusMasterNode *node = &master->nodes[master->next];
+        master->next = (master->next + 1U) % master->count;
+        if (!node->online && node->skip > 0) {
+            node->skip--;
+            continue;
+        }
+        return node;
+    }
+    return NULL;
+}
+
+size_t bus_master_start_poll(BusMaster *master, uint64_t now_us, uint8_t *frame) {
+    if (master->count == 0) {
+        return 0;
+    }
+    BusMasterNode *node = bus_master_pick(master);
+    if (node == NULL) {
+        return 0;
+    }
+
+    uint8_t payload[sizeof(BusPoll) + 1];
+    payload[0] = master->config.acknowledge ? node->ack_sequence : 0;
+    size_t length;
+    if (node->command_pending) {
+        payload[1] = node->command;
+        length = bus_frame_encode(frame, node->address, BUS_ADDRESS_MASTER, BUS_TYPE_COMMAND,
+                                  payload, sizeof(payload));
+    } else {
+        length = bus_frame_encode(frame, node->address, BUS_ADDRESS_MASTER, BUS_TYPE_POLL,
+                                  payload, sizeof(BusPoll));
+    }
+
+    node->polls++;
+    master->current = node;
+    master->answer_started = false;
+    master->corrupted = false;
+    master->poll_start_us = now_us;
+    bus_decoder_reset(&master->decoder);
+    // The answer's first character must be complete one character after the
+    // node's turnaround; one more character absorbs baud and clock error
+    master->deadline_us = now_us + char_time_us(master, (uint32_t)length + 2U) +
+                          master->config.turnaround_us;
+    return length;
+}
+
+static void bus_master_answered(BusMasterNode *node, uint64_t now_us) {
+    if (node->last_answer_us != 0 && now_us - node->last_answer_us > node->worst_gap_us) {
+        node->worst_gap_us = now_us - node->last_answer_us;
+    }
+    node->last_answer_us = now_us;
+    node->answers++;
+    node->misses = 0;
+    node->online = true;
+    node->backoff = 0;
+    node->command_pending = false;  // A node answers a COMMAND only after taking it
+}
+
+BusMasterEvent bus_master_receive(BusMaster *master, uint8_t byte, uint64_t now_us,
+                                  BusMasterNode **node_out, BusStatus *status) {
+    BusMasterNode *node = master->current;
+    if (node == NULL) {
+        return BUS_MASTER_BUSY;  // Stray byte between transactions
+    }
+    if (!master->answer_started) {
+        // The node is on the line: allow for its longest possible frame
+        master->answer_started = true;
+        master->deadline_us = now_us + char_time_us(master, BUS_FRAME_MAX);
+    }
+
+    if (master->corrupted) {
+        return BUS_MASTER_BUSY;
+    }
+    BusDecodeResult result = bus_decoder_push(&master->decoder, byte);
+    if (result == BUS_DECODE_BUSY) {
+        return BUS_MASTER_BUSY;
+    }
+    const BusFrame *frame = &master->decoder.frame;
+    if (result == BUS_DECODE_ERROR || frame->src != node->address) {
+        // The node may still be sending (e.g. after a corrupted length);
+        // keep the line until the deadline so the next poll cannot collide
+        master->corrupted = true;
+        return BUS_MASTER_BUSY;
+    }
+    *node_out = node;
+    master->current = NULL;
+
+    if (frame->type == BUS_TYPE_STATUS && frame->length == sizeof(BusStatus)) {
+        bus_master_answered(node, now_us);
+        memcpy(status, frame->payload, sizeof(BusStatus));
+        if (status->sequence == node->ack_sequence) {
+            return BUS_MASTER_EMPTY;  // Repeat: our ack was lost or is disabled
+        }
+        node->ack_sequence = status->sequence;
+        node->statuses++;
+        return BUS_MASTER_STATUS;
+    }
+    if (frame->type == BUS_TYPE_EMPTY) {
+        bus_master_answered(node, now_us);
+        return BUS_MASTER_EMPTY;
+    }
+    node->errors++;  // Valid frame of an unexpected type
+    return BUS_MASTER_ERROR;
+}
+
+BusMasterEvent bus_master_check_timeout(BusMaster *master, uint64_t now_us,
+                                        BusMasterNode **node_out) {
+    BusMasterNode *node = master->current;
+    if (node == NULL || now_us <= master->deadline_us) {
+        return BUS_MASTER_BUSY;
+    }
+    *node_out = node;
+    master->current = NULL;
+
+    if (master->answer_started) {
+        // Corrupted, or started but never completed; either way the node is alive
+        node->errors++;
+        node->misses = 0;
+        return BUS_MASTER_ERROR;
+    }
+    node->timeouts++;
+    if (node->misses < UINT8_MAX) {
+        node->misses++;
+    }
+    if (node->misses >= master->config.miss_limit) {
+        // Probe after 1, 2, 4 ... offline_rounds rounds, so a node that only
+        // lost a few polls to noise is back quickly
+        uint8_t rounds = node->online ? 1U : (uint8_t)(node->backoff * 2U);
+        if (rounds > master->config.offline_rounds) {
+            rounds = master->config.offline_rounds;
+        }
+        node->online = false;
+        node->backoff = rounds;
+        node->skip = rounds;
+    }
+    return BUS_MASTER_TIMEOUT;
+}
+
+uint64_t bus_master_deadline(const BusMaster *master) {
+    return master->deadline_us;
+}
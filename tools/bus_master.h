@@ -0,0 +1,121 @@
+/*
+ * Host-side master for the shared RS-485 bus (Irrigation_System.X/bus_protocol.h).
+ *
+ * The master owns the line: it sends one POLL (or COMMAND) at a time and
+ * waits for that node's answer or a timeout before the next one. The
+ * scheduler is written to keep the line busy with useful frames:
+ *
+ *  - The next poll goes out as soon as the answer's last byte is in. The
+ *    decoder knows every frame's length, so no idle gap is needed to find
+ *    frame ends.
+ *  - A missing node is detected by a first-byte timeout. This is the
+ *    poll's own transmit time, plus the node turnaround, plus one
+ *    character. Only once the SOF has arrived does the master wait for a
+ *    whole frame.
+ *  - After miss_limit unanswered polls in a row a node counts as offline.
+ *    Probes then back off to once every offline_rounds rounds, so
+ *    unpowered beds do not eat into the others' bus time. A garbled answer
+ *    still counts as a sign of life.
+ *  - Reports are acknowledged in the next poll. An idle node answers with
+ *    a 7-byte EMPTY frame instead of repeating its last status.
+ *
+ * The master does no I/O. The caller transmits the frame returned by
+ * bus_master_start_poll() and feeds every received byte to
+ * bus_master_receive(). Between bytes it calls bus_master_check_timeout().
+ * Times are in microseconds on any monotonic clock.
+ */
+
+#ifndef BUS_MASTER_H
+#define BUS_MASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "bus_protocol.h"
+
+#define BUS_MASTER_MAX_NODES 240
+
+typedef struct {
+    uint32_t baud;
+    uint32_t turnaround_us;      // Longest delay from poll end to the node's first start bit
+    uint8_t miss_limit;          // Unanswered polls before a node counts as offline
+    uint8_t offline_rounds;      // Longest spacing of probes to an offline node, in rounds
+    bool acknowledge;            // false: never ack, nodes repeat their status (baseline)
+} BusMasterConfig;
+
+typedef struct {
+    uint8_t address;
+    uint8_t ack_sequence;        // Last STATUS sequence received
+    uint8_t misses;              // Consecutive unanswered polls
+    uint8_t skip;                // Rounds left before the next probe while offline
+    uint8_t backoff;             // Current probe spacing in rounds
+    bool online;
+    bool command_pending;
+    uint8_t command;
+    uint64_t last_answer_us;
+    // Statistics
+    uint64_t worst_gap_us;       // Longest time between two answers
+    uint32_t polls;
+    uint32_t answers;
+    uint32_t statuses;           // New reports (not repeats)
+    uint32_t timeouts;
+    uint32_t errors;             // Corrupted answers
+} BusMasterNode;
+
+typedef enum {
+    BUS_MASTER_BUSY,             // Transaction still running
+    BUS_MASTER_STATUS,           // New report in *status
+    BUS_MASTER_EMPTY,            // Node answered, nothing new
+    BUS_MASTER_TIMEOUT,          // No (complete) answer; the line is free
+    BUS_MASTER_ERROR             // Corrupted or truncated answer; the line is free
+} BusMasterEvent;
+
+typedef struct {
+    BusMasterConfig config;
+    BusMasterNode nodes[BUS_MASTER_MAX_NODES];
+    size_t count;
+    size_t next;                 // Round-robin position
+    BusDecoder decoder;
+    BusMasterNode *current;      // Node being polled, NULL between transactions
+    uint64_t poll_start_us;
+    uint64_t deadline_us;
+    bool answer_started;
+    bool corrupted;              // Answer failed its checks; waiting out the deadline
+    uint32_t char_us_x16;        // One character time, 1/16 us
+} BusMaster;
+
+void bus_master_init(BusMaster *master, const BusMasterConfig *config);
+bool bus_master_add_node(BusMaster *master, uint8_t address);
+
+/**
+ * @brief Sends @p command with the node's next poll.
+ */
+bool bus_master_queue_command(BusMaster *master, uint8_t address, uint8_t command);
+
+/**
+ * @brief Picks the next node and builds its poll; transmit it at @p now_us.
+ * @param frame At least BUS_FRAME_MAX bytes.
+ * @return Frame length, 0 if there is no node to poll.
+ */
+size_t bus_master_start_poll(BusMaster *master, uint64_t now_us, uint8_t *frame);
+
+/**
+ * @brief Feeds one received byte (completed at @p now_us).
+ * @param node Receives the polled node when the transaction ends.
+ * @param status Receives the report on BUS_MASTER_STATUS.
+ */
+BusMasterEvent bus_master_receive(BusMaster *master, uint8_t byte, uint64_t now_us,
+                                  BusMasterNode **node, BusStatus *status);
+
+/**
+ * @brief Ends the transaction if its deadline has passed.
+ * @return BUS_MASTER_TIMEOUT if it did, otherwise BUS_MASTER_BUSY.
+ */
+BusMasterEvent bus_master_check_timeout(BusMaster *master, uint64_t now_us, BusMasterNode **node);
+
+/**
+ * @brief Time the current transaction times out (valid while one runs).
+ */
+uint64_t bus_master_deadline(const BusMaster *master);
+
+#endif /* BUS_MASTER_H */
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Build, check or decode a runtime configuration block for the firmware.
+
+    python tools/config_pack.py --version 2 config.json -o block.bin
+    python tools/config_pack.py --decode block.bin
+
+Without a JSON file the firmware defaults are packed. The JSON only has to
+name the values it changes, for example:
+
+    {"version": 2,
+     "plants": [{"name": "basil", "low": 45, "ideal_low": 55,
+                 "ideal_high": 75, "high": 85}],
+     "pump_points": [[20, 0.9], [60, 3.2], [100, 6.0]],
+     "sample_min_ms": 5000}
+
+To upload, send the block as one frame on the console UART, e.g.
+
+    stty -F /dev/ttyACM0 115200 raw && cat block.bin > /dev/ttyACM0
+
+and leave a pause afterwards so the idle timeout ends the frame. The board
+answers "Config vN applied ..." or the reason for the rejection. The layout
+is ConfigBlock in Irrigation_System.X/config_block.h.
+"""
+
+import argparse
+import binascii
+import json
+import struct
+import sys
+
+MAGIC = 0x47464352          # "RCFG"
+FORMAT = 1
+MAX_PLANTS = 8
+NAME_LENGTH = 12
+MAX_PUMP_POINTS = 8
+BLOCK_SIZE = 224
+
+HEADER = struct.Struct("<IHHIHBBHHII")
+PLANT = struct.Struct("<%dsBBBB" % NAME_LENGTH)
+PUMP_POINT = struct.Struct("<ff")
+
+# Must match the defaults built by runtime_config.c
+DEFAULTS = {
+    "version": 0,
+    "pump_pwm_period": 1199,
+    "moisture_level_threshold": 2300,
+    "sample_min_ms": 10000,
+    "sample_max_ms": 1800000,
+    "plants": [
+        {"name": "peppermint", "low": 40, "ideal_low": 50, "ideal_high": 70, "high": 80},
+        {"name": "tulip", "low": 30, "ideal_low": 40, "ideal_high": 60, "high": 70},
+        {"name": "basil", "low": 40, "ideal_low": 55, "ideal_high": 75, "high": 85},
+    ],
+    "pump_points": [[20.0, 0.8], [40.0, 1.9], [60.0, 3.1], [80.0, 4.5], [100.0, 5.8]],
+}
+
+
+def check(config):
+    """Same rules as config_block_validate(); raises ValueError."""
+    plants = config["plants"]
+    if not 1 <= len(plants) <= MAX_PLANTS:
+        raise ValueError("1 to %d plants" % MAX_PLANTS)
+    for plant in plants:
+        name = plant["name"].encode("ascii")
+        if not 1 <= len(name) < NAME_LENGTH:
+            raise ValueError("plant name must have 1 to %d characters" % (NAME_LENGTH - 1))
+        levels = [plant["low"], plant["ideal_low"], plant["ideal_high"], plant["high"]]
+        if levels != sorted(levels) or levels[0] < 0 or levels[3] > 100:
+            raise ValueError("%s: need 0 <= low <= ideal_low <= ideal_high <= high <= 100"
+                             % plant["name"])
+    points = config["pump_points"]
+    if not 2 <= len(points) <= MAX_PUMP_POINTS:
+        raise ValueError("2 to %d pump points" % MAX_PUMP_POINTS)
+    last_duty, last_flow = 0.0, 0.0
+    for duty, flow in points:
+        if not (last_duty < duty <= 100.0 and last_flow <= flow < 1000.0):
+            raise ValueError("pump points need rising duty (0-100] and non-falling flow")
+        last_duty, last_flow = duty, flow
+    if not 99 <= config["pump_pwm_period"] <= 0xFFFF:
+        raise ValueError("pump_pwm_period must be 99 to 65535")
+    if config["sample_min_ms"] < 1000 or config["sample_max_ms"] < config["sample_min_ms"]:
+        raise ValueError("need 1000 <= sample_min_ms <= sample_max_ms")
+    if not 0 <= config["moisture_level_threshold"] <= 4095:
+        raise ValueError("moisture_level_threshold must be 0 to 4095")
+
+
+def pack(config):
+    check(config)
+    data = HEADER.pack(MAGIC, FORMAT, BLOCK_SIZE, config["version"],
+                       config["pump_pwm_period"], len(config["plants"]),
+                       len(config["pump_points"]), config["moisture_level_threshold"], 0,
+                       config["sample_min_ms"], config["sample_max_ms"])
+    for i in range(MAX_PLANTS):
+        if i < len(config["plants"]):
+            p = config["plants"][i]
+            data += PLANT.pack(p["name"].encode("ascii"), p["low"], p["ideal_low"],
+                               p["ideal_high"], p["high"])
+        else:
+            data += bytes(PLANT.size)
+    for i in range(MAX_PUMP_POINTS):
+        duty, flow = config["pump_points"][i] if i < len(config["pump_points"]) else (0.0, 0.0)
+        data += PUMP_POINT.pack(duty, flow)
+    data += struct.pack("<I", binascii.crc32(data) & 0xFFFFFFFF)
+    assert len(data) == BLOCK_SIZE
+    return data
+
+
+def unpack(data):
+    if len(data) != BLOCK_SIZE:
+        raise ValueError("block is %d bytes, expected %d" % (len(data), BLOCK_SIZE))
+    (magic, fmt, size, version, period, plant_count, point_count, threshold, _,
+     sample_min, sample_max) = HEADER.unpack_from(data)
+    if magic != MAGIC or fmt != FORMAT or size != BLOCK_SIZE:
+        raise ValueError("not a format %d configuration block" % FORMAT)
+    crc = struct.unpack_from("<I", data, BLOCK_SIZE - 4)[0]
+    if crc != binascii.crc32(data[:-4]) & 0xFFFFFFFF:
+        raise ValueError("CRC mismatch")
+    plants = []
+    for i in range(min(plant_count, MAX_PLANTS)):
+        name, low, ideal_low, ideal_high, high = PLANT.unpack_from(data, HEADER.size + i * PLANT.size)
+        plants.append({"name": name.split(b"\0")[0].decode("ascii"), "low": low,
+                       "ideal_low": ideal_low, "ideal_high": ideal_high, "high": high})
+    points_offset = HEADER.size + MAX_PLANTS * PLANT.size
+    points = [list(PUMP_POINT.unpack_from(data, points_offset + i * PUMP_POINT.size))
+              for i in range(min(point_count, MAX_PUMP_POINTS))]
+    return {"version": version, "pump_pwm_period": period,
+            "moisture_level_threshold": threshold, "sample_min_ms": sample_min,
+            "sample_max_ms": sample_max, "plants": plants, "pump_points": points}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("json", nargs="?", help="values to change from the defaults")
+    parser.add_argument("--version", type=int, help="block version, above the one on the board")
+    parser.add_argument("-o", "--output", help="block file or serial device (default stdout)")
+    parser.add_argument("--decode", metavar="BLOCK", help="print a block as JSON")
+    args = parser.parse_args()
+
+    try:
+        if args.decode:
+            with open(args.decode, "rb") as f:
+                print(json.dumps(unpack(f.read()), indent=2))
+            return 0
+        config = dict(DEFAULTS)
+        if args.json:
+            with open(args.json) as f:
+                config.update(json.load(f))
+        if args.version is not None:
+            config["version"] = args.version
+        data = pack(config)
+    except (ValueError, KeyError) as error:
+        sys.stderr.write("config_pack: %s\n" % error)
+        return 1
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        sys.stdout.buffer.write(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
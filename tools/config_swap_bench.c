@@ -0,0 +1,174 @@
+/*
+ * Apply cost and reader consistency of the runtime configuration store
+ * (Irrigation_System.X/config_block.c).
+ *
+ *     cc -O2 -I Irrigation_System.X -o config_swap_bench tools/config_swap_bench.c \
+ *        Irrigation_System.X/config_block.c Irrigation_System.X/crc32.c
+ *     ./config_swap_bench [block.bin] [seconds]
+ *
+ * An interval timer signal stands in for the 1 ms tick: every 20 us it
+ * interrupts the "main loop", reads the active block and checks its CRC.
+ * A torn read is a block whose CRC does not match because the interrupt
+ * arrived halfway through an update. The main loop keeps applying two
+ * alternating blocks in three ways:
+ *  - in place: the block is copied word by word over the live one, as
+ *    the M0+ would copy it;
+ *  - in place, masked: the same copy with the signal blocked, which is
+ *    what a single buffer needs; the masked time is how long the tick
+ *    would be held off;
+ *  - double buffer: config_store_publish().
+ * A block file from tools/config_pack.py is validated first and used as
+ * one of the two blocks.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "config_block.h"
+
+#define TIMER_INTERVAL_US  20
+
+typedef enum { MODE_IN_PLACE, MODE_IN_PLACE_MASKED, MODE_DOUBLE_BUFFER, MODE_COUNT } Mode;
+static const char *const MODE_NAMES[MODE_COUNT] = {
+    "in place", "in place, masked", "double buffer"
+};
+
+static ConfigBlock live;                 // Single-buffer modes
+static ConfigStore store;
+static volatile Mode mode;
+static volatile unsigned long reads;
+static volatile unsigned long torn;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void tick(int signal) {
+    (void)signal;
+    const ConfigBlock *block = (mode == MODE_DOUBLE_BUFFER) ? config_store_active(&store) : &live;
+    if (block->crc != config_block_crc(block)) {
+        torn++;
+    }
+    reads++;
+}
+
+// Word copy, as the M0+ copies a block without a vector unit
+static void copy_words(ConfigBlock *to, const ConfigBlock *from) {
+    volatile uint32_t *out = (volatile uint32_t *)to;
+    const uint32_t *in = (const uint32_t *)from;
+    for (size_t i = 0; i < sizeof(ConfigBlock) / sizeof(uint32_t); i++) {
+        out[i] = in[i];
+    }
+}
+
+static void make_block(ConfigBlock *block, uint32_t version) {
+    memset(block, 0, sizeof(*block));
+    block->magic = CONFIG_BLOCK_MAGIC;
+    block->format = CONFIG_BLOCK_FORMAT;
+    block->size = sizeof(ConfigBlock);
+    block->version = version;
+    block->pump_pwm_period = 1199;
+    block->moisture_level_threshold = 2300;
+    block->sample_min_ms = 10000;
+    block->sample_max_ms = 1800000;
+    block->plant_count = 3;
+    const char *names[3] = { "peppermint", "tulip", "basil" };
+    for (int i = 0; i < 3; i++) {
+        strcpy(block->plants[i].name, names[i]);
+        block->plants[i].moisture_low = (uint8_t)(30 + version % 5);
+        block->plants[i].moisture_ideal_low = 50;
+        block->plants[i].moisture_ideal_high = 70;
+        block->plants[i].moisture_high = 80;
+    }
+    block->pump_point_count = 5;
+    for (int i = 0; i < 5; i++) {
+        block->pump_points[i].duty_cycle_percent = 20.0f * (i + 1);
+        block->pump_points[i].flow_rate_ml_per_sec = 1.2f * (i + 1) + 0.01f * (version % 7);
+    }
+    config_block_seal(block);
+}
+
+int main(int argc, char **argv) {
+    ConfigBlock blocks[2];
+    double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+
+    make_block(&blocks[0], 1);
+    make_block(&blocks[1], 2);
+    if (argc > 1) {
+        FILE *file = fopen(argv[1], "rb");
+        if (file == NULL || fread(&blocks[1], 1, sizeof(ConfigBlock), file) != sizeof(ConfigBlock)) {
+            fprintf(stderr, "cannot read a %zu-byte block from %s\n", sizeof(ConfigBlock), argv[1]);
+            return 1;
+        }
+        fclose(file);
+        ConfigResult result = config_block_validate(&blocks[1]);
+        printf("%s: version %u, %s\n", argv[1], blocks[1].version, config_result_name(result));
+        if (result != CONFIG_OK) {
+            return 1;
+        }
+    }
+
+    // Apply cost: copy, check and swap
+    config_store_init(&store);
+    const int APPLIES = 200000;
+    double start = now_ns();
+    for (int i = 0; i < APPLIES; i++) {
+        config_store_publish(&store, &blocks[i & 1], sizeof(ConfigBlock), false);
+    }
+    printf("config_store_publish(): %.0f ns per apply on this host (%zu-byte block)\n\n",
+           (now_ns() - start) / APPLIES, sizeof(ConfigBlock));
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = tick;
+    sigaction(SIGALRM, &action, NULL);
+    struct itimerval timer = { { 0, TIMER_INTERVAL_US }, { 0, TIMER_INTERVAL_US } };
+    sigset_t alarm_set;
+    sigemptyset(&alarm_set);
+    sigaddset(&alarm_set, SIGALRM);
+
+    printf("%-18s %10s %10s %8s %22s\n", "update", "applies", "reads", "torn", "masked per apply");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        copy_words(&live, &blocks[0]);
+        config_store_init(&store);
+        config_store_publish(&store, &blocks[0], sizeof(ConfigBlock), false);
+        mode = (Mode)m;
+        reads = 0;
+        torn = 0;
+        unsigned long applies = 0;
+        double masked_total_ns = 0.0;
+
+        setitimer(ITIMER_REAL, &timer, NULL);
+        double end = now_ns() + seconds * 1e9;
+        while (now_ns() < end) {
+            const ConfigBlock *next = &blocks[++applies & 1];
+            if (m == MODE_IN_PLACE) {
+                copy_words(&live, next);
+            } else if (m == MODE_IN_PLACE_MASKED) {
+                sigprocmask(SIG_BLOCK, &alarm_set, NULL);
+                double masked = now_ns();
+                copy_words(&live, next);
+                masked = now_ns() - masked;
+                sigprocmask(SIG_UNBLOCK, &alarm_set, NULL);
+                masked_total_ns += masked;
+            } else {
+                config_store_publish(&store, next, sizeof(ConfigBlock), false);
+            }
+        }
+        struct itimerval off = { { 0, 0 }, { 0, 0 } };
+        setitimer(ITIMER_REAL, &off, NULL);
+
+        printf("%-18s %10lu %10lu %8lu", MODE_NAMES[m], applies, reads, torn);
+        if (m == MODE_IN_PLACE_MASKED) {
+            printf(" %19.0f ns\n", masked_total_ns / applies);
+        } else {
+            printf(" %22s\n", "none");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * Measures how close pump_dispense_ml() (Irrigation_System.X/Pump_control.c)
+ * comes to the requested volume, and what each dose costs the CPU, next to
+ * the polling it replaces.
+ *
+ *     cc -O2 -I Irrigation_System.X -o dispense_sim tools/dispense_sim.c \
+ *        Irrigation_System.X/dose_plan.c
+ *     ./dispense_sim [-n doses] [-s seed]
+ *
+ * Simulated time is continuous (nanoseconds). Every dose starts at a random
+ * phase of the 5 kHz PWM, of the TC5 prescaler and of the 1 ms tick. The
+ * pump delivers the calibrated flow in proportion to the time WO[0] is
+ * high, so the truth is the integral of the PWM waveform between the
+ * first period that carries the new compare value and the moment the
+ * output stops. Three ways of ending the run are compared:
+ *  - EVSYS: dose_plan_make() on the default calibration table, TC5 in
+ *    segments with its one-shot overflow routed to the TCC0 fault input;
+ *  - ISR: the same timer, the last overflow interrupt taking the pin away.
+ *    It waits behind the tick interrupt and behind masked sections;
+ *  - polling: pump_activate(), then each main loop pass runs
+ *    pump_checkpoint() and compares pump_get_total_volume_ml() against the
+ *    target, with the firmware's float accounting on the millisecond
+ *    clock. pump_deactivate() takes effect at the next PWM period, since
+ *    the compare value is double-buffered. Two loops: an idle one that
+ *    wakes on every tick, and a busy one whose passes take 2-200 ms
+ *    (LCD rows, UART lines, sensor scans).
+ * The CPU figures count the work each way does per dose, in Cortex-M0+
+ * cycles estimated from the code paths with software float and division;
+ * dose_plan_make() is also timed on the host as a relative figure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "dose_plan.h"
+
+#define TIMER_HZ              (48000000U / 1024U)    // PUMP_DISPENSE_TIMER_HZ
+#define MAX_MS                900000U                // PUMP_DISPENSE_MAX_MS
+#define PWM_PERIOD            1199U                  // PUMP_PWM_PERIOD
+#define PWM_COUNT_NS          (1e9 / 6e6)            // TCC0 at 48 MHz / 8
+#define PWM_PERIOD_NS         ((PWM_PERIOD + 1U) * PWM_COUNT_NS)
+#define MS_NS                 1e6
+
+// What happens between the call and the hardware
+#define ACTIVATE_NS           22000.0                // pump_activate() up to the CC write
+#define ARM_NS                6000.0                 // CC write to TC5 enabled
+#define EVSYS_MIN_NS          40.0                   // Async channel and the TCC fault logic
+#define EVSYS_MAX_NS          100.0
+#define ISR_ENTRY_NS          750.0                  // Entry and TC5_Handler() up to the pin write
+#define TICK_BUSY_NS          4300.0                 // Tick interrupt with the interlock on a running pump
+#define MASKED_SHARE          0.01                   // Time spent with interrupts masked
+#define MASKED_MAX_NS         15000.0
+#define PASS_WORK_NS          5000.0                 // Wake to the volume check on an idle pass
+#define DEACTIVATE_NS         20000.0                // Check to the CC write
+
+// Cortex-M0+ cycles, software float and division
+#define CYCLES_POLL           450U                   // systime read, two float ops, compare
+#define CYCLES_PLAN           800U                   // dose_plan_make(), dose_plan_ms()
+#define CYCLES_ARM            120U                   // TC5 and EVSYS writes with their syncs
+#define CYCLES_SEGMENT_ISR    70U                    // Entry, TC5_Handler(), exit
+#define CYCLES_EXPIRY_CHECK   12U                    // dose_timer_expired() per pump_checkpoint()
+#define CYCLES_FINISH         350U                   // dose_end() and the callback dispatch
+
+#define DEFAULT_DOSES         300
+#define BUSY_MIN_MS           2.0
+#define BUSY_MAX_MS           200.0
+
+// Default calibration table (runtime_config.c)
+static const float table_duty[] = { 20.0f, 40.0f, 60.0f, 80.0f, 100.0f };
+static const float table_flow[] = { 0.8f, 1.9f, 3.1f, 4.5f, 5.8f };
+#define TABLE_POINTS (int)(sizeof(table_duty) / sizeof(table_duty[0]))
+
+typedef enum { WAY_EVSYS, WAY_ISR, WAY_POLL_IDLE, WAY_POLL_BUSY, WAY_COUNT } Way;
+static const char *const way_names[WAY_COUNT] = { "EVSYS", "ISR", "poll idle", "poll busy" };
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (double)(rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double uniform_range(double low, double high) {
+    return low + (high - low) * uniform();
+}
+
+// get_flow_rate_ml_per_sec() on the default table
+static float flow_at(float duty) {
+    if (duty <= table_duty[0]) {
+        return table_flow[0] * (duty / table_duty[0]);
+    }
+    for (int i = 0; i < TABLE_POINTS - 1; i++) {
+        if (duty <= table_duty[i + 1]) {
+            return table_flow[i] + (duty - table_duty[i]) * (table_flow[i + 1] - table_flow[i]) /
+                                   (table_duty[i + 1] - table_duty[i]);
+        }
+    }
+    return table_flow[TABLE_POINTS - 1];
+}
+
+// percentage_to_cc()
+static uint32_t duty_to_cc(float duty) {
+    uint32_t cc = (uint32_t)(((duty / 100.0f) * (float)(PWM_PERIOD + 1U)) + 0.5f);
+    if (cc > PWM_PERIOD || duty >= 99.99f) {
+        cc = PWM_PERIOD;
+    }
+    return cc;
+}
+
+// First PWM period boundary at or after t
+static double next_boundary(double t, double pwm_phase) {
+    return pwm_phase + ceil((t - pwm_phase) / PWM_PERIOD_NS) * PWM_PERIOD_NS;
+}
+
+// Time WO[0] is high between the first period with the compare value and
+// the stop; each period starts high for cc counts
+static double high_ns(double start, double stop, uint32_t cc) {
+    double on_ns = cc * PWM_COUNT_NS;
+    if (stop <= start) {
+        return 0.0;
+    }
+    double periods = floor((stop - start) / PWM_PERIOD_NS);
+    double rest = (stop - start) - periods * PWM_PERIOD_NS;
+    return periods * on_ns + (rest < on_ns ? rest : on_ns);
+}
+
+// Extra delay before an interrupt reaches its handler
+static double isr_wait_ns(void) {
+    double wait = 0.0;
+    if (uniform() < TICK_BUSY_NS / MS_NS) {
+        wait += uniform_range(0.0, TICK_BUSY_NS);
+    }
+    if (uniform() < MASKED_SHARE) {
+        wait += uniform_range(0.0, MASKED_MAX_NS);
+    }
+    return wait;
+}
+
+typedef struct {
+    double error_ul;             // Delivered minus requested
+    uint32_t polls;
+    uint32_t isrs;
+    uint32_t checkpoints;
+} DoseOutcome;
+
+static void run_timer(Way way, const DosePlan *plan, uint32_t cc, float flow, float volume,
+                      DoseOutcome *outcome) {
+    double pwm_phase = uniform_range(0.0, PWM_PERIOD_NS);
+    double written = ACTIVATE_NS;
+    double output_on = next_boundary(written, pwm_phase);
+    double enabled = written + ARM_NS;
+    // The counter moves on the first prescaler edge after the enable
+    double count_ns = 1e9 / TIMER_HZ;
+    double overflow = enabled + uniform_range(0.0, count_ns) + (double)(plan->counts - 1U) * count_ns;
+    double stop = overflow;
+    if (way == WAY_EVSYS) {
+        stop += uniform_range(EVSYS_MIN_NS, EVSYS_MAX_NS);
+        outcome->isrs = plan->segments - 1U;
+    } else {
+        stop += ISR_ENTRY_NS + isr_wait_ns();
+        outcome->isrs = plan->segments;
+    }
+    double duty_fraction = cc / (double)(PWM_PERIOD + 1U);
+    double delivered = flow * high_ns(output_on, stop, cc) / duty_fraction / 1e9;
+    outcome->error_ul = (delivered - volume) * 1000.0;
+    outcome->polls = 0;
+    // The main loop notices the end within a pass or two; the idle loop
+    // checks once per tick
+    outcome->checkpoints = (uint32_t)((stop - written) / MS_NS) + 1U;
+}
+
+static void run_poll(Way way, uint32_t cc, float flow, float volume, DoseOutcome *outcome) {
+    double pwm_phase = uniform_range(0.0, PWM_PERIOD_NS);
+    double tick_phase = uniform_range(0.0, MS_NS);
+    double written = ACTIVATE_NS;
+    double output_on = next_boundary(written, pwm_phase);
+    // Totals from earlier runs, so the float sums are not at zero
+    float total = (float)uniform_range(0.0, 2000.0);
+    float start_total = total;
+    uint64_t run_start = (uint64_t)((written + tick_phase) / MS_NS);
+    double t = written;
+    uint32_t polls = 0;
+
+    for (;;) {
+        if (way == WAY_POLL_IDLE) {
+            // Sleep to the next tick, then the pass up to the check
+            double next_tick = tick_phase + (floor((t - tick_phase) / MS_NS) + 1.0) * MS_NS;
+            t = next_tick + PASS_WORK_NS;
+        } else {
+            t += uniform_range(BUSY_MIN_MS, BUSY_MAX_MS) * MS_NS;
+        }
+        polls++;
+        uint64_t now_ms = (uint64_t)((t + tick_phase) / MS_NS);
+        // pump_checkpoint() folds the interval; pump_get_total_volume_ml()
+        // then has nothing open
+        total += flow * ((float)(uint32_t)(now_ms - run_start) / 1000.0f);
+        run_start = now_ms;
+        if (total - start_total >= volume) {
+            break;
+        }
+    }
+    double stop = next_boundary(t + DEACTIVATE_NS, pwm_phase);
+    double duty_fraction = cc / (double)(PWM_PERIOD + 1U);
+    double delivered = flow * high_ns(output_on, stop, cc) / duty_fraction / 1e9;
+    outcome->error_ul = (delivered - volume) * 1000.0;
+    outcome->polls = polls;
+    outcome->isrs = 0;
+    outcome->checkpoints = polls;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double mean, p50, p99, max_abs;
+    double polls, isrs, cycles;
+    double check_cycles;         // The expiry test in every pump_checkpoint()
+} WaySummary;
+
+static void summarize(double *errors, int n, WaySummary *summary) {
+    double sum = 0.0, max_abs = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += errors[i];
+        if (fabs(errors[i]) > max_abs) {
+            max_abs = fabs(errors[i]);
+        }
+    }
+    qsort(errors, (size_t)n, sizeof(double), compare_double);
+    summary->mean = sum / n;
+    summary->p50 = errors[n / 2];
+    // Two-sided: the larger tail
+    double low = errors[(int)(n * 0.005)];
+    double high = errors[n - 1 - (int)(n * 0.005)];
+    summary->p99 = (fabs(low) > fabs(high)) ? low : high;
+    summary->max_abs = max_abs;
+}
+
+static double plan_host_ns(void) {
+    DosePlan plan;
+    volatile float volume = 137.5f;
+    uint32_t sink = 0;
+    int calls = 5000000;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < calls; i++) {
+        if (dose_plan_make(&plan, volume + (float)(i & 1023), 1.9f, TIMER_HZ, MAX_MS)) {
+            sink += dose_plan_ms(&plan, TIMER_HZ);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (sink == 1U) {
+        printf("\n");
+    }
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / calls;
+}
+
+int main(int argc, char **argv) {
+    int doses = DEFAULT_DOSES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            doses = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 0) | 1U;
+        } else {
+            fprintf(stderr, "usage: %s [-n doses] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (doses < 10) {
+        doses = 10;
+    }
+
+    static const float duties[] = { 30.0f, 60.0f, 100.0f };
+    static const float volumes[] = { 5.0f, 20.0f, 100.0f, 500.0f };
+    double *errors[WAY_COUNT];
+    for (int w = 0; w < WAY_COUNT; w++) {
+        errors[w] = malloc(sizeof(double) * (size_t)doses);
+    }
+    WaySummary totals[WAY_COUNT];
+    memset(totals, 0, sizeof(totals));
+    int cells = 0;
+
+    printf("%d doses per cell; error = delivered - requested, in uL\n", doses);
+    printf("%5s %6s %8s %4s  %-9s %9s %9s %9s %9s %8s\n",
+           "duty", "mL", "s", "segs", "way", "mean", "p50", "p99", "|max|", "|max| %");
+    for (size_t d = 0; d < sizeof(duties) / sizeof(duties[0]); d++) {
+        uint32_t cc = duty_to_cc(duties[d]);
+        float flow = flow_at((float)cc * 100.0f / (float)(PWM_PERIOD + 1U));
+        for (size_t v = 0; v < sizeof(volumes) / sizeof(volumes[0]); v++) {
+            DosePlan plan;
+            if (!dose_plan_make(&plan, volumes[v], flow, TIMER_HZ, MAX_MS)) {
+                printf("%5.0f %6.0f  rejected\n", duties[d], volumes[v]);
+                continue;
+            }
+            cells++;
+            for (int w = 0; w < WAY_COUNT; w++) {
+                double polls = 0.0, isrs = 0.0, checkpoints = 0.0;
+                for (int i = 0; i < doses; i++) {
+                    DoseOutcome outcome;
+                    if (w == WAY_EVSYS || w == WAY_ISR) {
+                        run_timer((Way)w, &plan, cc, flow, volumes[v], &outcome);
+                    } else {
+                        run_poll((Way)w, cc, flow, volumes[v], &outcome);
+                    }
+                    errors[w][i] = outcome.error_ul;
+                    polls += outcome.polls;
+                    isrs += outcome.isrs;
+                    checkpoints += outcome.checkpoints;
+                }
+                WaySummary summary;
+                summarize(errors[w], doses, &summary);
+                summary.polls = polls / doses;
+                summary.isrs = isrs / doses;
+                if (w == WAY_EVSYS || w == WAY_ISR) {
+                    summary.cycles = CYCLES_PLAN + CYCLES_ARM + CYCLES_FINISH +
+                                     summary.isrs * CYCLES_SEGMENT_ISR;
+                    summary.check_cycles = checkpoints / doses * CYCLES_EXPIRY_CHECK;
+                } else {
+                    summary.cycles = summary.polls * CYCLES_POLL;
+                    summary.check_cycles = 0.0;
+                }
+                printf("%5.0f %6.0f %8.3f %4u  %-9s %9.2f %9.2f %9.2f %9.2f %8.4f\n",
+                       duties[d], volumes[v], (double)plan.counts / TIMER_HZ, plan.segments,
+                       way_names[w], summary.mean, summary.p50, summary.p99, summary.max_abs,
+                       summary.max_abs / (volumes[v] * 1000.0) * 100.0);
+                totals[w].polls += summary.polls;
+                totals[w].isrs += summary.isrs;
+                totals[w].cycles += summary.cycles;
+                totals[w].check_cycles += summary.check_cycles;
+                if (summary.max_abs > totals[w].max_abs) {
+                    totals[w].max_abs = summary.max_abs;
+                }
+            }
+        }
+    }
+
+    printf("\nCPU per dose, averaged over the %d cells (M0+ cycle estimates)\n", cells);
+    printf("%-9s %10s %8s %10s %12s %10s\n", "way", "polls", "ISRs", "cycles", "+checks", "us @48MHz");
+    for (int w = 0; w < WAY_COUNT; w++) {
+        double cycles = totals[w].cycles / cells;
+        double checks = totals[w].check_cycles / cells;
+        printf("%-9s %10.1f %8.2f %10.0f %12.0f %10.1f\n", way_names[w], totals[w].polls / cells,
+               totals[w].isrs / cells, cycles, checks, (cycles + checks) / 48.0);
+    }
+    printf("\ndose_plan_make() + dose_plan_ms() on the host: %.1f ns\n", plan_host_ns());
+
+    for (int w = 0; w < WAY_COUNT; w++) {
+        free(errors[w]);
+    }
+    return 0;
+}
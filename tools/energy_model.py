@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Build, check or decode a current model for the firmware's energy budget.
+
+    python tools/energy_model.py --version 2 model.json -o model.bin
+    python tools/energy_model.py --decode model.bin
+
+Without a JSON file the firmware defaults are packed. Currents are in uA
+and the JSON only has to name the values it changes, for example:
+
+    {"version": 2, "base_ua": 1850,
+     "active_ua": {"pump": 310000, "uart": 450},
+     "battery_mah": 2600}
+
+"base_ua" is the whole board with the CPU asleep. Each "active_ua" entry
+is the current a subsystem adds while it is active; the pump's is at
+100 % PWM duty. Measure them with a meter in series with the supply, one
+state at a time.
+
+To upload, send the model as one frame on the console UART, e.g.
+
+    stty -F /dev/ttyACM0 115200 raw && cat model.bin > /dev/ttyACM0
+
+and leave a pause afterwards so the idle timeout ends the frame. The board
+answers "Energy model vN applied." or the reason for the rejection, and
+keeps the model until the next reset. The layout is EnergyModel in
+Irrigation_System.X/energy_budget.h.
+"""
+
+import argparse
+import binascii
+import json
+import struct
+import sys
+
+MAGIC = 0x4C444D45          # "EMDL"
+FORMAT = 1
+MODEL_SIZE = 44
+MAX_UA = 5000000
+SUBSYSTEMS = ["cpu", "adc", "lcd", "uart", "pump"]
+
+LAYOUT = struct.Struct("<IHHII%dII" % len(SUBSYSTEMS))
+
+# Must match default_model in energy_monitor.c
+DEFAULTS = {
+    "version": 0,
+    "base_ua": 2100,
+    "active_ua": {"cpu": 2400, "adc": 400, "lcd": 300, "uart": 600, "pump": 250000},
+    "battery_mah": 0,
+}
+
+
+def pack(model):
+    """Same rules as energy_model_validate(); raises ValueError."""
+    unknown = set(model["active_ua"]) - set(SUBSYSTEMS)
+    if unknown:
+        raise ValueError("unknown subsystem %s" % ", ".join(sorted(unknown)))
+    currents = [model["active_ua"][name] for name in SUBSYSTEMS]
+    for value in [model["base_ua"]] + currents:
+        if not 0 <= value <= MAX_UA:
+            raise ValueError("current %r out of range" % value)
+    data = LAYOUT.pack(MAGIC, FORMAT, MODEL_SIZE, model["version"], model["base_ua"],
+                       *currents, model["battery_mah"])
+    data += struct.pack("<I", binascii.crc32(data) & 0xFFFFFFFF)
+    assert len(data) == MODEL_SIZE
+    return data
+
+
+def unpack(data):
+    if len(data) != MODEL_SIZE:
+        raise ValueError("model is %d bytes, expected %d" % (len(data), MODEL_SIZE))
+    fields = LAYOUT.unpack_from(data)
+    magic, fmt, size, version, base_ua = fields[:5]
+    if magic != MAGIC or fmt != FORMAT or size != MODEL_SIZE:
+        raise ValueError("not a format %d current model" % FORMAT)
+    if struct.unpack_from("<I", data, MODEL_SIZE - 4)[0] != binascii.crc32(data[:-4]) & 0xFFFFFFFF:
+        raise ValueError("CRC mismatch")
+    return {"version": version, "base_ua": base_ua,
+            "active_ua": dict(zip(SUBSYSTEMS, fields[5:5 + len(SUBSYSTEMS)])),
+            "battery_mah": fields[-1]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("json", nargs="?", help="values to change from the defaults")
+    parser.add_argument("--version", type=int, help="model version, reported back by the board")
+    parser.add_argument("-o", "--output", help="model file or serial device (default stdout)")
+    parser.add_argument("--decode", metavar="MODEL", help="print a model as JSON")
+    args = parser.parse_args()
+
+    try:
+        if args.decode:
+            with open(args.decode, "rb") as f:
+                print(json.dumps(unpack(f.read()), indent=2))
+            return 0
+        model = dict(DEFAULTS, active_ua=dict(DEFAULTS["active_ua"]))
+        if args.json:
+            with open(args.json) as f:
+                changes = json.load(f)
+            model["active_ua"].update(changes.pop("active_ua", {}))
+            model.update(changes)
+        if args.version is not None:
+            model["version"] = args.version
+        data = pack(model)
+    except (ValueError, KeyError, struct.error) as error:
+        sys.stderr.write("energy_model: %s\n" % error)
+        return 1
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        sys.stdout.buffer.write(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,436 @@
+/*
+ * Checks the energy counters (Irrigation_System.X/energy_budget.c)
+ * against the ground truth of a simulated day of firmware activity.
+ *
+ *     cc -O2 -I Irrigation_System.X -o energy_sim tools/energy_sim.c \
+ *        Irrigation_System.X/energy_budget.c Irrigation_System.X/crc32.c
+ *     ./energy_sim [hours] [model.bin]
+ *
+ * Simulated time is continuous (nanoseconds). The board runs the way the
+ * firmware does:
+ *  - the 1 ms tick interrupt, with the pump interlock and, every 4 ms, a
+ *    blocking current-sense conversion while the pump runs;
+ *  - the main loop, which sleeps in energy_monitor_idle() whenever it has
+ *    nothing to do and wakes on the next interrupt;
+ *  - moisture readings at adaptive intervals of 1-10 minutes, every 10 s
+ *    while watering. Each powers the sensor, converts after 20 ms, prints
+ *    two UART lines and rewrites both LCD rows. Inside the plant's band
+ *    the ADC window monitor then converts back to back until the next
+ *    reading;
+ *  - UART bytes sent from the SERCOM interrupt, which wakes the CPU once
+ *    per byte;
+ *  - four pump runs a day, at 60 % duty and then 75 %;
+ *  - the telemetry line every minute.
+ * The truth uses the real lengths of the work: the baud rate the SERCOM
+ * generator actually makes, delay_us() overshoot in the LCD driver and
+ * the ADC conversion time at the plib's clock. The counters are driven
+ * through energy_budget.c exactly as energy_monitor.c drives them, with
+ * the nominal lengths of energy_monitor.h, timestamps from a microsecond
+ * clock that wraps, as boot_monitor_now_us() does, and the sleep timed in
+ * 48 MHz timer counts less the calibrated cost of reading them. The
+ * charge uses the same current model on both sides, so the difference is
+ * the error of the counters alone. A model file from
+ * tools/energy_model.py is checked with energy_model_validate() and used
+ * instead of the defaults.
+ *
+ * The cost of the counter updates is timed on the host as a relative
+ * figure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "energy_budget.h"
+
+#define DEFAULT_HOURS         24
+#define TICK_NS               1000000ULL
+
+// Nominal lengths, as in energy_monitor.h
+#define ADC_CONVERSION_US     12U
+#define LCD_SEND_US           202U
+#define LCD_LONG_US           2000U
+#define UART_BYTE_US_X16      1389U          // 115200 baud
+
+// What the hardware really does
+#define ADC_CONVERSION_NS     11667ULL       // 14 ADC clocks at 1.2 MHz (GCLK 48 MHz / 40)
+#define UART_BYTE_NS          86826ULL       // BAUD = 63020 at 48 MHz: 115173 baud
+#define UART_GAP_MAX_NS       400ULL         // Refill of the data register by the ISR
+#define LCD_SEND_NS           207400ULL      // delay_us(1) and delay_us(100) overshoot, pin writes
+#define TICK_ISR_NS           2400ULL        // Interval1mS without the pump
+#define INTERLOCK_NS          1900ULL        // pump_interlock_tick() on a running pump
+#define UART_ISR_NS           1300ULL
+#define CLOCK_READ_NS         300ULL         // One masked_sample(), with the TC4 read synchronization
+#define DIVIDE_NS             900ULL         // The software division of masked_now_us()
+#define WFI_NS                60ULL          // Entering and leaving IDLE0
+#define COUNTS_PER_MS         48000U         // TC4 at 48 MHz
+#define PASS_MIN_NS           3000ULL        // Main loop pass with nothing due
+#define PASS_SPREAD_NS        4000ULL
+
+#define SETTLE_NS             20000000ULL    // Sensor power-up before the conversion
+#define READING_MIN_NS        60000000000ULL
+#define READING_SPREAD_NS     540000000000ULL
+#define WATERING_READING_NS   10000000000ULL
+#define WINDOW_PERCENT        70             // Readings inside the band
+#define TELEMETRY_NS          60000000000ULL
+#define TELEMETRY_BYTES       88
+#define READING_BYTES         79             // "Moisture: ..." and "ADC Count = ..." lines
+#define READING_WORK_NS       180000ULL      // Conversion, publish, formatting
+#define LCD_ROW_SENDS         17             // Cursor and 16 characters
+#define PUMP_PWM_PERIOD       1199U
+#define PUMP_RUN_NS           90000000000ULL
+#define PUMP_ADJUST_NS        30000000000ULL
+#define PUMP_SAMPLE_TICKS     4U
+
+typedef struct {
+    // Truth
+    uint64_t t;                               // Now
+    uint64_t sleep_ns;
+    uint64_t active_ns[ENERGY_SUBSYSTEM_COUNT];  // Pump: duty-weighted
+    uint32_t events[ENERGY_SUBSYSTEM_COUNT];
+
+    // Scheduler
+    uint64_t next_tick;
+    uint32_t ticks;
+    uint64_t next_reading;
+    uint64_t convert_at;                      // 0: no scan pending
+    bool result_pending;
+    bool window_armed;
+    uint64_t window_start;
+    uint64_t next_telemetry;
+    uint32_t uart_bytes;                      // Still to go out
+    uint64_t uart_next_irq;
+    bool pump_on;
+    uint32_t pump_cc;
+    uint64_t pump_changed;
+    int pump_run;
+    uint32_t rng;
+    uint32_t sample_counts;                   // Calibrated cost of read_counts()
+
+    EnergyCounters counters;
+} Sim;
+
+static const uint64_t pump_starts_h[] = { 6, 12, 18, 23 };
+
+static uint32_t next_random(Sim *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 17;
+    s->rng ^= s->rng << 5;
+    return s->rng;
+}
+
+static uint64_t random_below(Sim *s, uint64_t limit) {
+    return limit ? ((uint64_t)next_random(s) * limit) >> 32 : 0;
+}
+
+// The wrapping 32-bit microsecond clock of boot_monitor_now_us(); the
+// time is sampled as the read starts, and reading it takes CPU time
+static uint32_t read_clock(Sim *s) {
+    uint32_t now = (uint32_t)(s->t / 1000U);
+    s->t += CLOCK_READ_NS + DIVIDE_NS;
+    return now;
+}
+
+// masked_now_counts(): TC4 counts, without the division
+static uint32_t read_counts(Sim *s) {
+    uint32_t now = (uint32_t)(s->t * (COUNTS_PER_MS / 1000U) / 1000U);
+    s->t += CLOCK_READ_NS;
+    return now;
+}
+
+static void service_interrupts(Sim *s);
+
+// Main-loop work of length ns; interrupts due in between preempt it
+static void cpu_busy(Sim *s, uint64_t ns) {
+    uint64_t end = s->t + ns;
+    for (;;) {
+        uint64_t irq = s->next_tick;
+        if (s->uart_bytes && s->uart_next_irq < irq) {
+            irq = s->uart_next_irq;
+        }
+        if (irq >= end) {
+            break;
+        }
+        if (irq > s->t) {
+            s->t = irq;
+        }
+        uint64_t before = s->t;
+        service_interrupts(s);
+        end += s->t - before;
+    }
+    s->t = end;
+}
+
+static void uart_send(Sim *s, uint32_t bytes) {
+    energy_count(&s->counters, ENERGY_UART, (bytes * UART_BYTE_US_X16) >> 4);
+    s->events[ENERGY_UART]++;
+    if (s->uart_bytes == 0) {
+        s->uart_next_irq = s->t + UART_BYTE_NS;
+    }
+    s->uart_bytes += bytes;
+}
+
+static void lcd_send(Sim *s, uint32_t sends) {
+    for (uint32_t i = 0; i < sends; i++) {
+        energy_count(&s->counters, ENERGY_LCD, LCD_SEND_US);
+        s->events[ENERGY_LCD]++;
+        s->active_ns[ENERGY_LCD] += LCD_SEND_NS;
+        cpu_busy(s, LCD_SEND_NS);
+    }
+}
+
+static void pump_set(Sim *s, float percent) {
+    uint32_t cc = (uint32_t)(percent / 100.0f * (PUMP_PWM_PERIOD + 1U) + 0.5f);
+    uint32_t now = read_clock(s);
+    s->active_ns[ENERGY_PUMP] += (s->t - s->pump_changed) * s->pump_cc / (PUMP_PWM_PERIOD + 1U);
+    if (!s->pump_on && cc != 0) {
+        s->events[ENERGY_PUMP]++;
+    }
+    energy_set_level(&s->counters, ENERGY_PUMP, now,
+                     (uint16_t)((cc << ENERGY_LEVEL_SHIFT) / (PUMP_PWM_PERIOD + 1U)));
+    s->pump_cc = cc;
+    s->pump_changed = s->t;
+    s->pump_on = cc != 0;
+}
+
+static void window_disarm(Sim *s) {
+    if (s->window_armed) {
+        s->active_ns[ENERGY_ADC] += s->t - s->window_start;
+        energy_set_level(&s->counters, ENERGY_ADC, read_clock(s), 0);
+        s->window_armed = false;
+    }
+}
+
+static void service_interrupts(Sim *s) {
+    while (s->t >= s->next_tick || (s->uart_bytes && s->t >= s->uart_next_irq)) {
+        if (s->t >= s->next_tick) {
+            uint64_t isr = TICK_ISR_NS;
+            s->ticks++;
+            s->next_tick += TICK_NS;
+            if (s->pump_on) {
+                isr += INTERLOCK_NS;
+                // The window is never armed while watering; a scan holds
+                // the ADC only for its conversion, which this skips past
+                if (s->ticks % PUMP_SAMPLE_TICKS == 0) {
+                    energy_count(&s->counters, ENERGY_ADC, ADC_CONVERSION_US);
+                    s->events[ENERGY_ADC]++;
+                    s->active_ns[ENERGY_ADC] += ADC_CONVERSION_NS;
+                    isr += ADC_CONVERSION_NS;
+                }
+            }
+            s->t += isr;
+        } else {
+            s->uart_bytes--;
+            s->active_ns[ENERGY_UART] += UART_BYTE_NS;
+            uint64_t gap = random_below(s, UART_GAP_MAX_NS);
+            s->active_ns[ENERGY_UART] += s->uart_bytes ? gap : 0;
+            s->uart_next_irq += UART_BYTE_NS + gap;
+            s->t += UART_ISR_NS;
+        }
+    }
+}
+
+static void main_pass(Sim *s, uint64_t day_ns) {
+    cpu_busy(s, PASS_MIN_NS + random_below(s, PASS_SPREAD_NS));
+
+    // Pump schedule
+    uint64_t in_day = s->t % day_ns;
+    for (size_t i = 0; i < sizeof(pump_starts_h) / sizeof(pump_starts_h[0]); i++) {
+        uint64_t start = pump_starts_h[i] * 3600000000000ULL;
+        if (!s->pump_on && s->pump_run != (int)i && in_day >= start && in_day < start + PUMP_RUN_NS) {
+            window_disarm(s);
+            pump_set(s, 60.0f);
+            s->pump_run = (int)i;
+            s->next_reading = s->t;
+        }
+        if (s->pump_on && s->pump_run == (int)i) {
+            if (in_day >= start + PUMP_RUN_NS) {
+                pump_set(s, 0.0f);
+            } else if (in_day >= start + PUMP_ADJUST_NS && s->pump_cc < 900U) {
+                pump_set(s, 75.0f);
+            }
+        }
+    }
+
+    // Moisture reading: power and settle, convert, then report
+    if (s->t >= s->next_reading && s->convert_at == 0 && !s->result_pending) {
+        window_disarm(s);
+        s->convert_at = s->t + SETTLE_NS;
+    }
+    if (s->convert_at != 0 && s->t >= s->convert_at) {
+        // The conversion runs while the CPU sleeps until the next pass
+        s->events[ENERGY_ADC]++;
+        s->active_ns[ENERGY_ADC] += ADC_CONVERSION_NS;
+        s->convert_at = 0;
+        s->result_pending = true;
+    } else if (s->result_pending) {
+        energy_count(&s->counters, ENERGY_ADC, ADC_CONVERSION_US);
+        s->result_pending = false;
+        cpu_busy(s, READING_WORK_NS);
+        uart_send(s, READING_BYTES);
+        lcd_send(s, 2 * LCD_ROW_SENDS);
+        if (s->pump_on) {
+            s->next_reading = s->t + WATERING_READING_NS;
+        } else {
+            s->next_reading = s->t + READING_MIN_NS + random_below(s, READING_SPREAD_NS);
+            if (random_below(s, 100) < WINDOW_PERCENT) {
+                s->window_armed = true;
+                s->events[ENERGY_ADC]++;
+                s->window_start = s->t;
+                energy_set_level(&s->counters, ENERGY_ADC, read_clock(s), ENERGY_LEVEL_FULL);
+            }
+        }
+    }
+
+    if (s->t >= s->next_telemetry) {
+        s->next_telemetry += TELEMETRY_NS;
+        energy_advance(&s->counters, read_clock(s));
+        cpu_busy(s, 60000);
+        uart_send(s, TELEMETRY_BYTES);
+    }
+}
+
+// energy_monitor_idle(): both timestamps are taken with interrupts masked
+static void idle(Sim *s) {
+    uint64_t irq = s->next_tick;
+    if (s->uart_bytes && s->uart_next_irq < irq) {
+        irq = s->uart_next_irq;
+    }
+    uint32_t start = read_counts(s);
+    s->t += WFI_NS / 2U;
+    if (irq > s->t) {
+        s->sleep_ns += irq - s->t;
+        s->t = irq;
+    }
+    s->t += WFI_NS / 2U;
+    uint32_t slept = read_counts(s) - start;
+    energy_sleep(&s->counters, (slept > s->sample_counts) ? slept - s->sample_counts : 0U);
+    s->events[ENERGY_CPU]++;
+    service_interrupts(s);
+}
+
+static double percent_error(double counted, double truth) {
+    return truth != 0.0 ? 100.0 * (counted - truth) / truth : 0.0;
+}
+
+static double time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void measure_cost(void) {
+    static EnergyCounters counters;
+    const uint32_t calls = 10000000U;
+    energy_counters_init(&counters, 0, COUNTS_PER_MS);
+
+    double start = time_ns();
+    for (uint32_t i = 0; i < calls; i++) {
+        energy_count(&counters, (EnergySubsystem)(i & 3U), 12U);
+        __asm__ volatile("" ::: "memory");
+    }
+    double count_ns = (time_ns() - start) / calls;
+
+    start = time_ns();
+    for (uint32_t i = 0; i < calls; i++) {
+        energy_sleep(&counters, i & 0xFFFFU);
+        __asm__ volatile("" ::: "memory");
+    }
+    double sleep_ns = (time_ns() - start) / calls;
+
+    start = time_ns();
+    for (uint32_t i = 0; i < calls; i++) {
+        energy_set_level(&counters, ENERGY_PUMP, i * 7U, (uint16_t)(i & 1U) * 600U);
+    }
+    double level_ns = (time_ns() - start) / calls;
+
+    printf("host cost: energy_count %.2f ns, energy_sleep %.2f ns, energy_set_level %.2f ns per call\n",
+           count_ns, sleep_ns, level_ns);
+}
+
+int main(int argc, char **argv) {
+    int hours = (argc > 1) ? atoi(argv[1]) : DEFAULT_HOURS;
+    EnergyModel model = {
+        ENERGY_MODEL_MAGIC, ENERGY_MODEL_FORMAT, sizeof(EnergyModel), 0,
+        2100U, { 2400U, 400U, 300U, 600U, 250000U }, 0U, 0U
+    };
+    energy_model_seal(&model);
+
+    if (argc > 2) {
+        uint8_t data[sizeof(EnergyModel) + 1];
+        FILE *file = fopen(argv[2], "rb");
+        size_t length = file ? fread(data, 1, sizeof(data), file) : 0;
+        if (file) fclose(file);
+        EnergyModelResult result = energy_model_validate(data, (uint16_t)length);
+        if (result != ENERGY_MODEL_OK) {
+            fprintf(stderr, "%s: %s\n", argv[2], energy_model_result_name(result));
+            return 1;
+        }
+        memcpy(&model, data, sizeof(model));
+        printf("model v%u from %s\n", (unsigned)model.version, argv[2]);
+    }
+    if (hours <= 0) {
+        hours = DEFAULT_HOURS;
+    }
+
+    static Sim sim;
+    Sim *s = &sim;
+    uint64_t day_ns = 24ULL * 3600000000000ULL;
+    uint64_t end = (uint64_t)hours * 3600000000000ULL;
+    s->rng = 0x2545F491U;
+    s->next_tick = TICK_NS;
+    s->next_reading = 5000000000ULL;
+    s->next_telemetry = TELEMETRY_NS;
+    s->pump_run = -1;
+    energy_counters_init(&s->counters, 0, COUNTS_PER_MS);
+    // As energy_monitor_init() calibrates it
+    s->sample_counts = UINT32_MAX;
+    for (int i = 0; i < 8; i++) {
+        s->t += random_below(s, 1000);
+        uint32_t first = read_counts(s);
+        uint32_t elapsed = read_counts(s) - first;
+        if (elapsed < s->sample_counts) {
+            s->sample_counts = elapsed;
+        }
+    }
+    s->t = 0;
+
+    while (s->t < end) {
+        main_pass(s, day_ns);
+        idle(s);
+    }
+    window_disarm(s);
+    pump_set(s, 0.0f);
+    energy_advance(&s->counters, read_clock(s));
+    s->active_ns[ENERGY_CPU] = s->t - s->sleep_ns;
+
+    EnergyBudget budget;
+    energy_estimate(&s->counters, &model, &budget);
+
+    // Truth charge in nAh: uA * ns / 3.6e9
+    double truth_nah = (double)model.base_ua * (double)s->t / 3.6e9;
+    double counted_nah = (double)budget.base_nah;
+    printf("%d h simulated, uptime %.3f s counted, %.3f s true\n\n", hours,
+           budget.uptime_us / 1e6, s->t / 1e9);
+    printf("subsystem   events  counted   true ms    counted ms   error    uA       true mAh  counted mAh\n");
+    for (int i = 0; i < ENERGY_SUBSYSTEM_COUNT; i++) {
+        double true_ms = s->active_ns[i] / 1e6;
+        double counted_ms = budget.active_us[i] / 1e3;
+        double sub_truth = (double)model.active_ua[i] * (double)s->active_ns[i] / 3.6e9;
+        truth_nah += sub_truth;
+        counted_nah += (double)budget.charge_nah[i];
+        printf("%-8s %9u %8u %12.1f %12.1f  %+6.2f%% %7u %10.3f %10.3f\n",
+               energy_subsystem_name((EnergySubsystem)i), s->events[i], budget.events[i],
+               true_ms, counted_ms, percent_error(counted_ms, true_ms),
+               (unsigned)model.active_ua[i], sub_truth / 1e6, budget.charge_nah[i] / 1e6);
+    }
+    printf("%-8s %52s %7u %10.3f %10.3f\n", "Base", "", (unsigned)model.base_ua,
+           model.base_ua * (double)s->t / 3.6e9 / 1e6, budget.base_nah / 1e6);
+    printf("\ntotal %.3f mAh true, %.3f mAh counted (%+.3f%%), average %u uA counted\n",
+           truth_nah / 1e6, counted_nah / 1e6, percent_error(counted_nah, truth_nah),
+           (unsigned)budget.average_ua);
+    printf("CPU awake %.3f %% of the time, %u wakeups\n",
+           100.0 * (double)s->active_ns[ENERGY_CPU] / (double)s->t, budget.events[ENERGY_CPU]);
+    measure_cost();
+    return 0;
+}
@@ -0,0 +1,968 @@
+/*
+ * Greenhouse-scale what-if runs: thousands of virtual controllers, each
+ * with its own bed, sharing one water supply, sharded across all cores.
+ *
+ *     cc -O2 -pthread -I Irrigation_System.X -o fleet_sim tools/fleet_sim.c \
+ *        Irrigation_System.X/hsm.c Irrigation_System.X/adaptive_sampling.c \
+ *        Irrigation_System.X/moisture_curve.c Irrigation_System.X/adc_window.c \
+ *        Irrigation_System.X/config_block.c Irrigation_System.X/crc32.c -lm
+ *
+ *     ./fleet_sim [-n controllers] [-d days] [-t threads] [-s supply_l_min]
+ *                 [-u duty] [-c block.bin] [-r seed] [-p] [-S]
+ *
+ * Each controller runs the firmware's decision code:
+ *  - the moisture state machine of moisture_sensor.c, as the same hsm.h
+ *    tables: scan, settle, convert through the calibration table, sample
+ *    again after the adaptive interval (adaptive_sampling.c), and hand
+ *    over to the ADC window (adc_window.c) inside the plant's band, with
+ *    the same re-arm hysteresis and refresh;
+ *  - the plant thresholds, sampling bounds and pump calibration of a
+ *    runtime configuration block. Without -c the firmware defaults are
+ *    used; a block from tools/config_pack.py is checked with
+ *    config_block_validate() first, so a what-if run takes exactly the
+ *    block that would be uploaded;
+ *  - the pump: on at -u percent duty when a reading is at or below the
+ *    plant's low threshold, off at its ideal high or after
+ *    PUMP_MAX_RUN_MS, with the flow interpolated from the calibration
+ *    table as Pump_control.c does. The tree has no main loop with a
+ *    watering rule; this is the one the thresholds are meant for.
+ * The bed is a bucket of soil water. It dries exponentially towards its
+ * floor, faster by day, and the sunnier end of the greenhouse (high bed
+ * numbers) dries up to three times faster. The sensor's true dry and wet
+ * readings differ from the two-point calibration by up to +/-80 counts
+ * and every conversion has noise; the window's 16-sample average has a
+ * quarter of it.
+ *
+ * All pumps draw from one main line of -s litres per minute. When the
+ * running pumps ask for more, each gets the same fraction. The controllers
+ * do not know: their volume accounting counts the calibrated flow, so the
+ * report shows what they counted next to what the beds got.
+ *
+ * Scheduling. Simulated time advances in EPOCH_MS epochs. Within an
+ * epoch the controllers are independent; the supply couples them only at
+ * the epoch boundaries, where the share for the next epoch is set from
+ * the pumps then running. The controllers are cut into chunks of
+ * CHUNK_SIZE. Each worker thread owns a contiguous shard of chunks and
+ * pushes them onto its own deque at the start of an epoch, then works
+ * from the bottom of it. A worker whose deque is empty steals from the top
+ * of another's (Chase-Lev deques), so beds that need more work, those
+ * watering or close to a threshold, do not hold the epoch up. -p keeps
+ * every worker on its own shard for comparison. Workers meet at a
+ * spinning barrier, and the last to arrive sets the next epoch's share.
+ *
+ * A controller's result depends only on its own bed and the share, which
+ * is computed from integer demand, so the run is the same for any number
+ * of threads and any steal pattern. The fleet digest (CRC-32 of every
+ * controller's counters) checks this; -S runs 1, 2, 4, ... threads up to
+ * -t and compares the digests and speeds.
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hsm.h"
+#include "moisture_sensor.h"
+#include "adaptive_sampling.h"
+#include "moisture_curve.h"
+#include "adc_window.h"
+#include "config_block.h"
+#include "crc32.h"
+
+#define DEFAULT_CONTROLLERS   1000U
+#define DEFAULT_DAYS          7U
+#define MAX_DAYS              45U      // The controllers' millisecond clock wraps at 49 days
+#define DEFAULT_SUPPLY_L_MIN  2.0
+#define DEFAULT_DUTY          60.0
+
+#define EPOCH_MS              60000U   // Supply shares are set per epoch
+#define STEP_MS               10000U   // Soil and window compare resolution
+#define STEPS_PER_DAY         (86400000U / STEP_MS)
+#define CHUNK_SIZE            32U      // Controllers per task
+#define CACHE_LINE            64
+
+// Firmware values
+#define PUMP_MAX_RUN_MS       600000U  // SCHEDULE_MAX_RUN_MS
+#define DRY_RAW               3200U    // Two-point calibration of the controllers
+#define WET_RAW               1300U
+
+// Beds
+#define SENSOR_OFFSET_MAX     80       // True dry/wet reading vs. the calibration
+#define SENSOR_NOISE          12       // Counts, single conversion
+#define DRY_TIME_CONSTANT_S   (2.0 * 86400.0)  // Shady end of the greenhouse, by day average
+#define SUN_FACTOR_MAX        3.0      // Sunny end dries this much faster
+
+#define SPIN_LIMIT            256      // Spins before yielding the core
+
+// --- Firmware configuration ---
+
+// Must match build_defaults() in runtime_config.c and PLANT_THRESHOLDS
+static void build_defaults(ConfigBlock *block) {
+    static const ConfigPlant plants[] = {
+        { "peppermint", 40, 50, 70, 80 },
+        { "tulip",      30, 40, 60, 70 },
+        { "basil",      40, 55, 75, 85 },
+    };
+    static const ConfigPumpPoint pump_points[] = {
+        { 20.0f, 0.8f }, { 40.0f, 1.9f }, { 60.0f, 3.1f }, { 80.0f, 4.5f }, { 100.0f, 5.8f },
+    };
+
+    memset(block, 0, sizeof(*block));
+    block->magic = CONFIG_BLOCK_MAGIC;
+    block->format = CONFIG_BLOCK_FORMAT;
+    block->size = sizeof(ConfigBlock);
+    block->pump_pwm_period = 1199;
+    block->moisture_level_threshold = 2300;
+    block->sample_min_ms = ADAPTIVE_SAMPLING_MIN_MS;
+    block->sample_max_ms = ADAPTIVE_SAMPLING_MAX_MS;
+    block->plant_count = sizeof(plants) / sizeof(plants[0]);
+    memcpy(block->plants, plants, sizeof(plants));
+    block->pump_point_count = sizeof(pump_points) / sizeof(pump_points[0]);
+    memcpy(block->pump_points, pump_points, sizeof(pump_points));
+    config_block_seal(block);
+}
+
+// get_flow_rate_ml_per_sec() in Pump_control.c
+static float flow_rate_ml_per_sec(const ConfigBlock *config, float duty) {
+    const ConfigPumpPoint *table = config->pump_points;
+    uint8_t count = config->pump_point_count;
+
+    if (duty <= table[0].duty_cycle_percent) {
+        return (table[0].duty_cycle_percent > 0.01f)
+            ? table[0].flow_rate_ml_per_sec * (duty / table[0].duty_cycle_percent) : 0.0f;
+    }
+    for (uint8_t i = 0; i + 1U < count; i++) {
+        if (duty >= table[i].duty_cycle_percent && duty <= table[i + 1U].duty_cycle_percent) {
+            float d1 = table[i].duty_cycle_percent, r1 = table[i].flow_rate_ml_per_sec;
+            float d2 = table[i + 1U].duty_cycle_percent, r2 = table[i + 1U].flow_rate_ml_per_sec;
+            return (d2 - d1 < 0.01f) ? r1 : r1 + (duty - d1) * (r2 - r1) / (d2 - d1);
+        }
+    }
+    return table[count - 1U].flow_rate_ml_per_sec;
+}
+
+// --- Controllers ---
+
+typedef struct {
+    uint64_t water_ul;           // Reached the bed
+    uint64_t counted_ul;         // Counted by the controller at the calibrated flow
+    uint64_t runoff_ul;          // Beyond saturation
+    uint32_t dry_steps;          // Below the plant's low threshold
+    uint32_t band_steps;         // Within ideal low..ideal high
+    uint32_t wet_steps;          // Above the high threshold
+    uint32_t readings;
+    uint32_t window_wakeups;
+    uint32_t window_refreshes;
+    uint32_t pump_runs;
+    uint32_t time_limits;        // Runs ended by PUMP_MAX_RUN_MS
+    uint32_t pump_ms;
+} ControllerStats;
+
+typedef struct {
+    Hsm fsm;                     // States of moisture_sensor.h
+
+    // Moisture context, as MoistureSensorContext
+    uint16_t raw;
+    uint8_t percent;
+    uint8_t window_margin;
+    uint32_t measurement_start;
+    uint32_t wait_ms;
+    AdaptiveSampler sampler;
+    AdcWindow window;
+    bool window_crossed;
+    uint16_t window_raw;
+    uint32_t now_ms;
+    uint32_t wake_ms;            // Next time the machine has something to do
+
+    // Pump
+    bool pump_on;
+    bool pump_was_on;            // At the previous reading
+    uint32_t pump_start_ms;
+    uint32_t pump_mark_ms;       // On-time accounted up to here
+    uint32_t step_on_ms;         // On-time in the current soil step
+
+    // Bed
+    const ConfigPlant *plant;
+    uint8_t plant_index;
+    uint16_t dry_raw;            // True sensor readings
+    uint16_t wet_raw;
+    uint32_t rng;
+    double moisture;             // Percent
+    double floor;
+    double ml_per_percent;
+    double dry_rate;             // Per step at the day's average
+
+    ControllerStats stats;
+} __attribute__((aligned(CACHE_LINE))) Controller;
+
+typedef struct Fleet Fleet;
+
+typedef struct {
+    // Chase-Lev deque of chunk indices; top and bottom only grow
+    int64_t top __attribute__((aligned(CACHE_LINE)));
+    int64_t bottom __attribute__((aligned(CACHE_LINE)));
+    uint32_t *tasks;
+    uint32_t mask;
+
+    Fleet *fleet;
+    pthread_t thread;
+    uint32_t first_chunk;        // Shard
+    uint32_t chunk_count;
+    uint32_t rng;
+    uint64_t demand_ul_s;        // Pumps on at the end of the epoch
+    uint64_t chunks_run;
+    uint64_t chunks_stolen;
+} __attribute__((aligned(CACHE_LINE))) Worker;
+
+struct Fleet {
+    // Run parameters
+    uint32_t controller_count;
+    uint32_t days;
+    uint32_t supply_ul_s;        // 0: unlimited
+    float duty;
+    uint32_t seed;
+    bool stealing;
+    const ConfigBlock *config;
+    MoistureLut lut;
+    uint32_t flow_ul_s;          // Calibrated flow at the duty
+    double drying[STEPS_PER_DAY];
+
+    Controller *controllers;
+    uint32_t chunk_count;
+    Worker *workers;
+    uint32_t worker_count;
+
+    // Epoch state; the share is written by the last worker into the barrier
+    double share;
+    uint32_t epoch;
+    uint32_t remaining __attribute__((aligned(CACHE_LINE)));
+    uint32_t arrived __attribute__((aligned(CACHE_LINE)));
+    uint32_t generation;
+
+    // Supply, over all epochs
+    uint32_t throttled_epochs;
+    double lowest_share;
+    uint64_t peak_demand_ul_s;
+};
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double random_unit(uint32_t *state) {
+    return next_random(state) / 4294967296.0;
+}
+
+static const Fleet *fleet_of(const Controller *c);
+
+// One conversion of the bed's sensor (capacitive: lower when wet)
+static uint16_t sensor_read(Controller *c, int noise) {
+    double raw = c->wet_raw + (c->dry_raw - c->wet_raw) * (100.0 - c->moisture) / 100.0;
+    raw += (int)(next_random(&c->rng) % (2U * noise + 1U)) - noise;
+    return (uint16_t)((raw < 0.0) ? 0.0 : (raw > 4095.0) ? 4095.0 : raw + 0.5);
+}
+
+static void pump_start(Controller *c) {
+    c->pump_on = true;
+    c->pump_start_ms = c->now_ms;
+    c->pump_mark_ms = c->now_ms;
+    c->stats.pump_runs++;
+}
+
+static void pump_stop(Controller *c) {
+    c->pump_on = false;
+    c->step_on_ms += c->now_ms - c->pump_mark_ms;
+    c->stats.pump_ms += c->now_ms - c->pump_start_ms;
+}
+
+// --- Moisture state machine, as in moisture_sensor.c ---
+
+#define MOISTURE_STATE_WAITING      (MOISTURE_STATE_MONITOR + 1)
+#define MOISTURE_STATE_COUNT        (MOISTURE_STATE_WAITING + 1)
+
+typedef enum {
+    MOISTURE_EVT_DONE,
+    MOISTURE_EVT_ARMED,
+    MOISTURE_EVT_CROSSED,
+    MOISTURE_EVT_TIMEOUT,
+    MOISTURE_EVT_COUNT
+} MoistureSensorEvent;
+
+static HsmEventId idle_poll(Hsm *fsm) {
+    (void)fsm;
+    return MOISTURE_EVT_DONE;
+}
+
+static HsmEventId init_measurement_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+    c->measurement_start = c->now_ms;
+    return MOISTURE_EVT_DONE;
+}
+
+static HsmEventId wait_conversion_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+    return (c->now_ms - c->measurement_start >= SENSOR_SCAN_SETTLE_MS) ? MOISTURE_EVT_DONE : HSM_NONE;
+}
+
+static HsmEventId process_data_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+    c->raw = sensor_read(c, SENSOR_NOISE);
+    return MOISTURE_EVT_DONE;
+}
+
+static void convert_entry(Hsm *fsm) {
+    Controller *c = fsm->context;
+    const Fleet *fleet = fleet_of(c);
+
+    c->percent = moisture_lut_convert(&fleet->lut, c->raw);
+    c->stats.readings++;
+    c->sampler.config.min_interval_ms = fleet->config->sample_min_ms;
+    c->sampler.config.max_interval_ms = fleet->config->sample_max_ms;
+    if (c->pump_was_on && !c->pump_on) {
+        adaptive_sampling_reset(&c->sampler);
+    }
+    c->pump_was_on = c->pump_on;
+    c->wait_ms = adaptive_sampling_update(&c->sampler, c->now_ms, c->percent,
+                                          c->plant->moisture_low, c->plant->moisture_high);
+}
+
+static HsmEventId convert_poll(Hsm *fsm) {
+    (void)fsm;
+    return MOISTURE_EVT_DONE;
+}
+
+// moisture_window_arm()
+static bool window_arm(Controller *c) {
+    uint8_t low = c->plant->moisture_low;
+    uint8_t high = c->plant->moisture_high;
+
+    if (c->percent <= low || c->percent >= high) {
+        c->window_margin = MOISTURE_WINDOW_HYSTERESIS;
+        return false;
+    }
+    if (c->pump_on) {
+        return false;
+    }
+    if (c->percent < low + c->window_margin || c->percent > high - c->window_margin ||
+        !adc_window_around(&fleet_of(c)->lut, c->raw, 0, low, high, &c->window)) {
+        return false;
+    }
+    c->window_margin = 0;
+    c->window_crossed = false;
+    return true;
+}
+
+// SEND_UART publishes the reading; the watering rule acts on it here
+static HsmEventId send_uart_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+
+    if (c->pump_on) {
+        if (c->percent >= c->plant->moisture_ideal_high) {
+            pump_stop(c);
+        } else if (c->now_ms - c->pump_start_ms >= PUMP_MAX_RUN_MS) {
+            c->stats.time_limits++;
+            pump_stop(c);
+        }
+    } else if (c->percent <= c->plant->moisture_low) {
+        pump_start(c);
+    }
+    return window_arm(c) ? MOISTURE_EVT_ARMED : MOISTURE_EVT_DONE;
+}
+
+static void waiting_entry(Hsm *fsm) {
+    Controller *c = fsm->context;
+    c->measurement_start = c->now_ms;
+}
+
+static HsmEventId wait_timer_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+    uint32_t elapsed = c->now_ms - c->measurement_start;
+
+    if (elapsed >= c->wait_ms ||
+        (c->pump_on && elapsed >= c->sampler.config.min_interval_ms)) {
+        return MOISTURE_EVT_TIMEOUT;
+    }
+    return HSM_NONE;
+}
+
+static HsmEventId monitor_poll(Hsm *fsm) {
+    Controller *c = fsm->context;
+
+    if (c->window_crossed) {
+        c->window_crossed = false;
+        c->raw = c->window_raw;
+        c->stats.window_wakeups++;
+        return MOISTURE_EVT_CROSSED;
+    }
+    if (c->now_ms - c->measurement_start >= MOISTURE_WINDOW_REFRESH_MS || c->pump_on) {
+        c->stats.window_refreshes++;
+        return MOISTURE_EVT_TIMEOUT;
+    }
+    return HSM_NONE;
+}
+
+static const HsmState moisture_states[MOISTURE_STATE_COUNT] = {
+    //                                    parent                  initial                    entry          exit  poll
+    [MOISTURE_STATE_IDLE]             = { HSM_NONE,               HSM_NONE,                  NULL,          NULL, idle_poll },
+    [MOISTURE_STATE_INIT_MEASUREMENT] = { HSM_NONE,               HSM_NONE,                  NULL,          NULL, init_measurement_poll },
+    [MOISTURE_STATE_WAIT_CONVERSION]  = { HSM_NONE,               HSM_NONE,                  NULL,          NULL, wait_conversion_poll },
+    [MOISTURE_STATE_PROCESS_DATA]     = { HSM_NONE,               HSM_NONE,                  NULL,          NULL, process_data_poll },
+    [MOISTURE_STATE_CONVERT]          = { HSM_NONE,               HSM_NONE,                  convert_entry, NULL, convert_poll },
+    [MOISTURE_STATE_SEND_UART]        = { HSM_NONE,               HSM_NONE,                  NULL,          NULL, send_uart_poll },
+    [MOISTURE_STATE_WAIT_TIMER]       = { MOISTURE_STATE_WAITING, HSM_NONE,                  NULL,          NULL, wait_timer_poll },
+    [MOISTURE_STATE_MONITOR]          = { MOISTURE_STATE_WAITING, HSM_NONE,                  NULL,          NULL, monitor_poll },
+    [MOISTURE_STATE_WAITING]          = { HSM_NONE,               MOISTURE_STATE_WAIT_TIMER, waiting_entry, NULL, NULL },
+};
+
+static const HsmStateId moisture_transitions[MOISTURE_STATE_COUNT][MOISTURE_EVT_COUNT] = {
+    [MOISTURE_STATE_IDLE]             = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_INIT_MEASUREMENT) },
+    [MOISTURE_STATE_INIT_MEASUREMENT] = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_WAIT_CONVERSION) },
+    [MOISTURE_STATE_WAIT_CONVERSION]  = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_PROCESS_DATA) },
+    [MOISTURE_STATE_PROCESS_DATA]     = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_CONVERT) },
+    [MOISTURE_STATE_CONVERT]          = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_SEND_UART) },
+    [MOISTURE_STATE_SEND_UART]        = { [MOISTURE_EVT_DONE] = HSM_TO(MOISTURE_STATE_WAIT_TIMER),
+                                          [MOISTURE_EVT_ARMED] = HSM_TO(MOISTURE_STATE_MONITOR) },
+    [MOISTURE_STATE_MONITOR]          = { [MOISTURE_EVT_CROSSED] = HSM_TO(MOISTURE_STATE_CONVERT) },
+    [MOISTURE_STATE_WAITING]          = { [MOISTURE_EVT_TIMEOUT] = HSM_TO(MOISTURE_STATE_IDLE) },
+};
+
+static const HsmDefinition moisture_machine = {
+    moisture_states,
+    &moisture_transitions[0][0],
+    MOISTURE_STATE_COUNT,
+    MOISTURE_EVT_COUNT,
+    0,
+    NULL,
+};
+
+// The controllers reach the fleet through this; set before the workers start
+static const Fleet *current_fleet;
+
+static const Fleet *fleet_of(const Controller *c) {
+    (void)c;
+    return current_fleet;
+}
+
+// Main-loop passes at now_ms until the machine waits for something
+static void controller_run(Controller *c, uint32_t now_ms) {
+    c->now_ms = now_ms;
+    for (;;) {
+        uint32_t before = c->fsm.transitions;
+        hsm_run(&c->fsm);
+        if (c->fsm.transitions == before) {
+            break;
+        }
+    }
+
+    switch (hsm_state(&c->fsm)) {
+        case MOISTURE_STATE_WAIT_CONVERSION:
+            c->wake_ms = c->measurement_start + SENSOR_SCAN_SETTLE_MS;
+            break;
+        case MOISTURE_STATE_WAIT_TIMER: {
+            uint32_t wait = c->wait_ms;
+            if (c->pump_on && c->sampler.config.min_interval_ms < wait) {
+                wait = c->sampler.config.min_interval_ms;
+            }
+            c->wake_ms = c->measurement_start + wait;
+            break;
+        }
+        case MOISTURE_STATE_MONITOR:
+            // Crossings are found by the soil step's compare
+            c->wake_ms = c->measurement_start + MOISTURE_WINDOW_REFRESH_MS;
+            break;
+        default:
+            c->wake_ms = now_ms;
+            break;
+    }
+}
+
+// Water and weather for one STEP_MS from step_ms
+static void soil_step(Controller *c, const Fleet *fleet, uint32_t step_ms, double share) {
+    const ConfigPlant *plant = c->plant;
+    uint32_t end_ms = step_ms + STEP_MS;
+
+    if (c->moisture < plant->moisture_low) {
+        c->stats.dry_steps++;
+    } else if (c->moisture > plant->moisture_high) {
+        c->stats.wet_steps++;
+    } else if (c->moisture >= plant->moisture_ideal_low && c->moisture <= plant->moisture_ideal_high) {
+        c->stats.band_steps++;
+    }
+
+    if (c->pump_on) {
+        c->step_on_ms += end_ms - c->pump_mark_ms;
+        c->pump_mark_ms = end_ms;
+    }
+    if (c->step_on_ms != 0) {
+        uint64_t water_ul = (uint64_t)(fleet->flow_ul_s * share) * c->step_on_ms / 1000U;
+        c->stats.water_ul += water_ul;
+        c->stats.counted_ul += (uint64_t)fleet->flow_ul_s * c->step_on_ms / 1000U;
+        c->step_on_ms = 0;
+        c->moisture += water_ul / 1000.0 / c->ml_per_percent;
+        if (c->moisture > 100.0) {
+            c->stats.runoff_ul += (uint64_t)((c->moisture - 100.0) * c->ml_per_percent * 1000.0);
+            c->moisture = 100.0;
+        }
+    }
+    c->moisture -= (c->moisture - c->floor) * c->dry_rate * fleet->drying[(step_ms / STEP_MS) % STEPS_PER_DAY];
+}
+
+static void controller_epoch(Controller *c, const Fleet *fleet, uint32_t epoch_ms, double share) {
+    for (uint32_t step_ms = epoch_ms; step_ms < epoch_ms + EPOCH_MS; step_ms += STEP_MS) {
+        uint32_t end_ms = step_ms + STEP_MS;
+
+        // The ADC compares on its own; a result outside the band wakes the CPU
+        if (hsm_state(&c->fsm) == MOISTURE_STATE_MONITOR) {
+            uint16_t raw = sensor_read(c, SENSOR_NOISE / 4);
+            if (adc_window_outside(&c->window, raw)) {
+                c->window_crossed = true;
+                c->window_raw = raw;
+                c->wake_ms = step_ms;
+            }
+        }
+        while (c->wake_ms < end_ms) {
+            controller_run(c, (c->wake_ms > step_ms) ? c->wake_ms : step_ms);
+        }
+        soil_step(c, fleet, step_ms, share);
+    }
+}
+
+static void controller_init(Controller *c, const Fleet *fleet, uint32_t index) {
+    memset(c, 0, sizeof(*c));
+    c->rng = (index + 1U) * 0x9E3779B9U ^ fleet->seed;
+    if (c->rng == 0) {
+        c->rng = 1;
+    }
+    next_random(&c->rng);
+
+    c->plant_index = (uint8_t)(index % fleet->config->plant_count);
+    c->plant = &fleet->config->plants[c->plant_index];
+    c->dry_raw = (uint16_t)(DRY_RAW + (int)(next_random(&c->rng) % (2U * SENSOR_OFFSET_MAX + 1U)) - SENSOR_OFFSET_MAX);
+    c->wet_raw = (uint16_t)(WET_RAW + (int)(next_random(&c->rng) % (2U * SENSOR_OFFSET_MAX + 1U)) - SENSOR_OFFSET_MAX);
+    c->moisture = c->plant->moisture_ideal_low +
+                  random_unit(&c->rng) * (c->plant->moisture_ideal_high - c->plant->moisture_ideal_low);
+    c->floor = 8.0 + 7.0 * random_unit(&c->rng);
+    c->ml_per_percent = 15.0 + 15.0 * random_unit(&c->rng);
+    double sun = 1.0 + (SUN_FACTOR_MAX - 1.0) * index / fleet->controller_count;
+    c->dry_rate = sun * (0.8 + 0.4 * random_unit(&c->rng)) * STEP_MS / 1000.0 / DRY_TIME_CONSTANT_S;
+
+    adaptive_sampling_init(&c->sampler, NULL);
+    c->wait_ms = c->sampler.interval_ms;
+    hsm_init(&c->fsm, &moisture_machine, c);
+    hsm_transition(&c->fsm, MOISTURE_STATE_WAIT_TIMER);
+    // Boots spread over the first minute
+    c->measurement_start = 0;
+    c->wait_ms = (uint32_t)(next_random(&c->rng) % EPOCH_MS);
+    c->wake_ms = c->wait_ms;
+}
+
+// --- Work-stealing scheduler ---
+
+static void deque_push(Worker *w, uint32_t task) {
+    int64_t bottom = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->tasks[bottom & w->mask], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&w->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+// Owner end
+static bool deque_take(Worker *w, uint32_t *task) {
+    int64_t bottom = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&w->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&w->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    *task = __atomic_load_n(&w->tasks[bottom & w->mask], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // Last task: race the thieves for it
+        bool won = __atomic_compare_exchange_n(&w->top, &top, top + 1, false,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&w->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+// Thief end
+static bool deque_steal(Worker *w, uint32_t *task) {
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return false;
+    }
+    *task = __atomic_load_n(&w->tasks[top & w->mask], __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&w->top, &top, top + 1, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static void run_chunk(Worker *w, uint32_t chunk) {
+    Fleet *fleet = w->fleet;
+    uint32_t first = chunk * CHUNK_SIZE;
+    uint32_t last = first + CHUNK_SIZE;
+    if (last > fleet->controller_count) {
+        last = fleet->controller_count;
+    }
+    uint32_t epoch_ms = fleet->epoch * EPOCH_MS;
+    for (uint32_t i = first; i < last; i++) {
+        Controller *c = &fleet->controllers[i];
+        controller_epoch(c, fleet, epoch_ms, fleet->share);
+        if (c->pump_on) {
+            w->demand_ul_s += fleet->flow_ul_s;
+        }
+    }
+    w->chunks_run++;
+    __atomic_sub_fetch(&fleet->remaining, 1U, __ATOMIC_RELEASE);
+}
+
+// Serial section of the barrier: the share for the next epoch
+static void end_epoch(Fleet *fleet) {
+    uint64_t demand = 0;
+    for (uint32_t i = 0; i < fleet->worker_count; i++) {
+        demand += fleet->workers[i].demand_ul_s;
+        fleet->workers[i].demand_ul_s = 0;
+    }
+    if (demand > fleet->peak_demand_ul_s) {
+        fleet->peak_demand_ul_s = demand;
+    }
+    fleet->share = 1.0;
+    if (fleet->supply_ul_s != 0 && demand > fleet->supply_ul_s) {
+        fleet->share = (double)fleet->supply_ul_s / (double)demand;
+        fleet->throttled_epochs++;
+        if (fleet->share < fleet->lowest_share) {
+            fleet->lowest_share = fleet->share;
+        }
+    }
+    fleet->epoch++;
+    __atomic_store_n(&fleet->remaining, fleet->chunk_count, __ATOMIC_RELAXED);
+}
+
+static void barrier_wait(Fleet *fleet) {
+    uint32_t generation = __atomic_load_n(&fleet->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&fleet->arrived, 1U, __ATOMIC_ACQ_REL) == fleet->worker_count) {
+        end_epoch(fleet);
+        __atomic_store_n(&fleet->arrived, 0U, __ATOMIC_RELAXED);
+        __atomic_store_n(&fleet->generation, generation + 1U, __ATOMIC_RELEASE);
+        return;
+    }
+    for (int spins = 0; __atomic_load_n(&fleet->generation, __ATOMIC_ACQUIRE) == generation; spins++) {
+        if (spins >= SPIN_LIMIT) {
+            sched_yield();
+        }
+    }
+}
+
+static void *worker_main(void *argument) {
+    Worker *w = argument;
+    Fleet *fleet = w->fleet;
+    uint32_t epochs = fleet->days * (86400000U / EPOCH_MS);
+
+    while (__atomic_load_n(&fleet->epoch, __ATOMIC_ACQUIRE) < epochs) {
+        // Pushed last to first, so the owner works through its shard in order
+        for (uint32_t i = w->chunk_count; i-- > 0;) {
+            deque_push(w, w->first_chunk + i);
+        }
+
+        int spins = 0;
+        while (__atomic_load_n(&fleet->remaining, __ATOMIC_ACQUIRE) != 0) {
+            uint32_t chunk;
+            if (deque_take(w, &chunk)) {
+                run_chunk(w, chunk);
+                continue;
+            }
+            bool stolen = false;
+            if (fleet->stealing && fleet->worker_count > 1) {
+                uint32_t start = next_random(&w->rng) % fleet->worker_count;
+                for (uint32_t i = 0; i < fleet->worker_count && !stolen; i++) {
+                    Worker *victim = &fleet->workers[(start + i) % fleet->worker_count];
+                    if (victim != w && deque_steal(victim, &chunk)) {
+                        w->chunks_stolen++;
+                        run_chunk(w, chunk);
+                        stolen = true;
+                    }
+                }
+            }
+            if (!stolen && ++spins >= SPIN_LIMIT) {
+                sched_yield();
+            }
+        }
+        barrier_wait(fleet);
+    }
+    return NULL;
+}
+
+// --- Runs ---
+
+static double time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Simulates the fleet with @p threads workers; returns the wall time
+static double fleet_run(Fleet *fleet, uint32_t threads) {
+    current_fleet = fleet;
+    for (uint32_t i = 0; i < fleet->controller_count; i++) {
+        controller_init(&fleet->controllers[i], fleet, i);
+    }
+    fleet->chunk_count = (fleet->controller_count + CHUNK_SIZE - 1U) / CHUNK_SIZE;
+    fleet->worker_count = threads;
+    fleet->epoch = 0;
+    fleet->share = 1.0;
+    fleet->remaining = fleet->chunk_count;
+    fleet->arrived = 0;
+    fleet->generation = 0;
+    fleet->throttled_epochs = 0;
+    fleet->lowest_share = 1.0;
+    fleet->peak_demand_ul_s = 0;
+
+    uint32_t capacity = 1;
+    while (capacity < fleet->chunk_count) {
+        capacity <<= 1;
+    }
+    fleet->workers = aligned_alloc(CACHE_LINE, threads * sizeof(Worker));
+    for (uint32_t i = 0; i < threads; i++) {
+        Worker *w = &fleet->workers[i];
+        memset(w, 0, sizeof(*w));
+        w->fleet = fleet;
+        w->tasks = calloc(capacity, sizeof(uint32_t));
+        w->mask = capacity - 1U;
+        w->first_chunk = (uint32_t)((uint64_t)fleet->chunk_count * i / threads);
+        w->chunk_count = (uint32_t)((uint64_t)fleet->chunk_count * (i + 1U) / threads) - w->first_chunk;
+        w->rng = 0x2545F491U * (i + 1U);
+    }
+
+    double start = time_s();
+    for (uint32_t i = 1; i < threads; i++) {
+        pthread_create(&fleet->workers[i].thread, NULL, worker_main, &fleet->workers[i]);
+    }
+    worker_main(&fleet->workers[0]);
+    for (uint32_t i = 1; i < threads; i++) {
+        pthread_join(fleet->workers[i].thread, NULL);
+    }
+    return time_s() - start;
+}
+
+static void fleet_release_workers(Fleet *fleet) {
+    for (uint32_t i = 0; i < fleet->worker_count; i++) {
+        free(fleet->workers[i].tasks);
+    }
+    free(fleet->workers);
+    fleet->workers = NULL;
+}
+
+static uint32_t fleet_digest(const Fleet *fleet) {
+    uint32_t crc = CRC32_INITIAL;
+    for (uint32_t i = 0; i < fleet->controller_count; i++) {
+        crc = crc32_update(crc, &fleet->controllers[i].stats, sizeof(ControllerStats));
+    }
+    return crc;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_results(const Fleet *fleet) {
+    uint32_t n = fleet->controller_count;
+    double steps = (double)fleet->days * STEPS_PER_DAY;
+    double *band = malloc(n * sizeof(double));
+    double water = 0, counted = 0, runoff = 0, dry = 0, wet = 0, in_band = 0;
+    double readings = 0, wakeups = 0, refreshes = 0, runs = 0, limits = 0, pump_s = 0;
+    double plant_beds[CONFIG_MAX_PLANTS] = { 0 }, plant_band[CONFIG_MAX_PLANTS] = { 0 };
+    double plant_dry[CONFIG_MAX_PLANTS] = { 0 }, plant_water[CONFIG_MAX_PLANTS] = { 0 };
+
+    for (uint32_t i = 0; i < n; i++) {
+        const Controller *c = &fleet->controllers[i];
+        const ControllerStats *s = &c->stats;
+        band[i] = 100.0 * s->band_steps / steps;
+        water += s->water_ul / 1e6;
+        counted += s->counted_ul / 1e6;
+        runoff += s->runoff_ul / 1e6;
+        dry += 100.0 * s->dry_steps / steps;
+        wet += 100.0 * s->wet_steps / steps;
+        in_band += band[i];
+        readings += s->readings;
+        wakeups += s->window_wakeups;
+        refreshes += s->window_refreshes;
+        runs += s->pump_runs;
+        limits += s->time_limits;
+        pump_s += s->pump_ms / 1000.0;
+        plant_beds[c->plant_index]++;
+        plant_band[c->plant_index] += band[i];
+        plant_dry[c->plant_index] += 100.0 * s->dry_steps / steps;
+        plant_water[c->plant_index] += s->water_ul / 1e3;
+    }
+    qsort(band, n, sizeof(double), compare_double);
+    double bed_days = (double)n * fleet->days;
+
+    printf("water: %.1f L delivered, %.1f L counted by the controllers (%+.2f %%), %.1f L runoff\n",
+           water, counted, counted > 0 ? 100.0 * (counted - water) / water : 0.0, runoff);
+    printf("       %.0f mL per bed and day; %.0f pump runs, %.0f s each on average, %.0f hit the %u s limit\n",
+           water * 1000.0 / bed_days, runs, runs > 0 ? pump_s / runs : 0.0, limits,
+           PUMP_MAX_RUN_MS / 1000U);
+    printf("supply: %s, peak demand %.2f L/min, throttled in %u of %u epochs (%.2f %%), lowest share %.0f %%\n",
+           fleet->supply_ul_s ? "limited" : "unlimited", fleet->peak_demand_ul_s * 60.0 / 1e6,
+           fleet->throttled_epochs, fleet->days * (86400000U / EPOCH_MS),
+           100.0 * fleet->throttled_epochs / (fleet->days * (86400000.0 / EPOCH_MS)),
+           100.0 * fleet->lowest_share);
+    printf("time in the ideal band: mean %.1f %%, p10 %.1f %%, p50 %.1f %%, p90 %.1f %%\n",
+           in_band / n, band[n / 10], band[n / 2], band[n * 9 / 10]);
+    printf("time below the low threshold %.2f %%, above the high threshold %.2f %%\n", dry / n, wet / n);
+    printf("readings: %.0f per bed and day, %.0f window wakeups, %.0f window refreshes\n\n",
+           readings / bed_days, wakeups, refreshes);
+
+    printf("%-12s %6s %8s %8s %10s\n", "plant", "beds", "in band", "dry", "mL/day");
+    for (uint8_t p = 0; p < fleet->config->plant_count; p++) {
+        if (plant_beds[p] == 0) {
+            continue;
+        }
+        printf("%-12.*s %6.0f %7.1f%% %7.2f%% %10.0f\n", CONFIG_PLANT_NAME_LENGTH,
+               fleet->config->plants[p].name, plant_beds[p], plant_band[p] / plant_beds[p],
+               plant_dry[p] / plant_beds[p], plant_water[p] / plant_beds[p] / fleet->days);
+    }
+    free(band);
+}
+
+static void print_workers(const Fleet *fleet) {
+    printf("worker  chunks  stolen\n");
+    for (uint32_t i = 0; i < fleet->worker_count; i++) {
+        printf("%6u %7llu %7llu\n", i, (unsigned long long)fleet->workers[i].chunks_run,
+               (unsigned long long)fleet->workers[i].chunks_stolen);
+    }
+}
+
+static ConfigBlock *load_block(const char *path) {
+    static ConfigBlock block;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    size_t length = fread(&block, 1, sizeof(block), file);
+    fclose(file);
+    ConfigResult result = (length == sizeof(block)) ? config_block_validate(&block) : CONFIG_ERROR_LENGTH;
+    if (result != CONFIG_OK) {
+        fprintf(stderr, "%s: %s\n", path, config_result_name(result));
+        exit(1);
+    }
+    return &block;
+}
+
+int main(int argc, char **argv) {
+    static Fleet fleet;
+    static ConfigBlock defaults;
+    uint32_t threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    double supply_l_min = DEFAULT_SUPPLY_L_MIN;
+    bool scaling = false;
+    int option;
+
+    fleet.controller_count = DEFAULT_CONTROLLERS;
+    fleet.days = DEFAULT_DAYS;
+    fleet.duty = DEFAULT_DUTY;
+    fleet.seed = 1;
+    fleet.stealing = true;
+    build_defaults(&defaults);
+    fleet.config = &defaults;
+
+    while ((option = getopt(argc, argv, "n:d:t:s:u:c:r:pS")) != -1) {
+        switch (option) {
+            case 'n': fleet.controller_count = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'd': fleet.days = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': threads = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': supply_l_min = atof(optarg); break;
+            case 'u': fleet.duty = (float)atof(optarg); break;
+            case 'c': fleet.config = load_block(optarg); break;
+            case 'r': fleet.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'p': fleet.stealing = false; break;
+            case 'S': scaling = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n controllers] [-d days] [-t threads] [-s supply_l_min] "
+                                "[-u duty] [-c block.bin] [-r seed] [-p] [-S]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (fleet.controller_count < 10 || fleet.days == 0 || fleet.days > MAX_DAYS || threads == 0 ||
+        fleet.duty <= 0.0f || fleet.duty > 100.0f) {
+        fprintf(stderr, "fleet_sim: need at least 10 controllers, 1-%u days, a thread and a duty of 0-100 %%\n",
+                MAX_DAYS);
+        return 2;
+    }
+
+    MoistureCurve curve;
+    moisture_curve_two_point(&curve, DRY_RAW, WET_RAW);
+    moisture_curve_compile(&curve, &fleet.lut);
+    fleet.flow_ul_s = (uint32_t)(flow_rate_ml_per_sec(fleet.config, fleet.duty) * 1000.0f + 0.5f);
+    fleet.supply_ul_s = (uint32_t)(supply_l_min * 1e6 / 60.0 + 0.5);
+    for (uint32_t i = 0; i < STEPS_PER_DAY; i++) {
+        // Warmest at 15:00, coolest at 03:00; a day averages 1
+        double hour = i * (STEP_MS / 1000.0) / 3600.0;
+        fleet.drying[i] = 1.0 + 0.6 * cos(2.0 * M_PI * (hour - 15.0) / 24.0);
+    }
+    fleet.controllers = aligned_alloc(CACHE_LINE, fleet.controller_count * sizeof(Controller));
+
+    printf("%u controllers, %u days, config v%u, pump at %.0f %% duty (%.2f mL/s), supply ",
+           fleet.controller_count, fleet.days, fleet.config->version, fleet.duty,
+           fleet.flow_ul_s / 1000.0);
+    if (fleet.supply_ul_s) {
+        printf("%.2f L/min (%.1f pumps)\n", supply_l_min, (double)fleet.supply_ul_s / fleet.flow_ul_s);
+    } else {
+        printf("unlimited\n");
+    }
+
+    double bed_days = (double)fleet.controller_count * fleet.days;
+    if (!scaling) {
+        double seconds = fleet_run(&fleet, threads);
+        printf("%u threads%s: %.3f s, %.0f controller-days/s, digest %08x\n\n", threads,
+               fleet.stealing ? "" : " (static shards)", seconds, bed_days / seconds,
+               (unsigned)fleet_digest(&fleet));
+        print_results(&fleet);
+        printf("\n");
+        print_workers(&fleet);
+        fleet_release_workers(&fleet);
+        return 0;
+    }
+
+    printf("threads  seconds  controller-days/s  speedup  efficiency  stolen  digest\n");
+    double base = 0;
+    uint32_t first_digest = 0;
+    bool same = true;
+    for (uint32_t t = 1;; t = (t * 2U > threads) ? threads : t * 2U) {
+        double seconds = fleet_run(&fleet, t);
+        uint32_t digest = fleet_digest(&fleet);
+        uint64_t stolen = 0;
+        for (uint32_t i = 0; i < t; i++) {
+            stolen += fleet.workers[i].chunks_stolen;
+        }
+        if (t == 1) {
+            base = seconds;
+            first_digest = digest;
+        }
+        same = same && digest == first_digest;
+        printf("%7u %8.3f %18.0f %8.2f %10.0f%% %7llu  %08x\n", t, seconds, bed_days / seconds,
+               base / seconds, 100.0 * base / seconds / t, (unsigned long long)stolen, (unsigned)digest);
+        fleet_release_workers(&fleet);
+        if (t == threads) {
+            break;
+        }
+    }
+    printf("%s\n", same ? "digests match" : "DIGESTS DIFFER");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+#!/usr/bin/env python3
+"""Build or send a delta firmware update (Irrigation_System.X/fw_patch.h).
+
+    python tools/fw_delta.py make old.hex new.hex -o update.fwp
+    python tools/fw_delta.py make --full new.hex -o full.fwp
+    python tools/fw_delta.py send update.fwp /dev/ttyACM0 [--activate]
+    python tools/fw_delta.py bin new.hex -o new.bin
+
+The old image must be the one running on the board: the header carries
+its CRC and the board refuses a patch made against anything else. Images
+are Intel HEX or raw binaries. HEX data is taken from the slot A window
+(--origin, 0x2000 by default); use --origin 0 for images linked at 0.
+
+A patch file is the frames to send, each prefixed with its length as a
+little-endian u16. "send" sends the header and reads the board's answer,
+
+    FW <state> <next row> <rows> <result>
+
+then sends the record starting at that row and each following one,
+waiting for the answer to each. After a timeout, an error or a reset it
+sends the header again and carries on from the row the board gives, so it
+can be rerun after an interruption. With --activate the board then
+installs the image and restarts.
+
+tools/fw_update_sim.c runs patch files against the firmware code and a
+simulated flash, with power cuts.
+"""
+
+import argparse
+import binascii
+import os
+import select
+import struct
+import sys
+import time
+
+ROW_SIZE = 256
+SLOT_SIZE = 0xE000
+SLOT_A_ADDRESS = 0x2000
+HEADER_MAGIC = 0x50555746           # "FWUP"
+RECORD_MAGIC = 0x43525746           # "FWRC"
+ACTIVATE_MAGIC = 0x4F475746         # "FWGO"
+FORMAT = 1
+RECORD_OPS_MAX = 272
+OP_COPY = 0x80
+OP_FILL = 0x81
+LITERAL_MAX = 128
+MIN_COPY = 7                        # A COPY op is 6 bytes
+MIN_FILL = 5                        # A FILL op is 4 bytes
+KEY = 4                             # Bytes hashed to find COPY candidates
+CANDIDATES = 32                     # Most recent base positions kept per key
+FRAME_GAP_S = 0.010                 # Twice the console's idle time
+HEADER_TRIES = 10                   # Unanswered headers before giving up
+
+
+def crc32(data):
+    return binascii.crc32(data) & 0xFFFFFFFF
+
+
+def load_image(path, origin):
+    with open(path, "rb") as file:
+        data = file.read()
+    if not path.lower().endswith(".hex"):
+        return data
+    image = bytearray(b"\xff" * SLOT_SIZE)
+    size = 0
+    upper = 0
+    for line in data.decode("ascii").split():
+        record = bytes.fromhex(line.lstrip(":"))
+        count, address, kind = record[0], struct.unpack(">H", record[1:3])[0], record[3]
+        payload = record[4:4 + count]
+        if kind == 0:
+            start = upper + address - origin
+            if 0 <= start and start + count <= SLOT_SIZE:
+                image[start:start + count] = payload
+                size = max(size, start + count)
+        elif kind == 2:
+            upper = struct.unpack(">H", payload)[0] << 4
+        elif kind == 4:
+            upper = struct.unpack(">H", payload)[0] << 16
+        elif kind == 1:
+            break
+    return bytes(image[:size])
+
+
+class Matcher:
+    """Finds the longest run of base bytes equal to new bytes at a position."""
+
+    def __init__(self, base):
+        self.base = base
+        self.index = {}
+        for position in range(len(base) - KEY + 1):
+            self.index.setdefault(base[position:position + KEY], []).append(position)
+        for key, positions in self.index.items():
+            self.index[key] = positions[-CANDIDATES:]
+
+    def longest(self, new, position, end, hints):
+        base = self.base
+        best_offset, best_length = 0, 0
+        candidates = list(hints) + self.index.get(new[position:position + KEY], [])
+        for offset in candidates:
+            if offset < 0 or offset >= len(base):
+                continue
+            length = 0
+            limit = min(end - position, len(base) - offset, 0xFFFF)
+            while length < limit and base[offset + length] == new[position + length]:
+                length += 1
+            if length > best_length:
+                best_offset, best_length = offset, length
+        return best_offset, best_length
+
+
+def encode(new, start, end, matcher, full):
+    """Ops rebuilding new[start:end]."""
+    ops = bytearray()
+    literal = bytearray()
+    last_copy_end = start
+
+    def flush():
+        while literal:
+            chunk = literal[:LITERAL_MAX]
+            ops.append(len(chunk) - 1)
+            ops.extend(chunk)
+            del literal[:LITERAL_MAX]
+
+    position = start
+    while position < end:
+        if full:
+            literal.append(new[position])
+            position += 1
+            if len(literal) == LITERAL_MAX:
+                flush()
+            continue
+        run = 1
+        while position + run < end and run < 0xFFFF and new[position + run] == new[position]:
+            run += 1
+        offset, length = (matcher.longest(new, position, end, (position, last_copy_end))
+                          if matcher else (0, 0))
+        if run >= MIN_FILL and run >= length:
+            flush()
+            ops.extend(struct.pack("<BHB", OP_FILL, run, new[position]))
+            position += run
+        elif length >= MIN_COPY:
+            flush()
+            ops.extend(struct.pack("<BBHH", OP_COPY, offset & 0xFF, offset >> 8, length))
+            position += length
+            last_copy_end = offset + length
+        else:
+            literal.append(new[position])
+            position += 1
+            if len(literal) == LITERAL_MAX:
+                flush()
+    flush()
+    return bytes(ops)
+
+
+def header_frame(new, base, version):
+    data = struct.pack("<IHHIIIII", HEADER_MAGIC, FORMAT, ROW_SIZE, len(new), crc32(new),
+                       len(base), crc32(base) if base else 0, version)
+    return data + struct.pack("<I", crc32(data))
+
+
+def record_frame(session, first_row, row_count, ops):
+    data = struct.pack("<IHHHH", RECORD_MAGIC, session, first_row, row_count, len(ops)) + ops
+    return data + struct.pack("<I", crc32(data))
+
+
+def make_patch(base, new, version, full):
+    """Header frame and record frames; each record holds as many rows as fit."""
+    if len(new) == 0 or len(new) > SLOT_SIZE or len(base) > SLOT_SIZE:
+        raise ValueError("images must be 1 to %d bytes" % SLOT_SIZE)
+    matcher = Matcher(base) if base and not full else None
+    rows = (len(new) + ROW_SIZE - 1) // ROW_SIZE
+    session = crc32(new) & 0xFFFF
+    frames = [header_frame(new, base, version)]
+    row = 0
+    while row < rows:
+        count = 1
+        ops = encode(new, row * ROW_SIZE, min(len(new), (row + 1) * ROW_SIZE), matcher, full)
+        while row + count < rows:
+            longer = encode(new, row * ROW_SIZE, min(len(new), (row + count + 1) * ROW_SIZE),
+                            matcher, full)
+            if len(longer) > RECORD_OPS_MAX:
+                break
+            ops = longer
+            count += 1
+        if len(ops) > RECORD_OPS_MAX:
+            raise ValueError("row %d does not fit a record" % row)
+        frames.append(record_frame(session, row, count, ops))
+        row += count
+    return frames
+
+
+def write_frames(frames, path):
+    with open(path, "wb") as file:
+        for frame in frames:
+            file.write(struct.pack("<H", len(frame)) + frame)
+
+
+def read_frames(path):
+    with open(path, "rb") as file:
+        data = file.read()
+    frames = []
+    position = 0
+    while position < len(data):
+        length = struct.unpack_from("<H", data, position)[0]
+        frames.append(data[position + 2:position + 2 + length])
+        position += 2 + length
+    return frames
+
+
+def record_rows(frame):
+    first_row, row_count = struct.unpack_from("<HH", frame, 6)
+    return first_row, first_row + row_count
+
+
+def open_serial(device, baud):
+    import termios
+    import tty
+    fd = os.open(device, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attributes = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attributes[4] = attributes[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attributes)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def exchange(fd, frame, timeout):
+    """Sends one frame; returns the board's FW answer split into fields, or None."""
+    os.write(fd, frame)
+    time.sleep(FRAME_GAP_S)
+    line = b""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        ready, _, _ = select.select([fd], [], [], 0.05)
+        if ready:
+            line += os.read(fd, 256)
+            for text in line.split(b"\n"):
+                fields = text.decode("ascii", "replace").split()
+                if len(fields) >= 5 and fields[0] == "FW" and text.endswith(b"\r"):
+                    return fields[1], int(fields[2]), int(fields[3]), " ".join(fields[4:])
+    return None
+
+
+def send(frames, device, baud, activate, timeout):
+    fd = open_serial(device, baud)
+    header = frames[0]
+    records = frames[1:]
+    image_crc = struct.unpack_from("<I", header, 12)[0]
+    sent = 0
+    start = time.monotonic()
+    tries = 0
+    while True:
+        answer = exchange(fd, header, timeout)
+        sent += len(header)
+        if answer is None:
+            tries += 1
+            if tries == HEADER_TRIES:
+                raise SystemExit("no answer from the board")
+            continue
+        tries = 0
+        state, row, rows, result = answer
+        if result != "ok":
+            raise SystemExit("board refused the update: %s" % result)
+        while state == "RECEIVING":
+            record = next((r for r in records if record_rows(r)[0] <= row < record_rows(r)[1]),
+                          None)
+            if record is None:
+                raise SystemExit("no record for row %d" % row)
+            answer = exchange(fd, record, timeout)
+            sent += len(record)
+            if answer is None or answer[3] != "ok":
+                break                   # Resend the header to find out where it stands
+            state, row = answer[0], answer[1]
+            sys.stderr.write("\rrow %d/%d" % (row, rows))
+        if answer is not None and state in ("READY", "INSTALLED"):
+            break
+    sys.stderr.write("\n%s after %d bytes in %.1f s\n" % (state, sent, time.monotonic() - start))
+    if activate and state == "READY":
+        answer = exchange(fd, struct.pack("<II", ACTIVATE_MAGIC, image_crc), timeout)
+        sys.stderr.write("activate: %s\n" % (answer[3] if answer else "no answer"))
+    os.close(fd)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    make = commands.add_parser("make", help="build a patch file")
+    make.add_argument("images", nargs="+", help="old and new image, or the new one with --full")
+    make.add_argument("--full", action="store_true", help="whole image as literals, no base")
+    make.add_argument("--version", type=int, default=0, help="version number reported")
+    make.add_argument("--origin", type=lambda text: int(text, 0), default=SLOT_A_ADDRESS)
+    make.add_argument("-o", "--output", required=True)
+    to_bin = commands.add_parser("bin", help="extract the slot image of a HEX file")
+    to_bin.add_argument("image")
+    to_bin.add_argument("--origin", type=lambda text: int(text, 0), default=SLOT_A_ADDRESS)
+    to_bin.add_argument("-o", "--output", required=True)
+    send_cmd = commands.add_parser("send", help="send a patch file to the board")
+    send_cmd.add_argument("patch")
+    send_cmd.add_argument("device")
+    send_cmd.add_argument("--baud", type=int, default=115200)
+    send_cmd.add_argument("--timeout", type=float, default=2.0, help="seconds per answer")
+    send_cmd.add_argument("--activate", action="store_true", help="install once staged")
+    args = parser.parse_args()
+
+    if args.command == "bin":
+        with open(args.output, "wb") as file:
+            file.write(load_image(args.image, args.origin))
+    elif args.command == "make":
+        if len(args.images) != (1 if args.full else 2):
+            parser.error("make takes the old and new image, or only the new one with --full")
+        new = load_image(args.images[-1], args.origin)
+        base = b"" if args.full else load_image(args.images[0], args.origin)
+        frames = make_patch(base, new, args.version, args.full)
+        write_frames(frames, args.output)
+        rows = (len(new) + ROW_SIZE - 1) // ROW_SIZE
+        sys.stderr.write("%d-byte image, %d rows, %d records, %d bytes to send\n"
+                         % (len(new), rows, len(frames) - 1, sum(len(f) for f in frames)))
+    else:
+        send(read_frames(args.patch), args.device, args.baud, args.activate, args.timeout)
+
+
+if __name__ == "__main__":
+    main()
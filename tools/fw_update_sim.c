@@ -0,0 +1,308 @@
+/*
+ * End-to-end test of the delta firmware update (Irrigation_System.X/fw_patch.c)
+ * on the host NVM simulator (tools/nvm_sim.c), with power cuts.
+ *
+ *     cc -O2 -I Irrigation_System.X -I tools -o fw_update_sim tools/fw_update_sim.c \
+ *        tools/nvm_sim.c Irrigation_System.X/fw_patch.c Irrigation_System.X/crc32.c
+ *     python3 tools/fw_delta.py make old.hex new.hex -o update.fwp
+ *     python3 tools/fw_delta.py make --full new.hex -o full.fwp
+ *     ./fw_update_sim [-c cuts] [-s seed] [-b baud] [-n new.bin] old.bin update.fwp full.fwp
+ *
+ * For each patch file the simulated board starts with old.bin in slot A.
+ * The host side plays tools/fw_delta.py "send --activate": header, records
+ * in answer-driven order, activate. The board side runs the firmware's
+ * fw_updater_*() calls, and after each reset the bootloader's
+ * fw_install(). -c arms that many power cuts at random NVM commands, each
+ * leaving its command half done. After a cut the board boots again and
+ * the host resends the header once its answer timeout expires.
+ *
+ * The run must end with the new image installed in slot A, matching the
+ * header CRC and -n if given, and with the rows around the slots
+ * untouched. Time is estimated from the bytes on the wire at the baud
+ * rate, a 10 ms gap after each frame (twice the console's idle time), the
+ * datasheet maximum of every erase and page write, and a 2 s host
+ * timeout per cut while receiving. CPU time is not counted.
+ */
+
+#include <getopt.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fw_patch.h"
+#include "crc32.h"
+#include "nvm_sim.h"
+
+#define MAX_FRAMES        1024
+#define FRAME_GAP_MS      10.0
+#define ANSWER_BYTES      26U       // "FW RECEIVING 24 54 ok\r\n" and the like
+#define HOST_TIMEOUT_MS   2000.0
+#define MAX_BOOTS         1000
+
+typedef struct {
+    uint8_t *data;
+    uint16_t length;
+} Frame;
+
+typedef struct {
+    uint64_t sent;                  // Bytes to the board, resends included
+    uint32_t frames;
+    uint32_t headers;
+    uint64_t answered;
+    uint32_t cuts;
+    uint32_t receive_cuts;          // Cost the host a timeout
+    uint32_t boots;
+    uint32_t erases;
+    uint32_t writes;
+    double receive_flash_ms;
+    double install_flash_ms;
+} RunStats;
+
+static NvmSim nvm;
+static FwFlash flash;
+static FwUpdater updater;
+static Frame frames[MAX_FRAMES];
+static int frame_count;
+static RunStats run;
+static int cuts_left;
+static long command_span;           // Commands of a run without cuts
+static int installing;              // Set while the bootloader runs
+static double install_start_ms;
+
+static Frame *record_for_row(uint16_t row) {
+    for (int i = 1; i < frame_count; i++) {
+        FwRecordHeader header;
+        memcpy(&header, frames[i].data, sizeof(header));
+        if (header.first_row <= row && row < header.first_row + header.row_count) {
+            return &frames[i];
+        }
+    }
+    return NULL;
+}
+
+static FwResult send(const Frame *frame, FwResult (*handler)(FwUpdater *, const uint8_t *, uint16_t)) {
+    run.sent += frame->length;
+    run.frames++;
+    FwResult result = handler(&updater, frame->data, frame->length);
+    run.answered += ANSWER_BYTES;
+    return result;
+}
+
+static void arm_cut(void) {
+    if (cuts_left > 0 && command_span > 0) {
+        cuts_left--;
+        nvm.cut_after = rand() % command_span;
+    }
+}
+
+// Reset: bootloader, then the application's fw_update_init()
+static bool boot(void) {
+    FwProgress progress;
+
+    run.boots++;
+    fw_progress_load(&flash, &progress, NULL);
+    if (progress.state == FW_STATE_READY || progress.state == FW_STATE_INSTALLING) {
+        installing = 1;
+        install_start_ms = nvm.busy_ms;
+        fw_install(&flash);
+        installing = 0;
+        run.install_flash_ms += nvm.busy_ms - install_start_ms;
+        fw_progress_load(&flash, &progress, NULL);
+        if (progress.state == FW_STATE_INSTALLING) {
+            return false;           // Halted; the next power cycle retries
+        }
+        run.boots++;                // It resets again to start the application
+    }
+    fw_updater_init(&updater, &flash);
+    return true;
+}
+
+// fw_delta.py send --activate, until the board resets
+static void host_session(void) {
+    Frame *header = &frames[0];
+
+    run.headers++;
+    FwResult result = send(header, fw_updater_header);
+    while (result == FW_OK && updater.progress.state == FW_STATE_RECEIVING) {
+        Frame *record = record_for_row(updater.progress.next_row);
+        if (record == NULL) {
+            fprintf(stderr, "no record for row %u\n", updater.progress.next_row);
+            exit(1);
+        }
+        result = send(record, fw_updater_record);
+        if (result != FW_OK) {
+            run.headers++;
+            result = send(header, fw_updater_header);
+        }
+    }
+    if (result != FW_OK) {
+        fprintf(stderr, "board refused the update: %s\n", fw_result_name(result));
+        exit(1);
+    }
+    if (updater.progress.state == FW_STATE_READY) {
+        FwActivateCommand command = { FW_ACTIVATE_MAGIC, updater.progress.image_crc };
+        Frame frame = { (uint8_t *)&command, sizeof(command) };
+        if (send(&frame, fw_updater_activate) != FW_OK) {
+            fprintf(stderr, "activate refused\n");
+            exit(1);
+        }
+    }
+}
+
+static uint8_t *read_file(const char *path, long *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(*size > 0 ? (size_t)*size : 1U);
+    if (fread(data, 1, (size_t)*size, file) != (size_t)*size) {
+        perror(path);
+        exit(1);
+    }
+    fclose(file);
+    return data;
+}
+
+static void load_patch(const char *path) {
+    long size;
+    uint8_t *data = read_file(path, &size);
+    frame_count = 0;
+    for (long position = 0; position + 2 <= size && frame_count < MAX_FRAMES;) {
+        uint16_t length = (uint16_t)(data[position] | (data[position + 1] << 8));
+        frames[frame_count].data = &data[position + 2];
+        frames[frame_count].length = length;
+        frame_count++;
+        position += 2 + length;
+    }
+    if (frame_count < 2) {
+        fprintf(stderr, "%s: no records\n", path);
+        exit(1);
+    }
+}
+
+static const uint8_t *fill_pattern(void) {
+    static uint8_t pattern[FW_ROW_SIZE];
+    for (uint32_t i = 0; i < FW_ROW_SIZE; i++) {
+        pattern[i] = (uint8_t)(i * 7U + 3U);
+    }
+    return pattern;
+}
+
+// One complete update; false if the image did not end up installed
+static bool run_update(const uint8_t *base, long base_size, int cuts) {
+    static jmp_buf target;
+    FwPatchHeader header;
+
+    memcpy(&header, frames[0].data, sizeof(header));
+    nvm_sim_init(&nvm, FW_BOOTLOADER_SIZE);
+    nvm_sim_load(&nvm, FW_SLOT_A_ADDRESS, base, (uint32_t)base_size);
+    // Data rows beside the slots: calibration and schedule
+    nvm_sim_load(&nvm, 0x1000, fill_pattern(), FW_ROW_SIZE);
+    nvm_sim_load(&nvm, 0x1E000, fill_pattern(), FW_ROW_SIZE);
+    nvm.cut_target = &target;
+    flash = nvm_sim_flash(&nvm);
+    memset(&run, 0, sizeof(run));
+    cuts_left = cuts;
+    installing = 0;
+    arm_cut();
+
+    if (setjmp(target) != 0) {
+        run.cuts++;
+        if (installing) {
+            run.install_flash_ms += nvm.busy_ms - install_start_ms;
+        } else {
+            run.receive_cuts++;
+        }
+        installing = 0;
+        arm_cut();
+    }
+    while (run.boots < MAX_BOOTS) {
+        if (!boot()) {
+            continue;
+        }
+        if (updater.progress.state == FW_STATE_INSTALLED &&
+            updater.progress.image_crc == header.image_crc) {
+            break;
+        }
+        host_session();
+    }
+    run.erases = nvm.erases;
+    run.writes = nvm.writes;
+    run.receive_flash_ms = nvm.busy_ms - run.install_flash_ms;
+
+    return updater.progress.state == FW_STATE_INSTALLED &&
+           crc32_update(CRC32_INITIAL, &nvm.flash[FW_SLOT_A_ADDRESS], header.image_size) ==
+               header.image_crc &&
+           memcmp(&nvm.flash[0x1000], fill_pattern(), FW_ROW_SIZE) == 0 &&
+           memcmp(&nvm.flash[0x1E000], fill_pattern(), FW_ROW_SIZE) == 0;
+}
+
+int main(int argc, char **argv) {
+    int cuts = 0;
+    unsigned seed = 1;
+    double baud = 115200.0;
+    const char *new_path = NULL;
+    int option;
+
+    while ((option = getopt(argc, argv, "c:s:b:n:")) != -1) {
+        switch (option) {
+            case 'c': cuts = atoi(optarg); break;
+            case 's': seed = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'b': baud = atof(optarg); break;
+            case 'n': new_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-c cuts] [-s seed] [-b baud] [-n new.bin] "
+                                "old.bin patch.fwp...\n", argv[0]);
+                return 2;
+        }
+    }
+    if (argc - optind < 2) {
+        fprintf(stderr, "usage: %s [-c cuts] [-s seed] [-b baud] [-n new.bin] old.bin patch.fwp...\n",
+                argv[0]);
+        return 2;
+    }
+
+    long base_size;
+    uint8_t *base = read_file(argv[optind], &base_size);
+    long new_size = 0;
+    uint8_t *new_image = new_path ? read_file(new_path, &new_size) : NULL;
+    int failures = 0;
+
+    printf("%-16s %6s %5s %8s %7s %5s %7s %7s %9s %9s %9s %9s  %s\n", "patch", "image",
+           "recs", "sent", "frames", "cuts", "erases", "writes", "wire s", "flash s",
+           "install s", "total s", "result");
+    for (int i = optind + 1; i < argc; i++) {
+        FwPatchHeader header;
+        load_patch(argv[i]);
+        memcpy(&header, frames[0].data, sizeof(header));
+
+        // A run without cuts sizes the range the cuts are drawn from
+        srand(seed);
+        command_span = 0;
+        run_update(base, base_size, 0);
+        command_span = (long)(run.erases + run.writes);
+        srand(seed);
+        bool ok = run_update(base, base_size, cuts);
+        if (ok && new_image != NULL) {
+            ok = new_size == (long)header.image_size &&
+                 memcmp(&nvm.flash[FW_SLOT_A_ADDRESS], new_image, (size_t)new_size) == 0;
+        }
+        failures += !ok;
+
+        double wire_s = ((double)(run.sent + run.answered) * 10.0 / baud) +
+                        run.frames * FRAME_GAP_MS / 1000.0 +
+                        run.receive_cuts * HOST_TIMEOUT_MS / 1000.0;
+        double flash_s = run.receive_flash_ms / 1000.0;
+        double install_s = run.install_flash_ms / 1000.0;
+        const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+        printf("%-16s %6u %5d %8llu %7u %5u %7u %7u %9.2f %9.2f %9.2f %9.2f  %s\n", name,
+               header.image_size, frame_count - 1, (unsigned long long)run.sent, run.frames,
+               run.cuts, run.erases, run.writes, wire_s, flash_s, install_s,
+               wire_s + flash_s + install_s, ok ? "installed" : "FAILED");
+    }
+    return failures ? 1 : 0;
+}
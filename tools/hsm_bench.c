@@ -0,0 +1,346 @@
+/*
+ * Dispatch cost of the table-driven state machine engine
+ * (Irrigation_System.X/hsm.c) against the switch statements it replaced.
+ *
+ *     cc -O2 -I Irrigation_System.X -o hsm_bench tools/hsm_bench.c Irrigation_System.X/hsm.c
+ *     ./hsm_bench [steps]
+ *
+ * Two machines are built both ways, with the same actions:
+ *  - calibration: the shape of the calibration machine (an ACTIVE parent
+ *    around the four button states), driven by a random event stream;
+ *  - moisture: the polled measurement cycle, where each step runs the
+ *    current state's poll and its conditions come from a random stream.
+ * Both variants of a machine must end in the same state with the same
+ * action counts, which checks the tables against the switch. The engine
+ * runs with a trace hook that counts transitions; the switch counts them
+ * inline.
+ *
+ * For code size, compare the objects, e.g.
+ *     cc -Os -c -ffunction-sections tools/hsm_bench.c -I Irrigation_System.X && nm -S --size-sort hsm_bench.o
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hsm.h"
+
+#define DEFAULT_STEPS  10000000UL
+
+static uint32_t rng_state = 1;
+static uint32_t actions[8];
+static uint32_t traced;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void trace_count(uint8_t machine, HsmStateId from, HsmStateId to, HsmEventId event) {
+    (void)machine; (void)from; (void)to; (void)event;
+    traced++;
+}
+
+// --- Calibration shape ---
+
+enum { CAL_IDLE, CAL_DRY_WAIT, CAL_DRY_RECORD, CAL_WET_WAIT, CAL_WET_RECORD, CAL_COMPLETE,
+       CAL_ACTIVE, CAL_STATE_COUNT };
+enum { CAL_EVT_START, CAL_EVT_PRESS, CAL_EVT_RELEASE, CAL_EVT_RETRY, CAL_EVT_COUNT };
+
+static void active_entry(Hsm *fsm) { (void)fsm; actions[0]++; }
+static void active_exit(Hsm *fsm) { (void)fsm; actions[1]++; }
+static void wait_entry(Hsm *fsm) { (void)fsm; actions[2]++; }
+static void record_exit(Hsm *fsm) { (void)fsm; actions[3]++; }
+static void complete_entry(Hsm *fsm) { (void)fsm; actions[4]++; }
+
+static const HsmState cal_states[CAL_STATE_COUNT] = {
+    [CAL_IDLE]       = { HSM_NONE,   HSM_NONE,     NULL,           NULL,        NULL },
+    [CAL_DRY_WAIT]   = { CAL_ACTIVE, HSM_NONE,     wait_entry,     NULL,        NULL },
+    [CAL_DRY_RECORD] = { CAL_ACTIVE, HSM_NONE,     NULL,           record_exit, NULL },
+    [CAL_WET_WAIT]   = { CAL_ACTIVE, HSM_NONE,     wait_entry,     NULL,        NULL },
+    [CAL_WET_RECORD] = { CAL_ACTIVE, HSM_NONE,     NULL,           record_exit, NULL },
+    [CAL_COMPLETE]   = { HSM_NONE,   HSM_NONE,     complete_entry, NULL,        NULL },
+    [CAL_ACTIVE]     = { HSM_NONE,   CAL_DRY_WAIT, active_entry,   active_exit, NULL },
+};
+
+static const HsmStateId cal_transitions[CAL_STATE_COUNT][CAL_EVT_COUNT] = {
+    [CAL_IDLE]       = { [CAL_EVT_START] = HSM_TO(CAL_DRY_WAIT) },
+    [CAL_DRY_WAIT]   = { [CAL_EVT_PRESS] = HSM_TO(CAL_DRY_RECORD) },
+    [CAL_DRY_RECORD] = { [CAL_EVT_RELEASE] = HSM_TO(CAL_WET_WAIT) },
+    [CAL_WET_WAIT]   = { [CAL_EVT_PRESS] = HSM_TO(CAL_WET_RECORD) },
+    [CAL_WET_RECORD] = { [CAL_EVT_RELEASE] = HSM_TO(CAL_COMPLETE) },
+    [CAL_COMPLETE]   = { [CAL_EVT_RETRY] = HSM_TO(CAL_DRY_WAIT) },
+};
+
+static const HsmDefinition cal_machine = {
+    cal_states, &cal_transitions[0][0], CAL_STATE_COUNT, CAL_EVT_COUNT, 0, trace_count
+};
+
+static uint8_t cal_switch_state;
+
+static void cal_switch_dispatch(uint8_t event) {
+    switch (cal_switch_state) {
+        case CAL_IDLE:
+            if (event == CAL_EVT_START) {
+                active_entry(NULL);
+                wait_entry(NULL);
+                cal_switch_state = CAL_DRY_WAIT;
+                traced++;
+            }
+            break;
+        case CAL_DRY_WAIT:
+            if (event == CAL_EVT_PRESS) {
+                cal_switch_state = CAL_DRY_RECORD;
+                traced++;
+            }
+            break;
+        case CAL_DRY_RECORD:
+            if (event == CAL_EVT_RELEASE) {
+                record_exit(NULL);
+                wait_entry(NULL);
+                cal_switch_state = CAL_WET_WAIT;
+                traced++;
+            }
+            break;
+        case CAL_WET_WAIT:
+            if (event == CAL_EVT_PRESS) {
+                cal_switch_state = CAL_WET_RECORD;
+                traced++;
+            }
+            break;
+        case CAL_WET_RECORD:
+            if (event == CAL_EVT_RELEASE) {
+                record_exit(NULL);
+                active_exit(NULL);
+                complete_entry(NULL);
+                cal_switch_state = CAL_COMPLETE;
+                traced++;
+            }
+            break;
+        case CAL_COMPLETE:
+            if (event == CAL_EVT_RETRY) {
+                active_entry(NULL);
+                wait_entry(NULL);
+                cal_switch_state = CAL_DRY_WAIT;
+                traced++;
+            }
+            break;
+    }
+}
+
+// --- Moisture shape ---
+
+enum { MS_IDLE, MS_INIT, MS_WAIT_CONVERSION, MS_PROCESS, MS_CONVERT, MS_SEND, MS_WAIT_TIMER,
+       MS_MONITOR, MS_WAITING, MS_STATE_COUNT };
+enum { MS_EVT_DONE, MS_EVT_ARMED, MS_EVT_CROSSED, MS_EVT_TIMEOUT, MS_EVT_COUNT };
+
+static HsmEventId done_poll(Hsm *fsm) { (void)fsm; actions[5]++; return MS_EVT_DONE; }
+static HsmEventId conversion_poll(Hsm *fsm) { (void)fsm; return (rng_next() & 3U) == 0 ? MS_EVT_DONE : HSM_NONE; }
+static void convert_entry(Hsm *fsm) { (void)fsm; actions[6]++; }
+static HsmEventId send_poll(Hsm *fsm) { (void)fsm; return (rng_next() & 1U) ? MS_EVT_ARMED : MS_EVT_DONE; }
+static void waiting_entry(Hsm *fsm) { (void)fsm; actions[7]++; }
+static HsmEventId timer_poll(Hsm *fsm) { (void)fsm; return (rng_next() & 15U) == 0 ? MS_EVT_TIMEOUT : HSM_NONE; }
+static HsmEventId monitor_poll(Hsm *fsm) {
+    (void)fsm;
+    uint32_t roll = rng_next() & 31U;
+    return roll == 0 ? MS_EVT_CROSSED : roll == 1 ? MS_EVT_TIMEOUT : HSM_NONE;
+}
+static void monitor_exit(Hsm *fsm) { (void)fsm; actions[1]++; }
+
+static const HsmState ms_states[MS_STATE_COUNT] = {
+    [MS_IDLE]            = { HSM_NONE,   HSM_NONE,      NULL,          NULL,         done_poll },
+    [MS_INIT]            = { HSM_NONE,   HSM_NONE,      NULL,          NULL,         done_poll },
+    [MS_WAIT_CONVERSION] = { HSM_NONE,   HSM_NONE,      NULL,          NULL,         conversion_poll },
+    [MS_PROCESS]         = { HSM_NONE,   HSM_NONE,      NULL,          NULL,         done_poll },
+    [MS_CONVERT]         = { HSM_NONE,   HSM_NONE,      convert_entry, NULL,         done_poll },
+    [MS_SEND]            = { HSM_NONE,   HSM_NONE,      NULL,          NULL,         send_poll },
+    [MS_WAIT_TIMER]      = { MS_WAITING, HSM_NONE,      NULL,          NULL,         timer_poll },
+    [MS_MONITOR]         = { MS_WAITING, HSM_NONE,      NULL,          monitor_exit, monitor_poll },
+    [MS_WAITING]         = { HSM_NONE,   MS_WAIT_TIMER, waiting_entry, NULL,         NULL },
+};
+
+static const HsmStateId ms_transitions[MS_STATE_COUNT][MS_EVT_COUNT] = {
+    [MS_IDLE]            = { [MS_EVT_DONE] = HSM_TO(MS_INIT) },
+    [MS_INIT]            = { [MS_EVT_DONE] = HSM_TO(MS_WAIT_CONVERSION) },
+    [MS_WAIT_CONVERSION] = { [MS_EVT_DONE] = HSM_TO(MS_PROCESS) },
+    [MS_PROCESS]         = { [MS_EVT_DONE] = HSM_TO(MS_CONVERT) },
+    [MS_CONVERT]         = { [MS_EVT_DONE] = HSM_TO(MS_SEND) },
+    [MS_SEND]            = { [MS_EVT_DONE] = HSM_TO(MS_WAIT_TIMER), [MS_EVT_ARMED] = HSM_TO(MS_MONITOR) },
+    [MS_MONITOR]         = { [MS_EVT_CROSSED] = HSM_TO(MS_CONVERT) },
+    [MS_WAITING]         = { [MS_EVT_TIMEOUT] = HSM_TO(MS_IDLE) },
+};
+
+static const HsmDefinition ms_machine = {
+    ms_states, &ms_transitions[0][0], MS_STATE_COUNT, MS_EVT_COUNT, 1, trace_count
+};
+
+static uint8_t ms_switch_state;
+
+// One pass, as moisture_sensor_state_machine_run() did before the engine
+static void ms_switch_run(void) {
+    switch (ms_switch_state) {
+        case MS_IDLE:
+        case MS_INIT:
+            done_poll(NULL);
+            ms_switch_state++;
+            traced++;
+            break;
+        case MS_PROCESS:
+            done_poll(NULL);
+            convert_entry(NULL);
+            ms_switch_state = MS_CONVERT;
+            traced++;
+            break;
+        case MS_WAIT_CONVERSION:
+            if (conversion_poll(NULL) == MS_EVT_DONE) {
+                ms_switch_state = MS_PROCESS;
+                traced++;
+            }
+            break;
+        case MS_CONVERT:
+            done_poll(NULL);
+            ms_switch_state = MS_SEND;
+            traced++;
+            break;
+        case MS_SEND:
+            ms_switch_state = (send_poll(NULL) == MS_EVT_ARMED) ? MS_MONITOR : MS_WAIT_TIMER;
+            waiting_entry(NULL);
+            traced++;
+            break;
+        case MS_WAIT_TIMER:
+            if (timer_poll(NULL) == MS_EVT_TIMEOUT) {
+                ms_switch_state = MS_IDLE;
+                traced++;
+            }
+            break;
+        case MS_MONITOR:
+            switch (monitor_poll(NULL)) {
+                case MS_EVT_CROSSED:
+                    monitor_exit(NULL);
+                    convert_entry(NULL);
+                    ms_switch_state = MS_CONVERT;
+                    traced++;
+                    break;
+                case MS_EVT_TIMEOUT:
+                    monitor_exit(NULL);
+                    ms_switch_state = MS_IDLE;
+                    traced++;
+                    break;
+            }
+            break;
+    }
+}
+
+// --- Runs ---
+
+typedef struct {
+    double ns_per_step;
+    uint8_t state;
+    uint32_t actions[8];
+    uint32_t transitions;
+} Run;
+
+static void finish(Run *run, double start, unsigned long steps, uint8_t state) {
+    run->ns_per_step = (now_ns() - start) / steps;
+    run->state = state;
+    for (int i = 0; i < 8; i++) {
+        run->actions[i] = actions[i];
+    }
+    run->transitions = traced;
+}
+
+static void reset(void) {
+    rng_state = 1;
+    traced = 0;
+    for (int i = 0; i < 8; i++) {
+        actions[i] = 0;
+    }
+}
+
+static void run_calibration(unsigned long steps, Run *table, Run *by_switch) {
+    static uint8_t events[1U << 16];
+    Hsm fsm;
+
+    reset();
+    for (uint32_t i = 0; i < sizeof(events); i++) {
+        events[i] = (uint8_t)(rng_next() % CAL_EVT_COUNT);
+    }
+
+    reset();
+    hsm_init(&fsm, &cal_machine, NULL);
+    hsm_transition(&fsm, CAL_IDLE);
+    traced = 0;
+    double start = now_ns();
+    for (unsigned long i = 0; i < steps; i++) {
+        hsm_dispatch(&fsm, events[i & (sizeof(events) - 1U)]);
+    }
+    finish(table, start, steps, hsm_state(&fsm));
+
+    reset();
+    cal_switch_state = CAL_IDLE;
+    start = now_ns();
+    for (unsigned long i = 0; i < steps; i++) {
+        cal_switch_dispatch(events[i & (sizeof(events) - 1U)]);
+    }
+    finish(by_switch, start, steps, cal_switch_state);
+}
+
+static void run_moisture(unsigned long steps, Run *table, Run *by_switch) {
+    Hsm fsm;
+
+    reset();
+    hsm_init(&fsm, &ms_machine, NULL);
+    hsm_transition(&fsm, MS_IDLE);
+    traced = 0;
+    double start = now_ns();
+    for (unsigned long i = 0; i < steps; i++) {
+        hsm_run(&fsm);
+    }
+    finish(table, start, steps, hsm_state(&fsm));
+
+    reset();
+    ms_switch_state = MS_IDLE;
+    start = now_ns();
+    for (unsigned long i = 0; i < steps; i++) {
+        ms_switch_run();
+    }
+    finish(by_switch, start, steps, ms_switch_state);
+}
+
+static int report(const char *name, const Run *table, const Run *by_switch) {
+    int match = table->state == by_switch->state && table->transitions == by_switch->transitions;
+    for (int i = 0; i < 8; i++) {
+        match = match && table->actions[i] == by_switch->actions[i];
+    }
+    printf("%-12s table %6.2f ns/step  switch %6.2f ns/step  (%.2fx)  %u transitions  %s\n",
+           name, table->ns_per_step, by_switch->ns_per_step,
+           table->ns_per_step / by_switch->ns_per_step, (unsigned)table->transitions,
+           match ? "match" : "MISMATCH");
+    return match;
+}
+
+int main(int argc, char **argv) {
+    unsigned long steps = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEFAULT_STEPS;
+    Run table, by_switch;
+    int ok = 1;
+
+    if (steps == 0) {
+        fprintf(stderr, "usage: %s [steps]\n", argv[0]);
+        return 2;
+    }
+    run_calibration(steps, &table, &by_switch);
+    ok &= report("calibration", &table, &by_switch);
+    run_moisture(steps, &table, &by_switch);
+    ok &= report("moisture", &table, &by_switch);
+    printf("tables: calibration %zu + %zu bytes, moisture %zu + %zu bytes\n",
+           sizeof(cal_states), sizeof(cal_transitions), sizeof(ms_states), sizeof(ms_transitions));
+    return ok ? 0 : 1;
+}
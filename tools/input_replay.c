@@ -0,0 +1,629 @@
+/*
+ * Replays a recorded input stream (Irrigation_System.X/input_record.h)
+ * through the firmware's own processing code, as fast as the host runs.
+ *
+ *     cc -O2 -DTRACE_ENABLED=0 -I Irrigation_System.X -o input_replay tools/input_replay.c \
+ *        Irrigation_System.X/input_log.c Irrigation_System.X/moisture_curve.c \
+ *        Irrigation_System.X/adaptive_sampling.c Irrigation_System.X/rx_framer.c \
+ *        Irrigation_System.X/crc32.c Irrigation_System.X/calibration_machine.c \
+ *        Irrigation_System.X/hsm.c
+ *
+ *     ./input_replay capture.txt > replay.txt     # saved "INPUT BEGIN" dump
+ *     ./input_replay -q stream.bin                 # speed and output CRC only
+ *     ./input_replay -c 3200,1300 stream.bin       # flash already calibrated
+ *     ./input_replay --generate day.bin [days] [seed]
+ *
+ * The input is the UART dump of input_record_dump() (one or more, lines
+ * around them are ignored) or a raw stream file. Time comes only from the
+ * record timestamps, never from the host clock, so a replay prints the
+ * same bytes on every run and every machine. Diff the output against a
+ * saved replay as a regression check; the CRC-32 on stderr is a quick
+ * form of the same.
+ *
+ * The replay feeds the firmware modules that turn these inputs into
+ * decisions:
+ *  - scan and window ADC results go through the two-point calibration
+ *    table (moisture_curve.c) and the zone's adaptive sampler, with the
+ *    first plant's thresholds. The tool prints the percent and the next
+ *    interval, and flags jumps of SPIKE_PERCENT or more as SPIKE;
+ *  - console bytes are cut into frames by rx_framer.c, with the ring size
+ *    and idle timeout of console_rx.h;
+ *  - calibration readings and SW0 edges drive the firmware's calibration
+ *    state machine (calibration_machine.c). Its ADC returns the last
+ *    recorded calibration reading and its button the last recorded SW0
+ *    level. The machine runs at every event and when a pending button edge
+ *    clears the debounce time, which is every pass of the main loop at
+ *    which one of its inputs can have changed. State changes, prompts and
+ *    recorded values are printed, so a calibration that stays in
+ *    CALIBRATION_DRY_WAIT shows why. A stubbed flash keeps the accepted
+ *    values, and the scan percent uses them from then on. Without -c the
+ *    flash starts empty and the machine starts calibrating at the first
+ *    event;
+ *  - RESET restarts the framer and the samplers, as a reboot does, and
+ *    restarts the calibration from the stubbed flash.
+ *
+ * --generate writes a synthetic stream instead: 4 zones scanned every
+ * minute as the soil dries and is watered, one glitched reading a day,
+ * console keys and a 224-byte config upload, and a dry/wet calibration
+ * with button presses once a day.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "input_log.h"
+#include "moisture_curve.h"
+#include "adaptive_sampling.h"
+#include "rx_framer.h"
+#include "crc32.h"
+#include "calibration_machine.h"
+
+#define ZONES               8U       // Sources INPUT_ADC_ZONE(0..7)
+#define DRY_RAW             3200U    // Table used until a calibration completes
+#define WET_RAW             1300U
+#define THRESHOLD_LOW       40       // peppermint in PLANT_THRESHOLDS
+#define THRESHOLD_HIGH      80
+#define SPIKE_PERCENT       10
+#define RING_SIZE           1024U    // CONSOLE_RX_RING_SIZE
+#define FRAME_MAX           288U     // CONSOLE_RX_FRAME_MAX
+#define IDLE_MS             5U       // CONSOLE_RX_IDLE_MS
+#define FRAME_SHOWN         16U      // Frame bytes printed in hex
+#define MAX_DAYS            45U      // The recorder's millisecond clock wraps at 49 days
+
+// --- Output: printed unless quiet, always counted into the CRC ---
+
+static FILE *output;
+static uint32_t output_crc = CRC32_INITIAL;
+static uint64_t output_bytes;
+
+static void emit(const char *format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length >= sizeof(line)) {
+        length = sizeof(line) - 1;
+    }
+    output_crc = crc32_update(output_crc, line, (size_t)length);
+    output_bytes += (uint64_t)length;
+    if (output) {
+        fwrite(line, 1, (size_t)length, output);
+    }
+}
+
+static void emit_time(uint32_t ms) {
+    emit("%9u.%03u ", ms / 1000U, ms % 1000U);
+}
+
+// --- Replay ---
+
+typedef struct {
+    MoistureLut lut;
+    AdaptiveSampler samplers[ZONES];
+    int last_percent[ZONES + 2U];        // Zones, then calibration and window
+    RxFramer framer;
+    uint8_t ring[RING_SIZE];
+    uint8_t scratch[FRAME_MAX];
+    uint32_t written;
+    uint32_t uart_last_ms;
+    bool uart_pending;                   // Bytes the idle timeout has not ended yet
+    uint32_t frame_ms;                   // Time frames are delivered at
+    uint32_t sw0_down_ms;
+    // Calibration state machine and its stubbed inputs and flash
+    CalibrationMachine calibration;
+    CalibrationContext calibration_values;
+    CalibrationState calibration_shown;  // Last state printed
+    uint32_t calibration_ms;             // Time of the current run
+    uint16_t calibration_raw;            // Last recorded calibration reading
+    bool sw0_pressed;
+    bool flash_valid;
+    uint16_t flash_dry;
+    uint16_t flash_wet;
+    uint32_t events;
+    uint32_t frames;
+    uint32_t spikes;
+} Replay;
+
+static void print_frame(const uint8_t *frame, uint16_t length, void *context) {
+    Replay *replay = context;
+    replay->frames++;
+    emit_time(replay->frame_ms);
+    emit("frame   %3u bytes ", length);
+    for (uint16_t i = 0; i < length && i < FRAME_SHOWN; i++) {
+        emit(" %02x", frame[i]);
+    }
+    emit(length > FRAME_SHOWN ? " ...\n" : "\n");
+}
+
+// --- Calibration state machine ---
+
+static const char *const CALIBRATION_STATE_NAMES[] = {
+    "IDLE", "DRY_WAIT", "DRY_RECORD", "WET_WAIT", "WET_RECORD", "COMPLETE"
+};
+
+// The hardware callbacks carry no context; one replay runs at a time
+static Replay *calibration_replay;
+
+static void use_calibration(Replay *replay, uint16_t dry, uint16_t wet) {
+    MoistureCurve curve;
+    moisture_curve_two_point(&curve, dry, wet);
+    moisture_curve_compile(&curve, &replay->lut);
+}
+
+// The ADC is always free and converts at once
+static bool stub_convert_start(void) {
+    return true;
+}
+
+static bool stub_convert_done(uint16_t *raw) {
+    *raw = calibration_replay->calibration_raw;
+    return true;
+}
+
+static bool stub_button_pressed(void) {
+    return calibration_replay->sw0_pressed;
+}
+
+static void stub_hold_power(bool on) {
+    (void)on;
+}
+
+static void stub_report(CalibrationState state, uint16_t value) {
+    Replay *replay = calibration_replay;
+    emit_time(replay->calibration_ms);
+    switch (state) {
+        case CALIBRATION_DRY_WAIT:
+            emit("cal     waiting for SW0, sensor DRY\n");
+            break;
+        case CALIBRATION_WET_WAIT:
+            emit("cal     waiting for SW0, sensor WET\n");
+            break;
+        case CALIBRATION_DRY_RECORD:
+            emit("cal     dry recorded %u\n", value);
+            break;
+        case CALIBRATION_WET_RECORD:
+            emit("cal     wet recorded %u\n", value);
+            break;
+        case CALIBRATION_COMPLETE:
+            if (!value) {
+                emit("cal     failed, dry and wet identical\n");
+                break;
+            }
+            // Saved to the stubbed flash; the scans use it from here on
+            replay->flash_valid = true;
+            replay->flash_dry = replay->calibration_values.dry_calibration_value;
+            replay->flash_wet = replay->calibration_values.wet_calibration_value;
+            use_calibration(replay, replay->flash_dry, replay->flash_wet);
+            emit("cal     complete, dry %u wet %u\n", replay->flash_dry, replay->flash_wet);
+            break;
+        default:
+            emit("cal     state %u value %u\n", state, value);
+            break;
+    }
+}
+
+static const CalibrationHardware stub_hardware = {
+    stub_convert_start,
+    stub_convert_done,
+    stub_button_pressed,
+    stub_hold_power,
+    stub_report,
+};
+
+static void calibration_show_state(Replay *replay) {
+    CalibrationState state = calibration_machine_state(&replay->calibration);
+    if (state != replay->calibration_shown) {
+        replay->calibration_shown = state;
+        emit_time(replay->calibration_ms);
+        emit("cal     state %s\n", CALIBRATION_STATE_NAMES[state]);
+    }
+}
+
+// As calibration_load() after a reboot: a saved calibration is in use,
+// otherwise the machine starts over
+static void calibration_restart(Replay *replay, uint32_t now_ms) {
+    calibration_replay = replay;
+    replay->calibration_ms = now_ms;
+    replay->calibration_values.dry_calibration_value = replay->flash_dry;
+    replay->calibration_values.wet_calibration_value = replay->flash_wet;
+    replay->calibration_shown = CALIBRATION_IDLE;
+    calibration_machine_init(&replay->calibration, &stub_hardware, &replay->calibration_values,
+                             replay->flash_valid, now_ms);
+    calibration_show_state(replay);
+}
+
+// The main loop's passes at @p now_ms: enough runs for a conversion, a
+// button edge and a posted retry
+static void calibration_run(Replay *replay, uint32_t now_ms) {
+    replay->calibration_ms = now_ms;
+    for (int pass = 0; pass < 4; pass++) {
+        calibration_machine_run(&replay->calibration, now_ms);
+        calibration_show_state(replay);
+    }
+}
+
+// A button edge held back by the debounce is taken once it clears
+static void calibration_catch_up(Replay *replay, uint32_t now_ms) {
+    CalibrationMachine *machine = &replay->calibration;
+    uint32_t due_ms = machine->button_edge_ms + CALIBRATION_DEBOUNCE_MS;
+    if (!machine->complete && replay->sw0_pressed != machine->button_level &&
+        (int32_t)(now_ms - due_ms) > 0) {
+        calibration_run(replay, due_ms);
+    }
+}
+
+static void replay_restart(Replay *replay, uint32_t now_ms) {
+    for (uint32_t zone = 0; zone < ZONES; zone++) {
+        adaptive_sampling_init(&replay->samplers[zone], NULL);
+    }
+    for (uint32_t i = 0; i < ZONES + 2U; i++) {
+        replay->last_percent[i] = -1;
+    }
+    rx_framer_init(&replay->framer, replay->ring, RING_SIZE, replay->scratch, FRAME_MAX,
+                   RX_FRAMER_NO_DELIMITER, IDLE_MS, now_ms);
+    replay->written = 0;
+    replay->uart_pending = false;
+    calibration_restart(replay, now_ms);
+}
+
+static void replay_init(Replay *replay, bool flash_valid, uint16_t dry, uint16_t wet) {
+    memset(replay, 0, sizeof(*replay));
+    replay->flash_valid = flash_valid;
+    replay->flash_dry = dry;
+    replay->flash_wet = wet;
+    use_calibration(replay, dry, wet);
+    replay_restart(replay, 0);
+}
+
+// The main loop would have seen the line go idle before this event
+static void replay_idle(Replay *replay, uint32_t now_ms) {
+    if (replay->uart_pending && now_ms - replay->uart_last_ms >= IDLE_MS) {
+        replay->frame_ms = replay->uart_last_ms + IDLE_MS;
+        rx_framer_poll(&replay->framer, replay->written, replay->frame_ms, print_frame, replay);
+        replay->uart_pending = false;
+    }
+}
+
+static void replay_adc(Replay *replay, const InputEvent *event) {
+    int percent = moisture_lut_convert(&replay->lut, event->value);
+    int *last = &replay->last_percent[(event->source < ZONES) ? event->source
+                                      : ZONES + (event->source == INPUT_ADC_WINDOW)];
+    bool spike = *last >= 0 && abs(percent - *last) >= SPIKE_PERCENT;
+    *last = percent;
+    replay->spikes += spike;
+
+    emit_time(event->time_ms);
+    if (event->source < ZONES) {
+        uint32_t next = adaptive_sampling_update(&replay->samplers[event->source], event->time_ms,
+                                                 (uint8_t)percent, THRESHOLD_LOW, THRESHOLD_HIGH);
+        emit("scan    zone %u raw %4u %3d %%  next %u s%s\n", event->source, event->value,
+             percent, next / 1000U, spike ? "  SPIKE" : "");
+    } else if (event->source == INPUT_ADC_CALIBRATION) {
+        replay->calibration_raw = event->value;
+        emit("cal     raw %4u\n", event->value);
+    } else if (event->source == INPUT_ADC_WINDOW) {
+        emit("window  raw %4u %3d %%%s\n", event->value, percent, spike ? "  SPIKE" : "");
+    } else {
+        emit("adc     source %u raw %4u\n", event->source, event->value);
+    }
+}
+
+static void replay_event(Replay *replay, const InputEvent *event) {
+    replay_idle(replay, event->time_ms);
+    if (event->type != INPUT_EVT_RESET) {
+        calibration_catch_up(replay, event->time_ms);
+    }
+    replay->events++;
+
+    switch (event->type) {
+        case INPUT_EVT_SYNC:
+            break;
+        case INPUT_EVT_RESET:
+            emit_time(event->time_ms);
+            emit("reset\n");
+            replay_restart(replay, event->time_ms);
+            break;
+        case INPUT_EVT_ADC:
+            replay_adc(replay, event);
+            break;
+        case INPUT_EVT_SW0_DOWN:
+            replay->sw0_down_ms = event->time_ms;
+            replay->sw0_pressed = true;
+            emit_time(event->time_ms);
+            emit("sw0     down\n");
+            break;
+        case INPUT_EVT_SW0_UP:
+            replay->sw0_pressed = false;
+            emit_time(event->time_ms);
+            emit("sw0     up, held %u ms\n", event->time_ms - replay->sw0_down_ms);
+            break;
+        case INPUT_EVT_UART:
+            for (uint8_t i = 0; i < event->length; i++) {
+                replay->ring[(replay->written + i) & (RING_SIZE - 1U)] = event->bytes[i];
+            }
+            replay->written += event->length;
+            replay->uart_last_ms = event->time_ms;
+            replay->uart_pending = true;
+            replay->frame_ms = event->time_ms;
+            rx_framer_poll(&replay->framer, replay->written, event->time_ms, print_frame, replay);
+            break;
+        default:
+            break;
+    }
+    if (event->type != INPUT_EVT_SYNC) {
+        calibration_run(replay, event->time_ms);
+    }
+}
+
+// --- Input files ---
+
+static int hex_value(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Keeps the hex lines between "INPUT BEGIN" and "INPUT END", in place
+static size_t parse_dump(uint8_t *data, size_t size) {
+    size_t out = 0;
+    bool inside = false;
+    char *text = (char *)data;
+    text[size] = '\0';
+
+    for (char *line = strtok(text, "\r\n"); line; line = strtok(NULL, "\r\n")) {
+        if (strncmp(line, "INPUT BEGIN", 11) == 0) {
+            inside = true;
+        } else if (strncmp(line, "INPUT END", 9) == 0) {
+            inside = false;
+        } else if (inside) {
+            for (char *c = line; hex_value(c[0]) >= 0 && hex_value(c[1]) >= 0; c += 2) {
+                data[out++] = (uint8_t)(hex_value(c[0]) << 4 | hex_value(c[1]));
+            }
+        }
+    }
+    return out;
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc((size_t)length + 1U);
+    if (!data || fread(data, 1, (size_t)length, file) != (size_t)length) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(file);
+        free(data);
+        return NULL;
+    }
+    fclose(file);
+    *size = (size_t)length;
+    // A text dump rather than a raw stream
+    data[*size] = '\0';
+    if (strstr((const char *)data, "INPUT BEGIN") != NULL) {
+        *size = parse_dump(data, *size);
+    }
+    return data;
+}
+
+// --- Generator ---
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint16_t noisy_raw(double percent) {
+    double raw = DRY_RAW + ((double)WET_RAW - DRY_RAW) * percent / 100.0;
+    raw += (double)(rng() % 39U) - 19.0;
+    return (uint16_t)(raw < 0.0 ? 0.0 : raw > 4095.0 ? 4095.0 : raw);
+}
+
+static bool put(InputLogWriter *writer, uint32_t time_ms, uint8_t type, uint8_t source,
+                uint16_t value, uint8_t length, const uint8_t *bytes) {
+    InputEvent event = { time_ms, type, source, value, length, bytes };
+    if (!input_log_put(writer, &event)) {
+        fprintf(stderr, "generate: stream buffer full\n");
+        return false;
+    }
+    return true;
+}
+
+static int generate(const char *path, uint32_t days, uint32_t seed) {
+    const uint32_t scan_ms = 60000U;
+    const uint32_t day_ms = 86400000U;
+    uint32_t size = days * 262144U;
+    uint8_t *data = malloc(size);
+    InputLogWriter writer;
+    double percent[4];
+    uint32_t water_at[4];
+    uint8_t upload[224];
+    bool ok = true;
+
+    rng_state = seed ? seed : 1;
+    input_log_writer_init(&writer, data, size);
+    for (uint32_t zone = 0; zone < 4U; zone++) {
+        percent[zone] = 55.0 + 5.0 * zone;
+        water_at[zone] = UINT32_MAX;
+    }
+
+    for (uint32_t day = 0; day < days && ok; day++) {
+        uint32_t glitch_scan = rng() % (day_ms / scan_ms);
+        for (uint32_t t = day * day_ms + 1000U; t < (day + 1U) * day_ms && ok; t += 1000U) {
+            uint32_t of_day = t % day_ms;
+
+            if (t % scan_ms == 1000U) {
+                // Dries towards 15 % over about two days; watered 5 minutes
+                // after crossing the low threshold
+                for (uint32_t zone = 0; zone < 4U && ok; zone++) {
+                    percent[zone] -= (percent[zone] - 15.0) * scan_ms / (2.0 * day_ms) * (1.0 + 0.2 * zone);
+                    if (percent[zone] < THRESHOLD_LOW && water_at[zone] == UINT32_MAX) {
+                        water_at[zone] = t + 300000U;
+                    }
+                    if (t >= water_at[zone]) {
+                        percent[zone] = 75.0;
+                        water_at[zone] = UINT32_MAX;
+                    }
+                    uint16_t raw = noisy_raw(percent[zone]);
+                    if (zone == 0 && (of_day - 1000U) / scan_ms == glitch_scan) {
+                        raw = (uint16_t)(rng() % 4096U);
+                    }
+                    ok = put(&writer, t + zone * 12U, INPUT_EVT_ADC, INPUT_ADC_ZONE(zone), raw, 0, NULL);
+                }
+            }
+            if (of_day % 10800000U == 7200000U) {
+                // Console key: status request
+                static const uint8_t key = 's';
+                ok = ok && put(&writer, t + 500U, INPUT_EVT_UART, 0, 0, 1, &key);
+            }
+            if (of_day == 9U * 3600000U) {
+                // Config upload, arriving in DMA-sized pieces
+                for (uint32_t i = 0; i < sizeof(upload); i++) {
+                    upload[i] = (uint8_t)rng();
+                }
+                ok = ok && put(&writer, t + 100U, INPUT_EVT_UART, 0, 0, 128, upload) &&
+                     put(&writer, t + 101U, INPUT_EVT_UART, 0, 0, 96, upload + 128);
+            }
+            if (of_day >= 12U * 3600000U && of_day < 12U * 3600000U + 180000U) {
+                // Calibration: dry reading, press, wet reading, press
+                uint32_t into = of_day - 12U * 3600000U;
+                ok = ok && put(&writer, t, INPUT_EVT_ADC, INPUT_ADC_CALIBRATION,
+                               noisy_raw(into < 90000U ? 2.0 : 97.0), 0, NULL);
+                if (into == 60000U || into == 150000U) {
+                    uint32_t held = 80U + rng() % 250U;
+                    ok = ok && put(&writer, t + 200U, INPUT_EVT_SW0_DOWN, 0, 0, 0, NULL) &&
+                         put(&writer, t + 200U + held, INPUT_EVT_SW0_UP, 0, 0, 0, NULL);
+                }
+            }
+        }
+    }
+
+    FILE *file = ok ? fopen(path, "wb") : NULL;
+    if (file) {
+        ok = fwrite(data, 1, writer.used, file) == writer.used;
+        fclose(file);
+    } else if (ok) {
+        perror(path);
+        ok = false;
+    }
+    if (ok) {
+        fprintf(stderr, "%u days of input, %u bytes (%.1f KB per day)\n",
+                days, writer.used, writer.used / 1024.0 / days);
+    }
+    free(data);
+    return ok ? 0 : 1;
+}
+
+// --- Main ---
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    const char *output_path = NULL;
+    bool quiet = false;
+    bool calibrated = false;
+    unsigned dry = DRY_RAW, wet = WET_RAW;
+
+    if (argc >= 3 && strcmp(argv[1], "--generate") == 0) {
+        uint32_t days = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 1U;
+        uint32_t seed = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 0) : 1U;
+        if (days == 0 || days > MAX_DAYS) {
+            fprintf(stderr, "days must be 1..%u\n", MAX_DAYS);
+            return 1;
+        }
+        return generate(argv[2], days, seed);
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u,%u", &dry, &wet) != 2 || dry > 4095U || wet > 4095U ||
+                dry == wet) {
+                fprintf(stderr, "-c needs dry,wet: two different 12-bit readings\n");
+                return 1;
+            }
+            calibrated = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [-q] [-o output] [-c dry,wet] stream.bin|dump.txt\n"
+                        "       %s --generate stream.bin [days] [seed]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    size_t size;
+    uint8_t *data = read_file(path, &size);
+    if (!data) {
+        return 1;
+    }
+    output = quiet ? NULL : stdout;
+    if (output_path && !quiet) {
+        output = fopen(output_path, "w");
+        if (!output) {
+            perror(output_path);
+            return 1;
+        }
+    }
+
+    static Replay replay;
+    InputLogReader reader;
+    InputEvent event;
+    uint64_t span_ms = 0;
+    uint32_t previous_ms = 0;
+    int result;
+
+    replay_init(&replay, calibrated, (uint16_t)dry, (uint16_t)wet);
+    input_log_reader_init(&reader, data, (uint32_t)size);
+    double start = now_s();
+    while ((result = input_log_next(&reader, &event)) == 1) {
+        // Recorded time only moves backwards across a reset
+        if (replay.events != 0 && event.time_ms >= previous_ms) {
+            span_ms += event.time_ms - previous_ms;
+        }
+        previous_ms = event.time_ms;
+        replay_event(&replay, &event);
+    }
+    replay_idle(&replay, previous_ms + IDLE_MS);
+    double elapsed = now_s() - start;
+
+    if (output && output != stdout) {
+        fclose(output);
+    }
+    if (result < 0) {
+        fprintf(stderr, "malformed record at byte %u\n", reader.position);
+        free(data);
+        return 1;
+    }
+    fprintf(stderr, "%u events, %u frames, %u spikes from %zu stream bytes\n",
+            replay.events, replay.frames, replay.spikes, size);
+    fprintf(stderr, "replayed %.2f h of input in %.3f s: %.0fx real time\n",
+            span_ms / 3600000.0, elapsed, elapsed > 0.0 ? span_ms / 1000.0 / elapsed : 0.0);
+    fprintf(stderr, "output %llu bytes, CRC-32 0x%08x\n",
+            (unsigned long long)output_bytes, output_crc);
+    free(data);
+    return 0;
+}
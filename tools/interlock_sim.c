@@ -0,0 +1,241 @@
+/*
+ * Trip latency and cost of the pump interlock
+ * (Irrigation_System.X/interlock.c), run as the 1 ms tick would run it.
+ *
+ *     cc -O2 -I Irrigation_System.X -o interlock_sim tools/interlock_sim.c \
+ *        Irrigation_System.X/interlock.c
+ *     ./interlock_sim [runs_per_scenario]
+ *
+ * Simulated time is continuous (microseconds). The pump starts at a
+ * random point between two ticks. Each scenario fails in one way at a
+ * random time, and the simulation records when the failure condition
+ * became true and at which tick the interlock tripped. Trip latency is
+ * the difference. The output is cut in the tripping tick, so there is no
+ * further delay on the target beyond the PORT write.
+ *
+ * Current samples follow pump_interlock.c: started every
+ * PUMP_INTERLOCK_SAMPLE_MS, unless the moisture code has the ADC, and read
+ * one tick later. While watering, the sensor
+ * scans every 10 s and holds the ADC for 1-3 ms. Moisture readings arrive
+ * with the same 10 s period. Scenarios:
+ *  - stuck: the main loop stops with the pump on; on-time limit;
+ *  - volume: flow at a random duty until the zone's volume limit;
+ *  - dry: the current falls below the dry threshold at a random time;
+ *  - leak: the moisture reading does not rise;
+ *  - normal: healthy runs of 200-2000 mL within the on-time limit, which
+ *    must not trip.
+ * The interlock_tick() cost is timed on the host as a relative figure.
+ * The target counts cycles in PumpInterlockStats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "interlock.h"
+
+#define DEFAULT_RUNS       500
+#define SAMPLE_MS          4U        // PUMP_INTERLOCK_SAMPLE_MS
+#define SCAN_PERIOD_US     10000000ULL
+#define DRY_CURRENT        300U
+#define RUNNING_CURRENT    620U
+
+static const InterlockZoneLimits limits[1] = { { 900000UL, 3000U } };
+static const InterlockConfig config = { DRY_CURRENT, 500U, 3000U, 1000U, 2U };
+
+typedef enum { SCENARIO_STUCK, SCENARIO_VOLUME, SCENARIO_DRY, SCENARIO_LEAK, SCENARIO_NORMAL,
+               SCENARIO_COUNT } Scenario;
+static const char *const SCENARIO_NAMES[SCENARIO_COUNT] = {
+    "stuck loop (on-time)", "volume limit", "dry run", "leak", "normal runs"
+};
+static const InterlockTrip EXPECTED[SCENARIO_COUNT] = {
+    INTERLOCK_TRIP_ON_TIME, INTERLOCK_TRIP_VOLUME, INTERLOCK_TRIP_DRY_RUN, INTERLOCK_TRIP_LEAK,
+    INTERLOCK_OK
+};
+// Flow rates of the pump's calibration table (mL/s)
+static const double FLOWS[] = { 0.8, 1.9, 3.1, 4.5, 5.8 };
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct {
+    uint32_t runs;
+    uint32_t correct;            // Tripped for the expected reason (or not at all)
+    uint32_t wrong;
+    double latency_min_ms;
+    double latency_max_ms;
+    double latency_sum_ms;
+    double detect_max_s;         // Leak: leak volume reached to trip
+} ScenarioResult;
+
+static double tick_ns_total;
+static uint64_t ticks_timed;
+
+static InterlockTrip timed_tick(Interlock *interlock, uint16_t current) {
+    double start = now_ns();
+    InterlockTrip trip = interlock_tick(interlock, current);
+    tick_ns_total += now_ns() - start;
+    ticks_timed++;
+    return trip;
+}
+
+static void run_one(Scenario scenario, ScenarioResult *result) {
+    Interlock interlock;
+    interlock_init(&interlock, limits, 1, &config);
+
+    // Stuck runs use the rates that reach the time limit before the
+    // volume limit, volume runs the ones that reach the volume limit first.
+    // At 0.8 mL/s the leak volume is beyond the time limit.
+    uint32_t pick = rng();
+    double flow = (scenario == SCENARIO_STUCK) ? FLOWS[pick % 3U]
+                : (scenario == SCENARIO_VOLUME) ? FLOWS[3U + pick % 2U]
+                : (scenario == SCENARIO_LEAK) ? FLOWS[1U + pick % 4U]
+                : FLOWS[pick % 5U];
+    uint32_t flow_nl = (uint32_t)(flow * 1000.0 + 0.5);
+    uint64_t start_us = 1000000ULL + rng() % 1000U;   // Between two ticks
+    uint64_t scan_phase_us = rng() % SCAN_PERIOD_US;
+    uint64_t scan_busy_us = 1000U + rng() % 2001U;
+    uint64_t dry_at_us = UINT64_MAX;
+    double condition_us = -1.0;
+    double leak_volume_us = -1.0;
+    uint8_t moisture = (uint8_t)(25U + rng() % 10U);
+    uint32_t target_ml = 0;
+
+    switch (scenario) {
+        case SCENARIO_STUCK:
+            condition_us = start_us + limits[0].max_on_ms * 1000.0;
+            break;
+        case SCENARIO_VOLUME:
+            condition_us = start_us + limits[0].max_volume_ml / flow * 1e6;
+            break;
+        case SCENARIO_DRY:
+            dry_at_us = start_us + 600000ULL + rng() % 60000000U;
+            condition_us = dry_at_us + config.dry_run_ms * 1000.0;
+            break;
+        case SCENARIO_LEAK:
+            leak_volume_us = start_us + config.leak_volume_ml / flow * 1e6;
+            break;
+        case SCENARIO_NORMAL:
+            target_ml = 200U + rng() % 1801U;
+            if (target_ml > flow * 800.0) {
+                target_ml = (uint32_t)(flow * 800.0);   // Within the on-time limit
+            }
+            break;
+        default:
+            break;
+    }
+
+    interlock_report_moisture(&interlock, moisture);
+    interlock_start(&interlock, 0, flow_nl, 0, 0);
+
+    uint64_t next_reading_us = start_us + SCAN_PERIOD_US - scan_phase_us % SCAN_PERIOD_US;
+    InterlockTrip trip = INTERLOCK_OK;
+    uint64_t tick_us = (start_us / 1000U + 1U) * 1000U;
+    uint32_t tick = 0;
+    uint16_t pending_current = INTERLOCK_NO_CURRENT;
+
+    for (;; tick_us += 1000U, tick++) {
+        // Main loop: moisture readings (none once stuck)
+        while (scenario != SCENARIO_STUCK && next_reading_us <= tick_us) {
+            double dispensed_ml = (next_reading_us - start_us) / 1e6 * flow;
+            if (scenario == SCENARIO_LEAK) {
+                // Water runs off: the reading wanders by a point at most
+                interlock_report_moisture(&interlock, (uint8_t)(moisture + rng() % 2U));
+            } else {
+                // Soaks in after about 100 mL, then 1 % per 50 mL
+                double rise = dispensed_ml > 100.0 ? (dispensed_ml - 100.0) / 50.0 : 0.0;
+                interlock_report_moisture(&interlock, (uint8_t)(moisture + (rise > 60 ? 60 : rise)));
+            }
+            if (scenario == SCENARIO_LEAK && leak_volume_us >= 0.0 && condition_us < 0.0 &&
+                next_reading_us > leak_volume_us) {
+                condition_us = (double)next_reading_us;
+            }
+            next_reading_us += SCAN_PERIOD_US;
+        }
+
+        // Current sense every SAMPLE_MS unless a sensor conversion holds the
+        // ADC; the conversion started in one tick is read in the next
+        uint16_t current = pending_current;
+        pending_current = INTERLOCK_NO_CURRENT;
+        if ((tick + 1U) % SAMPLE_MS == 0) {
+            uint64_t scan_offset = (tick_us + scan_phase_us) % SCAN_PERIOD_US;
+            bool adc_busy = scenario != SCENARIO_STUCK && scan_offset < scan_busy_us;
+            if (!adc_busy) {
+                pending_current = (tick_us >= dry_at_us)
+                    ? (uint16_t)(40U + rng() % 100U)
+                    : (uint16_t)(RUNNING_CURRENT - 60U + rng() % 121U);
+            }
+        }
+
+        trip = timed_tick(&interlock, current);
+        if (trip != INTERLOCK_OK) {
+            break;
+        }
+        if (scenario == SCENARIO_NORMAL &&
+            (tick_us - start_us) / 1e6 * flow >= target_ml) {
+            break;
+        }
+        if (tick > 2000000U) {
+            break;
+        }
+    }
+
+    result->runs++;
+    if (trip != EXPECTED[scenario]) {
+        result->wrong++;
+        return;
+    }
+    result->correct++;
+    if (scenario == SCENARIO_NORMAL) {
+        return;
+    }
+    double latency_ms = (tick_us - condition_us) / 1000.0;
+    if (result->correct == 1 || latency_ms < result->latency_min_ms) result->latency_min_ms = latency_ms;
+    if (result->correct == 1 || latency_ms > result->latency_max_ms) result->latency_max_ms = latency_ms;
+    result->latency_sum_ms += latency_ms;
+    if (scenario == SCENARIO_LEAK) {
+        double detect_s = (tick_us - leak_volume_us) / 1e6;
+        if (detect_s > result->detect_max_s) result->detect_max_s = detect_s;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t runs = (argc > 1) ? (uint32_t)atoi(argv[1]) : DEFAULT_RUNS;
+
+    printf("%u runs per scenario, current sampled every %u ms, dry after %u ms, "
+           "leak check after %u mL\n\n", runs, SAMPLE_MS, config.dry_run_ms, config.leak_volume_ml);
+    printf("%-22s %9s %18s %18s\n", "scenario", "correct", "latency min..max", "avg");
+
+    for (int s = 0; s < SCENARIO_COUNT; s++) {
+        ScenarioResult result = {0};
+        rng_state = 0x1234567U + (uint32_t)s;
+        for (uint32_t i = 0; i < runs; i++) {
+            run_one((Scenario)s, &result);
+        }
+        if (s == SCENARIO_NORMAL) {
+            printf("%-22s %4u/%-4u %18s %18s  (false trips: %u)\n", SCENARIO_NAMES[s],
+                   result.correct, result.runs, "-", "-", result.wrong);
+            continue;
+        }
+        printf("%-22s %4u/%-4u %8.3f..%6.3f ms %15.3f ms", SCENARIO_NAMES[s],
+               result.correct, result.runs, result.latency_min_ms, result.latency_max_ms,
+               result.correct ? result.latency_sum_ms / result.correct : 0.0);
+        if (s == SCENARIO_LEAK) {
+            printf("  (leak volume to trip: max %.1f s)", result.detect_max_s);
+        }
+        printf("\n");
+    }
+    printf("\ninterlock_tick() on this host: %.1f ns average over %llu ticks "
+           "(includes the clock read)\n", tick_ns_total / ticks_timed, (unsigned long long)ticks_timed);
+    return 0;
+}
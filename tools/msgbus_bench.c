@@ -0,0 +1,192 @@
+/*
+ * Publish-to-handle latency, cost and memory of the message bus
+ * (Irrigation_System.X/msgbus.c) with the firmware's topics and
+ * subscribers (Irrigation_System.X/app_msg.h).
+ *
+ *     cc -O2 -I Irrigation_System.X -o msgbus_bench tools/msgbus_bench.c Irrigation_System.X/msgbus.c
+ *     ./msgbus_bench [passes]
+ *
+ * Each simulated main-loop pass publishes a burst (a reading, sometimes a
+ * pump event or a state change) and then dispatches. The bus clock is a
+ * nanosecond counter, so the subscriber statistics give the latency from
+ * publish to the handler in ns; on the target they are in ms ticks
+ * (app_msg_report()). The last part overfills one pass to show the drop
+ * and overrun accounting; every subscriber must still handle the newest
+ * reading, or the tool exits with 1.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_msg.h"
+
+#define DEFAULT_PASSES  1000000UL
+
+static uint32_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile uint32_t sink;
+static int latest_percent[3];   // Last reading each subscriber handled, -1 for none
+
+// Stand-ins for the firmware handlers: read the payload, as they do
+static void interlock_handler(const MsgbusMessage *message, const void *payload) {
+    (void)message;
+    latest_percent[0] = ((const MoistureMessage *)payload)->percent;
+    sink += ((const MoistureMessage *)payload)->percent;
+}
+
+static void telemetry_handler(const MsgbusMessage *message, const void *payload) {
+    if (message->topic == MSG_MOISTURE) {
+        latest_percent[1] = ((const MoistureMessage *)payload)->percent;
+    }
+    const MoistureMessage *reading = msgbus_latest(&app_msgbus, MSG_MOISTURE);
+    sink += reading ? reading->raw : message->topic;
+}
+
+static void display_handler(const MsgbusMessage *message, const void *payload) {
+    if (message->topic == MSG_MOISTURE) {
+        latest_percent[2] = ((const MoistureMessage *)payload)->percent;
+    }
+    sink += (message->topic == MSG_STATE) ? ((const StateMessage *)payload)->to
+                                          : ((const MoistureMessage *)payload)->percent;
+}
+
+// Same sizes as app_msg.c
+static MoistureMessage moisture_slots[4];
+static PumpMessage pump_slots[4];
+static StateMessage state_slots[4];
+static MsgbusTopic topics[MSG_TOPIC_COUNT] = {
+    [MSG_MOISTURE] = MSGBUS_TOPIC_INIT(moisture_slots),
+    [MSG_PUMP]     = MSGBUS_TOPIC_INIT(pump_slots),
+    [MSG_STATE]    = MSGBUS_TOPIC_INIT(state_slots),
+};
+static const char *const topic_names[MSG_TOPIC_COUNT] = { "moisture", "pump", "state" };
+
+static MsgbusMessage interlock_queue[4];
+static MsgbusMessage telemetry_queue[8];
+static MsgbusMessage display_queue[8];
+static MsgbusSubscriber subscribers[] = {
+    MSGBUS_SUBSCRIBER_INIT(interlock_handler, MSGBUS_TOPIC_BIT(MSG_MOISTURE), interlock_queue),
+    MSGBUS_SUBSCRIBER_INIT(telemetry_handler,
+                           MSGBUS_TOPIC_BIT(MSG_MOISTURE) | MSGBUS_TOPIC_BIT(MSG_PUMP), telemetry_queue),
+    MSGBUS_SUBSCRIBER_INIT(display_handler,
+                           MSGBUS_TOPIC_BIT(MSG_MOISTURE) | MSGBUS_TOPIC_BIT(MSG_STATE), display_queue),
+};
+static const char *const subscriber_names[] = { "interlock", "bus node", "display" };
+#define SUBSCRIBER_COUNT (sizeof(subscribers) / sizeof(subscribers[0]))
+
+Msgbus app_msgbus = { topics, subscribers, MSG_TOPIC_COUNT, SUBSCRIBER_COUNT, clock_ns };
+
+static void reset_stats(void) {
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        memset(&subscribers[i].stats, 0, sizeof(subscribers[i].stats));
+    }
+}
+
+static void publish_pass(unsigned long pass, int in_place) {
+    if (in_place) {
+        MoistureMessage *reading = msgbus_claim(&app_msgbus, MSG_MOISTURE);
+        reading->zone = 0;
+        reading->percent = (uint8_t)(pass % 100U);
+        reading->raw = (uint16_t)(pass & 0x0FFFU);
+        msgbus_commit(&app_msgbus, MSG_MOISTURE);
+    } else {
+        MoistureMessage reading = { 0, (uint8_t)(pass % 100U), 0, false, (uint16_t)(pass & 0x0FFFU), 0, 0 };
+        APP_MSG_PUBLISH(MSG_MOISTURE, &reading);
+    }
+    if ((pass & 7U) == 0) {
+        PumpMessage event = { PUMP_MSG_STARTED, 0, 0, 60, (uint32_t)pass };
+        APP_MSG_PUBLISH(MSG_PUMP, &event);
+    }
+    if ((pass & 31U) == 0) {
+        StateMessage change = { 0, (uint8_t)(pass % 5U), (uint8_t)((pass + 1U) % 5U) };
+        APP_MSG_PUBLISH(MSG_STATE, &change);
+    }
+}
+
+static void run(const char *name, unsigned long passes, int in_place) {
+    reset_stats();
+    double start = now_ns();
+    for (unsigned long pass = 0; pass < passes; pass++) {
+        publish_pass(pass, in_place);
+        msgbus_dispatch(&app_msgbus);
+    }
+    double elapsed = now_ns() - start;
+    uint32_t handled = 0;
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        handled += subscribers[i].stats.handled;
+    }
+    printf("%s: %.1f ns per pass, %.1f ns per delivery\n", name, elapsed / passes, elapsed / handled);
+}
+
+static void report(void) {
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        const MsgbusSubscriberStats *stats = &subscribers[i].stats;
+        printf("  %-9s handled %8u  dropped %4u  overrun %4u  latency avg %5.0f ns  max %6u ns\n",
+               subscriber_names[i], (unsigned)stats->handled, (unsigned)stats->dropped,
+               (unsigned)stats->overrun,
+               stats->handled ? (double)stats->latency_total / stats->handled : 0.0,
+               (unsigned)stats->latency_max);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long passes = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEFAULT_PASSES;
+    uint32_t queues = 0;
+
+    if (passes == 0) {
+        fprintf(stderr, "usage: %s [passes]\n", argv[0]);
+        return 2;
+    }
+
+    printf("memory:\n");
+    for (uint8_t topic = 0; topic < MSG_TOPIC_COUNT; topic++) {
+        printf("  topic %-8s %u slots x %2u B = %3u B with descriptor\n", topic_names[topic],
+               topics[topic].slot_count, topics[topic].payload_size,
+               (unsigned)msgbus_topic_bytes(&app_msgbus, topic));
+    }
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        uint32_t bytes = subscribers[i].queue_size * (uint32_t)sizeof(MsgbusMessage);
+        queues += bytes;
+        printf("  sub   %-9s queue %u x %zu B = %3u B, descriptor %zu B\n", subscriber_names[i],
+               subscribers[i].queue_size, sizeof(MsgbusMessage), (unsigned)bytes,
+               sizeof(MsgbusSubscriber));
+    }
+    printf("  queues %u B in all\n", (unsigned)queues);
+
+    run("publish (copy)", passes, 0);
+    report();
+    run("claim/commit (in place)", passes, 1);
+    report();
+
+    // 20 readings without a dispatch: queues hold the newest 3 or 7, and
+    // the 4 slots keep the newest 4 payloads
+    reset_stats();
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        latest_percent[i] = -1;
+    }
+    for (unsigned long pass = 0; pass < 20; pass++) {
+        MoistureMessage reading = { 0, (uint8_t)pass, 0, false, 0, 0, 0 };
+        APP_MSG_PUBLISH(MSG_MOISTURE, &reading);
+    }
+    msgbus_dispatch(&app_msgbus);
+    printf("burst of 20 readings (0-19) before one dispatch:\n");
+    report();
+    int missed = 0;
+    for (size_t i = 0; i < SUBSCRIBER_COUNT; i++) {
+        printf("  %-9s last reading handled: %d\n", subscriber_names[i], latest_percent[i]);
+        missed += latest_percent[i] != 19;
+    }
+    return missed ? 1 : 0;
+}
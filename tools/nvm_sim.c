@@ -0,0 +1,98 @@
+/*
+ * Host model of the SAMD21G17D NVM (see nvm_sim.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvm_sim.h"
+
+static uint8_t *locate(NvmSim *nvm, uint32_t address, uint32_t size) {
+    if (address + size <= NVM_SIM_FLASH_SIZE) {
+        return &nvm->flash[address];
+    }
+    if (address >= NVM_SIM_RWW_ADDRESS && address + size <= NVM_SIM_RWW_ADDRESS + NVM_SIM_RWW_SIZE) {
+        return &nvm->rww[address - NVM_SIM_RWW_ADDRESS];
+    }
+    fprintf(stderr, "nvm_sim: access outside flash at 0x%08x\n", address);
+    abort();
+}
+
+static void check_command(NvmSim *nvm, uint32_t address, uint32_t alignment) {
+    if (address % alignment != 0) {
+        fprintf(stderr, "nvm_sim: unaligned command at 0x%08x\n", address);
+        abort();
+    }
+    if (address < nvm->bootprot) {
+        fprintf(stderr, "nvm_sim: command in the protected boot area at 0x%08x\n", address);
+        abort();
+    }
+}
+
+// true if this command is the one the power cut interrupts
+static bool cut_now(NvmSim *nvm) {
+    if (nvm->cut_after < 0) {
+        return false;
+    }
+    return nvm->cut_after-- == 0;
+}
+
+static void power_cut(NvmSim *nvm) {
+    nvm->cut_after = -1;
+    nvm->cuts++;
+    longjmp(*nvm->cut_target, 1);
+}
+
+static const uint8_t *sim_map(void *context, uint32_t address) {
+    return locate(context, address, 1);
+}
+
+static void sim_erase_row(void *context, uint32_t address) {
+    NvmSim *nvm = context;
+    check_command(nvm, address, FW_ROW_SIZE);
+    uint8_t *row = locate(nvm, address, FW_ROW_SIZE);
+    nvm->erases++;
+    nvm->busy_ms += NVM_SIM_ERASE_MS;
+    if (cut_now(nvm)) {
+        memset(row, 0xFF, FW_ROW_SIZE / 2U);
+        power_cut(nvm);
+    }
+    memset(row, 0xFF, FW_ROW_SIZE);
+}
+
+static void sim_write_page(void *context, uint32_t address, const uint32_t *data) {
+    NvmSim *nvm = context;
+    check_command(nvm, address, FW_PAGE_SIZE);
+    uint8_t *page = locate(nvm, address, FW_PAGE_SIZE);
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t count = FW_PAGE_SIZE;
+    nvm->writes++;
+    nvm->busy_ms += NVM_SIM_WRITE_MS;
+    bool cut = cut_now(nvm);
+    if (cut) {
+        count /= 2U;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        page[i] &= bytes[i];
+    }
+    if (cut) {
+        power_cut(nvm);
+    }
+}
+
+void nvm_sim_init(NvmSim *nvm, uint32_t bootprot) {
+    memset(nvm, 0, sizeof(*nvm));
+    memset(nvm->flash, 0xFF, sizeof(nvm->flash));
+    memset(nvm->rww, 0xFF, sizeof(nvm->rww));
+    nvm->bootprot = bootprot;
+    nvm->cut_after = -1;
+}
+
+void nvm_sim_load(NvmSim *nvm, uint32_t address, const void *data, uint32_t size) {
+    memcpy(locate(nvm, address, size), data, size);
+}
+
+FwFlash nvm_sim_flash(NvmSim *nvm) {
+    FwFlash flash = { sim_map, sim_erase_row, sim_write_page, nvm };
+    return flash;
+}
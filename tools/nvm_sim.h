@@ -0,0 +1,62 @@
+/*
+ * Host model of the SAMD21G17D non-volatile memory for firmware update
+ * tests (see tools/fw_update_sim.c).
+ *
+ * Covers the 128 KB main array and the 4 KB RWW EEPROM section, at the
+ * target's addresses. It behaves like the NVMCTRL:
+ *  - a row erase sets 256 bytes to 0xFF;
+ *  - a page write can only clear bits, so writing a page twice without
+ *    an erase ANDs the data;
+ *  - the BOOTPROT region cannot be erased or written.
+ * Each command adds its datasheet maximum to busy_ms (row erase 6 ms,
+ * page write 2.5 ms).
+ *
+ * Power cuts: with cut_after set, the command that uses up the budget is
+ * left half done and the simulator longjmps to cut_target. The half done
+ * command is an erase that reached only half the row, or a page write
+ * that programmed only its first half. Everything the code did since is
+ * lost, as on a real reset.
+ */
+
+#ifndef NVM_SIM_H
+#define NVM_SIM_H
+
+#include <setjmp.h>
+#include <stdint.h>
+#include "fw_patch.h"
+
+#define NVM_SIM_FLASH_SIZE     0x20000U
+#define NVM_SIM_RWW_ADDRESS    0x00400000U
+#define NVM_SIM_RWW_SIZE       0x1000U
+#define NVM_SIM_ERASE_MS       6.0
+#define NVM_SIM_WRITE_MS       2.5
+
+typedef struct {
+    uint8_t flash[NVM_SIM_FLASH_SIZE];
+    uint8_t rww[NVM_SIM_RWW_SIZE];
+    uint32_t bootprot;                  // Protected bytes from address 0
+    uint32_t erases;
+    uint32_t writes;
+    double busy_ms;
+    long cut_after;                     // Commands until a power cut; < 0 for none
+    uint32_t cuts;
+    jmp_buf *cut_target;
+} NvmSim;
+
+/**
+ * @brief Everything erased, no cut armed.
+ */
+void nvm_sim_init(NvmSim *nvm, uint32_t bootprot);
+
+/**
+ * @brief Programs @p data at @p address as a debugger would, with no
+ * time or command counted.
+ */
+void nvm_sim_load(NvmSim *nvm, uint32_t address, const void *data, uint32_t size);
+
+/**
+ * @brief FwFlash bound to @p nvm.
+ */
+FwFlash nvm_sim_flash(NvmSim *nvm);
+
+#endif // NVM_SIM_H
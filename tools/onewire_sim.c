@@ -0,0 +1,270 @@
+/*
+ * 1-Wire transactions of the DS18B20 driver against a scripted sensor
+ * model (Irrigation_System.X/onewire.c, programs of temperature_sensor.c).
+ *
+ *     cc -O2 -I Irrigation_System.X -o onewire_sim tools/onewire_sim.c \
+ *        Irrigation_System.X/onewire.c
+ *     ./onewire_sim [transactions]
+ *
+ * The model answers each UART frame the way the bus would echo it: a
+ * 9600-baud reset frame comes back as 0xE0 when the sensor pulls the
+ * presence pulse and unchanged when nothing is connected, a read slot
+ * comes back as 0xFF or with the low bits pulled for a 0. It decodes
+ * Skip ROM, Convert T and Read Scratchpad and shifts out a scratchpad
+ * with a valid CRC-8. Scenarios:
+ *  - convert: the first transaction after boot (no reading yet);
+ *  - read and convert: the steady-state transaction, which must decode
+ *    the model's temperature;
+ *  - bad CRC: one scratchpad bit flipped on the bus, which must fail;
+ *  - no sensor: no presence pulse, which must fail after one slot.
+ * Each scenario reports the slots (receive interrupts on the target) and
+ * baud changes per transaction. onewire_slot_done() is then timed on the
+ * host by replaying the recorded echoes of a read-and-convert
+ * transaction; the figure is relative. The target counts slots and cycles
+ * in TemperatureSensorStats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "onewire.h"
+
+#define DEFAULT_TRANSACTIONS  200000
+#define MAX_SLOTS             256
+
+#define DS18B20_SKIP_ROM        0xCC
+#define DS18B20_CONVERT_T       0x44
+#define DS18B20_READ_SCRATCHPAD 0xBE
+#define DS18B20_SCRATCHPAD_SIZE 9
+
+// Copies of the programs in temperature_sensor.c
+static const OneWireOp program_convert[] = {
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_CONVERT_T },
+    { ONEWIRE_OP_END, 0 }
+};
+
+static const OneWireOp program_read_and_convert[] = {
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_READ_SCRATCHPAD },
+    { ONEWIRE_OP_READ, DS18B20_SCRATCHPAD_SIZE },
+    { ONEWIRE_OP_RESET, 0 },
+    { ONEWIRE_OP_WRITE, DS18B20_SKIP_ROM },
+    { ONEWIRE_OP_WRITE, DS18B20_CONVERT_T },
+    { ONEWIRE_OP_END, 0 }
+};
+
+// --- Sensor model ---
+typedef enum { DEV_IDLE, DEV_ROM, DEV_FUNCTION, DEV_READING } DeviceState;
+
+typedef struct {
+    bool present;
+    int flip_bit;                   // Scratchpad bit corrupted on the bus, or -1
+    DeviceState state;
+    uint8_t shift;
+    uint8_t bits;
+    uint16_t read_bit;
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+    uint32_t conversions;
+} Ds18b20;
+
+static void device_init(Ds18b20 *dev, int16_t temperature_x16) {
+    static const uint8_t rest[] = { 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };
+    memset(dev, 0, sizeof(*dev));
+    dev->present = true;
+    dev->flip_bit = -1;
+    dev->scratchpad[0] = (uint8_t)temperature_x16;
+    dev->scratchpad[1] = (uint8_t)((uint16_t)temperature_x16 >> 8);
+    memcpy(&dev->scratchpad[2], rest, sizeof(rest));
+    dev->scratchpad[8] = onewire_crc8(dev->scratchpad, DS18B20_SCRATCHPAD_SIZE - 1);
+}
+
+static void device_command(Ds18b20 *dev, uint8_t command) {
+    if (dev->state == DEV_ROM) {
+        dev->state = (command == DS18B20_SKIP_ROM) ? DEV_FUNCTION : DEV_IDLE;
+    } else if (command == DS18B20_READ_SCRATCHPAD) {
+        dev->state = DEV_READING;
+        dev->read_bit = 0;
+    } else {
+        if (command == DS18B20_CONVERT_T) {
+            dev->conversions++;
+        }
+        dev->state = DEV_IDLE;
+    }
+}
+
+// Bus echo of one frame at the baud rate it was sent with
+static uint8_t device_echo(Ds18b20 *dev, uint32_t baud, uint8_t frame) {
+    if (baud == ONEWIRE_RESET_BAUD) {
+        if (!dev->present) {
+            return frame;
+        }
+        dev->state = DEV_ROM;
+        dev->bits = 0;
+        dev->shift = 0;
+        return 0xE0;
+    }
+    if (dev->state == DEV_READING && frame == ONEWIRE_SLOT_ONE) {
+        uint16_t bit = dev->read_bit++;
+        if (bit >= DS18B20_SCRATCHPAD_SIZE * 8U) {
+            return ONEWIRE_SLOT_ONE;  // Bus idles high after the scratchpad
+        }
+        bool one = (dev->scratchpad[bit >> 3] >> (bit & 7U)) & 0x01;
+        if ((int)bit == dev->flip_bit) {
+            one = !one;
+        }
+        return one ? ONEWIRE_SLOT_ONE : 0xFE;
+    }
+    if (dev->state == DEV_ROM || dev->state == DEV_FUNCTION) {
+        if (frame == ONEWIRE_SLOT_ONE) {
+            dev->shift |= (uint8_t)(1U << dev->bits);
+        }
+        if (++dev->bits == 8) {
+            uint8_t command = dev->shift;
+            dev->bits = 0;
+            dev->shift = 0;
+            device_command(dev, command);
+        }
+    }
+    return frame;
+}
+
+// --- Bus under test ---
+static OneWireBus bus;
+static uint32_t baud = ONEWIRE_SLOT_BAUD;
+static uint8_t tx_frame;
+static bool tx_pending;
+static uint32_t baud_changes;
+static bool done_called;
+static bool done_success;
+static uint8_t done_length;
+static uint8_t done_data[ONEWIRE_READ_MAX];
+
+static void sim_set_baud(uint32_t value) {
+    baud = value;
+    baud_changes++;
+}
+
+static void sim_send(uint8_t frame) {
+    tx_frame = frame;
+    tx_pending = true;
+}
+
+static void sim_done(bool success, const uint8_t *data, uint8_t length) {
+    done_called = true;
+    done_success = success;
+    done_length = length;
+    memcpy(done_data, data, length);
+}
+
+static const OneWireHardware sim_hardware = { sim_set_baud, sim_send, sim_done };
+
+typedef struct {
+    uint32_t slots;
+    uint32_t baud_changes;
+    bool success;
+    uint8_t length;
+} TransactionResult;
+
+// Runs one program to the end and records its echoes for the timing replay
+static TransactionResult run_transaction(Ds18b20 *dev, const OneWireOp *program,
+                                         uint8_t *echoes) {
+    TransactionResult result = { 0, 0, false, 0 };
+    done_called = false;
+    baud_changes = 0;
+    onewire_start(&bus, program);
+    while (!done_called && tx_pending && result.slots < MAX_SLOTS) {
+        tx_pending = false;
+        uint8_t echo = device_echo(dev, baud, tx_frame);
+        if (echoes != NULL) {
+            echoes[result.slots] = echo;
+        }
+        result.slots++;
+        onewire_slot_done(&bus, echo);
+    }
+    result.baud_changes = baud_changes;
+    result.success = done_called && done_success;
+    result.length = done_length;
+    return result;
+}
+
+static int report(const char *name, TransactionResult r, bool expect_success,
+                  uint32_t expect_slots) {
+    bool ok = (r.success == expect_success) && (r.slots == expect_slots);
+    printf("%-18s %5u slots  %u baud changes  %-7s %s\n", name, (unsigned)r.slots,
+           (unsigned)r.baud_changes, r.success ? "ok" : "failed", ok ? "" : "  UNEXPECTED");
+    return ok ? 0 : 1;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    int transactions = (argc > 1) ? atoi(argv[1]) : DEFAULT_TRANSACTIONS;
+    const int16_t temperature_x16 = 0x0191;   // 25.0625 degC
+    uint8_t echoes[MAX_SLOTS];
+    int errors = 0;
+    Ds18b20 dev;
+
+    if (transactions <= 0) {
+        fprintf(stderr, "usage: %s [transactions]\n", argv[0]);
+        return 2;
+    }
+    onewire_init(&bus, &sim_hardware);
+
+    // Reset (1) + two command bytes (16), and one scratchpad read on top
+    const uint32_t convert_slots = 1 + 16;
+    const uint32_t read_convert_slots = 2 * convert_slots + DS18B20_SCRATCHPAD_SIZE * 8;
+
+    device_init(&dev, temperature_x16);
+    errors += report("convert", run_transaction(&dev, program_convert, NULL), true, convert_slots);
+    if (dev.conversions != 1) {
+        printf("  sensor saw %u Convert T commands\n", (unsigned)dev.conversions);
+        errors++;
+    }
+
+    TransactionResult r = run_transaction(&dev, program_read_and_convert, echoes);
+    errors += report("read and convert", r, true, read_convert_slots);
+    int16_t decoded = (int16_t)((done_data[1] << 8) | done_data[0]);
+    printf("  scratchpad %u bytes, temperature %.4f degC (model %.4f)\n", (unsigned)r.length,
+           decoded / 16.0, temperature_x16 / 16.0);
+    if (r.length != DS18B20_SCRATCHPAD_SIZE || decoded != temperature_x16 || dev.conversions != 2) {
+        errors++;
+    }
+
+    device_init(&dev, temperature_x16);
+    dev.flip_bit = 21;
+    // The CRC is checked on the last scratchpad bit, before the second reset
+    errors += report("bad CRC", run_transaction(&dev, program_read_and_convert, NULL), false,
+                     read_convert_slots - convert_slots);
+
+    device_init(&dev, temperature_x16);
+    dev.present = false;
+    errors += report("no sensor", run_transaction(&dev, program_read_and_convert, NULL), false, 1);
+
+    // Replay the recorded echoes of the read-and-convert transaction
+    double t0 = now_ns();
+    for (int i = 0; i < transactions; i++) {
+        done_called = false;
+        onewire_start(&bus, program_read_and_convert);
+        for (uint32_t slot = 0; slot < read_convert_slots; slot++) {
+            onewire_slot_done(&bus, echoes[slot]);
+        }
+        if (!done_called || !done_success) {
+            errors++;
+            break;
+        }
+    }
+    double per_slot = (now_ns() - t0) / ((double)transactions * read_convert_slots);
+    printf("onewire_slot_done: %.1f ns per slot on this host, %.2f us per read-and-convert\n",
+           per_slot, per_slot * read_convert_slots / 1000.0);
+
+    printf("%s\n", errors ? "FAILED" : "all scenarios as expected");
+    return errors ? 1 : 0;
+}
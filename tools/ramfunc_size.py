@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Report the RAM taken by code relocated with RAMFUNC (.ramcode section).
+
+    python ../tools/ramfunc_size.py dist/default/production/Irrigation_System.X.production.hex
+
+Runs as the MPLAB X post-build step with ${ImagePath}. It reads the linker
+map next to the image (same name, .map) and prints the section's total,
+its share of the 16 KB RAM, and the size and functions per object file.
+A map file can also be given directly. Exits non-zero if the map has no
+.ramcode section, i.e. ramfunc.ld was not passed to the linker.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+RAM_BYTES = 16 * 1024
+SECTION = ".ramcode"
+
+OUTPUT_LINE = re.compile(r"^\.ramcode\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+load address 0x([0-9a-f]+))?")
+INPUT_SECTION = re.compile(r"^\s+\.ramcode(?:\.\S+)?(?:\s+(0x[0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+))?$")
+INPUT_LINE = re.compile(r"^\s*0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+SYMBOL_LINE = re.compile(r"^\s+0x([0-9a-f]+)\s+([A-Za-z_]\w*)$")
+
+
+def map_path(path):
+    if path.endswith(".map"):
+        return path
+    return os.path.splitext(path)[0] + ".map"
+
+
+def parse(lines):
+    """Return (address, size, load address, [(object, size, [functions])])."""
+    section = None
+    objects = []
+    pending_input = False
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if section is None:
+            match = OUTPUT_LINE.match(line)
+            if match:
+                section = (int(match.group(1), 16), int(match.group(2), 16),
+                           int(match.group(3), 16) if match.group(3) else None)
+            continue
+        # The output section ends at the next blank line or next section
+        if not line.strip() or re.match(r"^\.\S", line):
+            break
+        match = INPUT_SECTION.match(line)
+        if match:
+            if match.group(1):
+                objects.append([match.group(3), int(match.group(2), 16), []])
+            else:
+                # Long input section names put the address on the next line
+                pending_input = True
+            continue
+        if pending_input:
+            pending_input = False
+            match = INPUT_LINE.match(line)
+            if match:
+                objects.append([match.group(3), int(match.group(2), 16), []])
+            continue
+        match = SYMBOL_LINE.match(line)
+        if match and objects and not match.group(2).startswith("__ramcode"):
+            objects[-1][2].append(match.group(2))
+
+    if section is None:
+        return None
+    return section + (objects,)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="built image (.hex/.elf) or its .map file")
+    args = parser.parse_args()
+
+    path = map_path(args.image)
+    try:
+        with open(path) as f:
+            result = parse(f)
+    except OSError as error:
+        sys.stderr.write("ramfunc_size: %s\n" % error)
+        return 1
+    if result is None:
+        sys.stderr.write("ramfunc_size: no %s section in %s (is ramfunc.ld linked?)\n"
+                         % (SECTION, path))
+        return 1
+
+    address, size, load, objects = result
+    print("RAM code (%s): %d bytes at 0x%08x, %.1f %% of RAM%s"
+          % (SECTION, size, address, 100.0 * size / RAM_BYTES,
+             ", loaded from 0x%08x" % load if load is not None else ""))
+    for name, object_size, functions in objects:
+        if object_size:
+            print("  %6d  %-24s %s" % (object_size, os.path.basename(name), " ".join(functions)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
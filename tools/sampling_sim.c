@@ -0,0 +1,279 @@
+/*
+ * Compare fixed-interval, adaptive and ADC-window moisture sampling on a
+ * moisture trace.
+ *
+ * Builds against the firmware modules directly:
+ *
+ *     cc -O2 -I Irrigation_System.X -o sampling_sim \
+ *        tools/sampling_sim.c Irrigation_System.X/adaptive_sampling.c \
+ *        Irrigation_System.X/adc_window.c Irrigation_System.X/moisture_curve.c -lm
+ *
+ *     ./sampling_sim                      # simulated 14-day trace
+ *     ./sampling_sim recorded.csv         # "seconds,percent" per line
+ *
+ * A recorded trace can be produced from a trace dump: the MOISTURE_READING
+ * lines printed by tools/trace_decode.py give the time and the percent.
+ * Between recorded points the trace is interpolated linearly.
+ *
+ * The simulated trace dries exponentially towards 15 % with a daily
+ * temperature swing and +/-1 % sensor noise. It is watered back to 75 %
+ * a few minutes after each crossing of the low threshold, the way the
+ * pump would. The reported detection delay is the time from the true
+ * (noise-free) crossing to the first sample that reads at or below it.
+ *
+ * The window policy follows moisture_sensor.c. After a full measurement
+ * between the thresholds, adc_window_around() turns the thresholds into a
+ * raw band around it. The free-running ADC is then compared with that band
+ * every simulated second. The raw values come from a two-point
+ * calibration table, and each result is the average of 16 noisy samples,
+ * like the hardware averaging. A result outside the band wakes the CPU
+ * and is itself the reading. After MOISTURE_WINDOW_REFRESH_MS the CPU
+ * wakes for a full measurement. Outside the band the adaptive interval
+ * applies, as before. After a reading at a threshold, the window is armed
+ * again only WINDOW_HYSTERESIS percent inside the band. Once the trace has
+ * risen by watering, the adaptive history is reset at the next reading,
+ * as moisture_sensor.c does when the pump stops.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "adaptive_sampling.h"
+#include "adc_window.h"
+
+#define FIXED_INTERVAL_MS   30000U   // Original 30 s cadence
+#define SIM_DAYS            14
+#define SIM_STEP_S          1
+#define THRESHOLD_LOW       40       // peppermint in PLANT_THRESHOLDS
+#define THRESHOLD_HIGH      80
+#define WATERED_PERCENT     75.0
+#define WATERING_DELAY_S    300      // Pump reacts within 5 minutes
+#define WATERING_STEP       0.25     // Rise per step (%) taken as the pump running
+#define MAX_POINTS          200000
+#define DRY_RAW             3200     // Two-point calibration, capacitive sensor polarity
+#define WET_RAW             1300
+#define SAMPLE_NOISE_RAW    19       // +/-1 % of the span per single conversion
+#define HW_AVERAGE          16       // AVGCTRL.SAMPLENUM in monitoring mode
+#define WINDOW_REFRESH_S    1800     // MOISTURE_WINDOW_REFRESH_MS
+#define WINDOW_HYSTERESIS   2        // MOISTURE_WINDOW_HYSTERESIS
+
+typedef enum {
+    POLICY_FIXED,
+    POLICY_ADAPTIVE,
+    POLICY_WINDOW
+} Policy;
+
+typedef struct {
+    double *time_s;
+    double *percent;
+    size_t count;
+} Trace;
+
+typedef struct {
+    unsigned long wakeups;
+    unsigned long window_wakeups;    // Woken by the ADC window (included in wakeups)
+    unsigned long crossings;
+    double delay_total_s;
+    double delay_max_s;
+} Result;
+
+static double trace_at(const Trace *trace, double t) {
+    size_t lo = 0, hi = trace->count - 1;
+    if (t <= trace->time_s[0]) return trace->percent[0];
+    if (t >= trace->time_s[hi]) return trace->percent[hi];
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (trace->time_s[mid] <= t) lo = mid; else hi = mid;
+    }
+    double f = (t - trace->time_s[lo]) / (trace->time_s[hi] - trace->time_s[lo]);
+    return trace->percent[lo] + f * (trace->percent[hi] - trace->percent[lo]);
+}
+
+static void simulate_trace(Trace *trace) {
+    size_t n = SIM_DAYS * 86400 / 60 + 1;  // One true point per minute
+    trace->time_s = malloc(n * sizeof(double));
+    trace->percent = malloc(n * sizeof(double));
+    double moisture = WATERED_PERCENT;
+    double water_at = -1.0;
+    for (size_t i = 0; i < n; i++) {
+        double t = (double)i * 60.0;
+        // Drying rate follows a daily temperature cycle (faster at midday)
+        double rate = 1.0 / (36.0 * 3600.0) * (1.0 + 0.6 * sin(2.0 * M_PI * t / 86400.0));
+        moisture += (15.0 - moisture) * rate * 60.0;
+        if (moisture <= THRESHOLD_LOW && water_at < 0.0) {
+            water_at = t + WATERING_DELAY_S;
+        }
+        if (water_at >= 0.0 && t >= water_at) {
+            moisture = WATERED_PERCENT;
+            water_at = -1.0;
+        }
+        trace->time_s[i] = t;
+        trace->percent[i] = moisture;
+    }
+    trace->count = n;
+}
+
+static int load_trace(const char *path, Trace *trace) {
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+    trace->time_s = malloc(MAX_POINTS * sizeof(double));
+    trace->percent = malloc(MAX_POINTS * sizeof(double));
+    trace->count = 0;
+    double t, p;
+    while (trace->count < MAX_POINTS && fscanf(file, "%lf,%lf", &t, &p) == 2) {
+        trace->time_s[trace->count] = t;
+        trace->percent[trace->count] = p;
+        trace->count++;
+    }
+    fclose(file);
+    return trace->count >= 2;
+}
+
+// Deterministic noise so both policies see the same readings at the same times
+static int noisy_reading(double percent, double t) {
+    unsigned long h = (unsigned long)(t * 7919.0) * 2654435761UL;
+    int noise = (int)((h >> 16) % 3) - 1;
+    int reading = (int)lround(percent) + noise;
+    return reading < 0 ? 0 : (reading > 100 ? 100 : reading);
+}
+
+static MoistureLut lut;
+
+// Raw ADC value of a moisture percentage under the two-point calibration
+static double percent_to_raw(double percent) {
+    return DRY_RAW + (WET_RAW - DRY_RAW) * percent / 100.0;
+}
+
+// One conversion with +/-SAMPLE_NOISE_RAW of noise
+static long noisy_raw(double percent, double t, int sample) {
+    unsigned long h = ((unsigned long)(t * 7919.0) + (unsigned long)sample * 104729UL) * 2654435761UL;
+    int noise = (int)((h >> 13) % (2 * SAMPLE_NOISE_RAW + 1)) - SAMPLE_NOISE_RAW;
+    return lround(percent_to_raw(percent)) + noise;
+}
+
+// One free-running result: HW_AVERAGE conversions averaged in hardware
+static uint16_t averaged_raw(double percent, double t) {
+    long sum = 0;
+    for (int i = 0; i < HW_AVERAGE; i++) {
+        sum += noisy_raw(percent, t, i);
+    }
+    return (uint16_t)((sum + HW_AVERAGE / 2) / HW_AVERAGE);
+}
+
+static Result run(const Trace *trace, Policy policy) {
+    Result result = {0};
+    AdaptiveSampler sampler;
+    adaptive_sampling_init(&sampler, NULL);
+    AdcWindow window;
+    int window_armed = 0;
+    int window_margin = 0;       // Extra distance from the thresholds needed to arm
+    double window_since = 0.0;
+
+    double end = trace->time_s[trace->count - 1];
+    double next_sample = 0.0;
+    double crossing = -1.0;     // Time of the pending true crossing
+    double previous = trace_at(trace, 0.0);
+    int watered = 0;            // The pump ran since the last reading
+
+    for (double t = 0.0; t <= end; t += SIM_STEP_S) {
+        double truth = trace_at(trace, t);
+        if (previous > THRESHOLD_LOW && truth <= THRESHOLD_LOW) {
+            crossing = t;
+        }
+        if (truth > previous + WATERING_STEP) {
+            watered = 1;
+        }
+        previous = truth;
+
+        int reading;
+        if (window_armed) {
+            // The ADC compares on its own; the CPU sleeps unless it leaves the band.
+            // The result that tripped the window is the measurement
+            uint16_t raw = averaged_raw(truth, t);
+            if (adc_window_outside(&window, raw)) {
+                result.window_wakeups++;
+                reading = moisture_lut_convert(&lut, raw);
+            } else if (t - window_since >= WINDOW_REFRESH_S) {
+                reading = moisture_lut_convert(&lut, (uint16_t)noisy_raw(truth, t, 0));
+            } else {
+                continue;
+            }
+            window_armed = 0;
+        } else if (t >= next_sample) {
+            // The firmware converts every reading through the calibration table
+            reading = (policy == POLICY_WINDOW)
+                ? moisture_lut_convert(&lut, (uint16_t)noisy_raw(truth, t, 0))
+                : noisy_reading(truth, t);
+        } else {
+            continue;
+        }
+        result.wakeups++;
+        if (crossing >= 0.0 && reading <= THRESHOLD_LOW) {
+            double delay = t - crossing;
+            result.crossings++;
+            result.delay_total_s += delay;
+            if (delay > result.delay_max_s) result.delay_max_s = delay;
+            crossing = -1.0;
+        }
+
+        uint32_t interval_ms = FIXED_INTERVAL_MS;
+        if (policy != POLICY_FIXED) {
+            if (watered) {
+                adaptive_sampling_reset(&sampler);
+            }
+            interval_ms = adaptive_sampling_update(&sampler, (uint32_t)(t * 1000.0),
+                                                   (uint8_t)reading, THRESHOLD_LOW, THRESHOLD_HIGH);
+        }
+        next_sample = t + interval_ms / 1000.0;
+        watered = 0;
+
+        if (policy == POLICY_WINDOW) {
+            uint16_t raw = (uint16_t)lround(percent_to_raw(reading));
+            window_armed = reading >= THRESHOLD_LOW + window_margin &&
+                           reading <= THRESHOLD_HIGH - window_margin &&
+                           adc_window_around(&lut, raw, 0, THRESHOLD_LOW, THRESHOLD_HIGH, &window);
+            window_margin = (reading <= THRESHOLD_LOW || reading >= THRESHOLD_HIGH)
+                ? WINDOW_HYSTERESIS : (window_armed ? 0 : window_margin);
+            window_since = t;
+        }
+    }
+    return result;
+}
+
+static void report(const char *name, const Result *r, double hours) {
+    printf("%-9s %10lu wakeups (%6.1f/h)  %4lu crossings  delay avg %6.1f s  max %6.1f s\n",
+           name, r->wakeups, r->wakeups / hours, r->crossings,
+           r->crossings ? r->delay_total_s / r->crossings : 0.0, r->delay_max_s);
+}
+
+int main(int argc, char **argv) {
+    Trace trace;
+    if (argc > 1) {
+        if (!load_trace(argv[1], &trace)) {
+            fprintf(stderr, "cannot read trace %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        simulate_trace(&trace);
+    }
+
+    MoistureCurve curve;
+    moisture_curve_two_point(&curve, DRY_RAW, WET_RAW);
+    moisture_curve_compile(&curve, &lut);
+
+    Result fixed = run(&trace, POLICY_FIXED);
+    Result adaptive = run(&trace, POLICY_ADAPTIVE);
+    Result window = run(&trace, POLICY_WINDOW);
+    double hours = trace.time_s[trace.count - 1] / 3600.0;
+    printf("trace: %.1f days, thresholds %d..%d %%\n", hours / 24.0, THRESHOLD_LOW, THRESHOLD_HIGH);
+    report("fixed", &fixed, hours);
+    report("adaptive", &adaptive, hours);
+    report("window", &window, hours);
+    printf("wakeup reduction vs fixed: adaptive %.1f %%, window %.1f %% "
+           "(%lu window wakes, rest refresh and out-of-band sampling)\n",
+           100.0 * (1.0 - (double)adaptive.wakeups / (double)fixed.wakeups),
+           100.0 * (1.0 - (double)window.wakeups / (double)fixed.wakeups),
+           window.window_wakeups);
+    return 0;
+}
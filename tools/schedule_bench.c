@@ -0,0 +1,180 @@
+/*
+ * Host benchmark of the watering schedule's next-event lookup
+ * (Irrigation_System.X/watering_schedule.c).
+ *
+ *     cc -O2 -DSCHEDULE_MAX_ENTRIES=500 -I Irrigation_System.X \
+ *        -o schedule_bench tools/schedule_bench.c \
+ *        Irrigation_System.X/watering_schedule.c
+ *     ./schedule_bench [entries] [seed]
+ *
+ * Builds a table of random entries (time of day, weekday mask, 1 in 10
+ * disabled) and compares the heap with the obvious alternative, a linear
+ * scan that computes every entry's next occurrence and keeps the earliest:
+ *  - next-event lookup: heap root vs full scan;
+ *  - firing an event and rescheduling its entry: heap sift vs rescan;
+ *  - building the index after the clock is set.
+ *
+ * Then it checks the heap against the scan over four simulated weeks:
+ * both must fire the same entries at the same times in the same order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "watering_schedule.h"
+
+#define DEFAULT_ENTRIES  500
+#define START_TIME_S     1760000000UL   // October 2025
+#define CHECK_SECONDS    (28UL * 86400UL)
+
+static WateringSchedule schedule;
+static uint32_t scan_next[SCHEDULE_MAX_ENTRIES];
+static volatile uint32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Baseline: earliest next occurrence over all entries, ties to the lower index
+static uint32_t scan_lookup(const WateringSchedule *table, uint32_t now_s, uint16_t *index) {
+    uint32_t best = SCHEDULE_NEVER;
+    for (uint16_t i = 0; i < table->count; i++) {
+        uint32_t fire = schedule_entry_next_fire(&table->entries[i], now_s);
+        if (fire < best) {
+            best = fire;
+            *index = i;
+        }
+    }
+    return best;
+}
+
+// Baseline with cached occurrences: scan an array instead of recomputing
+static uint32_t cached_lookup(uint16_t count, uint16_t *index) {
+    uint32_t best = SCHEDULE_NEVER;
+    for (uint16_t i = 0; i < count; i++) {
+        if (scan_next[i] < best) {
+            best = scan_next[i];
+            *index = i;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    unsigned entries = (argc > 1) ? (unsigned)atoi(argv[1]) : DEFAULT_ENTRIES;
+    rng_state = (argc > 2) ? (uint32_t)atoi(argv[2]) : 1U;
+    if (entries == 0 || entries > SCHEDULE_MAX_ENTRIES) {
+        fprintf(stderr, "entries must be 1..%u (build with -DSCHEDULE_MAX_ENTRIES=N)\n",
+                SCHEDULE_MAX_ENTRIES);
+        return 1;
+    }
+
+    schedule_init(&schedule);
+    for (unsigned i = 0; i < entries; i++) {
+        ScheduleEntry entry = {
+            .zone = (uint8_t)(rng() % 8U),
+            .weekdays = (rng() % 10U == 0) ? 0 : (uint8_t)((rng() % 0x7FU) + 1U),
+            .minute_of_day = (uint16_t)(rng() % SCHEDULE_MINUTES_PER_DAY),
+            .volume_ml = (uint16_t)(50U + rng() % 500U),
+        };
+        if (!schedule_add(&schedule, &entry, START_TIME_S)) {
+            fprintf(stderr, "schedule_add failed at %u\n", i);
+            return 1;
+        }
+    }
+    printf("%u entries, %u enabled\n", schedule.count, schedule.heap_size);
+
+    // Next-event lookup
+    const int lookups = 200000;
+    uint16_t index = 0;
+    double start = now_ns();
+    for (int i = 0; i < lookups; i++) {
+        sink += schedule_next_fire(&schedule);
+        __asm__ volatile("" ::: "memory");
+    }
+    double heap_lookup_ns = (now_ns() - start) / lookups;
+
+    const int scans = 2000;
+    start = now_ns();
+    for (int i = 0; i < scans; i++) {
+        sink += scan_lookup(&schedule, START_TIME_S + (uint32_t)i, &index);
+    }
+    double scan_ns = (now_ns() - start) / scans;
+
+    for (uint16_t i = 0; i < schedule.count; i++) {
+        scan_next[i] = schedule_entry_next_fire(&schedule.entries[i], START_TIME_S);
+    }
+    start = now_ns();
+    for (int i = 0; i < lookups / 10; i++) {
+        sink += cached_lookup(schedule.count, &index);
+        __asm__ volatile("" ::: "memory");
+    }
+    double cached_ns = (now_ns() - start) / (lookups / 10);
+
+    // Building the index (after setting the clock)
+    const int rebuilds = 2000;
+    start = now_ns();
+    for (int i = 0; i < rebuilds; i++) {
+        schedule_rebuild(&schedule, START_TIME_S + (uint32_t)i * 60U);
+    }
+    double rebuild_ns = (now_ns() - start) / rebuilds;
+
+    // Fire and reschedule, walking through a week of events
+    schedule_rebuild(&schedule, START_TIME_S);
+    ScheduleEntry due;
+    uint32_t fired = 0;
+    start = now_ns();
+    for (int round = 0; round < 20; round++) {
+        schedule_rebuild(&schedule, START_TIME_S);
+        uint32_t fire;
+        while ((fire = schedule_next_fire(&schedule)) < START_TIME_S + 7UL * 86400UL) {
+            schedule_pop_due(&schedule, fire, &due);
+            fired++;
+        }
+    }
+    double pop_ns = (now_ns() - start - 20 * rebuild_ns) / fired;
+
+    printf("next-event lookup: heap %.1f ns, scan %.0f ns, cached scan %.0f ns\n",
+           heap_lookup_ns, scan_ns, cached_ns);
+    printf("fire + reschedule: heap %.0f ns (rescan: %.0f ns)\n", pop_ns, scan_ns);
+    printf("index build:       %.0f ns\n", rebuild_ns);
+
+    // Cross-check against the scan with cached occurrences
+    schedule_rebuild(&schedule, START_TIME_S);
+    for (uint16_t i = 0; i < schedule.count; i++) {
+        scan_next[i] = schedule_entry_next_fire(&schedule.entries[i], START_TIME_S);
+    }
+    uint32_t checked = 0;
+    for (;;) {
+        uint32_t heap_fire = schedule_next_fire(&schedule);
+        uint32_t scan_fire = cached_lookup(schedule.count, &index);
+        if (heap_fire != scan_fire) {
+            printf("MISMATCH: heap %u, scan %u\n", (unsigned)heap_fire, (unsigned)scan_fire);
+            return 1;
+        }
+        if (heap_fire >= START_TIME_S + CHECK_SECONDS) {
+            break;
+        }
+        schedule_pop_due(&schedule, heap_fire, &due);
+        if (memcmp(&due, &schedule.entries[index], sizeof(due)) != 0) {
+            printf("MISMATCH: different entry at %u\n", (unsigned)heap_fire);
+            return 1;
+        }
+        scan_next[index] = schedule_entry_next_fire(&schedule.entries[index], heap_fire);
+        checked++;
+    }
+    printf("cross-check: %u events over %lu days match the scan\n",
+           (unsigned)checked, CHECK_SECONDS / 86400UL);
+    return 0;
+}
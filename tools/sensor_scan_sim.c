@@ -0,0 +1,109 @@
+/*
+ * Host simulation of the power-gated sensor scan.
+ *
+ * Runs Irrigation_System.X/sensor_scan.c against simulated GPIOs and ADC
+ * and reports, per zone count, the scan time, how long each sensor is
+ * powered and the resulting duty cycle and average sensor current.
+ *
+ *     cc -O2 -I Irrigation_System.X -o sensor_scan_sim \
+ *        tools/sensor_scan_sim.c Irrigation_System.X/sensor_scan.c
+ *     ./sensor_scan_sim [sample_interval_s]
+ *
+ * "serial" is the naive gating (power, settle, convert, power off, one
+ * zone at a time), "pipelined" is the scan as configured in sensor_scan.h.
+ * The simulation also checks that every zone was powered for at least the
+ * settle time before its conversion started and that no more than
+ * SENSOR_SCAN_MAX_POWERED supplies were on at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sensor_scan.h"
+
+#define CONVERSION_MS      1U     // Conversion plus result averaging
+#define SENSOR_CURRENT_MA  5.0    // TL555 board supply current when powered
+#define DEFAULT_INTERVAL_S 30.0
+
+static uint32_t sim_now_ms;
+static bool powered[SENSOR_SCAN_MAX_ZONES];
+static uint32_t powered_since[SENSOR_SCAN_MAX_ZONES];
+static int powered_count, powered_peak;
+static int converting_zone = -1;
+static uint32_t conversion_end_ms;
+static int violations;
+
+static void sim_power(uint8_t zone, bool on) {
+    if (on && !powered[zone]) {
+        powered_since[zone] = sim_now_ms;
+        powered_count++;
+        if (powered_count > powered_peak) powered_peak = powered_count;
+    } else if (!on && powered[zone]) {
+        powered_count--;
+    }
+    powered[zone] = on;
+}
+
+static void sim_start_conversion(uint8_t zone) {
+    if (!powered[zone] || sim_now_ms - powered_since[zone] < SENSOR_SCAN_SETTLE_MS) {
+        violations++;
+    }
+    converting_zone = zone;
+    conversion_end_ms = sim_now_ms + CONVERSION_MS;
+}
+
+static bool sim_conversion_done(void) {
+    return converting_zone >= 0 && sim_now_ms >= conversion_end_ms;
+}
+
+static uint16_t sim_result(void) {
+    uint16_t value = (uint16_t)(2000 + converting_zone);
+    converting_zone = -1;
+    return value;
+}
+
+static const SensorScanHardware sim_hardware = {
+    sim_power, sim_start_conversion, sim_conversion_done, sim_result
+};
+
+static void run_scan(uint8_t zones, uint8_t max_powered, uint32_t *scan_ms, double *on_ms_per_zone) {
+    SensorScan scan;
+    sensor_scan_init(&scan, &sim_hardware, zones);
+    scan.max_powered = max_powered;
+    powered_peak = 0;
+
+    sim_now_ms = 1000;
+    sensor_scan_start(&scan, sim_now_ms);
+    while (!sensor_scan_run(&scan, sim_now_ms)) {
+        sim_now_ms++;  // Main loop polls once per millisecond tick
+    }
+    for (uint8_t zone = 0; zone < zones; zone++) {
+        if (sensor_scan_result(&scan, zone) != 2000 + zone) violations++;
+    }
+    if (powered_peak > max_powered || powered_count != 0) violations++;
+    *scan_ms = scan.last_scan_ms;
+    *on_ms_per_zone = (double)scan.powered_ms_total / zones;
+}
+
+int main(int argc, char **argv) {
+    double interval_s = (argc > 1) ? atof(argv[1]) : DEFAULT_INTERVAL_S;
+
+    printf("settle %u ms, conversion %u ms, max powered %d, sample every %.0f s\n",
+           SENSOR_SCAN_SETTLE_MS, CONVERSION_MS, SENSOR_SCAN_MAX_POWERED, interval_s);
+    printf("zones  serial scan  pipelined scan  on-time/zone  duty      avg current/zone\n");
+    for (uint8_t zones = 1; zones <= SENSOR_SCAN_MAX_ZONES; zones++) {
+        uint32_t serial_ms, pipelined_ms;
+        double serial_on, pipelined_on;
+        run_scan(zones, 1, &serial_ms, &serial_on);
+        run_scan(zones, SENSOR_SCAN_MAX_POWERED, &pipelined_ms, &pipelined_on);
+        double duty = pipelined_on / (interval_s * 1000.0);
+        printf("%5u  %8u ms  %11u ms  %9.1f ms  %6.3f %%  %7.1f uA (always on: %.0f uA)\n",
+               zones, serial_ms, pipelined_ms, pipelined_on, duty * 100.0,
+               duty * SENSOR_CURRENT_MA * 1000.0, SENSOR_CURRENT_MA * 1000.0);
+    }
+    if (violations) {
+        printf("FAILED: %d settle, result or power-limit violations\n", violations);
+        return 1;
+    }
+    printf("all scans settled before converting and respected the power limit\n");
+    return 0;
+}
@@ -0,0 +1,420 @@
+// Telemetry ingest daemon: reads the firmware's UART output from many
+// serial ports or pseudo-terminals and appends the moisture, pump and
+// energy records to per-device columnar files (see telemetry_store.h).
+//
+// Build:
+//     c++ -O2 -std=c++17 -o ingestd tools/telemetry/ingestd.cpp
+//
+// Usage:
+//     ingestd [-o <root>] [-b <baud>] [name=]<tty> ...
+//
+// Each device is named after its tty (basename) unless name= is given.
+// All ports are served by one thread through epoll. A port that hangs up
+// is reopened every second, so boards can be unplugged and replugged.
+// SIGINT/SIGTERM stop the daemon after the pending input has been parsed;
+// SIGUSR1 prints per-device counters to stderr.
+//
+// Parsed lines (everything else is counted and skipped):
+//     Moisture: 42% (Raw: 2048)[ Temp: 21.5000 C]
+//     DEBUG: Tracked interval: 1.234 s @ 50.0% (2.500 mL/s). Added: 3.085 mL. New Total: 10.000 mL
+//     Energy: 60000 ms, CPU 1210 ms, ADC 4 ms, LCD 41 ms, UART 152 ms, Pump 0 ms, 36.130 uAh
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "telemetry_store.h"
+
+namespace {
+
+constexpr size_t kLineMax = 256;       // Longer lines are discarded
+constexpr size_t kReadChunk = 16384;
+constexpr int kReopenIntervalMs = 1000;
+
+volatile sig_atomic_t stop_requested = 0;
+volatile sig_atomic_t stats_requested = 0;
+
+int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// --- Line parsing ---
+
+// Cursor over one line; every parse step fails softly
+struct Cursor {
+    const char *p;
+    const char *end;
+
+    bool literal(const char *text) {
+        size_t n = std::strlen(text);
+        if (static_cast<size_t>(end - p) < n || std::memcmp(p, text, n) != 0) return false;
+        p += n;
+        return true;
+    }
+
+    bool integer(int64_t &value) {
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        if (negative) value = -value;
+        return true;
+    }
+
+    // Decimal number scaled by 10^decimals, e.g. "1.5" with 3 -> 1500
+    bool fixed(int decimals, int64_t &value) {
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+        int64_t whole;
+        if (!integer(whole)) return false;
+        int64_t fraction = 0;
+        int digits = 0;
+        if (p < end && *p == '.') {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (digits < decimals) {
+                    fraction = fraction * 10 + (*p - '0');
+                    digits++;
+                }
+                p++;
+            }
+        }
+        for (; digits < decimals; digits++) fraction *= 10;
+        int64_t scale = 1;
+        for (int i = 0; i < decimals; i++) scale *= 10;
+        value = whole * scale + fraction;
+        if (negative) value = -value;
+        return true;
+    }
+};
+
+struct MoistureRecord {
+    uint8_t percent;
+    uint16_t raw;
+    int16_t temperature_x16;
+};
+
+struct PumpRecord {
+    uint32_t duration_ms;
+    uint16_t duty_permille;
+    uint32_t flow_ul_s;
+    uint32_t added_ul;
+    uint32_t total_ul;
+};
+
+struct EnergyRecord {
+    uint32_t interval_ms;
+    uint32_t active_ms[5];  // CPU, ADC, LCD, UART, Pump
+    uint32_t charge_nah;
+};
+
+bool parse_moisture(Cursor c, MoistureRecord &record) {
+    int64_t percent, raw;
+    if (!c.literal("Moisture: ") || !c.integer(percent) || !c.literal("% (Raw: ") ||
+        !c.integer(raw) || !c.literal(")")) {
+        return false;
+    }
+    record.percent = static_cast<uint8_t>(percent);
+    record.raw = static_cast<uint16_t>(raw);
+    record.temperature_x16 = telemetry::kNoTemperature;
+    int64_t temperature;
+    if (c.literal(" Temp: ") && c.fixed(4, temperature)) {
+        record.temperature_x16 = static_cast<int16_t>(temperature / 625);  // 1/10000 -> 1/16 degC
+    }
+    return true;
+}
+
+bool parse_pump(Cursor c, PumpRecord &record) {
+    int64_t duration, duty, flow, added, total;
+    if (!c.literal("DEBUG: Tracked interval: ") || !c.fixed(3, duration) ||
+        !c.literal(" s @ ") || !c.fixed(1, duty) || !c.literal("% (") ||
+        !c.fixed(3, flow) || !c.literal(" mL/s). Added: ") || !c.fixed(3, added) ||
+        !c.literal(" mL. New Total: ") || !c.fixed(3, total)) {
+        return false;
+    }
+    record.duration_ms = static_cast<uint32_t>(duration);
+    record.duty_permille = static_cast<uint16_t>(duty);
+    record.flow_ul_s = static_cast<uint32_t>(flow);  // mL/s x1000 = uL/s
+    record.added_ul = static_cast<uint32_t>(added);
+    record.total_ul = static_cast<uint32_t>(total);
+    return true;
+}
+
+bool parse_energy(Cursor c, EnergyRecord &record) {
+    static const char *const kSubsystems[] = {", CPU ", ", ADC ", ", LCD ", ", UART ", ", Pump "};
+    int64_t interval, charge;
+    if (!c.literal("Energy: ") || !c.integer(interval) || !c.literal(" ms")) return false;
+    record.interval_ms = static_cast<uint32_t>(interval);
+    for (size_t i = 0; i < 5; i++) {
+        int64_t active;
+        if (!c.literal(kSubsystems[i]) || !c.integer(active) || !c.literal(" ms")) return false;
+        record.active_ms[i] = static_cast<uint32_t>(active);
+    }
+    if (!c.literal(", ") || !c.fixed(3, charge) || !c.literal(" uAh")) return false;
+    record.charge_nah = static_cast<uint32_t>(charge);  // uAh x1000 = nAh
+    return true;
+}
+
+// --- Devices ---
+
+struct Device {
+    std::string name;
+    std::string path;
+    int fd = -1;
+    char line[kLineMax];
+    size_t line_length = 0;
+    bool overflow = false;
+    int64_t next_reopen_ns = 0;
+    telemetry::DeviceStore store;
+    uint64_t lines = 0, moisture_rows = 0, pump_rows = 0, energy_rows = 0, skipped = 0, bytes = 0;
+};
+
+speed_t baud_constant(long baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        default: return B115200;
+    }
+}
+
+bool open_port(Device &device, int epoll_fd, speed_t speed) {
+    int fd = open(device.path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return false;
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &device;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        return false;
+    }
+    device.fd = fd;
+    device.line_length = 0;
+    device.overflow = false;
+    return true;
+}
+
+void close_port(Device &device, int epoll_fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, nullptr);
+    close(device.fd);
+    device.fd = -1;
+    device.next_reopen_ns = now_ns() + kReopenIntervalMs * 1000000LL;
+}
+
+void handle_line(Device &device, const char *text, size_t length, int64_t timestamp) {
+    device.lines++;
+    Cursor cursor{text, text + length};
+    MoistureRecord moisture;
+    PumpRecord pump;
+    EnergyRecord energy;
+    if (parse_moisture(cursor, moisture)) {
+        telemetry::Table &t = device.store.moisture;
+        t.set<int64_t>(telemetry::kMoistureTime, timestamp);
+        t.set<uint8_t>(telemetry::kMoisturePercent, moisture.percent);
+        t.set<uint16_t>(telemetry::kMoistureRaw, moisture.raw);
+        t.set<int16_t>(telemetry::kMoistureTemperature, moisture.temperature_x16);
+        t.commit_row();
+        device.moisture_rows++;
+    } else if (parse_pump(cursor, pump)) {
+        telemetry::Table &t = device.store.pump;
+        t.set<int64_t>(telemetry::kPumpTime, timestamp);
+        t.set<uint32_t>(telemetry::kPumpDuration, pump.duration_ms);
+        t.set<uint16_t>(telemetry::kPumpDuty, pump.duty_permille);
+        t.set<uint32_t>(telemetry::kPumpFlow, pump.flow_ul_s);
+        t.set<uint32_t>(telemetry::kPumpAdded, pump.added_ul);
+        t.set<uint32_t>(telemetry::kPumpTotal, pump.total_ul);
+        t.commit_row();
+        device.pump_rows++;
+    } else if (parse_energy(cursor, energy)) {
+        telemetry::Table &t = device.store.energy;
+        t.set<int64_t>(telemetry::kEnergyTime, timestamp);
+        t.set<uint32_t>(telemetry::kEnergyInterval, energy.interval_ms);
+        for (size_t i = 0; i < 5; i++) {
+            t.set<uint32_t>(telemetry::kEnergyCpu + i, energy.active_ms[i]);
+        }
+        t.set<uint32_t>(telemetry::kEnergyCharge, energy.charge_nah);
+        t.commit_row();
+        device.energy_rows++;
+    } else {
+        device.skipped++;
+    }
+}
+
+// Splits input into lines; '\r' and '\n' both terminate a line
+void consume(Device &device, const char *data, size_t length, int64_t timestamp) {
+    device.bytes += length;
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == '\n' || c == '\r') {
+            if (device.line_length > 0 && !device.overflow) {
+                handle_line(device, device.line, device.line_length, timestamp);
+            } else if (device.overflow) {
+                device.skipped++;
+            }
+            device.line_length = 0;
+            device.overflow = false;
+        } else if (device.line_length < kLineMax) {
+            device.line[device.line_length++] = c;
+        } else {
+            device.overflow = true;
+        }
+    }
+}
+
+void print_stats(const std::vector<std::unique_ptr<Device>> &devices) {
+    for (const auto &device : devices) {
+        std::fprintf(stderr, "%s: %s lines=%llu moisture=%llu pump=%llu energy=%llu skipped=%llu bytes=%llu\n",
+                     device->name.c_str(), device->fd >= 0 ? "open" : "closed",
+                     static_cast<unsigned long long>(device->lines),
+                     static_cast<unsigned long long>(device->moisture_rows),
+                     static_cast<unsigned long long>(device->pump_rows),
+                     static_cast<unsigned long long>(device->energy_rows),
+                     static_cast<unsigned long long>(device->skipped),
+                     static_cast<unsigned long long>(device->bytes));
+    }
+}
+
+void on_signal(int signal_number) {
+    if (signal_number == SIGUSR1) {
+        stats_requested = 1;
+    } else {
+        stop_requested = 1;
+    }
+}
+
+void usage() {
+    std::fprintf(stderr, "usage: ingestd [-o root] [-b baud] [name=]tty ...\n");
+    std::exit(2);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string root = "telemetry";
+    long baud = 115200;
+    std::vector<std::unique_ptr<Device>> devices;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            root = argv[++i];
+        } else if (arg == "-b" && i + 1 < argc) {
+            baud = std::strtol(argv[++i], nullptr, 10);
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+        } else {
+            auto device = std::make_unique<Device>();
+            size_t equals = arg.find('=');
+            device->path = (equals == std::string::npos) ? arg : arg.substr(equals + 1);
+            if (equals != std::string::npos) {
+                device->name = arg.substr(0, equals);
+            } else {
+                size_t slash = arg.find_last_of('/');
+                device->name = (slash == std::string::npos) ? arg : arg.substr(slash + 1);
+            }
+            devices.push_back(std::move(device));
+        }
+    }
+    if (devices.empty()) usage();
+
+    struct sigaction action {};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGUSR1, &action, nullptr);
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        std::perror("epoll_create1");
+        return 1;
+    }
+    speed_t speed = baud_constant(baud);
+    try {
+        telemetry::make_directory(root);
+        for (auto &device : devices) {
+            device->store.open(root, device->name, true);
+            if (!open_port(*device, epoll_fd, speed)) {
+                std::fprintf(stderr, "%s: cannot open %s, retrying\n",
+                             device->name.c_str(), device->path.c_str());
+            }
+        }
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "ingestd: %s\n", error.what());
+        return 1;
+    }
+
+    std::vector<epoll_event> events(devices.size());
+    std::vector<char> buffer(kReadChunk);
+    while (!stop_requested) {
+        int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()),
+                               kReopenIntervalMs);
+        if (ready < 0 && errno != EINTR) {
+            std::perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            Device &device = *static_cast<Device *>(events[i].data.ptr);
+            int64_t timestamp = now_ns();
+            // One read per wakeup: a busy device cannot starve the others
+            // for longer than one chunk, level triggering brings it back
+            ssize_t n = read(device.fd, buffer.data(), buffer.size());
+            if (n > 0) {
+                consume(device, buffer.data(), static_cast<size_t>(n), timestamp);
+            } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close_port(device, epoll_fd);
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                close_port(device, epoll_fd);
+            }
+        }
+
+        int64_t now = now_ns();
+        for (auto &device : devices) {
+            if (device->fd < 0 && now >= device->next_reopen_ns) {
+                if (!open_port(*device, epoll_fd, speed)) {
+                    device->next_reopen_ns = now + kReopenIntervalMs * 1000000LL;
+                }
+            }
+        }
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats(devices);
+        }
+    }
+
+    // Parse whatever is still queued in the kernel before exiting
+    for (auto &device : devices) {
+        if (device->fd < 0) continue;
+        ssize_t n;
+        while ((n = read(device->fd, buffer.data(), buffer.size())) > 0) {
+            consume(*device, buffer.data(), static_cast<size_t>(n), now_ns());
+        }
+    }
+    print_stats(devices);
+    close(epoll_fd);
+    return 0;
+}
@@ -0,0 +1,268 @@
+// Load generator and end-to-end check for ingestd.
+//
+// Creates N pseudo-terminals, starts ingestd on their slave ends and
+// writes firmware-format moisture and pump lines into the masters at a
+// fixed aggregate rate. Afterwards it stops the daemon, reads the columnar
+// files back and reports throughput, dropped rows, ingest latency (time
+// stored by the daemon minus time the line was written) and daemon CPU.
+//
+// Build (ingestd must be built next to it):
+//     c++ -O2 -std=c++17 -o loadgen tools/telemetry/loadgen.cpp
+//
+// Usage:
+//     loadgen [-n devices] [-r lines/s total] [-t seconds] [-p pump every Nth line]
+//             [-d ingestd path] [-o output root]
+//
+// The moisture raw column carries a per-device sequence number (mod 4096),
+// which identifies the send time of each stored row.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "telemetry_store.h"
+
+namespace {
+
+int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void sleep_until(int64_t deadline_ns) {
+    timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000LL;
+    ts.tv_nsec = deadline_ns % 1000000000LL;
+    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, nullptr);
+}
+
+struct Pty {
+    int master = -1;
+    std::string slave;
+    uint64_t moisture_sent = 0;
+    uint64_t pump_sent = 0;
+    std::vector<int64_t> send_ns;  // Indexed by moisture sequence number
+};
+
+Pty open_pty() {
+    Pty pty;
+    pty.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty.master < 0 || grantpt(pty.master) != 0 || unlockpt(pty.master) != 0) {
+        throw telemetry::system_error("posix_openpt");
+    }
+    pty.slave = ptsname(pty.master);
+    termios tio;
+    tcgetattr(pty.master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty.master, TCSANOW, &tio);
+    fcntl(pty.master, F_SETFL, fcntl(pty.master, F_GETFL) | O_NONBLOCK);
+    return pty;
+}
+
+// Masters are non-blocking: if the daemon dies the pty buffers fill up
+// and the load generator has to notice instead of hanging
+bool write_all(int fd, const char *data, size_t length, pid_t daemon) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return false;
+            if (waitpid(daemon, nullptr, WNOHANG) != 0) {
+                errno = ECHILD;
+                return false;
+            }
+            pollfd ready{fd, POLLOUT, 0};
+            poll(&ready, 1, 100);
+            continue;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+double percentile(std::vector<int64_t> &values, double fraction) {
+    if (values.empty()) return 0.0;
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return static_cast<double>(values[index]) / 1000.0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int devices = 100;
+    double rate = 10000.0;
+    double seconds = 5.0;
+    int pump_every = 10;
+    std::string daemon = "./ingestd";
+    std::string root;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        const char *value = argv[i + 1];
+        if (flag == "-n") devices = std::atoi(value);
+        else if (flag == "-r") rate = std::atof(value);
+        else if (flag == "-t") seconds = std::atof(value);
+        else if (flag == "-p") pump_every = std::atoi(value);
+        else if (flag == "-d") daemon = value;
+        else if (flag == "-o") root = value;
+        else {
+            std::fprintf(stderr, "loadgen: unknown option %s\n", flag.c_str());
+            return 2;
+        }
+    }
+    if (root.empty()) {
+        char pattern[] = "/tmp/telemetry.XXXXXX";
+        if (!mkdtemp(pattern)) {
+            std::perror("mkdtemp");
+            return 1;
+        }
+        root = pattern;
+    }
+
+    std::vector<Pty> ptys;
+    try {
+        for (int i = 0; i < devices; i++) ptys.push_back(open_pty());
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "loadgen: %s\n", error.what());
+        return 1;
+    }
+
+    std::vector<std::string> arguments = {daemon, "-o", root};
+    for (int i = 0; i < devices; i++) {
+        arguments.push_back("dev" + std::to_string(i) + "=" + ptys[static_cast<size_t>(i)].slave);
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        std::vector<char *> argv_child;
+        for (auto &argument : arguments) argv_child.push_back(&argument[0]);
+        argv_child.push_back(nullptr);
+        execv(daemon.c_str(), argv_child.data());
+        std::perror("execv");
+        _exit(127);
+    }
+    // The daemon opens the devices in order, each store before its port
+    std::string last = root + "/dev" + std::to_string(devices - 1) + "/pump.meta";
+    while (access(last.c_str(), F_OK) != 0) {
+        if (waitpid(child, nullptr, WNOHANG) != 0) {
+            std::fprintf(stderr, "loadgen: %s exited during startup\n", daemon.c_str());
+            return 1;
+        }
+        usleep(1000);
+    }
+    usleep(50000);
+
+    uint64_t total_lines = static_cast<uint64_t>(rate * seconds);
+    int64_t period_ns = static_cast<int64_t>(1e9 / rate);
+    for (auto &pty : ptys) pty.send_ns.reserve(total_lines / static_cast<uint64_t>(devices) + 1);
+
+    // Round-robin over the devices; each burst of lines shares one deadline
+    // so the sender is not dominated by sleeping at high rates
+    constexpr uint64_t kBurst = 64;
+    int64_t start = now_ns();
+    char line[160];
+    for (uint64_t n = 0; n < total_lines; n++) {
+        if (n % kBurst == 0) sleep_until(start + static_cast<int64_t>(n) * period_ns);
+        Pty &pty = ptys[n % static_cast<uint64_t>(devices)];
+        int length;
+        bool pump = pump_every > 0 && (n / static_cast<uint64_t>(devices)) % static_cast<uint64_t>(pump_every) ==
+                                          static_cast<uint64_t>(pump_every) - 1;
+        if (pump) {
+            pty.pump_sent++;
+            length = std::snprintf(line, sizeof(line),
+                                   "DEBUG: Tracked interval: 1.250 s @ 60.0%% (2.500 mL/s). "
+                                   "Added: 3.125 mL. New Total: %llu.000 mL\n",
+                                   static_cast<unsigned long long>(pty.pump_sent * 3));
+        } else {
+            uint64_t sequence = pty.moisture_sent++;
+            length = std::snprintf(line, sizeof(line), "Moisture: %u%% (Raw: %u) Temp: 21.5000 C\r\n",
+                                   static_cast<unsigned>(sequence % 101),
+                                   static_cast<unsigned>(sequence % 4096));
+            pty.send_ns.push_back(now_ns());
+        }
+        if (!write_all(pty.master, line, static_cast<size_t>(length), child)) {
+            std::perror("loadgen: write");
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            return 1;
+        }
+    }
+    double send_seconds = static_cast<double>(now_ns() - start) / 1e9;
+
+    usleep(200000);  // Let the daemon drain the pty buffers
+    kill(child, SIGINT);
+    int status = 0;
+    waitpid(child, &status, 0);
+    rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    double cpu = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+                 static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+    uint64_t sent_moisture = 0, sent_pump = 0, stored_moisture = 0, stored_pump = 0;
+    uint64_t mismatched = 0;
+    std::vector<int64_t> latencies;
+    latencies.reserve(total_lines);
+    for (int i = 0; i < devices; i++) {
+        Pty &pty = ptys[static_cast<size_t>(i)];
+        telemetry::DeviceStore store;
+        try {
+            store.open(root, "dev" + std::to_string(i), false);
+        } catch (const std::exception &error) {
+            std::fprintf(stderr, "loadgen: %s\n", error.what());
+            return 1;
+        }
+        uint64_t rows = store.moisture.row_count();
+        const int64_t *time = store.moisture.column<int64_t>(telemetry::kMoistureTime);
+        const uint16_t *raw = store.moisture.column<uint16_t>(telemetry::kMoistureRaw);
+        const int16_t *temperature = store.moisture.column<int16_t>(telemetry::kMoistureTemperature);
+        for (uint64_t row = 0; row < rows && row < pty.send_ns.size(); row++) {
+            // In-order delivery: row k is the k-th line sent to this device
+            if (raw[row] != row % 4096 || temperature[row] != 344) {
+                mismatched++;
+                continue;
+            }
+            latencies.push_back(time[row] - pty.send_ns[row]);
+        }
+        sent_moisture += pty.moisture_sent;
+        sent_pump += pty.pump_sent;
+        stored_moisture += rows;
+        stored_pump += store.pump.row_count();
+        close(pty.master);
+    }
+
+    uint64_t sent = sent_moisture + sent_pump;
+    uint64_t stored = stored_moisture + stored_pump;
+    std::printf("devices %d, %.1f s, %llu lines sent (%.0f lines/s achieved)\n", devices, send_seconds,
+                static_cast<unsigned long long>(sent), static_cast<double>(sent) / send_seconds);
+    std::printf("stored moisture %llu/%llu, pump %llu/%llu, dropped %llu, mismatched %llu\n",
+                static_cast<unsigned long long>(stored_moisture),
+                static_cast<unsigned long long>(sent_moisture),
+                static_cast<unsigned long long>(stored_pump),
+                static_cast<unsigned long long>(sent_pump),
+                static_cast<unsigned long long>(sent - std::min(sent, stored)),
+                static_cast<unsigned long long>(mismatched));
+    double p50 = percentile(latencies, 0.50);
+    double p99 = percentile(latencies, 0.99);
+    double max = percentile(latencies, 1.0);
+    std::printf("latency us: p50 %.1f  p99 %.1f  max %.1f\n", p50, p99, max);
+    std::printf("daemon cpu %.2f s (%.1f %% of one core, %.2f us/line)\n", cpu,
+                100.0 * cpu / send_seconds, 1e6 * cpu / static_cast<double>(std::max<uint64_t>(stored, 1)));
+    std::printf("output in %s\n", root.c_str());
+
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && stored == sent && mismatched == 0;
+    return ok ? 0 : 1;
+}
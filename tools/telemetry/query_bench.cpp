@@ -0,0 +1,417 @@
+// Benchmark for the telemetry query engine (telemetry_query.h).
+//
+// Generates a store of moisture and pump readings in the format ingestd
+// writes, unless the output root already holds one, then runs a set of
+// agronomy queries with every instruction set the host has, with and
+// without zone maps, and reports rows per second per core. The results
+// of every run must match, or the benchmark fails.
+//
+// Build:
+//     c++ -O2 -std=c++17 -pthread -o query_bench tools/telemetry/query_bench.cpp
+//
+// Usage:
+//     query_bench [-o root] [-n rows] [-d devices] [-t threads] [-r repeats]
+//
+// The defaults make a billion moisture rows over 1000 beds: a reading
+// every 10 s, about 116 days per bed, 13 GB on disk. The beds grow
+// peppermint, tulips and basil in turn (Plants_definitions.h); each dries
+// out and is watered back to the top of its band by a logged pump run.
+// The receipt clock steps back 30 s once in about a million readings, as
+// an NTP correction of a drifting host does, so a few blocks take the
+// unordered path.
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry_query.h"
+
+namespace {
+
+struct Plant {
+    const char *name;
+    int low;
+    int ideal_high;
+};
+
+// Plants_definitions.h
+const Plant kPlants[] = {
+    {"peppermint", 40, 70},
+    {"tulip", 30, 60},
+    {"basil", 40, 75},
+};
+constexpr size_t kPlantCount = sizeof(kPlants) / sizeof(kPlants[0]);
+
+constexpr int64_t kSecondNs = 1000000000LL;
+constexpr int64_t kStartNs = 1772323200LL * kSecondNs;  // 2026-03-01 00:00 UTC
+constexpr int64_t kReadingNs = 10 * kSecondNs;
+constexpr uint64_t kClockStepEvery = 1u << 20;
+constexpr uint8_t kCrossingThreshold = 45;
+
+struct Random {
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+std::string device_name(int index) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "bed%04d", index);
+    return name;
+}
+
+double seconds_now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+void generate_device(const std::string &root, int index, uint64_t rows) {
+    telemetry::DeviceStore store;
+    store.open(root, device_name(index), true);
+    const Plant &plant = kPlants[static_cast<size_t>(index) % kPlantCount];
+    Random random(static_cast<uint64_t>(index) + 1);
+
+    int64_t time = kStartNs + static_cast<int64_t>(random.next() % static_cast<uint64_t>(kReadingNs));
+    double moisture = plant.ideal_high;
+    double drying = 0.0006 + 0.0006 * random.uniform();  // Percent per reading, 5-10 % a day
+    uint32_t total_ul = 0;
+    for (uint64_t row = 0; row < rows; row++) {
+        time += kReadingNs + static_cast<int64_t>(random.next() % 400000000ULL) - 200000000LL;
+        if (random.next() % kClockStepEvery == 0) time -= 30 * kSecondNs;
+
+        moisture -= drying * (0.5 + random.uniform());
+        if (moisture < plant.low) {
+            // Water back to the top of the band at 60 % duty
+            uint32_t duration_ms = static_cast<uint32_t>((plant.ideal_high - moisture) * 900.0);
+            uint32_t flow_ul_s = 3100;
+            uint32_t added_ul = static_cast<uint32_t>(static_cast<uint64_t>(flow_ul_s) * duration_ms / 1000U);
+            total_ul += added_ul;
+            store.pump.set<int64_t>(telemetry::kPumpTime, time);
+            store.pump.set<uint32_t>(telemetry::kPumpDuration, duration_ms);
+            store.pump.set<uint16_t>(telemetry::kPumpDuty, 600);
+            store.pump.set<uint32_t>(telemetry::kPumpFlow, flow_ul_s);
+            store.pump.set<uint32_t>(telemetry::kPumpAdded, added_ul);
+            store.pump.set<uint32_t>(telemetry::kPumpTotal, total_ul);
+            store.pump.commit_row();
+            moisture = plant.ideal_high + 2.0 * random.uniform();
+        }
+
+        double reading = moisture + 3.0 * (random.uniform() - 0.5);
+        int percent = std::max(0, std::min(100, static_cast<int>(std::lround(reading))));
+        int raw = 3400 - 18 * percent + static_cast<int>(random.next() % 17) - 8;
+        store.moisture.set<int64_t>(telemetry::kMoistureTime, time);
+        store.moisture.set<uint8_t>(telemetry::kMoisturePercent, static_cast<uint8_t>(percent));
+        store.moisture.set<uint16_t>(telemetry::kMoistureRaw, static_cast<uint16_t>(raw));
+        store.moisture.set<int16_t>(telemetry::kMoistureTemperature, telemetry::kNoTemperature);
+        store.moisture.commit_row();
+    }
+}
+
+bool store_exists(const std::string &root) {
+    struct stat st;
+    return stat((root + "/" + device_name(0) + "/moisture.meta").c_str(), &st) == 0;
+}
+
+// FNV-1a over the result values
+struct Digest {
+    uint64_t value = 0xcbf29ce484222325ULL;
+
+    void add(uint64_t word) {
+        for (int i = 0; i < 8; i++) {
+            value ^= (word >> (8 * i)) & 0xff;
+            value *= 0x100000001b3ULL;
+        }
+    }
+
+    void add(const telemetry::ValueStats &stats) {
+        add(stats.count);
+        add(stats.sum);
+        add(stats.min);
+        add(stats.max);
+    }
+};
+
+struct Query {
+    const char *name;
+    // Runs the query once; returns the digest of its result
+    uint64_t (*run)(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                    telemetry::QueryStats *stats);
+};
+
+int64_t range_end_ns;  // Newest reading in the store, plus one
+
+telemetry::TimeRange last_days(int days) {
+    telemetry::TimeRange range;
+    range.begin = range_end_ns - days * telemetry::kDayNs;
+    range.end = range_end_ns;
+    return range;
+}
+
+uint64_t digest_days(const std::vector<telemetry::DailyStats> &days) {
+    Digest digest;
+    for (const auto &day : days) {
+        digest.add(day.device);
+        digest.add(static_cast<uint64_t>(day.day));
+        digest.add(day.stats);
+    }
+    return digest.value;
+}
+
+uint64_t daily_percent(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                       telemetry::QueryStats *stats) {
+    return digest_days(engine.daily_moisture(telemetry::kMoisturePercent, telemetry::TimeRange{}, 0, options, stats));
+}
+
+uint64_t daily_raw_week(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                        telemetry::QueryStats *stats) {
+    // Central European Summer Time
+    return digest_days(engine.daily_moisture(telemetry::kMoistureRaw, last_days(7), 2 * 3600 * kSecondNs,
+                                             options, stats));
+}
+
+std::vector<std::string> plant_of_device(const telemetry::Engine &engine) {
+    std::vector<std::string> groups;
+    for (size_t device = 0; device < engine.device_count(); device++) {
+        groups.push_back(kPlants[device % kPlantCount].name);
+    }
+    return groups;
+}
+
+uint64_t water_per_plant(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                         telemetry::QueryStats *stats) {
+    Digest digest;
+    for (const auto &group : engine.water_by_group(plant_of_device(engine), telemetry::TimeRange{}, options, stats)) {
+        digest.add(group.runs);
+        digest.add(group.duration_ms);
+        digest.add(group.added_ul);
+    }
+    return digest.value;
+}
+
+uint64_t crossings(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                   const telemetry::TimeRange &range, telemetry::QueryStats *stats) {
+    Digest digest;
+    for (const auto &device : engine.threshold_crossings(kCrossingThreshold, range, options, stats)) {
+        digest.add(device.crossings.down);
+        digest.add(device.crossings.up);
+    }
+    return digest.value;
+}
+
+uint64_t crossings_all(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                       telemetry::QueryStats *stats) {
+    return crossings(engine, options, telemetry::TimeRange{}, stats);
+}
+
+uint64_t crossings_month(const telemetry::Engine &engine, const telemetry::QueryOptions &options,
+                         telemetry::QueryStats *stats) {
+    return crossings(engine, options, last_days(30), stats);
+}
+
+const Query kQueries[] = {
+    {"daily percent, all", daily_percent},
+    {"daily raw, 7 days", daily_raw_week},
+    {"water per plant", water_per_plant},
+    {"crossings 45%, all", crossings_all},
+    {"crossings 45%, 30 days", crossings_month},
+};
+
+void print_samples(const telemetry::Engine &engine, const telemetry::QueryOptions &options) {
+    auto days = engine.daily_moisture(telemetry::kMoisturePercent, last_days(3), 0, options);
+    std::printf("sample: %s daily percent, last 3 days\n", engine.device_name(0).c_str());
+    for (const auto &day : days) {
+        if (day.device != 0) break;
+        std::printf("  day %lld: min %u mean %.2f max %u (%llu readings)\n", static_cast<long long>(day.day),
+                    day.stats.min, day.stats.mean(), day.stats.max, static_cast<unsigned long long>(day.stats.count));
+    }
+    std::printf("sample: water per plant type\n");
+    for (const auto &group : engine.water_by_group(plant_of_device(engine), telemetry::TimeRange{}, options)) {
+        std::printf("  %-10s %8llu runs %10.1f h %12.1f L\n", group.group.c_str(),
+                    static_cast<unsigned long long>(group.runs), static_cast<double>(group.duration_ms) / 3.6e6,
+                    static_cast<double>(group.added_ul) / 1e6);
+    }
+    auto counts = engine.threshold_crossings(kCrossingThreshold, telemetry::TimeRange{}, options);
+    std::printf("sample: %s crossed %u%% %llu times down, %llu up\n", engine.device_name(0).c_str(),
+                kCrossingThreshold, static_cast<unsigned long long>(counts[0].crossings.down),
+                static_cast<unsigned long long>(counts[0].crossings.up));
+}
+
+// The kernels alone on one block that stays in L1, in values per second
+void print_kernel_rates(const std::vector<telemetry::Isa> &isas) {
+    constexpr size_t kValues = telemetry::kBlockRows;
+    constexpr int kRounds = 20000;
+    std::vector<uint8_t> percent(kValues);
+    std::vector<uint16_t> raw(kValues);
+    std::vector<uint32_t> added(kValues);
+    Random random(7);
+    for (size_t i = 0; i < kValues; i++) {
+        percent[i] = static_cast<uint8_t>(40 + random.next() % 11);
+        raw[i] = static_cast<uint16_t>(2500 + random.next() % 300);
+        added[i] = static_cast<uint32_t>(random.next() % 100000);
+    }
+    std::printf("\nkernels on a %zu-row block in L1, G values/s\n", kValues);
+    std::printf("%-6s %10s %10s %10s %10s\n", "isa", "stats u8", "stats u16", "sum u32", "cross u8");
+    for (auto isa : isas) {
+        const telemetry::Kernels &kernels = telemetry::kernels_for(isa);
+        double rates[4];
+        uint64_t sink = 0;
+        for (int kernel = 0; kernel < 4; kernel++) {
+            double start = seconds_now();
+            for (int round = 0; round < kRounds; round++) {
+                telemetry::ValueStats stats;
+                telemetry::Crossings crossings;
+                switch (kernel) {
+                case 0: kernels.stats_u8(percent.data(), kValues, &stats); break;
+                case 1: kernels.stats_u16(raw.data(), kValues, &stats); break;
+                case 2: stats.sum = kernels.sum_u32(added.data(), kValues); break;
+                default: kernels.crossings_u8(percent.data(), kValues, kCrossingThreshold, &crossings); break;
+                }
+                sink += stats.sum + stats.min + crossings.down;
+            }
+            rates[kernel] = static_cast<double>(kValues) * kRounds / (seconds_now() - start) / 1e9;
+        }
+        std::printf("%-6s %10.2f %10.2f %10.2f %10.2f%s\n", telemetry::isa_name(isa), rates[0], rates[1], rates[2],
+                    rates[3], sink == 1 ? " " : "");
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string root = "/tmp/telemetry_query";
+    uint64_t rows = 1000000000ULL;
+    int devices = 1000;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int repeats = 3;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        const char *value = argv[i + 1];
+        if (flag == "-o") root = value;
+        else if (flag == "-n") rows = std::strtoull(value, nullptr, 10);
+        else if (flag == "-d") devices = std::atoi(value);
+        else if (flag == "-t") threads = static_cast<unsigned>(std::atoi(value));
+        else if (flag == "-r") repeats = std::atoi(value);
+        else {
+            std::fprintf(stderr, "query_bench: unknown option %s\n", flag.c_str());
+            return 2;
+        }
+    }
+    if (devices < 1 || threads < 1 || repeats < 1) {
+        std::fprintf(stderr, "query_bench: -d, -t and -r must be positive\n");
+        return 2;
+    }
+
+    try {
+        if (!store_exists(root)) {
+            telemetry::make_directory(root);
+            double start = seconds_now();
+            std::atomic<int> next{0};
+            std::vector<std::thread> pool;
+            auto worker = [&]() {
+                for (int index; (index = next.fetch_add(1)) < devices;) {
+                    generate_device(root, index, rows / static_cast<uint64_t>(devices));
+                }
+            };
+            for (unsigned i = 1; i < threads; i++) pool.emplace_back(worker);
+            worker();
+            for (auto &thread : pool) thread.join();
+            double seconds = seconds_now() - start;
+            std::printf("generated %llu rows over %d devices in %s: %.1f s (%.1f M rows/s)\n",
+                        static_cast<unsigned long long>(rows / static_cast<uint64_t>(devices) * devices), devices,
+                        root.c_str(), seconds, static_cast<double>(rows) / seconds / 1e6);
+        } else {
+            std::printf("using the store in %s\n", root.c_str());
+        }
+
+        telemetry::Engine engine;
+        telemetry::OpenStats opened = engine.open(root, threads);
+        std::printf("opened %zu devices, %llu moisture rows, %llu pump rows in %.2f s (%llu zone map blocks built)\n",
+                    opened.devices, static_cast<unsigned long long>(opened.moisture_rows),
+                    static_cast<unsigned long long>(opened.pump_rows), opened.seconds,
+                    static_cast<unsigned long long>(opened.blocks_described));
+        if (opened.devices == 0) return 1;
+
+        // The newest reading, for the ranges that end "now"
+        telemetry::DeviceStore newest;
+        for (size_t device = 0; device < engine.device_count(); device++) {
+            newest.open(root, engine.device_name(device), false);
+            uint64_t count = newest.moisture.row_count();
+            if (count > 0) {
+                range_end_ns = std::max(range_end_ns,
+                                        newest.moisture.column<int64_t>(telemetry::kMoistureTime)[count - 1] + 1);
+            }
+        }
+
+        telemetry::QueryOptions options;
+        options.threads = threads;
+        print_samples(engine, options);
+
+        std::vector<telemetry::Isa> isas;
+        for (auto isa : {telemetry::Isa::kScalar, telemetry::Isa::kSse2, telemetry::Isa::kAvx2}) {
+            if (telemetry::isa_supported(isa)) isas.push_back(isa);
+        }
+
+        print_kernel_rates(isas);
+
+        bool consistent = true;
+        std::printf("\n%u threads, best of %d\n", threads, repeats);
+        std::printf("%-24s %-6s %-5s %14s %9s %9s %9s %14s %8s\n", "query", "isa", "zmap", "rows", "read %",
+                    "skipped", "summed", "M rows/s/core", "ms");
+        for (const auto &query : kQueries) {
+            uint64_t reference = 0;
+            bool first = true;
+            for (bool zone_maps : {false, true}) {
+                for (auto isa : isas) {
+                    options.isa = isa;
+                    options.zone_maps = zone_maps;
+                    telemetry::QueryStats best;
+                    for (int repeat = 0; repeat < repeats; repeat++) {
+                        telemetry::QueryStats stats;
+                        uint64_t digest = query.run(engine, options, &stats);
+                        if (first) {
+                            reference = digest;
+                            first = false;
+                        } else if (digest != reference) {
+                            consistent = false;
+                        }
+                        if (repeat == 0 || stats.seconds < best.seconds) best = stats;
+                    }
+                    double rate = static_cast<double>(best.rows) / best.seconds / threads / 1e6;
+                    std::printf("%-24s %-6s %-5s %14llu %9.2f %9llu %9llu %14.1f %8.1f\n", query.name,
+                                telemetry::isa_name(isa), zone_maps ? "on" : "off",
+                                static_cast<unsigned long long>(best.rows),
+                                best.rows ? 100.0 * static_cast<double>(best.rows_scanned) / static_cast<double>(best.rows) : 0.0,
+                                static_cast<unsigned long long>(best.blocks_skipped),
+                                static_cast<unsigned long long>(best.blocks_summed), rate, best.seconds * 1e3);
+                }
+            }
+        }
+        if (!consistent) {
+            std::printf("RESULTS DIFFER between runs\n");
+            return 1;
+        }
+        std::printf("results identical across instruction sets and zone map settings\n");
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "query_bench: %s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
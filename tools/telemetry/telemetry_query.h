@@ -0,0 +1,957 @@
+// Aggregation queries over the columnar telemetry store (telemetry_store.h):
+// per-device daily moisture statistics, water per group of devices (plant
+// type) and threshold crossings, over any time range.
+//
+// A query splits every device's table into partitions of kPartitionRows
+// rows, which a pool of threads scans. A partition is worked through in
+// blocks of kBlockRows rows:
+//  - A zone map per column, kept next to it as <table>.<column>.zmap,
+//    holds the min, max and sum of every full block and whether the
+//    block's timestamps are in order. Blocks outside the time range are
+//    skipped without touching their values, as are blocks that lie on one
+//    side of a crossing threshold. A block inside the range is taken whole
+//    without reading its time column, and answered from its sums when it
+//    falls into one day or only totals are asked for.
+//  - Rows are appended in receipt order, so in an ordered block the rows
+//    of a range or a day form one run, found by binary search on the time
+//    column. The values of the run go through SSE2 or AVX2 kernels. A
+//    block whose clock stepped back is filtered row by row.
+// Zone maps are extended for blocks appended since the last open and
+// written back; on a store the user cannot write they stay in memory.
+// Rows appended after Engine::open() are not seen.
+//
+// Partial results are merged in partition order, so results do not
+// depend on the thread count, the instruction set or the zone maps.
+//
+// Header-only, like telemetry_store.h. query_bench.cpp generates a
+// dataset and measures the scan rate.
+
+#ifndef TELEMETRY_QUERY_H
+#define TELEMETRY_QUERY_H
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TELEMETRY_QUERY_X86 1
+#define TELEMETRY_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define TELEMETRY_QUERY_X86 0
+#endif
+
+#include "telemetry_store.h"
+
+namespace telemetry {
+
+constexpr uint32_t kZoneMapMagic = 0x5a4d4150;  // "ZMAP"
+constexpr uint32_t kZoneMapVersion = 1;
+constexpr uint64_t kBlockRows = 1024;           // Rows per zone map entry
+constexpr uint64_t kPartitionRows = 64 * kBlockRows;
+constexpr int64_t kDayNs = 86400LL * 1000000000LL;
+
+// Half-open range of time_ns values
+struct TimeRange {
+    int64_t begin = INT64_MIN;
+    int64_t end = INT64_MAX;
+
+    bool contains(int64_t time) const { return time >= begin && time < end; }
+};
+
+struct ValueStats {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+    void add(const ValueStats &other) {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    void add(uint32_t value) {
+        count++;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+};
+
+struct Crossings {
+    uint64_t down = 0;  // From at or above the threshold to below it
+    uint64_t up = 0;
+
+    void add(const Crossings &other) {
+        down += other.down;
+        up += other.up;
+    }
+};
+
+// --- Kernels ---
+
+enum class Isa { kScalar, kSse2, kAvx2 };
+
+inline const char *isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::kScalar: return "scalar";
+    case Isa::kSse2: return "sse2";
+    case Isa::kAvx2: return "avx2";
+    }
+    return "?";
+}
+
+inline bool isa_supported(Isa isa) {
+#if TELEMETRY_QUERY_X86
+    if (isa == Isa::kAvx2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    if (isa == Isa::kSse2) return __builtin_cpu_supports("sse2");
+#endif
+    return isa == Isa::kScalar;
+}
+
+inline Isa best_isa() {
+    if (isa_supported(Isa::kAvx2)) return Isa::kAvx2;
+    if (isa_supported(Isa::kSse2)) return Isa::kSse2;
+    return Isa::kScalar;
+}
+
+struct Kernels {
+    void (*stats_u8)(const uint8_t *values, size_t count, ValueStats *stats);
+    void (*stats_u16)(const uint16_t *values, size_t count, ValueStats *stats);
+    uint64_t (*sum_u32)(const uint32_t *values, size_t count);
+    // Transitions between neighbours in values[0..count)
+    void (*crossings_u8)(const uint8_t *values, size_t count, uint8_t threshold, Crossings *crossings);
+};
+
+namespace kernels {
+
+template <typename T>
+void stats_scalar(const T *values, size_t count, ValueStats *stats) {
+    uint32_t low = stats->min;
+    uint32_t high = stats->max;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = values[i];
+        low = std::min(low, value);
+        high = std::max(high, value);
+        sum += value;
+    }
+    stats->min = low;
+    stats->max = high;
+    stats->sum += sum;
+    stats->count += count;
+}
+
+inline uint64_t sum_u32_scalar(const uint32_t *values, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) sum += values[i];
+    return sum;
+}
+
+inline void crossings_u8_scalar(const uint8_t *values, size_t count, uint8_t threshold,
+                                Crossings *crossings) {
+    if (count == 0) return;
+    bool before = values[0] < threshold;
+    for (size_t i = 1; i < count; i++) {
+        bool below = values[i] < threshold;
+        crossings->down += below && !before;
+        crossings->up += !below && before;
+        before = below;
+    }
+}
+
+// Folds vector lanes into stats; `vectors` values went through them
+template <typename T>
+void fold_lanes(const T *lows, const T *highs, size_t lanes, uint64_t sum, size_t vectors, ValueStats *stats) {
+    if (vectors == 0) return;
+    for (size_t i = 0; i < lanes; i++) {
+        stats->min = std::min<uint32_t>(stats->min, lows[i]);
+        stats->max = std::max<uint32_t>(stats->max, highs[i]);
+    }
+    stats->sum += sum;
+    stats->count += vectors;
+}
+
+#if TELEMETRY_QUERY_X86
+
+// 16-bit sums are widened to 32-bit lanes, which are emptied into 64-bit
+// ones before they can overflow
+constexpr size_t kWideFlush = 16384;
+
+inline void stats_u8_sse2(const uint8_t *values, size_t count, ValueStats *stats) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_set1_epi8(-1);
+    __m128i high = zero;
+    __m128i sum = zero;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        low = _mm_min_epu8(low, x);
+        high = _mm_max_epu8(high, x);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(x, zero));
+    }
+    alignas(16) uint8_t lows[16], highs[16];
+    alignas(16) uint64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lows), low);
+    _mm_store_si128(reinterpret_cast<__m128i *>(highs), high);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums), sum);
+    fold_lanes(lows, highs, 16, sums[0] + sums[1], i, stats);
+    stats_scalar(values + i, count - i, stats);
+}
+
+TELEMETRY_AVX2 inline void stats_u8_avx2(const uint8_t *values, size_t count, ValueStats *stats) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = _mm256_set1_epi8(-1);
+    __m256i high = zero;
+    __m256i sum = zero;
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        low = _mm256_min_epu8(low, x);
+        high = _mm256_max_epu8(high, x);
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, zero));
+    }
+    alignas(32) uint8_t lows[32], highs[32];
+    alignas(32) uint64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lows), low);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(highs), high);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+    fold_lanes(lows, highs, 32, sums[0] + sums[1] + sums[2] + sums[3], i, stats);
+    stats_scalar(values + i, count - i, stats);
+}
+
+inline void stats_u16_sse2(const uint16_t *values, size_t count, ValueStats *stats) {
+    // SSE2 only compares signed 16-bit lanes; flipping the top bit keeps
+    // the order of unsigned values
+    const __m128i bias = _mm_set1_epi16(INT16_MIN);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_set1_epi16(INT16_MAX);
+    __m128i high = bias;
+    __m128i wide = zero;
+    __m128i sum = zero;
+    size_t i = 0;
+    size_t flush = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        __m128i biased = _mm_xor_si128(x, bias);
+        low = _mm_min_epi16(low, biased);
+        high = _mm_max_epi16(high, biased);
+        wide = _mm_add_epi32(wide, _mm_add_epi32(_mm_unpacklo_epi16(x, zero), _mm_unpackhi_epi16(x, zero)));
+        if (++flush == kWideFlush) {
+            sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(wide, zero), _mm_unpackhi_epi32(wide, zero)));
+            wide = zero;
+            flush = 0;
+        }
+    }
+    sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(wide, zero), _mm_unpackhi_epi32(wide, zero)));
+    alignas(16) uint16_t lows[8], highs[8];
+    alignas(16) uint64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lows), _mm_xor_si128(low, bias));
+    _mm_store_si128(reinterpret_cast<__m128i *>(highs), _mm_xor_si128(high, bias));
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums), sum);
+    fold_lanes(lows, highs, 8, sums[0] + sums[1], i, stats);
+    stats_scalar(values + i, count - i, stats);
+}
+
+TELEMETRY_AVX2 inline void stats_u16_avx2(const uint16_t *values, size_t count, ValueStats *stats) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = _mm256_set1_epi16(-1);
+    __m256i high = zero;
+    __m256i wide = zero;
+    __m256i sum = zero;
+    size_t i = 0;
+    size_t flush = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        low = _mm256_min_epu16(low, x);
+        high = _mm256_max_epu16(high, x);
+        wide = _mm256_add_epi32(wide, _mm256_add_epi32(_mm256_unpacklo_epi16(x, zero),
+                                                       _mm256_unpackhi_epi16(x, zero)));
+        if (++flush == kWideFlush) {
+            sum = _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(wide, zero),
+                                                         _mm256_unpackhi_epi32(wide, zero)));
+            wide = zero;
+            flush = 0;
+        }
+    }
+    sum = _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(wide, zero),
+                                                 _mm256_unpackhi_epi32(wide, zero)));
+    alignas(32) uint16_t lows[16], highs[16];
+    alignas(32) uint64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lows), low);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(highs), high);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+    fold_lanes(lows, highs, 16, sums[0] + sums[1] + sums[2] + sums[3], i, stats);
+    stats_scalar(values + i, count - i, stats);
+}
+
+inline uint64_t sum_u32_sse2(const uint32_t *values, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(x, zero), _mm_unpackhi_epi32(x, zero)));
+    }
+    alignas(16) uint64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums), sum);
+    return sums[0] + sums[1] + sum_u32_scalar(values + i, count - i);
+}
+
+TELEMETRY_AVX2 inline uint64_t sum_u32_avx2(const uint32_t *values, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        sum = _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(x, zero),
+                                                     _mm256_unpackhi_epi32(x, zero)));
+    }
+    alignas(32) uint64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sum_u32_scalar(values + i, count - i);
+}
+
+// The comparisons give one bit per value, below the threshold or not; a
+// transition is a bit that differs from the one before it, carried across
+// vectors. There is no unsigned byte compare, so x < t is min(x, t-1) == x.
+
+// SSE2 machines need not have POPCNT
+inline uint32_t popcount16(uint32_t bits) {
+    bits = bits - ((bits >> 1) & 0x5555U);
+    bits = (bits & 0x3333U) + ((bits >> 2) & 0x3333U);
+    bits = (bits + (bits >> 4)) & 0x0f0fU;
+    return (bits + (bits >> 8)) & 0x1fU;
+}
+
+inline void crossings_u8_sse2(const uint8_t *values, size_t count, uint8_t threshold,
+                              Crossings *crossings) {
+    if (count == 0 || threshold == 0) return;  // Nothing is below 0
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold - 1));
+    uint32_t carry = values[0] < threshold;     // The first value has no predecessor
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        uint32_t below = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(x, limit), x)));
+        uint32_t before = ((below << 1) | carry) & 0xffffU;
+        crossings->down += popcount16(below & ~before & 0xffffU);
+        crossings->up += popcount16(~below & before);
+        carry = below >> 15;
+    }
+    if (i > 0 && i < count) i--;  // The scalar tail starts from the last value seen
+    crossings_u8_scalar(values + i, count - i, threshold, crossings);
+}
+
+TELEMETRY_AVX2 inline void crossings_u8_avx2(const uint8_t *values, size_t count, uint8_t threshold,
+                                             Crossings *crossings) {
+    if (count == 0 || threshold == 0) return;
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold - 1));
+    uint32_t carry = values[0] < threshold;
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        uint32_t below =
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(x, limit), x)));
+        uint32_t before = (below << 1) | carry;
+        crossings->down += static_cast<uint64_t>(_mm_popcnt_u32(below & ~before));
+        crossings->up += static_cast<uint64_t>(_mm_popcnt_u32(~below & before));
+        carry = below >> 31;
+    }
+    if (i > 0 && i < count) i--;
+    crossings_u8_scalar(values + i, count - i, threshold, crossings);
+}
+
+#endif  // TELEMETRY_QUERY_X86
+
+}  // namespace kernels
+
+inline const Kernels &kernels_for(Isa isa) {
+    static const Kernels scalar = {
+        kernels::stats_scalar<uint8_t>, kernels::stats_scalar<uint16_t>, kernels::sum_u32_scalar,
+        kernels::crossings_u8_scalar,
+    };
+#if TELEMETRY_QUERY_X86
+    static const Kernels sse2 = {
+        kernels::stats_u8_sse2, kernels::stats_u16_sse2, kernels::sum_u32_sse2, kernels::crossings_u8_sse2,
+    };
+    static const Kernels avx2 = {
+        kernels::stats_u8_avx2, kernels::stats_u16_avx2, kernels::sum_u32_avx2, kernels::crossings_u8_avx2,
+    };
+    if (isa == Isa::kAvx2 && isa_supported(isa)) return avx2;
+    if (isa == Isa::kSse2 && isa_supported(isa)) return sse2;
+#endif
+    (void)isa;
+    return scalar;
+}
+
+// --- Zone maps ---
+
+struct ZoneEntry {
+    int64_t min;
+    int64_t max;
+    uint64_t sum;    // Wraps for time columns, where it is not used
+    uint64_t flags;
+};
+static_assert(sizeof(ZoneEntry) == 32, "ZoneEntry is part of the file format");
+
+constexpr uint64_t kZoneOrdered = 1;  // No value is below the one before it
+
+struct ZoneMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_rows;
+    uint32_t value_width;
+    uint64_t blocks;
+};
+
+template <typename T>
+ZoneEntry describe_block(const T *values, size_t count) {
+    ZoneEntry entry{INT64_MAX, INT64_MIN, 0, kZoneOrdered};
+    for (size_t i = 0; i < count; i++) {
+        int64_t value = static_cast<int64_t>(values[i]);
+        entry.min = std::min(entry.min, value);
+        entry.max = std::max(entry.max, value);
+        entry.sum += static_cast<uint64_t>(value);
+        if (i > 0 && values[i] < values[i - 1]) entry.flags &= ~kZoneOrdered;
+    }
+    return entry;
+}
+
+// Entries for the full blocks of one column
+class ZoneMap {
+public:
+    // Reads <path>, describes the blocks added since and writes it back.
+    // Returns the number of blocks described.
+    template <typename T>
+    uint64_t load(const std::string &path, const T *values, uint64_t rows) {
+        uint64_t blocks = rows / kBlockRows;
+        entries_.clear();
+        read(path, sizeof(T), blocks);
+        uint64_t known = entries_.size();
+        for (uint64_t block = known; block < blocks; block++) {
+            entries_.push_back(describe_block(values + block * kBlockRows, kBlockRows));
+        }
+        if (entries_.size() > known) write(path, sizeof(T));
+        return entries_.size() - known;
+    }
+
+    uint64_t blocks() const { return entries_.size(); }
+    const ZoneEntry &operator[](uint64_t block) const { return entries_[block]; }
+
+private:
+    void read(const std::string &path, size_t width, uint64_t blocks) {
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file) return;
+        ZoneMapHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == kZoneMapMagic &&
+            header.version == kZoneMapVersion && header.block_rows == kBlockRows &&
+            header.value_width == width && header.blocks <= blocks) {
+            entries_.resize(header.blocks);
+            if (std::fread(entries_.data(), sizeof(ZoneEntry), entries_.size(), file) != entries_.size()) {
+                entries_.clear();
+            }
+        }
+        std::fclose(file);
+    }
+
+    // Best effort: a map that cannot be stored is rebuilt on the next open
+    void write(const std::string &path, size_t width) {
+        std::string temporary = path + ".tmp";
+        FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (!file) return;
+        ZoneMapHeader header{kZoneMapMagic, kZoneMapVersion, static_cast<uint32_t>(kBlockRows),
+                             static_cast<uint32_t>(width), entries_.size()};
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(entries_.data(), sizeof(ZoneEntry), entries_.size(), file) == entries_.size();
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) std::remove(temporary.c_str());
+    }
+
+    std::vector<ZoneEntry> entries_;
+};
+
+// --- Engine ---
+
+struct QueryOptions {
+    unsigned threads = 1;
+    Isa isa = best_isa();
+    bool zone_maps = true;  // false reads every block, for comparison
+};
+
+struct QueryStats {
+    uint64_t rows = 0;             // Rows of the tables the query covered
+    uint64_t rows_scanned = 0;     // Rows whose values were read
+    uint64_t blocks_skipped = 0;   // Outside the range, or no crossing possible
+    uint64_t blocks_summed = 0;    // Answered from the zone map sums
+    double seconds = 0.0;
+
+    void add(const QueryStats &other) {
+        rows += other.rows;
+        rows_scanned += other.rows_scanned;
+        blocks_skipped += other.blocks_skipped;
+        blocks_summed += other.blocks_summed;
+    }
+};
+
+struct DailyStats {
+    size_t device;
+    int64_t day;                   // Days since the epoch, in the query's time zone
+    ValueStats stats;
+};
+
+struct GroupWater {
+    std::string group;
+    uint64_t runs = 0;
+    uint64_t duration_ms = 0;
+    uint64_t added_ul = 0;
+};
+
+struct DeviceCrossings {
+    size_t device;
+    Crossings crossings;
+};
+
+struct OpenStats {
+    size_t devices = 0;
+    uint64_t moisture_rows = 0;
+    uint64_t pump_rows = 0;
+    uint64_t blocks_described = 0;  // Zone map entries built by this open
+    double seconds = 0.0;
+};
+
+// Runs work(0) .. work(count - 1) on `threads` threads
+template <typename Work>
+void run_partitions(size_t count, unsigned threads, Work work) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) work(i);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads && i < count; i++) pool.emplace_back(worker);
+    worker();
+    for (auto &thread : pool) thread.join();
+}
+
+inline int64_t floor_divide(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+class Engine {
+public:
+    // Opens every device directory under `root` read-only and brings the
+    // zone maps up to date, one device per thread
+    OpenStats open(const std::string &root, unsigned threads) {
+        auto start = std::chrono::steady_clock::now();
+        devices_.clear();
+        DIR *directory = opendir(root.c_str());
+        if (!directory) throw system_error("opendir " + root);
+        std::vector<std::string> names;
+        while (dirent *entry = readdir(directory)) {
+            std::string name = entry->d_name;
+            struct stat st;
+            if (name[0] != '.' && stat((root + "/" + name + "/moisture.meta").c_str(), &st) == 0) {
+                names.push_back(name);
+            }
+        }
+        closedir(directory);
+        std::sort(names.begin(), names.end());
+
+        for (const auto &name : names) {
+            auto device = std::make_unique<Device>();
+            device->name = name;
+            device->store.open(root, name, false);
+            device->moisture_rows = device->store.moisture.row_count();
+            device->pump_rows = device->store.pump.row_count();
+            devices_.push_back(std::move(device));
+        }
+
+        std::atomic<uint64_t> described{0};
+        run_partitions(devices_.size(), threads, [&](size_t index) {
+            Device &device = *devices_[index];
+            std::string base = root + "/" + device.name + "/";
+            const Table &moisture = device.store.moisture;
+            const Table &pump = device.store.pump;
+            uint64_t blocks = 0;
+            blocks += device.moisture_time.load(base + "moisture.time_ns.zmap",
+                                                moisture.column<int64_t>(kMoistureTime), device.moisture_rows);
+            blocks += device.moisture_percent.load(base + "moisture.percent.zmap",
+                                                   moisture.column<uint8_t>(kMoisturePercent), device.moisture_rows);
+            blocks += device.moisture_raw.load(base + "moisture.raw.zmap",
+                                               moisture.column<uint16_t>(kMoistureRaw), device.moisture_rows);
+            blocks += device.pump_time.load(base + "pump.time_ns.zmap", pump.column<int64_t>(kPumpTime),
+                                            device.pump_rows);
+            blocks += device.pump_duration.load(base + "pump.duration_ms.zmap",
+                                                pump.column<uint32_t>(kPumpDuration), device.pump_rows);
+            blocks += device.pump_added.load(base + "pump.added_ul.zmap", pump.column<uint32_t>(kPumpAdded),
+                                             device.pump_rows);
+            described.fetch_add(blocks, std::memory_order_relaxed);
+        });
+
+        OpenStats stats;
+        stats.devices = devices_.size();
+        for (const auto &device : devices_) {
+            stats.moisture_rows += device->moisture_rows;
+            stats.pump_rows += device->pump_rows;
+        }
+        stats.blocks_described = described.load();
+        stats.seconds = seconds_since(start);
+        return stats;
+    }
+
+    size_t device_count() const { return devices_.size(); }
+    const std::string &device_name(size_t device) const { return devices_[device]->name; }
+
+    // Min, mean and max of the percent or raw moisture column per device
+    // and day. Days start at midnight `utc_offset_ns` east of UTC.
+    std::vector<DailyStats> daily_moisture(MoistureColumn column, const TimeRange &range, int64_t utc_offset_ns,
+                                           const QueryOptions &options, QueryStats *stats = nullptr) const {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Partition> partitions = split(false);
+        std::vector<DayPartial> partials(partitions.size());
+        const Kernels &kernels = kernels_for(options.isa);
+        run_partitions(partitions.size(), options.threads, [&](size_t index) {
+            const Partition &partition = partitions[index];
+            const Device &device = *devices_[partition.device];
+            const ZoneMap &values = (column == kMoistureRaw) ? device.moisture_raw : device.moisture_percent;
+            if (column == kMoistureRaw) {
+                scan_days(device, partition, range, utc_offset_ns, options, kernels,
+                          device.store.moisture.column<uint16_t>(kMoistureRaw), values, &partials[index]);
+            } else {
+                scan_days(device, partition, range, utc_offset_ns, options, kernels,
+                          device.store.moisture.column<uint8_t>(kMoisturePercent), values, &partials[index]);
+            }
+        });
+
+        std::vector<DailyStats> result;
+        QueryStats total;
+        size_t index = 0;
+        for (size_t device = 0; device < devices_.size(); device++) {
+            std::map<int64_t, ValueStats> days;
+            for (; index < partitions.size() && partitions[index].device == device; index++) {
+                for (const auto &day : partials[index].days) days[day.first].add(day.second);
+                total.add(partials[index].stats);
+            }
+            for (const auto &day : days) result.push_back(DailyStats{device, day.first, day.second});
+        }
+        finish(start, total, stats);
+        return result;
+    }
+
+    // Pump runs, run time and water per group. group_of_device names the
+    // group of each device, in device order; devices beyond it count
+    // under their own name.
+    std::vector<GroupWater> water_by_group(const std::vector<std::string> &group_of_device, const TimeRange &range,
+                                           const QueryOptions &options, QueryStats *stats = nullptr) const {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Partition> partitions = split(true);
+        std::vector<WaterPartial> partials(partitions.size());
+        const Kernels &kernels = kernels_for(options.isa);
+        run_partitions(partitions.size(), options.threads, [&](size_t index) {
+            scan_water(partitions[index], range, options, kernels, &partials[index]);
+        });
+
+        std::map<std::string, GroupWater> groups;
+        QueryStats total;
+        for (size_t index = 0; index < partitions.size(); index++) {
+            size_t device = partitions[index].device;
+            const std::string &name =
+                (device < group_of_device.size()) ? group_of_device[device] : devices_[device]->name;
+            GroupWater &group = groups[name];
+            group.group = name;
+            group.runs += partials[index].water.runs;
+            group.duration_ms += partials[index].water.duration_ms;
+            group.added_ul += partials[index].water.added_ul;
+            total.add(partials[index].stats);
+        }
+        std::vector<GroupWater> result;
+        for (const auto &group : groups) result.push_back(group.second);
+        finish(start, total, stats);
+        return result;
+    }
+
+    // Times the moisture percent crossed `threshold`, per device. A
+    // crossing is counted between neighbouring rows that are both in the
+    // range.
+    std::vector<DeviceCrossings> threshold_crossings(uint8_t threshold, const TimeRange &range,
+                                                     const QueryOptions &options,
+                                                     QueryStats *stats = nullptr) const {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Partition> partitions = split(false);
+        std::vector<CrossingPartial> partials(partitions.size());
+        const Kernels &kernels = kernels_for(options.isa);
+        run_partitions(partitions.size(), options.threads, [&](size_t index) {
+            scan_crossings(partitions[index], threshold, range, options, kernels, &partials[index]);
+        });
+
+        std::vector<DeviceCrossings> result;
+        for (size_t device = 0; device < devices_.size(); device++) result.push_back(DeviceCrossings{device, {}});
+        QueryStats total;
+        for (size_t index = 0; index < partitions.size(); index++) {
+            result[partitions[index].device].crossings.add(partials[index].crossings);
+            total.add(partials[index].stats);
+        }
+        finish(start, total, stats);
+        return result;
+    }
+
+private:
+    struct Device {
+        std::string name;
+        DeviceStore store;
+        uint64_t moisture_rows = 0;  // Snapshot taken by open()
+        uint64_t pump_rows = 0;
+        ZoneMap moisture_time, moisture_percent, moisture_raw;
+        ZoneMap pump_time, pump_duration, pump_added;
+    };
+
+    struct Partition {
+        size_t device;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // One block of a partition, with its zone map entries; the partial
+    // block at the end of a table is described on the spot
+    struct Block {
+        uint64_t begin;
+        uint64_t end;
+        ZoneEntry time;
+        const ZoneEntry *values;   // nullptr for the partial block
+        bool inside;               // Every row is in the range, by the zone map
+        bool previous_inside;      // So is the row before the block
+        uint64_t lo;               // Rows in the range, if inside or ordered
+        uint64_t hi;
+
+        bool contiguous() const { return inside || (time.flags & kZoneOrdered); }
+    };
+
+    struct DayPartial {
+        std::vector<std::pair<int64_t, ValueStats>> days;
+        QueryStats stats;
+
+        void add(int64_t day, const ValueStats &values) {
+            if (!days.empty() && days.back().first == day) {
+                days.back().second.add(values);
+            } else {
+                days.emplace_back(day, values);
+            }
+        }
+    };
+
+    struct WaterPartial {
+        GroupWater water;
+        QueryStats stats;
+    };
+
+    struct CrossingPartial {
+        Crossings crossings;
+        QueryStats stats;
+    };
+
+    static double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static void finish(std::chrono::steady_clock::time_point start, QueryStats &total, QueryStats *stats) {
+        total.seconds = seconds_since(start);
+        if (stats) *stats = total;
+    }
+
+    std::vector<Partition> split(bool pump) const {
+        std::vector<Partition> partitions;
+        for (size_t device = 0; device < devices_.size(); device++) {
+            uint64_t rows = pump ? devices_[device]->pump_rows : devices_[device]->moisture_rows;
+            for (uint64_t begin = 0; begin < rows; begin += kPartitionRows) {
+                partitions.push_back(Partition{device, begin, std::min(begin + kPartitionRows, rows)});
+            }
+        }
+        return partitions;
+    }
+
+    // Calls visit(block) for every block of the partition that may hold
+    // rows in the range. A block the zone map puts inside the range is
+    // passed on without reading its time column. Without zone maps every
+    // block is visited, and its time column checked for order.
+    template <typename Visit>
+    static void for_each_block(const Partition &partition, const int64_t *time, const ZoneMap &time_map,
+                               const ZoneMap &value_map, const TimeRange &range, const QueryOptions &options,
+                               QueryStats *stats, Visit visit) {
+        stats->rows += partition.end - partition.begin;
+        for (uint64_t begin = partition.begin; begin < partition.end; begin += kBlockRows) {
+            Block block;
+            block.begin = begin;
+            block.end = std::min(begin + kBlockRows, partition.end);
+            block.inside = false;
+            block.previous_inside = false;
+            uint64_t index = begin / kBlockRows;
+            if (options.zone_maps && index < time_map.blocks()) {
+                block.time = time_map[index];
+                block.values = &value_map[index];
+                if (block.time.max < range.begin || block.time.min >= range.end) {
+                    stats->blocks_skipped++;
+                    continue;
+                }
+                block.inside = block.time.min >= range.begin && block.time.max < range.end;
+                block.previous_inside = index > 0 && time_map[index - 1].min >= range.begin &&
+                                        time_map[index - 1].max < range.end;
+            } else {
+                bool ordered = std::is_sorted(time + block.begin, time + block.end);
+                block.time = ZoneEntry{INT64_MIN, INT64_MAX, 0, ordered ? kZoneOrdered : 0};
+                block.values = nullptr;
+            }
+            if (block.inside) {
+                block.lo = block.begin;
+                block.hi = block.end;
+            } else if (block.time.flags & kZoneOrdered) {
+                block.lo = static_cast<uint64_t>(std::lower_bound(time + block.begin, time + block.end, range.begin) - time);
+                block.hi = static_cast<uint64_t>(std::lower_bound(time + block.lo, time + block.end, range.end) - time);
+                if (block.lo == block.hi) continue;
+            }
+            visit(block);
+        }
+    }
+
+    static void stats_kernel(const Kernels &kernels, const uint8_t *values, size_t count, ValueStats *stats) {
+        kernels.stats_u8(values, count, stats);
+    }
+
+    static void stats_kernel(const Kernels &kernels, const uint16_t *values, size_t count, ValueStats *stats) {
+        kernels.stats_u16(values, count, stats);
+    }
+
+    template <typename T>
+    void scan_days(const Device &device, const Partition &partition, const TimeRange &range, int64_t utc_offset_ns,
+                   const QueryOptions &options, const Kernels &kernels, const T *values, const ZoneMap &value_map,
+                   DayPartial *partial) const {
+        const int64_t *time = device.store.moisture.column<int64_t>(kMoistureTime);
+        for_each_block(partition, time, device.moisture_time, value_map, range, options, &partial->stats,
+                       [&](const Block &block) {
+            if (block.values && block.inside) {
+                int64_t day = floor_divide(block.time.min + utc_offset_ns, kDayNs);
+                if (day == floor_divide(block.time.max + utc_offset_ns, kDayNs)) {
+                    ValueStats whole;
+                    whole.count = block.end - block.begin;
+                    whole.sum = block.values->sum;
+                    whole.min = static_cast<uint32_t>(block.values->min);
+                    whole.max = static_cast<uint32_t>(block.values->max);
+                    partial->add(day, whole);
+                    partial->stats.blocks_summed++;
+                    return;
+                }
+            }
+            if (!(block.time.flags & kZoneOrdered)) {
+                for (uint64_t row = block.begin; row < block.end; row++) {
+                    if (!range.contains(time[row])) continue;
+                    ValueStats one;
+                    one.add(values[row]);
+                    partial->add(floor_divide(time[row] + utc_offset_ns, kDayNs), one);
+                }
+                partial->stats.rows_scanned += block.end - block.begin;
+                return;
+            }
+            // One run per day
+            for (uint64_t lo = block.lo; lo < block.hi;) {
+                int64_t day = floor_divide(time[lo] + utc_offset_ns, kDayNs);
+                int64_t next_day = (day + 1) * kDayNs - utc_offset_ns;
+                uint64_t run_end = (time[block.hi - 1] < next_day)
+                    ? block.hi
+                    : static_cast<uint64_t>(std::lower_bound(time + lo, time + block.hi, next_day) - time);
+                ValueStats run;
+                stats_kernel(kernels, values + lo, run_end - lo, &run);
+                partial->stats.rows_scanned += run_end - lo;
+                partial->add(day, run);
+                lo = run_end;
+            }
+        });
+    }
+
+    void scan_water(const Partition &partition, const TimeRange &range, const QueryOptions &options,
+                    const Kernels &kernels, WaterPartial *partial) const {
+        const Device &device = *devices_[partition.device];
+        const int64_t *time = device.store.pump.column<int64_t>(kPumpTime);
+        const uint32_t *duration = device.store.pump.column<uint32_t>(kPumpDuration);
+        const uint32_t *added = device.store.pump.column<uint32_t>(kPumpAdded);
+        GroupWater &water = partial->water;
+        for_each_block(partition, time, device.pump_time, device.pump_added, range, options, &partial->stats,
+                       [&](const Block &block) {
+            if (!block.contiguous()) {
+                for (uint64_t row = block.begin; row < block.end; row++) {
+                    if (!range.contains(time[row])) continue;
+                    water.runs++;
+                    water.duration_ms += duration[row];
+                    water.added_ul += added[row];
+                }
+                partial->stats.rows_scanned += block.end - block.begin;
+            } else if (block.values && block.inside) {
+                uint64_t index = block.begin / kBlockRows;
+                water.runs += block.end - block.begin;
+                water.duration_ms += device.pump_duration[index].sum;
+                water.added_ul += device.pump_added[index].sum;
+                partial->stats.blocks_summed++;
+            } else {
+                water.runs += block.hi - block.lo;
+                water.duration_ms += kernels.sum_u32(duration + block.lo, block.hi - block.lo);
+                water.added_ul += kernels.sum_u32(added + block.lo, block.hi - block.lo);
+                partial->stats.rows_scanned += block.hi - block.lo;
+            }
+        });
+    }
+
+    void scan_crossings(const Partition &partition, uint8_t threshold, const TimeRange &range,
+                        const QueryOptions &options, const Kernels &kernels, CrossingPartial *partial) const {
+        const Device &device = *devices_[partition.device];
+        const int64_t *time = device.store.moisture.column<int64_t>(kMoistureTime);
+        const uint8_t *percent = device.store.moisture.column<uint8_t>(kMoisturePercent);
+        for_each_block(partition, time, device.moisture_time, device.moisture_percent, range, options,
+                       &partial->stats, [&](const Block &block) {
+            // Each pair of neighbours belongs to the block of its second row
+            if (!block.contiguous()) {
+                for (uint64_t row = std::max<uint64_t>(block.begin, 1); row < block.end; row++) {
+                    if (!range.contains(time[row]) || !range.contains(time[row - 1])) continue;
+                    bool before = percent[row - 1] < threshold;
+                    bool below = percent[row] < threshold;
+                    partial->crossings.down += below && !before;
+                    partial->crossings.up += !below && before;
+                }
+                partial->stats.rows_scanned += block.end - block.begin;
+                return;
+            }
+            uint64_t first = block.lo;
+            if (first == block.begin && first > 0 && (block.previous_inside || range.contains(time[first - 1]))) {
+                first--;
+            }
+            if (block.values) {
+                // All values on one side, and the neighbour before them too
+                bool all_below = block.values->max < threshold;
+                bool none_below = block.values->min >= threshold;
+                if ((all_below || none_below) &&
+                    (first == block.lo || (percent[first] < threshold) == all_below)) {
+                    partial->stats.blocks_skipped++;
+                    return;
+                }
+            }
+            kernels.crossings_u8(percent + first, block.hi - first, threshold, &partial->crossings);
+            partial->stats.rows_scanned += block.hi - first;
+        });
+    }
+
+    std::vector<std::unique_ptr<Device>> devices_;
+};
+
+}  // namespace telemetry
+
+#endif  // TELEMETRY_QUERY_H
@@ -0,0 +1,270 @@
+// Append-only, memory-mapped columnar storage for board telemetry.
+//
+// Layout on disk, one directory per device:
+//
+//     <root>/<device>/moisture.meta      TableHeader (magic, row count)
+//     <root>/<device>/moisture.<column>  packed array, one value per row
+//     <root>/<device>/pump.meta
+//     <root>/<device>/pump.<column>
+//     <root>/<device>/energy.meta
+//     <root>/<device>/energy.<column>
+//     <root>/<device>/<table>.<column>.zmap   block zone maps (telemetry_query.h)
+//
+// Column files are plain little-endian arrays, so a reader can mmap a
+// column and scan it directly. Files grow in chunks and are mapped
+// MAP_SHARED; a row becomes visible only when the writer bumps row_count
+// in the .meta file after every column of the row has been written, so a
+// crash never exposes a half-written row. Bytes beyond row_count are
+// ignored and overwritten on the next append.
+//
+// Header-only; shared by ingestd.cpp, loadgen.cpp and the query tools.
+
+#ifndef TELEMETRY_STORE_H
+#define TELEMETRY_STORE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace telemetry {
+
+constexpr uint32_t kTableMagic = 0x54454c4d;  // "TELM"
+constexpr uint32_t kTableVersion = 1;
+constexpr uint64_t kGrowRows = 4096;          // Rows added per file extension
+
+// Sentinel for a missing temperature reading
+constexpr int16_t kNoTemperature = INT16_MIN;
+
+struct TableHeader {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> row_count;
+    uint32_t column_count;
+    uint32_t reserved[11];
+};
+static_assert(sizeof(TableHeader) == 64, "TableHeader is part of the file format");
+
+struct ColumnSpec {
+    const char *name;
+    size_t width;  // Bytes per value
+};
+
+// Schemas. Keep the order stable; readers index columns by position.
+enum MoistureColumn { kMoistureTime, kMoisturePercent, kMoistureRaw, kMoistureTemperature };
+static const ColumnSpec kMoistureColumns[] = {
+    {"time_ns", 8},          // int64, host CLOCK_REALTIME at line receipt
+    {"percent", 1},          // uint8
+    {"raw", 2},              // uint16, ADC counts
+    {"temperature_x16", 2},  // int16, 1/16 degC or kNoTemperature
+};
+
+enum PumpColumn { kPumpTime, kPumpDuration, kPumpDuty, kPumpFlow, kPumpAdded, kPumpTotal };
+static const ColumnSpec kPumpColumns[] = {
+    {"time_ns", 8},          // int64
+    {"duration_ms", 4},      // uint32, tracked interval
+    {"duty_permille", 2},    // uint16, PWM duty x10
+    {"flow_ul_s", 4},        // uint32, uL per second
+    {"added_ul", 4},         // uint32
+    {"total_ul", 4},         // uint32, running total reported by the board
+};
+
+// One row per "Energy:" line; every value covers the interval since the
+// board's previous line
+enum EnergyColumn {
+    kEnergyTime, kEnergyInterval, kEnergyCpu, kEnergyAdc, kEnergyLcd, kEnergyUart, kEnergyPump,
+    kEnergyCharge
+};
+static const ColumnSpec kEnergyColumns[] = {
+    {"time_ns", 8},          // int64
+    {"interval_ms", 4},      // uint32
+    {"cpu_ms", 4},           // uint32, active (awake) time
+    {"adc_ms", 4},           // uint32
+    {"lcd_ms", 4},           // uint32
+    {"uart_ms", 4},          // uint32
+    {"pump_ms", 4},          // uint32, PWM output on
+    {"charge_nah", 4},       // uint32, whole board under the board's current model
+};
+
+inline std::runtime_error system_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+inline void make_directory(const std::string &path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw system_error("mkdir " + path);
+    }
+}
+
+// One mmap'd file that can grow. The descriptor is closed once the file
+// is mapped, so a daemon serving hundreds of devices does not hold ten
+// descriptors per device; grow() reopens the file by path.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    void open(const std::string &path, size_t minimum_size, bool writable) {
+        path_ = path;
+        writable_ = writable;
+        int fd = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if (fd < 0) throw system_error("open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw system_error("stat " + path);
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        if (writable && size < minimum_size) {
+            size = minimum_size;
+            allocate(fd, size);
+        }
+        map(fd, size);
+        ::close(fd);
+    }
+
+    void grow(size_t new_size) {
+        if (new_size <= size_) return;
+        int fd = ::open(path_.c_str(), O_RDWR);
+        if (fd < 0) throw system_error("open " + path_);
+        allocate(fd, new_size);
+        ::close(fd);
+        void *address = mremap(data_, size_, new_size, MREMAP_MAYMOVE);
+        if (address == MAP_FAILED) throw system_error("mremap " + path_);
+        data_ = static_cast<uint8_t *>(address);
+        size_ = new_size;
+    }
+
+    void close() {
+        if (data_) munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    // Reserves the blocks up front: a sparse file would allocate them in
+    // the page fault of the first store, stalling the ingest loop
+    void allocate(int fd, size_t size) {
+        int error = posix_fallocate(fd, 0, static_cast<off_t>(size));
+        if (error != 0) {
+            ::close(fd);
+            errno = error;
+            throw system_error("fallocate " + path_);
+        }
+    }
+
+    void map(int fd, size_t size) {
+        size_ = size;
+        if (size == 0) return;
+        int protection = writable_ ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void *address = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            throw system_error("mmap " + path_);
+        }
+        data_ = static_cast<uint8_t *>(address);
+    }
+
+    std::string path_;
+    bool writable_ = false;
+    uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// A set of equally long columns plus the header holding the row count
+class Table {
+public:
+    template <size_t N>
+    void open(const std::string &directory, const std::string &name,
+              const ColumnSpec (&columns)[N], bool writable) {
+        specs_.assign(columns, columns + N);
+        header_file_.open(directory + "/" + name + ".meta", sizeof(TableHeader), writable);
+        header_ = reinterpret_cast<TableHeader *>(header_file_.data());
+        if (writable && header_->magic != kTableMagic) {
+            header_->magic = kTableMagic;
+            header_->version = kTableVersion;
+            header_->row_count.store(0, std::memory_order_relaxed);
+            header_->column_count = static_cast<uint32_t>(N);
+        }
+        if (header_->magic != kTableMagic || header_->column_count != N) {
+            throw std::runtime_error("bad table header in " + directory + "/" + name);
+        }
+        columns_.clear();
+        uint64_t rows = row_count();
+        for (size_t i = 0; i < N; i++) {
+            size_t minimum = writable ? (rows + kGrowRows) * specs_[i].width : 0;
+            columns_.push_back(std::make_unique<MappedFile>());
+            columns_[i]->open(directory + "/" + name + "." + specs_[i].name, minimum, writable);
+        }
+        capacity_ = writable ? rows + kGrowRows : rows;
+    }
+
+    uint64_t row_count() const { return header_->row_count.load(std::memory_order_acquire); }
+
+    // Pointer to the slot for value `column` of the row being appended
+    uint8_t *append_slot(size_t column) {
+        uint64_t row = header_->row_count.load(std::memory_order_relaxed);
+        if (row >= capacity_) {
+            capacity_ += kGrowRows;
+            for (size_t i = 0; i < columns_.size(); i++) {
+                columns_[i]->grow(capacity_ * specs_[i].width);
+            }
+        }
+        return columns_[column]->data() + row * specs_[column].width;
+    }
+
+    template <typename T>
+    void set(size_t column, T value) {
+        std::memcpy(append_slot(column), &value, sizeof(T));
+    }
+
+    // Publishes the row whose columns were filled with set()
+    void commit_row() {
+        header_->row_count.fetch_add(1, std::memory_order_release);
+    }
+
+    template <typename T>
+    const T *column(size_t index) const {
+        return reinterpret_cast<const T *>(columns_[index]->data());
+    }
+
+private:
+    std::vector<ColumnSpec> specs_;
+    MappedFile header_file_;
+    TableHeader *header_ = nullptr;
+    std::vector<std::unique_ptr<MappedFile>> columns_;
+    uint64_t capacity_ = 0;
+};
+
+// All tables of one device
+struct DeviceStore {
+    Table moisture;
+    Table pump;
+    Table energy;
+
+    void open(const std::string &root, const std::string &device, bool writable) {
+        std::string directory = root + "/" + device;
+        if (writable) make_directory(directory);
+        moisture.open(directory, "moisture", kMoistureColumns, writable);
+        pump.open(directory, "pump", kPumpColumns, writable);
+        energy.open(directory, "energy", kEnergyColumns, writable);
+    }
+};
+
+}  // namespace telemetry
+
+#endif  // TELEMETRY_STORE_H
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Decode a firmware trace dump into a timeline or a Chrome trace.
+
+Capture the serial output after sending the 'T' command to the board, then:
+
+    python tools/trace_decode.py capture.log             # text timeline
+    python tools/trace_decode.py --chrome capture.log > trace.json
+
+The JSON output loads in chrome://tracing or https://ui.perfetto.dev.
+The dump format is produced by trace_dump() in Irrigation_System.X/trace.c.
+"""
+
+import argparse
+import json
+import sys
+
+# Must match TraceEventId in Irrigation_System.X/trace.h
+EVENT_NAMES = {
+    1: "BOOT",
+    2: "STATE_CHANGE",
+    3: "PUMP_ON",
+    4: "PUMP_OFF",
+    5: "MOISTURE_READING",
+    6: "CALIBRATION",
+    7: "MARK",
+    8: "BOOT_MILESTONE",
+    9: "INTERLOCK_TRIP",
+    10: "CONFIG",
+    11: "FSM",
+    12: "FW_UPDATE",
+}
+
+STATE_NAMES = ["IDLE", "INIT", "RUNNING", "ERROR", "STANDBY"]
+BOOT_MILESTONES = ["STATE_RESTORED", "FIRST_CONTROL_ACTION", "CALIBRATION_LOADED",
+                   "LCD_READY", "FIRST_VALID_READING", "BOOT_COMPLETE"]
+INTERLOCK_TRIPS = ["NONE", "ON_TIME", "VOLUME", "DRY_RUN", "LEAK"]
+CONFIG_RESULTS = ["APPLIED", "LENGTH", "MAGIC", "FORMAT", "CRC", "VERSION", "PLANTS", "PUMP",
+                  "SAMPLING"]
+FW_FRAMES = ["HEADER", "RECORD", "ACTIVATE"]
+FW_RESULTS = ["OK", "LENGTH", "MAGIC", "FORMAT", "CRC", "SIZE", "BASE", "SESSION", "ORDER", "OPS",
+              "FLASH", "IMAGE", "STATE"]
+CALIBRATION_STATES = ["IDLE", "DRY_WAIT", "DRY_RECORD", "WET_WAIT", "WET_RECORD", "COMPLETE"]
+# State and event names of the hsm.h machines, by TRACE_FSM_* number
+FSM_MACHINES = [
+    ("APP", STATE_NAMES + ["APP"], ["BUTTON", "FAULT"]),
+    ("MOISTURE", ["IDLE", "INIT_MEASUREMENT", "WAIT_CONVERSION", "PROCESS_DATA", "CONVERT",
+                  "SEND_UART", "WAIT_TIMER", "MONITOR", "WAITING"],
+     ["DONE", "ARMED", "CROSSED", "TIMEOUT"]),
+    ("CALIBRATION", CALIBRATION_STATES + ["ACTIVE"], ["START", "PRESS", "RELEASE", "RETRY"]),
+]
+
+
+def parse_dump(lines):
+    """Return (records, lost) from the last complete TRACE block in lines."""
+    records, lost, block = [], 0, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE BEGIN"):
+            fields = line.split()
+            block, lost = [], int(fields[3]) if len(fields) > 3 else 0
+        elif line == "TRACE END" and block is not None:
+            records, block = block, None
+        elif block is not None:
+            fields = line.split()
+            if len(fields) != 4:
+                continue
+            timestamp, event, arg8, arg16 = (int(f, 16) for f in fields)
+            block.append((timestamp, event, arg8, arg16))
+    return records, lost
+
+
+def describe_fsm(machine, event, source, target):
+    if machine >= len(FSM_MACHINES):
+        return "machine %d event %d: %d -> %d" % (machine, event, source, target)
+    name, states, events = FSM_MACHINES[machine]
+
+    def state(number):
+        if number == 0xFF:
+            return "(start)"
+        return states[number] if number < len(states) else str(number)
+
+    cause = "forced" if event == 31 else (events[event] if event < len(events) else str(event))
+    return "%s %s -> %s on %s" % (name, state(source), state(target), cause)
+
+
+def describe(event, arg8, arg16):
+    name = EVENT_NAMES.get(event, "EVENT_%d" % event)
+    if event == 1:
+        return name, "reset cause 0x%02x" % arg8
+    if event == 2:
+        old = STATE_NAMES[arg8] if arg8 < len(STATE_NAMES) else str(arg8)
+        new = STATE_NAMES[arg16] if arg16 < len(STATE_NAMES) else str(arg16)
+        return name, "%s -> %s" % (old, new)
+    if event == 3:
+        return name, "cc=%d" % arg16
+    if event == 4:
+        return name, "total=%d mL" % arg16
+    if event == 5:
+        return name, "%d%% (raw %d)" % (arg8, arg16)
+    if event == 6:
+        state = CALIBRATION_STATES[arg8] if arg8 < len(CALIBRATION_STATES) else str(arg8)
+        return name, "%s value=%d" % (state, arg16)
+    if event == 8:
+        milestone = BOOT_MILESTONES[arg8] if arg8 < len(BOOT_MILESTONES) else str(arg8)
+        return name, "%s at %d us" % (milestone, arg16)
+    if event == 9:
+        trip = INTERLOCK_TRIPS[arg8] if arg8 < len(INTERLOCK_TRIPS) else str(arg8)
+        return name, "%s after %d mL" % (trip, arg16)
+    if event == 10:
+        result = CONFIG_RESULTS[arg8] if arg8 < len(CONFIG_RESULTS) else str(arg8)
+        return name, "%s version %d" % (result, arg16)
+    if event == 11:
+        return name, describe_fsm(arg8 >> 5, arg8 & 0x1F, arg16 >> 8, arg16 & 0xFF)
+    if event == 12:
+        frame = FW_FRAMES[arg8 >> 4] if (arg8 >> 4) < len(FW_FRAMES) else str(arg8 >> 4)
+        result = FW_RESULTS[arg8 & 0x0F] if (arg8 & 0x0F) < len(FW_RESULTS) else str(arg8 & 0x0F)
+        return name, "%s %s, next row %d" % (frame, result, arg16)
+    return name, "arg8=%d arg16=%d" % (arg8, arg16)
+
+
+def print_timeline(records, lost, out):
+    if lost:
+        out.write("(%d older events overwritten)\n" % lost)
+    if not records:
+        return
+    origin = records[0][0]
+    for timestamp, event, arg8, arg16 in records:
+        name, detail = describe(event, arg8, arg16)
+        out.write("%10d ms  +%9.3f s  %-17s %s\n"
+                  % (timestamp, (timestamp - origin) / 1000.0, name, detail))
+
+
+def chrome_trace(records):
+    events = []
+    pump_running = False
+    for timestamp, event, arg8, arg16 in records:
+        ts = timestamp * 1000  # Chrome trace timestamps are in microseconds
+        name, detail = describe(event, arg8, arg16)
+        if event == 3 and not pump_running:
+            events.append({"name": "pump", "ph": "B", "ts": ts, "pid": 1, "tid": 2,
+                           "args": {"cc": arg16}})
+            pump_running = True
+        elif event == 4 and pump_running:
+            events.append({"name": "pump", "ph": "E", "ts": ts, "pid": 1, "tid": 2,
+                           "args": {"total_ml": arg16}})
+            pump_running = False
+        elif event == 5:
+            events.append({"name": "moisture", "ph": "C", "ts": ts, "pid": 1,
+                           "args": {"percent": arg8, "raw": arg16}})
+        else:
+            events.append({"name": name, "ph": "i", "s": "p", "ts": ts, "pid": 1, "tid": 1,
+                           "args": {"detail": detail}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="serial capture file (default: stdin)")
+    parser.add_argument("--chrome", action="store_true", help="emit Chrome trace JSON")
+    args = parser.parse_args()
+
+    source = open(args.capture, errors="replace") if args.capture else sys.stdin
+    with source:
+        records, lost = parse_dump(source)
+
+    if args.chrome:
+        json.dump(chrome_trace(records), sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    else:
+        print_timeline(records, lost, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,342 @@
+/*
+ * Sustained-throughput simulation of the console UART receive path.
+ *
+ * A host tool streams frames at full baud into the console UART while
+ * the main loop runs with realistic busy periods. Two receive paths see
+ * the same byte stream:
+ *  - "polled": the old Check_Commands(). One SERCOM5_USART_Read of one
+ *    byte per main-loop pass, behind the SERCOM's two-byte receive
+ *    buffer. Bytes arriving into a full buffer are lost (BUFOVF).
+ *  - "dma": the ping-pong ring of console_rx.c, framed by
+ *    Irrigation_System.X/rx_framer.c. The ring is filled as the DMAC
+ *    would fill it. The block-complete count is updated with interrupt
+ *    latency, so the framer's position resolution is exercised too.
+ *
+ *     cc -O2 -I Irrigation_System.X -o uart_rx_sim tools/uart_rx_sim.c \
+ *        Irrigation_System.X/rx_framer.c Irrigation_System.X/crc32.c
+ *     ./uart_rx_sim [simulated_seconds]
+ *
+ * Every frame carries a CRC-32, checked on delivery. Two framings:
+ *  - "idle": binary frames of 16..264 bytes, with FRAME_GAP_MS of
+ *    silence after each, so the idle timeout can end them;
+ *  - "delim": text lines (CRC as hex) ended by '\n', back to back at the
+ *    full line rate.
+ *
+ * The main loop takes LOOP_NS per pass. The periodic blocking work in
+ * BUSY_SOURCES stalls it for milliseconds at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rx_framer.h"
+#include "crc32.h"
+
+#define DEFAULT_SECONDS     10U
+#define LOOP_NS             25000ULL     // One main-loop pass without blocking work
+#define ISR_LATENCY_NS      2000ULL      // Block complete to halves_done++
+#define FRAME_MAX           264U
+#define IDLE_MS             5U
+#define FRAME_GAP_MS        (2U * IDLE_MS)
+#define MAX_RING            4096U
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t busy_us;
+} BusySource;
+
+// Blocking work in the main loop and how long it holds the CPU
+static const BusySource BUSY_SOURCES[] = {
+    { "LCD refresh",       500U, 3000U },  // HD44780 writes with busy delays
+    { "1-Wire transaction", 750U, 1500U },
+    { "flash page write",  5000U, 2500U },
+    { "flash row erase",   60000U, 6000U },
+};
+#define BUSY_SOURCE_COUNT (sizeof(BUSY_SOURCES) / sizeof(BUSY_SOURCES[0]))
+
+typedef enum { FRAMING_IDLE, FRAMING_DELIMITER } Framing;
+
+// --- Host traffic ---
+
+typedef struct {
+    Framing framing;
+    uint64_t char_ns;
+    uint64_t next_ns;            // Arrival time of the next byte
+    uint8_t frame[FRAME_MAX + 16U];
+    uint16_t length;
+    uint16_t index;
+    uint32_t frame_id;
+    uint64_t bytes_sent;
+} Traffic;
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void traffic_next_frame(Traffic *traffic) {
+    uint16_t body = (uint16_t)(12U + rng() % (FRAME_MAX - 4U - 12U + 1U));
+    uint16_t length;
+
+    if (traffic->framing == FRAMING_IDLE) {
+        for (uint16_t i = 0; i < body; i++) {
+            traffic->frame[i] = (uint8_t)rng();
+        }
+        uint32_t crc = crc32_update(CRC32_INITIAL, traffic->frame, body);
+        memcpy(&traffic->frame[body], &crc, 4);
+        length = (uint16_t)(body + 4U);
+    } else {
+        body = (uint16_t)(body - 4U);  // 8 hex digits instead of 4 bytes
+        for (uint16_t i = 0; i < body; i++) {
+            traffic->frame[i] = (uint8_t)(0x20U + rng() % 95U);
+        }
+        uint32_t crc = crc32_update(CRC32_INITIAL, traffic->frame, body);
+        snprintf((char *)&traffic->frame[body], 9, "%08x", (unsigned)crc);
+        traffic->frame[body + 8U] = '\n';
+        length = (uint16_t)(body + 9U);
+    }
+    traffic->length = length;
+    traffic->index = 0;
+    traffic->frame_id++;
+}
+
+static void traffic_init(Traffic *traffic, Framing framing, uint32_t baud) {
+    memset(traffic, 0, sizeof(*traffic));
+    traffic->framing = framing;
+    traffic->char_ns = 10ULL * 1000000000ULL / baud;  // 8N1
+    traffic->next_ns = traffic->char_ns;
+    traffic_next_frame(traffic);
+}
+
+// Takes the byte that finishes arriving at traffic->next_ns
+static uint8_t traffic_take(Traffic *traffic) {
+    uint8_t byte = traffic->frame[traffic->index++];
+    traffic->bytes_sent++;
+    traffic->next_ns += traffic->char_ns;
+    if (traffic->index == traffic->length) {
+        if (traffic->framing == FRAMING_IDLE) {
+            traffic->next_ns += FRAME_GAP_MS * 1000000ULL;
+        }
+        traffic_next_frame(traffic);
+    }
+    return byte;
+}
+
+// --- Main loop ---
+
+typedef struct {
+    uint64_t next_due_ns[BUSY_SOURCE_COUNT];
+} Loop;
+
+static void loop_init(Loop *loop) {
+    for (size_t i = 0; i < BUSY_SOURCE_COUNT; i++) {
+        loop->next_due_ns[i] = (uint64_t)(rng() % BUSY_SOURCES[i].period_ms) * 1000000ULL;
+    }
+}
+
+// Length of the pass starting at @p now_ns
+static uint64_t loop_pass_ns(Loop *loop, uint64_t now_ns) {
+    uint64_t pass = LOOP_NS;
+    for (size_t i = 0; i < BUSY_SOURCE_COUNT; i++) {
+        if (now_ns >= loop->next_due_ns[i]) {
+            pass += BUSY_SOURCES[i].busy_us * 1000ULL;
+            loop->next_due_ns[i] += BUSY_SOURCES[i].period_ms * 1000000ULL;
+        }
+    }
+    return pass;
+}
+
+// --- Results ---
+
+typedef struct {
+    uint64_t sent;
+    uint64_t delivered;          // Bytes in frames that passed the CRC, delimiters excluded
+    uint64_t dropped;
+    uint32_t frames_sent;
+    uint32_t frames_good;
+    uint32_t frames_bad;
+    uint32_t interrupts;
+    uint32_t copied;
+    uint32_t position_errors;
+} Result;
+
+// --- Polled baseline ---
+
+static Result run_polled(Framing framing, uint32_t baud, uint32_t seconds) {
+    Result result = {0};
+    Traffic traffic;
+    Loop loop;
+    uint64_t end_ns = (uint64_t)seconds * 1000000000ULL;
+    uint8_t fifo_count = 0;
+    uint32_t frame = 1, frame_bytes = 0;
+    bool damaged = false;
+
+    rng_state = 12345;
+    traffic_init(&traffic, framing, baud);
+    loop_init(&loop);
+
+    for (uint64_t now = 0; now < end_ns; now += loop_pass_ns(&loop, now)) {
+        while (traffic.next_ns <= now) {
+            (void)traffic_take(&traffic);
+            if (fifo_count < 2) {
+                fifo_count++;
+            } else {
+                result.dropped++;
+                damaged = true;
+            }
+            frame_bytes++;
+            if (traffic.frame_id != frame) {
+                // Last byte of the frame: it got through only if all did
+                if (damaged) {
+                    result.frames_bad++;
+                } else {
+                    result.frames_good++;
+                    result.delivered += frame_bytes - (framing == FRAMING_DELIMITER ? 1U : 0U);
+                }
+                frame = traffic.frame_id;
+                frame_bytes = 0;
+                damaged = false;
+            }
+        }
+        if (fifo_count > 0) {
+            fifo_count--;        // Check_Commands(): one byte per pass
+        }
+    }
+    result.sent = traffic.bytes_sent;
+    result.frames_sent = traffic.frame_id - 1U;
+    return result;
+}
+
+// --- DMA ring ---
+
+typedef struct {
+    Framing framing;
+    Result *result;
+} Checker;
+
+static void check_frame(const uint8_t *frame, uint16_t length, void *context) {
+    Checker *checker = context;
+    bool good = false;
+
+    if (checker->framing == FRAMING_IDLE) {
+        if (length > 4U) {
+            uint32_t crc;
+            memcpy(&crc, &frame[length - 4U], 4);
+            good = crc32_update(CRC32_INITIAL, frame, length - 4U) == crc;
+        }
+    } else if (length > 8U) {
+        char hex[9];
+        snprintf(hex, sizeof(hex), "%08x",
+                 (unsigned)crc32_update(CRC32_INITIAL, frame, length - 8U));
+        good = memcmp(hex, &frame[length - 8U], 8) == 0;
+    }
+    if (good) {
+        checker->result->frames_good++;
+        checker->result->delivered += length;
+    } else {
+        checker->result->frames_bad++;
+    }
+}
+
+static Result run_dma(Framing framing, uint32_t baud, uint32_t seconds, uint16_t ring_size) {
+    static uint8_t ring[MAX_RING];
+    static uint8_t scratch[FRAME_MAX];
+    Result result = {0};
+    Checker checker = { framing, &result };
+    Traffic traffic;
+    Loop loop;
+    RxFramer framer;
+    uint64_t end_ns = (uint64_t)seconds * 1000000000ULL;
+    uint32_t written = 0;        // Bytes the DMA has stored
+    uint16_t half = ring_size / 2U;
+    // Completion times of halves whose interrupt has not run yet
+    uint64_t pending[64];
+    uint32_t pending_head = 0, pending_tail = 0;
+    uint32_t halves_done = 0;
+
+    rng_state = 12345;
+    traffic_init(&traffic, framing, baud);
+    loop_init(&loop);
+    rx_framer_init(&framer, ring, ring_size, scratch, FRAME_MAX,
+                   framing == FRAMING_DELIMITER ? '\n' : RX_FRAMER_NO_DELIMITER,
+                   IDLE_MS, 0);
+
+    for (uint64_t now = 0; now < end_ns; now += loop_pass_ns(&loop, now)) {
+        while (traffic.next_ns <= now) {
+            uint64_t arrival = traffic.next_ns;
+            ring[written & (ring_size - 1U)] = traffic_take(&traffic);
+            written++;
+            if (written % half == 0) {
+                pending[pending_head++ % 64U] = arrival + ISR_LATENCY_NS;
+            }
+        }
+        while (pending_tail != pending_head && pending[pending_tail % 64U] <= now) {
+            pending_tail++;
+            halves_done++;
+        }
+
+        uint32_t resolved = rx_framer_written(&framer, halves_done,
+                                              (uint16_t)(written & (ring_size - 1U)));
+        if (resolved != written) {
+            result.position_errors++;
+        }
+        rx_framer_poll(&framer, resolved, (uint32_t)(now / 1000000ULL), check_frame, &checker);
+    }
+    // Let the idle timeout end the last frame
+    rx_framer_poll(&framer, written, (uint32_t)(end_ns / 1000000ULL) + 2U * IDLE_MS,
+                   check_frame, &checker);
+    result.sent = traffic.bytes_sent;
+    result.frames_sent = traffic.frame_id - 1U;
+    result.dropped = framer.stats.dropped;
+    result.interrupts = halves_done;
+    result.copied = framer.stats.copied;
+    return result;
+}
+
+static void print_result(const char *path, const char *framing, uint32_t baud,
+                         uint16_t ring_size, uint32_t seconds, const Result *r) {
+    char ring_text[16] = "-";
+    if (ring_size != 0) {
+        snprintf(ring_text, sizeof(ring_text), "%u", ring_size);
+    }
+    printf("%-7s %-6s %8u %5s %8.1f %8.1f %9llu %6u/%-6u %7.0f %6u\n",
+           path, framing, baud, ring_text,
+           r->sent / 1024.0 / seconds, r->delivered / 1024.0 / seconds,
+           (unsigned long long)r->dropped, r->frames_good, r->frames_sent,
+           (double)r->interrupts / seconds, r->copied);
+    if (r->position_errors != 0) {
+        printf("        position resolution errors: %u\n", r->position_errors);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = (argc > 1) ? (uint32_t)atoi(argv[1]) : DEFAULT_SECONDS;
+    static const uint32_t BAUDS[] = { 115200U, 1000000U };
+    static const uint16_t RINGS[] = { 512U, 1024U, 2048U };
+
+    printf("%u s per run, main loop %.0f us per pass plus:", seconds, LOOP_NS / 1000.0);
+    for (size_t i = 0; i < BUSY_SOURCE_COUNT; i++) {
+        printf("%s %s %.1f ms every %u ms", i ? "," : "", BUSY_SOURCES[i].name,
+               BUSY_SOURCES[i].busy_us / 1000.0, BUSY_SOURCES[i].period_ms);
+    }
+    printf("\n\n%-7s %-6s %8s %5s %8s %8s %9s %13s %7s %6s\n", "path", "frame", "baud", "ring",
+           "KiB/s in", "KiB/s ok", "dropped", "frames ok", "irq/s", "copied");
+
+    for (int f = 0; f < 2; f++) {
+        Framing framing = f ? FRAMING_DELIMITER : FRAMING_IDLE;
+        const char *name = f ? "delim" : "idle";
+        for (size_t b = 0; b < sizeof(BAUDS) / sizeof(BAUDS[0]); b++) {
+            Result polled = run_polled(framing, BAUDS[b], seconds);
+            print_result("polled", name, BAUDS[b], 0, seconds, &polled);
+            for (size_t r = 0; r < sizeof(RINGS) / sizeof(RINGS[0]); r++) {
+                Result dma = run_dma(framing, BAUDS[b], seconds, RINGS[r]);
+                print_result("dma", name, BAUDS[b], RINGS[r], seconds, &dma);
+            }
+        }
+    }
+    return 0;
+}